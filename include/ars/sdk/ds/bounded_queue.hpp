@@ -0,0 +1,134 @@
+/**
+ * Copyright © 2021 <wotsen>.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of this software
+ * and associated documentation files (the “Software”), to deal in the Software without
+ * restriction, including without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sublicense, and/or sell copies of the Software, and to permit persons to whom the
+ *
+ * The above copyright notice and this permission notice shall be included in all copies or
+ * substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED “AS IS”, WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING
+ * BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM,
+ * DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ *
+ * @file bounded_queue.hpp
+ * @brief 有界无锁多生产者多消费者队列
+ * @author wotsen (astralrovers@outlook.com)
+ * @version 1.0.0
+ * @date 2021-05-05
+ *
+ * @copyright MIT
+ *
+ */
+#pragma once
+#include <stddef.h>
+#include <stdint.h>
+#include <atomic>
+#include <new>
+#include <type_traits>
+#include <utility>
+
+namespace ars {
+
+namespace sdk {
+
+/**
+ * @brief 有界无锁队列，槽位构造时一次分配，入队出队不再分配内存
+ *
+ * 每个槽位带序号，生产者/消费者各自 CAS 抢位置后只写自己的槽位。
+ * 满时 try_push 返回 false，由调用者决定退路。
+ *
+ * @tparam T 元素类型，需可移动
+ */
+template <typename T>
+class bounded_mpmc_queue {
+public:
+    /// @param capacity 容量，向上取 2 的幂
+    explicit bounded_mpmc_queue(size_t capacity) {
+        size_t n = 2;
+        while (n < capacity) n <<= 1;
+        mask_ = n - 1;
+        cells_ = new cell_t[n];
+        for (size_t i = 0; i < n; ++i) {
+            cells_[i].seq.store(i, std::memory_order_relaxed);
+        }
+        head_.store(0, std::memory_order_relaxed);
+        tail_.store(0, std::memory_order_relaxed);
+    }
+
+    ~bounded_mpmc_queue() {
+        T tmp;
+        while (try_pop(tmp)) {
+        }
+        delete[] cells_;
+    }
+
+    bounded_mpmc_queue(const bounded_mpmc_queue&) = delete;
+    bounded_mpmc_queue& operator=(const bounded_mpmc_queue&) = delete;
+
+    /// 入队，满时返回 false 且 v 不被移走
+    bool try_push(T&& v) {
+        size_t pos = tail_.load(std::memory_order_relaxed);
+        for (;;) {
+            cell_t* cell = &cells_[pos & mask_];
+            size_t seq = cell->seq.load(std::memory_order_acquire);
+            intptr_t dif = (intptr_t)seq - (intptr_t)pos;
+            if (dif == 0) {
+                if (tail_.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed)) {
+                    new (&cell->storage) T(std::move(v));
+                    cell->seq.store(pos + 1, std::memory_order_release);
+                    return true;
+                }
+            } else if (dif < 0) {
+                return false;
+            } else {
+                pos = tail_.load(std::memory_order_relaxed);
+            }
+        }
+    }
+
+    /// 出队，空时返回 false
+    bool try_pop(T& v) {
+        size_t pos = head_.load(std::memory_order_relaxed);
+        for (;;) {
+            cell_t* cell = &cells_[pos & mask_];
+            size_t seq = cell->seq.load(std::memory_order_acquire);
+            intptr_t dif = (intptr_t)seq - (intptr_t)(pos + 1);
+            if (dif == 0) {
+                if (head_.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed)) {
+                    T* p = reinterpret_cast<T*>(&cell->storage);
+                    v = std::move(*p);
+                    p->~T();
+                    cell->seq.store(pos + mask_ + 1, std::memory_order_release);
+                    return true;
+                }
+            } else if (dif < 0) {
+                return false;
+            } else {
+                pos = head_.load(std::memory_order_relaxed);
+            }
+        }
+    }
+
+    size_t capacity(void) const { return mask_ + 1; }
+
+private:
+    struct cell_t {
+        std::atomic<size_t> seq;
+        typename std::aligned_storage<sizeof(T), alignof(T)>::type storage;
+    };
+
+    // NOTE: keep producers and consumers on their own cache lines.
+    alignas(64) cell_t* cells_;
+    size_t mask_;
+    alignas(64) std::atomic<size_t> tail_;
+    alignas(64) std::atomic<size_t> head_;
+};
+
+} // namespace sdk
+
+} // namespace ars
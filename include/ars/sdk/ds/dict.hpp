@@ -33,6 +33,8 @@ namespace ars {
     
 namespace sdk {
 
+class Arena;
+
 /// 字典
 
 typedef struct _keypair_ {
@@ -46,6 +48,7 @@ typedef struct _dict_ {
     uint32_t used;
     uint32_t size;
     keypair *table;
+    Arena *arena;   // 非空时所有内存取自arena，dict_free无需调用
 } dict;
 
 typedef struct _key_list_ {
@@ -55,6 +58,8 @@ typedef struct _key_list_ {
 
 
 dict *dict_new(void);
+/// 键、表和key_list都从arena分配，随arena一起回收
+dict *dict_new(Arena *arena);
 void dict_free(dict *d);
 int dict_add(dict *d, char *key, char *val);
 int dict_del(dict *d, char * key);
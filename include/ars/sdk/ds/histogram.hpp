@@ -0,0 +1,129 @@
+/**
+ * Copyright © 2021 <wotsen>.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of this software
+ * and associated documentation files (the “Software”), to deal in the Software without
+ * restriction, including without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sublicense, and/or sell copies of the Software, and to permit persons to whom the
+ *
+ * The above copyright notice and this permission notice shall be included in all copies or
+ * substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED “AS IS”, WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING
+ * BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM,
+ * DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ *
+ * @file histogram.hpp
+ * @brief
+ * @author wotsen (astralrovers@outlook.com)
+ * @version 1.0.0
+ * @date 2021-04-04
+ *
+ * @copyright MIT
+ *
+ */
+#pragma once
+#include <stdint.h>
+
+namespace ars {
+
+namespace sdk {
+
+/// 对数线性直方图(HDR风格)
+/// 小于16的值每值一个桶, 之后每个2的幂区间分8个桶, 相对误差不超过12.5%, 覆盖到2^32.
+/// 只允许一个线程写, 其他线程可以无锁读取(各字段单独原子, 快照之间可能差一次记录).
+
+#define HISTOGRAM_SUB_BITS 3
+#define HISTOGRAM_SUB_COUNT (1 << HISTOGRAM_SUB_BITS)
+#define HISTOGRAM_MAX_BITS 32
+#define HISTOGRAM_BUCKETS ((HISTOGRAM_MAX_BITS - HISTOGRAM_SUB_BITS + 1) * HISTOGRAM_SUB_COUNT)
+
+struct histogram {
+    uint64_t count;
+    uint64_t sum;
+    uint64_t max;
+    uint64_t buckets[HISTOGRAM_BUCKETS];
+};
+
+// NOTE: single writer, so load + store instead of locked add, readers see no torn value.
+static inline void stat_counter_add(uint64_t* counter, uint64_t v) {
+    __atomic_store_n(counter, __atomic_load_n(counter, __ATOMIC_RELAXED) + v, __ATOMIC_RELAXED);
+}
+
+// NOTE: several writers, e.g. io_write called out of the loop thread.
+static inline void stat_counter_add_shared(uint64_t* counter, uint64_t v) {
+    __atomic_fetch_add(counter, v, __ATOMIC_RELAXED);
+}
+
+static inline uint64_t stat_counter_get(const uint64_t* counter) {
+    return __atomic_load_n(counter, __ATOMIC_RELAXED);
+}
+
+static inline int histogram_bucket(uint64_t v) {
+    if (v >= ((uint64_t)1 << HISTOGRAM_MAX_BITS)) {
+        v = ((uint64_t)1 << HISTOGRAM_MAX_BITS) - 1;
+    }
+    if (v < 2 * HISTOGRAM_SUB_COUNT) return (int)v;
+    int msb = 63 - __builtin_clzll(v);
+    int shift = msb - HISTOGRAM_SUB_BITS;
+    return shift * HISTOGRAM_SUB_COUNT + (int)(v >> shift);
+}
+
+// lowest value of the bucket
+static inline uint64_t histogram_bucket_value(int idx) {
+    if (idx < 2 * HISTOGRAM_SUB_COUNT) return idx;
+    int shift = idx / HISTOGRAM_SUB_COUNT - 1;
+    return (uint64_t)(idx % HISTOGRAM_SUB_COUNT + HISTOGRAM_SUB_COUNT) << shift;
+}
+
+static inline void histogram_record(struct histogram* h, uint64_t v) {
+    stat_counter_add(&h->buckets[histogram_bucket(v)], 1);
+    stat_counter_add(&h->sum, v);
+    if (v > h->max) {
+        __atomic_store_n(&h->max, v, __ATOMIC_RELAXED);
+    }
+    // NOTE: count last, so count never exceeds the buckets for readers.
+    __atomic_store_n(&h->count, h->count + 1, __ATOMIC_RELEASE);
+}
+
+static inline void histogram_snapshot(struct histogram* dst, const struct histogram* src) {
+    dst->count = __atomic_load_n(&src->count, __ATOMIC_ACQUIRE);
+    dst->sum = stat_counter_get(&src->sum);
+    dst->max = stat_counter_get(&src->max);
+    for (int i = 0; i < HISTOGRAM_BUCKETS; ++i) {
+        dst->buckets[i] = stat_counter_get(&src->buckets[i]);
+    }
+}
+
+// @param percent: 0~100
+// @return upper bound of the bucket holding the percentile, 0 if empty.
+static inline uint64_t histogram_percentile(const struct histogram* h, double percent) {
+    uint64_t total = 0;
+    for (int i = 0; i < HISTOGRAM_BUCKETS; ++i) {
+        total += h->buckets[i];
+    }
+    if (total == 0) return 0;
+    uint64_t rank = (uint64_t)(total * percent / 100.0 + 0.5);
+    if (rank == 0) rank = 1;
+    if (rank > total) rank = total;
+    uint64_t seen = 0;
+    for (int i = 0; i < HISTOGRAM_BUCKETS; ++i) {
+        seen += h->buckets[i];
+        if (seen >= rank) {
+            if (i == HISTOGRAM_BUCKETS - 1) return h->max;
+            uint64_t upper = histogram_bucket_value(i + 1) - 1;
+            return upper < h->max ? upper : h->max;
+        }
+    }
+    return h->max;
+}
+
+static inline uint64_t histogram_mean(const struct histogram* h) {
+    return h->count ? h->sum / h->count : 0;
+}
+
+} // namespace sdk
+
+} // namespace ars
@@ -0,0 +1,227 @@
+/**
+ * Copyright © 2021 <wotsen>.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of this software
+ * and associated documentation files (the “Software”), to deal in the Software without
+ * restriction, including without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sublicense, and/or sell copies of the Software, and to permit persons to whom the
+ *
+ * The above copyright notice and this permission notice shall be included in all copies or
+ * substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED “AS IS”, WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING
+ * BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM,
+ * DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ *
+ * @file timewheel.hpp
+ * @brief
+ * @author wotsen (astralrovers@outlook.com)
+ * @version 1.0.0
+ * @date 2021-04-04
+ *
+ * @copyright MIT
+ *
+ */
+#pragma once
+#include <stdint.h>
+#include "list.hpp"
+
+namespace ars {
+
+namespace sdk {
+
+/// 分层时间轮
+/// 第0层256个槽, 每槽1个tick; 第1~4层各64个槽, 每层槽跨度为上一层的一整圈.
+/// 添加/删除都是O(1), 到期时整槽取出, 上层槽在下层转完一圈时降级(cascade)到下层.
+
+#define TIMEWHEEL_ROOT_BITS 8
+#define TIMEWHEEL_LEVEL_BITS 6
+#define TIMEWHEEL_LEVELS 4 // levels above root
+#define TIMEWHEEL_ROOT_SIZE (1 << TIMEWHEEL_ROOT_BITS)
+#define TIMEWHEEL_LEVEL_SIZE (1 << TIMEWHEEL_LEVEL_BITS)
+#define TIMEWHEEL_ROOT_MASK (TIMEWHEEL_ROOT_SIZE - 1)
+#define TIMEWHEEL_LEVEL_MASK (TIMEWHEEL_LEVEL_SIZE - 1)
+#define TIMEWHEEL_SLOTS (TIMEWHEEL_ROOT_SIZE + TIMEWHEEL_LEVELS * TIMEWHEEL_LEVEL_SIZE)
+#define TIMEWHEEL_NOSLOT 0xFFFF
+// NOTE: expires too far away is clamped into the last level, owner should check it when expired.
+#define TIMEWHEEL_MAX_SPAN ((uint64_t)1 << (TIMEWHEEL_ROOT_BITS + TIMEWHEEL_LEVELS * TIMEWHEEL_LEVEL_BITS))
+
+struct timewheel_node {
+    struct list_head link;
+    uint64_t expires;  // tick
+    uint16_t slot;
+};
+
+struct timewheel {
+    uint64_t base;  // next tick to run
+    int nelts;
+    uint64_t bitmap[TIMEWHEEL_SLOTS / 64]; // non-empty slots
+    struct list_head slots[TIMEWHEEL_SLOTS];
+};
+
+#define TIMEWHEEL_SHIFT(level) (TIMEWHEEL_ROOT_BITS + (level) * TIMEWHEEL_LEVEL_BITS)
+#define TIMEWHEEL_LEVEL_SLOT(level, idx) \
+    (TIMEWHEEL_ROOT_SIZE + (level) * TIMEWHEEL_LEVEL_SIZE + (idx))
+
+static inline void timewheel_init(struct timewheel* tw, uint64_t now) {
+    tw->base = now;
+    tw->nelts = 0;
+    for (int i = 0; i < TIMEWHEEL_SLOTS / 64; ++i) {
+        tw->bitmap[i] = 0;
+    }
+    for (int i = 0; i < TIMEWHEEL_SLOTS; ++i) {
+        list_init(&tw->slots[i]);
+    }
+}
+
+static inline void __timewheel_link(struct timewheel* tw, struct timewheel_node* node) {
+    uint64_t expires = node->expires;
+    uint64_t delta = expires - tw->base;
+    int slot;
+    if ((int64_t)delta < 0) {
+        // NOTE: already expired, run it on next tick.
+        slot = tw->base & TIMEWHEEL_ROOT_MASK;
+    } else if (delta < TIMEWHEEL_ROOT_SIZE) {
+        slot = expires & TIMEWHEEL_ROOT_MASK;
+    } else {
+        if (delta >= TIMEWHEEL_MAX_SPAN) {
+            expires = tw->base + TIMEWHEEL_MAX_SPAN - 1;
+            delta = TIMEWHEEL_MAX_SPAN - 1;
+        }
+        int level = 0;
+        while (delta >= ((uint64_t)1 << TIMEWHEEL_SHIFT(level + 1))) {
+            ++level;
+        }
+        slot = TIMEWHEEL_LEVEL_SLOT(level, (expires >> TIMEWHEEL_SHIFT(level)) & TIMEWHEEL_LEVEL_MASK);
+    }
+    node->slot = slot;
+    list_add_tail(&node->link, &tw->slots[slot]);
+    tw->bitmap[slot >> 6] |= (uint64_t)1 << (slot & 63);
+}
+
+static inline void timewheel_add(struct timewheel* tw, struct timewheel_node* node, uint64_t expires) {
+    node->expires = expires;
+    __timewheel_link(tw, node);
+    ++tw->nelts;
+}
+
+static inline void timewheel_remove(struct timewheel* tw, struct timewheel_node* node) {
+    if (node->slot == TIMEWHEEL_NOSLOT) return;
+    int slot = node->slot;
+    list_del(&node->link);
+    if (list_empty(&tw->slots[slot])) {
+        tw->bitmap[slot >> 6] &= ~((uint64_t)1 << (slot & 63));
+    }
+    node->slot = TIMEWHEEL_NOSLOT;
+    --tw->nelts;
+}
+
+// first non-empty slot at or after from (cyclic) in bitmap words [word0, word0+nwords), -1 if none.
+static inline int __timewheel_find(const struct timewheel* tw, int word0, int nwords, int from) {
+    for (int i = 0; i <= nwords; ++i) {
+        int w = ((from >> 6) + i) % nwords;
+        uint64_t bits = tw->bitmap[word0 + w];
+        if (i == 0) {
+            bits &= ~(uint64_t)0 << (from & 63);
+        } else if (i == nwords) {
+            // wrap around, the bits before from in the first word
+            bits &= ((uint64_t)1 << (from & 63)) - 1;
+        }
+        if (bits) return (w << 6) + __builtin_ctzll(bits);
+    }
+    return -1;
+}
+
+// NOTE: return the earliest tick something may expire, timers from upper levels
+// are only known to expire no earlier than their cascade tick. UINT64_MAX if empty.
+static inline uint64_t timewheel_next_expires(const struct timewheel* tw) {
+    if (tw->nelts == 0) return UINT64_MAX;
+    uint64_t next = UINT64_MAX;
+    int cur = tw->base & TIMEWHEEL_ROOT_MASK;
+    int idx = __timewheel_find(tw, 0, TIMEWHEEL_ROOT_SIZE >> 6, cur);
+    if (idx >= 0) {
+        next = tw->base + ((idx - cur) & TIMEWHEEL_ROOT_MASK);
+    }
+    for (int level = 0; level < TIMEWHEEL_LEVELS; ++level) {
+        int shift = TIMEWHEEL_SHIFT(level);
+        // first tick >= base on the boundary of this level
+        uint64_t t0 = (tw->base + ((uint64_t)1 << shift) - 1) >> shift;
+        int from = t0 & TIMEWHEEL_LEVEL_MASK;
+        idx = __timewheel_find(tw, TIMEWHEEL_LEVEL_SLOT(level, 0) >> 6, TIMEWHEEL_LEVEL_SIZE >> 6, from);
+        if (idx < 0) continue;
+        uint64_t tick = (t0 + ((idx - from) & TIMEWHEEL_LEVEL_MASK)) << shift;
+        if (tick < next) next = tick;
+    }
+    return next;
+}
+
+static inline int __timewheel_cascade(struct timewheel* tw, int level) {
+    int idx = (tw->base >> TIMEWHEEL_SHIFT(level)) & TIMEWHEEL_LEVEL_MASK;
+    int slot = TIMEWHEEL_LEVEL_SLOT(level, idx);
+    if (!list_empty(&tw->slots[slot])) {
+        struct list_head list;
+        list_init(&list);
+        list_splice_init(&tw->slots[slot], &list);
+        tw->bitmap[slot >> 6] &= ~((uint64_t)1 << (slot & 63));
+        while (!list_empty(&list)) {
+            struct list_head* link = list.next;
+            list_del(link);
+            __timewheel_link(tw, container_of(link, struct timewheel_node, link));
+        }
+    }
+    return idx;
+}
+
+// move all nodes expires <= now into expired list, which then owned by caller.
+// nodes in expired list have slot TIMEWHEEL_NOSLOT.
+static inline int timewheel_expire(struct timewheel* tw, uint64_t now, struct list_head* expired) {
+    int n = 0;
+    while (tw->base <= now) {
+        if (tw->nelts == 0) {
+            tw->base = now + 1;
+            break;
+        }
+        // NOTE: nothing happens until next, jump over the empty ticks.
+        uint64_t next = timewheel_next_expires(tw);
+        if (next > tw->base) {
+            tw->base = next < now + 1 ? next : now + 1;
+            continue;
+        }
+        int idx = tw->base & TIMEWHEEL_ROOT_MASK;
+        if (idx == 0) {
+            for (int level = 0; level < TIMEWHEEL_LEVELS; ++level) {
+                if (__timewheel_cascade(tw, level) != 0) break;
+            }
+        }
+        ++tw->base;
+        struct list_head* head = &tw->slots[idx];
+        while (!list_empty(head)) {
+            struct timewheel_node* node = container_of(head->next, struct timewheel_node, link);
+            list_del(&node->link);
+            list_add_tail(&node->link, expired);
+            node->slot = TIMEWHEEL_NOSLOT;
+            --tw->nelts;
+            ++n;
+        }
+        tw->bitmap[idx >> 6] &= ~((uint64_t)1 << (idx & 63));
+    }
+    return n;
+}
+
+// any node of the wheel, NULL if empty, used to drain the wheel.
+static inline struct timewheel_node* timewheel_any(struct timewheel* tw) {
+    if (tw->nelts == 0) return NULL;
+    for (int i = 0; i < TIMEWHEEL_SLOTS / 64; ++i) {
+        if (tw->bitmap[i]) {
+            int slot = (i << 6) + __builtin_ctzll(tw->bitmap[i]);
+            return container_of(tw->slots[slot].next, struct timewheel_node, link);
+        }
+    }
+    return NULL;
+}
+
+} // namespace sdk
+
+} // namespace ars
@@ -5,6 +5,7 @@
 #include "../ds/heap.hpp"
 #include "../ds/list.hpp"
 #include "../ds/queue.hpp"
+#include "../ds/timewheel.hpp"
 #include "../lock/lock.hpp"
 #include "../memory/mem.hpp"
 #include "loop.hpp"
@@ -16,9 +17,47 @@ namespace sdk {
 namespace event {
 
 #define ARS_LOOP_READ_BUFSIZE 8192
+// NOTE: readbuf pool size classes, 8K 16K 32K 64K
+#define ARS_READBUF_CLASSES 4
+#define ARS_READBUF_POOL_SIZE 16  // free bufs kept per class
+#define ARS_SPLICE_PIPE_POOL_SIZE 16  // free pipes kept per loop
 
 ARS_ARRAY_DECL(io_t*, io_array);
-ARS_QUEUE_DECL(event_t, event_queue);
+
+// NOTE: node of custom_events, loop_post_event copy the event into it.
+typedef struct custom_event_s {
+    struct custom_event_s* next;
+    event_t ev;
+} custom_event_t;
+
+// NOTE: slot of custom_ring, seq == pos when free for pos, pos + 1 when published.
+#define ARS_CUSTOM_RING_SIZE 256  // power of 2
+typedef struct custom_slot_s {
+    uint64_t seq;
+    event_t ev;
+} custom_slot_t;
+
+// NOTE: typed object pool of loop, objects are carved from slabs and recycled by a free list,
+// so adding/deleting events makes no malloc. Slabs are freed with the loop, loop thread only.
+#define ARS_EVENT_POOL_SLAB_OBJS 64
+typedef struct event_pool_s {
+    size_t objsize;
+    void* free_list;
+    void* slabs;
+    char* carve;      // unused objects of the newest slab
+    uint32_t ncarve;
+    uint32_t nused;
+    uint32_t nslabs;
+} event_pool_t;
+
+void event_pool_init(event_pool_t* pool, size_t objsize);
+void* event_pool_alloc(event_pool_t* pool);  // zeroed like ARS_ALLOC
+void event_pool_free(event_pool_t* pool, void* obj);
+void event_pool_cleanup(event_pool_t* pool);
+// give idle/timer back to the pool of its loop
+void event_free(event_t* ev);
+
+struct iowatcher_engine_s;
 
 struct loop_s {
     uint32_t flags;
@@ -40,19 +79,60 @@ struct loop_s {
     // idles
     struct list_head idles;
     uint32_t nidles;
-    // timers
+    // pools of idle_t, timeout_t, data_timeout_t, period_t and io_t with its addrs
+    event_pool_t idle_pool;
+    event_pool_t timeout_pool;
+    event_pool_t data_timeout_pool;
+    event_pool_t period_pool;
+    event_pool_t io_pool;
+    // timers: timewheel by default, heap if ARS_LOOP_FLAG_TIMER_HEAP
     struct heap timers;
+    struct timewheel timewheel;
     uint32_t ntimers;
     // ios: with fd as array.index
     struct io_array ios;
     uint32_t nios;
     // one loop per thread, so one readbuf per loop is OK.
     buf_t readbuf;
+    // NOTE: ios reading with the default readbuf borrow from the pool for each read,
+    // so idle ios hold no readbuf. free lists by size class.
+    iobuf_t* readbufs[ARS_READBUF_CLASSES];
+    uint32_t nreadbufs[ARS_READBUF_CLASSES];
+    // NOTE: pooled readbufs are carved from one ars_page_alloc region, mapped on first use,
+    // heap bufs once it is used up.
+    struct readbuf_region_s* readbuf_region;
+    const struct iowatcher_engine_s* engine;
     void* iowatcher;
-    // custom_events
-    int sockpair[2];
-    event_queue custom_events;
-    mutex_lock_t custom_events_mutex;
+    // custom_ring: bounded MPSC ring, loop_post_event copies the event into a slot.
+    // custom_events: intrusive MPSC queue, producers push to head, loop pops from tail,
+    // used only when the ring is full, ncustom_overflows keeps later posts behind it.
+    custom_slot_t* custom_ring;
+    uint64_t custom_ring_enq;
+    uint64_t custom_ring_deq;
+    int ncustom_overflows;
+    custom_event_t* custom_events_head;
+    custom_event_t* custom_events_tail;
+    custom_event_t custom_events_stub;
+    int eventfds[2];
+    int sleeping;        // blocking in iowatcher_poll_events
+    int wakeup_pending;  // eventfd written but not read yet
+    uint64_t nposts;
+    uint64_t nwakeups;
+    uint64_t ncoalesced;
+    // NOTE: only if ARS_LOOP_FLAG_METRICS
+    loop_metrics_t* metrics;
+    // loop_load, written by loop thread before each poll
+    loop_load_t load;
+    uint64_t poll_end_hrtime;
+    uint64_t load_window_start;
+    uint64_t load_window_busy;
+    // ios with datagrams queued by io_set_mmsg, flushed at the end of iteration.
+    struct list_head mmsg_flushes;
+    // free pipes for io_setup_splice, an io borrows one only while relaying.
+    int splice_pipes[ARS_SPLICE_PIPE_POOL_SIZE][2];
+    int nsplice_pipes;
+    // NOTE: created by the first loop_resolve, see resolver.hpp
+    struct resolver_s* resolver;
 };
 
 uint64_t loop_next_event_id();
@@ -64,11 +144,14 @@ struct idle_s {
     struct list_node node;
 };
 
-#define ARS_TIMER_FIELDS   \
-    ARS_EVENT_FIELDS       \
-    uint32_t repeat;       \
-    uint64_t next_timeout; \
-    struct heap_node node;
+#define ARS_TIMER_FIELDS                  \
+    ARS_EVENT_FIELDS                      \
+    uint32_t repeat;                      \
+    uint64_t next_timeout;                \
+    union {                               \
+        struct heap_node node;            \
+        struct timewheel_node wheel_node; \
+    };
 
 struct timer_s {
     ARS_TIMER_FIELDS
@@ -77,8 +160,18 @@ struct timer_s {
 struct timeout_s {
     ARS_TIMER_FIELDS
     uint32_t timeout;
+    unsigned has_data : 1;  // it is a data_timeout_t, see timer_add_data
 };
 
+typedef struct data_timeout_s {
+    timeout_t timeout;
+    timer_data_dtor dtor;
+    union {
+        max_align_t align;
+        char buf[ARS_TIMER_DATA_SIZE];
+    } data;
+} data_timeout_t;
+
 struct period_s {
     ARS_TIMER_FIELDS
     int8_t minute;
@@ -88,7 +181,30 @@ struct period_s {
     int8_t month;
 };
 
-ARS_QUEUE_DECL(offset_buf_t, write_queue);
+struct iobuf_s {
+    char* base;
+    size_t len;
+    int refcnt;
+    iobuf_free_fn free_fn;
+    void* userdata;
+    struct iobuf_s* next;  // for loop readbuf pool
+};
+
+// NOTE: [base + offset, base + len) is left to write, buf owns the memory.
+// A file region queued by io_sendfile has fd >= 0,
+// [fileoff + offset, fileoff + len) of fd is left to write then.
+// Without sendfile, buf holds the chunk read from fd and [base, buf->base + buf->len) of it is left.
+typedef struct write_buf_s {
+    char* base;
+    size_t len;
+    size_t offset;
+    iobuf_t* buf;
+    int fd;
+    off_t fileoff;
+    sendfile_cb cb;
+} write_buf_t;
+
+ARS_QUEUE_DECL(write_buf_t, write_queue);
 
 struct io_s {
     ARS_EVENT_FIELDS
@@ -103,6 +219,14 @@ struct io_s {
     unsigned recvfrom : 1;
     unsigned sendto : 1;
     unsigned close : 1;
+    unsigned splice : 1;  // relay with upstream_io by splice, see io_setup_splice
+    unsigned splice_drain : 1;  // splice_pipe taken over from closed upstream_io, written to self
+    unsigned ktls : 1;    // ssl records sent by kernel, written like tcp, see ssl_ktls_send
+    unsigned write_over_high : 1;  // see io_set_write_water
+    unsigned pause_upstream : 1;
+    unsigned upstream_paused : 1;
+    unsigned resolving : 1;  // io_connect waits for loop_resolve, see ev_create_async
+    unsigned connect_pending : 1;  // io_connect called while resolving
     // public:
     uint32_t id;  // fd cannot be used as unique identifier, so we provide an id
     int fd;
@@ -113,7 +237,14 @@ struct io_s {
     struct sockaddr* localaddr;
     struct sockaddr* peeraddr;
     buf_t readbuf;                   // for ev_read
+    iobuf_t* lent_readbuf;           // borrowed from loop readbuf pool during read_cb
+    uint8_t readbuf_class;           // adaptive size class of lent_readbuf
+    uint8_t readbuf_small;           // count of reads much smaller than readbuf
+    io_stat_t stat;
     struct write_queue write_queue;  // for ev_write
+    size_t write_bufsize;            // bytes of write_queue in memory
+    size_t write_high_water;         // 0: unlimited
+    size_t write_low_water;
     mutex_lock_t write_mutex;        // lock write and write_queue
     // callbacks
     event::read_cb read_cb;
@@ -121,6 +252,9 @@ struct io_s {
     event::close_cb close_cb;
     event::accept_cb accept_cb;
     event::connect_cb connect_cb;
+    event::recvmmsg_cb recvmmsg_cb;
+    event::write_water_cb high_water_cb;
+    event::write_water_cb low_water_cb;
     // timers
     int connect_timeout;  // ms
     timer_t* connect_timer;
@@ -133,10 +267,17 @@ struct io_s {
     timer_t* heartbeat_timer;
     // upstream
     struct io_s* upstream_io;
+    int splice_pipe[2];  // holds bytes read but not yet written to upstream_io, or to self if splice_drain
+    int splice_pending;  // bytes in splice_pipe
+    // framing
+    unpack_setting_t* unpack_setting;  // see io_set_unpack
+    buf_t unpack_buf;                  // head of a frame split over reads
+    size_t unpack_len;
     // private:
     int event_index[2];  // for poll,kqueue
     void* hovlp;         // for iocp/overlapio
     void* ssl;           // for SSL
+    struct io_mmsg_s* mmsg;  // for io_set_mmsg
     void* ctx;
 };
 /*
@@ -145,17 +286,54 @@ struct io_s {
  * io_get => HV_ALLOC_SIZEOF(io) => io_init =>
  * io_ready => io_add => hio_del => io_done =>
  * io_close => close_cb =>
- * io_free => HV_FREE(io)
+ * io_free => event_pool_free(io)
  */
+#define ARS_IO_DEFAULT_READBUF(io) \
+    ((io)->readbuf.base == NULL || (io)->readbuf.base == (io)->loop->readbuf.base)
+
+// readbuf pool
+iobuf_t* loop_readbuf_get(loop_t* loop, int cls);
+void loop_readbuf_put(loop_t* loop, iobuf_t* buf);
+
 void io_init(io_t* io);
 void io_ready(io_t* io);
 void io_done(io_t* io);
 void io_free(io_t* io);
 uint32_t io_next_id();
 
+// io_stat_t and loop_metrics_t, count one syscall
+void io_count_read(io_t* io, int nread);
+void io_count_write(io_t* io, int nwrite);
+
+// io_add(io, ARS_IO_WRITE) handled by nio_write
+int io_wait_write(io_t* io);
+
+// batched udp, see io_set_mmsg
+void io_mmsg_read(io_t* io);
+void io_mmsg_write(io_t* io);
+// NOTE: takes the ref of buf
+int io_mmsg_send(io_t* io, iobuf_t* buf, struct sockaddr* addr);
+void io_mmsg_free(io_t* io);
+void loop_flush_mmsgs(loop_t* loop);
+
+// splice relay, see io_setup_splice
+void io_splice_read(io_t* io);
+// @return 0 if nothing left in upstream_io's pipe
+int io_splice_write(io_t* io);
+void io_splice_free(io_t* io);
+void loop_splice_cleanup(loop_t* loop);
+
+// framing, see io_set_unpack
+void io_unpack(io_t* io, void* buf, int readbytes);
+void io_unpack_free(io_t* io);
+
+// async dns, see loop_resolve
+void loop_resolver_cleanup(loop_t* loop);
+
 #define ARS_EVENT_ENTRY(p) container_of(p, event_t, pending_node)
 #define ARS_IDLE_ENTRY(p) container_of(p, idle_t, node)
 #define ARS_TIMER_ENTRY(p) container_of(p, timer_t, node)
+#define ARS_TIMER_WHEEL_ENTRY(p) container_of(p, timer_t, wheel_node.link)
 
 #define ARS_EVENT_ACTIVE(ev)  \
     if (!ev->active) {        \
@@ -188,12 +366,13 @@ uint32_t io_next_id();
         ARS_EVENT_ACTIVE(ev);                \
     } while (0)
 
-#define ARS_EVENT_DEL(ev)       \
-    do {                        \
-        ARS_EVENT_INACTIVE(ev); \
-        if (!ev->pending) {     \
-            ARS_FREE(ev);       \
-        }                       \
+#define ARS_EVENT_DEL(ev)                  \
+    do {                                   \
+        ARS_EVENT_INACTIVE(ev);            \
+        if (!ev->pending) {                \
+            event_free((event_t*)ev);      \
+            ev = NULL;                     \
+        }                                  \
     } while (0)
 
 #define ARS_EVENT_RESET(ev)   \
@@ -10,17 +10,52 @@ namespace event {
 
 #if defined(ARS_OS_LINUX)
 #define EVENT_EPOLL
+#if defined(__has_include)
+#if __has_include(<linux/io_uring.h>)
+// NOTE: io_uring is opt-in, select it by loop_new(ARS_LOOP_FLAG_IO_URING).
+#define EVENT_IO_URING
+#endif
+#endif
 #elif defined(ARS_OS_MAC)
 #define EVENT_KQUEUE
 #else
 #error "not support"
 #endif
 
+// NOTE: completion-based engines (io_uring) finish the read in kernel,
+// then hand the result over to nio_read by io->hovlp.
+typedef struct iocomp_s {
+    char* buf;
+    int nread;  // >0 bytes, 0 EOF, <0 -errno
+} iocomp_t;
+
+typedef struct iowatcher_engine_s {
+    const char* name;
+    int (*init)(loop_t* loop);
+    int (*cleanup)(loop_t* loop);
+    int (*add_event)(loop_t* loop, int fd, int events);
+    int (*del_event)(loop_t* loop, int fd, int events);
+    int (*poll_events)(loop_t* loop, int timeout);
+    // optional, give back the buffer of io->hovlp after read_cb
+    void (*read_done)(loop_t* loop, int fd);
+} iowatcher_engine_t;
+
+#ifdef EVENT_EPOLL
+extern const iowatcher_engine_t epoll_engine;
+#endif
+#ifdef EVENT_IO_URING
+extern const iowatcher_engine_t uring_engine;
+#endif
+#ifdef EVENT_KQUEUE
+extern const iowatcher_engine_t kqueue_engine;
+#endif
+
 int iowatcher_init(loop_t* loop);
 int iowatcher_cleanup(loop_t* loop);
 int iowatcher_add_event(loop_t* loop, int fd, int events);
 int iowatcher_del_event(loop_t* loop, int fd, int events);
 int iowatcher_poll_events(loop_t* loop, int timeout);
+void iowatcher_read_done(loop_t* loop, int fd);
 
 }  // namespace event
 
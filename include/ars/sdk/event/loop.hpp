@@ -2,6 +2,8 @@
 
 #include <stdint.h>
 #include <sys/socket.h>
+#include <sys/types.h>
+#include "../ds/histogram.hpp"
 #include "../macros/defs.hpp"
 
 namespace ars {
@@ -20,6 +22,8 @@ typedef struct timer_s timer_t;
 typedef struct timeout_s timeout_t;
 typedef struct period_s period_t;
 typedef struct io_s io_t;
+typedef struct iobuf_s iobuf_t;
+typedef struct io_dgram_s io_dgram_t;
 
 typedef void (*event_cb)(event_t* ev);
 typedef void (*idle_cb)(idle_t* idle);
@@ -31,6 +35,11 @@ typedef void (*connect_cb)(io_t* io);
 typedef void (*read_cb)(io_t* io, void* buf, int readbytes);
 typedef void (*write_cb)(io_t* io, const void* buf, int writebytes);
 typedef void (*close_cb)(io_t* io);
+typedef void (*recvmmsg_cb)(io_t* io, io_dgram_t* dgrams, int ndgrams);
+// @error 0 if the whole file region is written, else why it is dropped.
+typedef void (*sendfile_cb)(io_t* io, int fd, int error);
+// @param bufsize io_write_bufsize when the mark is crossed
+typedef void (*write_water_cb)(io_t* io, size_t bufsize);
 
 typedef enum { LOOP_STATUS_STOP, LOOP_STATUS_RUNNING, LOOP_STATUS_PAUSE } loop_status_e;
 
@@ -106,6 +115,17 @@ typedef enum {
 #define ARS_LOOP_FLAG_RUN_ONCE 0x00000001
 #define ARS_LOOP_FLAG_AUTO_FREE 0x00000002
 #define ARS_LOOP_FLAG_QUIT_WHEN_NO_ACTIVE_EVENTS 0x00000004
+// NOTE: use io_uring instead of epoll if the kernel supports it, see io_engine(loop).
+#define ARS_LOOP_FLAG_IO_URING 0x00000008
+// NOTE: timers are kept in a timewheel with 1ms tick by default,
+// use min-heap instead if you need exact ordering of timers.
+#define ARS_LOOP_FLAG_TIMER_HEAP 0x00000010
+// NOTE: register fds edge-triggered with epoll, reads and accepts are drained until EAGAIN
+// and write interest stays registered, which saves most epoll_ctl calls on busy sockets.
+// Listenfd is added with EPOLLEXCLUSIVE if available. Ignored by other iowatchers.
+#define ARS_LOOP_FLAG_EDGE_TRIGGERED 0x00000020
+// NOTE: collect loop_metrics_t, costs a few clock reads per iteration.
+#define ARS_LOOP_FLAG_METRICS 0x00000040
 loop_t* loop_new(int flags = ARS_LOOP_FLAG_AUTO_FREE);
 
 // WARN: Forbid to call loop_free if ARS_LOOP_FLAG_AUTO_FREE set.
@@ -146,8 +166,49 @@ void* loop_userdata(loop_t* loop);
  * loop_post_event(loop, &ev);
  */
 // NOTE: loop_post_event is thread-safe, used to post event from other thread to loop thread.
+// It is lock-free, and wakes up the loop by eventfd only if the loop is blocking in poll.
 void loop_post_event(loop_t* loop, event_t* ev);
 
+typedef struct loop_post_stat_s {
+    uint64_t posts;      // loop_post_event called
+    uint64_t wakeups;    // eventfd written
+    uint64_t coalesced;  // posts without eventfd written, loop awake or wakeup pending
+} loop_post_stat_t;
+void loop_post_stat(loop_t* loop, loop_post_stat_t* stat);
+
+// NOTE: the loop handles ios -> timers -> idles -> pendings in each iteration,
+// timers and idles only mark events pending, all callbacks run in pendings.
+// A long busy with short poll means callbacks are slow and ready fds wait for poll.
+typedef struct loop_metrics_s {
+    uint64_t loop_cnt;
+    // unit(us)
+    struct histogram poll;      // in iowatcher_poll_events, including blocking
+    struct histogram timers;
+    struct histogram idles;
+    struct histogram pendings;
+    struct histogram busy;      // iteration out of poll
+    struct histogram lateness;  // timer expired later than next_timeout
+    struct histogram depth;     // npendings before pendings
+    // sum of io_stat_t of ios in this loop
+    uint64_t read_calls;
+    uint64_t read_bytes;
+    uint64_t write_calls;
+    uint64_t write_bytes;
+} loop_metrics_t;
+// NOTE: lock-free snapshot, can be called in any thread.
+// @return -1 if loop without ARS_LOOP_FLAG_METRICS
+int loop_metrics(loop_t* loop, loop_metrics_t* metrics);
+
+// NOTE: always-on load of loop for balancing between loops, cheaper than loop_metrics_t.
+#define ARS_LOOP_LOAD_INTERVAL 100  // ms, window of busy_permille
+typedef struct loop_load_s {
+    uint64_t busy_us;        // total time out of poll
+    uint64_t busy_permille;  // busy ratio of recent windows, smoothed
+    uint64_t nios;           // active ios, listeners and internal ones included
+} loop_load_t;
+// NOTE: lock-free, can be called in any thread.
+void loop_load(loop_t* loop, loop_load_t* load);
+
 // idle
 idle_t* idle_add(loop_t* loop, idle_cb cb, uint32_t repeat = INFINITE);
 void idle_del(idle_t* idle);
@@ -171,6 +232,18 @@ timer_t* timer_add_period(loop_t* loop, timer_cb cb, int8_t minute = 0, int8_t h
 void timer_del(timer_t* timer);
 void timer_reset(timer_t* timer);
 
+// NOTE: timer_add with a payload of ARS_TIMER_DATA_SIZE bytes in the same pooled object,
+// e.g. a C++ callback placement-new'ed by the caller, dtor(data) is called when the timer is freed.
+#define ARS_TIMER_DATA_SIZE 64
+typedef void (*timer_data_dtor)(void* data);
+timer_t* timer_add_data(loop_t* loop, timer_cb cb, uint32_t timeout, uint32_t repeat = INFINITE,
+                        timer_data_dtor dtor = NULL);
+void* timer_data(timer_t* timer);
+// NOTE: generation check of a timer pointer kept after the timer may be freed,
+// pooled objects live as long as the loop, so it is safe in the loop thread.
+// @return 1 if the timer is not deleted and still has event_id, a repeat=0 timer in its cb included
+int timer_alive(timer_t* timer, uint64_t event_id);
+
 // io
 //-----------------------low-level apis---------------------------------------
 #define ARS_IO_READ 0x0001
@@ -196,6 +269,8 @@ const char* io_engine() {
 }
 */
 const char* io_engine();
+// @return the engine the loop really runs on, e.g. "io_uring" or "epoll"
+const char* io_engine(loop_t* loop);
 
 io_t* io_get(loop_t* loop, int fd);
 int io_add(io_t* io, io_cb cb, int events = ARS_IO_READ);
@@ -214,7 +289,19 @@ struct sockaddr* io_peeraddr(io_t* io);
 void io_set_context(io_t* io, void* ctx);
 void* io_context(io_t* io);
 bool io_is_opened(io_t* io);
+// NOTE: take io out of its loop without closing fd, io_get(other_loop, fd) to go on there.
+// Callbacks and timers of io are dropped, close_cb not called, loop thread only.
+void io_detach(io_t* io);
 bool io_is_closed(io_t* io);
+// NOTE: reads counted in loop thread, writes by the thread calling io_write,
+// can be read in any thread without lock.
+typedef struct io_stat_s {
+    uint64_t read_calls;  // read syscalls, including EAGAIN
+    uint64_t read_bytes;
+    uint64_t write_calls;
+    uint64_t write_bytes;
+} io_stat_t;
+void io_stat(io_t* io, io_stat_t* stat);
 
 // set callbacks
 void io_setcb_accept(io_t* io, accept_cb accept_cb);
@@ -226,9 +313,15 @@ void io_setcb_close(io_t* io, close_cb close_cb);
 // some useful settings
 // Enable SSL/TLS is so easy :)
 int io_enable_ssl(io_t* io);
-// TODO: One loop per thread, one readbuf per loop.
+// NOTE: By default, each read borrows a buf from the loop readbuf pool, sized 8K~64K
+// adaptively per io, see io_retain_readbuf.
 // But you can pass in your own readbuf instead of the default readbuf to avoid memcopy.
 void io_set_readbuf(io_t* io, void* buf, size_t len);
+// NOTE: call it in read_cb to keep the buf without memcpy, iobuf_unref it when done,
+// the loop lends a new buf for next read.
+// @return NULL if the buf is not borrowed from the loop readbuf pool,
+// e.g. io_set_readbuf by user, or read completed in io_uring's own buffers.
+iobuf_t* io_retain_readbuf(io_t* io);
 // connect timeout => close_cb
 void io_set_connect_timeout(io_t* io, int timeout_ms = ARS_IO_DEFAULT_CONNECT_TIMEOUT);
 // close timeout => close_cb
@@ -258,10 +351,40 @@ int io_read(io_t* io);
 // NOTE: io_write is thread-safe, locked by recursive_mutex, allow to be called by other threads.
 // hio_try_write => io_add(io, ARS_IO_WRITE) => write => write_cb
 int io_write(io_t* io, const void* buf, size_t len);
+// NOTE: io_write_bufs hands the bufs over to io without memcpy, it takes one ref of each buf,
+// and writes them by one writev(up to IOV_MAX) if the io is tcp.
+int io_write_bufs(io_t* io, iobuf_t** bufs, int nbufs);
+// NOTE: io_sendfile queues [offset, offset + len) of file fd next to the bufs of io_write,
+// and writes it by sendfile(2) without copy to user space if the io is plain tcp on linux,
+// otherwise the region is read one chunk at a time as the socket gets writable.
+// fd is owned by the caller, cb(io, fd, error) is called once io no longer needs it,
+// write_cb is not called for file bytes.
+// @return bytes written right now, -1 if io closed, cb is not called then.
+int io_sendfile(io_t* io, int fd, off_t offset, size_t len, sendfile_cb cb = NULL);
+// NOTE: bytes queued by io_write/io_write_bufs/io_sendfile and not yet written.
+size_t io_write_bufsize(io_t* io);
+// NOTE: high_water_cb once io_write_bufsize reaches high, then low_water_cb once it drains
+// down to low. With pause_upstream, reading io->upstream_io stops in between, so a relay
+// set up by io_setup_upstream holds about high bytes per direction at most.
+// high_water_cb runs in the thread calling io_write, pausing only if that is the loop thread.
+// @param high 0 to disable, low is at most high
+void io_set_write_water(io_t* io, size_t high, size_t low = 0, int pause_upstream = 0);
+void io_setcb_write_water(io_t* io, write_water_cb high_water_cb, write_water_cb low_water_cb = NULL);
 // NOTE: io_close is thread-safe, if called by other thread, loop_post_event(hio_close_event).
 // hio_del(io, ARS_IO_RDWR) => close => close_cb
 int io_close(io_t* io);
 
+// iobuf: refcounted buffer for io_write_bufs
+typedef void (*iobuf_free_fn)(void* base, void* userdata);
+// NOTE: refcnt = 1, header and data in one allocation.
+iobuf_t* iobuf_new(size_t len);
+// NOTE: refcnt = 1, wrap caller's memory, free_fn(base, userdata) called when refcnt drops to 0.
+iobuf_t* iobuf_wrap(void* base, size_t len, iobuf_free_fn free_fn = NULL, void* userdata = NULL);
+iobuf_t* iobuf_ref(iobuf_t* buf);
+void iobuf_unref(iobuf_t* buf);
+void* iobuf_data(iobuf_t* buf);
+size_t iobuf_len(iobuf_t* buf);
+
 //------------------high-level apis-------------------------------------------
 // io_get -> io_set_readbuf -> io_setcb_read -> io_read
 io_t* ev_read(loop_t* loop, int fd, void* buf, size_t len, read_cb read_cb);
@@ -290,6 +413,63 @@ io_t* ev_recvfrom(loop_t* loop, int sockfd, void* buf, size_t len, read_cb read_
 // io_get -> io_setcb_write -> io_write
 io_t* ev_sendto(loop_t* loop, int sockfd, const void* buf, size_t len, write_cb write_cb = NULL);
 
+// batched udp
+// NOTE: send datagrams of same peer and size as one by UDP_SEGMENT, fallback if NIC can not.
+#define ARS_IO_MMSG_GSO 0x00000001
+// NOTE: receive datagrams coalesced by UDP_GRO, see io_dgram_t.segsize, msgsize becomes 64K.
+#define ARS_IO_MMSG_GRO 0x00000002
+struct io_dgram_s {
+    void* buf;
+    int len;
+    int segsize;                 // GRO: buf holds datagrams of segsize, the last may be shorter
+    struct sockaddr* peeraddr;  // valid in recvmmsg_cb only
+    int peeraddrlen;
+};
+// NOTE: each read fills up to nmsgs datagrams of msgsize by one recvmmsg, then calls recvmmsg_cb
+// once, or read_cb per datagram with io_peeraddr set to its sender if no recvmmsg_cb.
+// io_write/io_write_bufs/io_sendto queue datagrams, flushed by sendmmsg when nmsgs queued
+// or at the end of the loop iteration, write_cb is not called for them.
+// @return -1 if not udp or recvmmsg unsupported
+int io_set_mmsg(io_t* io, int nmsgs = 64, int msgsize = 2048, int flags = 0);
+void io_setcb_recvmmsg(io_t* io, recvmmsg_cb recvmmsg_cb);
+// NOTE: thread-safe like io_write, queue one datagram to addr, io_write sends to io_peeraddr.
+int io_sendto(io_t* io, const void* buf, size_t len, struct sockaddr* addr);
+
+// framing
+#define ARS_DEFAULT_PACKAGE_MAX_LENGTH (1 << 21)  // 2M
+#define ARS_PACKAGE_MAX_DELIMITER_BYTES 8
+typedef enum {
+    UNPACK_MODE_NONE = 0,
+    UNPACK_BY_FIXED_LENGTH = 1,   // frame: fixed_length bytes
+    UNPACK_BY_DELIMITER = 2,      // frame: bytes up to and including delimiter
+    UNPACK_BY_LENGTH_FIELD = 3,   // frame: body_offset + length field + length_adjustment
+} unpack_mode_e;
+typedef enum {
+    ENCODE_BY_LITTLE_ENDIAN = 1234,
+    ENCODE_BY_BIG_ENDIAN = 4321,
+} unpack_coding_e;
+typedef struct unpack_setting_s {
+    unpack_mode_e mode;
+    unsigned int package_max_length;  // 0: ARS_DEFAULT_PACKAGE_MAX_LENGTH, longer frame closes io
+    // UNPACK_BY_FIXED_LENGTH
+    unsigned int fixed_length;
+    // UNPACK_BY_DELIMITER
+    unsigned char delimiter[ARS_PACKAGE_MAX_DELIMITER_BYTES];
+    unsigned short delimiter_bytes;
+    // UNPACK_BY_LENGTH_FIELD
+    unsigned short body_offset;          // header bytes, at least length_field_offset + length_field_bytes
+    unsigned short length_field_offset;
+    unsigned short length_field_bytes;   // 1 ~ 8
+    int length_adjustment;               // added to the length field, e.g. if it counts the header
+    unpack_coding_e length_field_coding;
+} unpack_setting_t;
+// NOTE: read_cb is called once per complete frame. A frame lying whole in the bytes just read
+// is passed in place, only a frame split over reads is copied into a per io buffer which
+// grows up to package_max_length. setting is not copied, it must outlive io, e.g. static.
+// @return -1 if setting is invalid
+int io_set_unpack(io_t* io, unpack_setting_t* setting);
+void io_unset_unpack(io_t* io);
+
 //-----------------top-level apis---------------------------------------------
 // Resolver -> socket -> io_get
 io_t* ev_create(loop_t* loop, const char* host, int port, int type = SOCK_STREAM);
@@ -332,6 +512,15 @@ io_t* io_get_upstream(io_t* io);
 io_t* io_setup_tcp_upstream(io_t* io, const char* host, int port, int ssl = 0);
 #define ars_io_setup_ssl_upstream(io, host, port) ars::sdk::event::io_setup_tcp_upstream(io, host, port, 1)
 
+// NOTE: like io_setup_upstream, but relay io1 <=> io2 by splice(2) through pipes in kernel,
+// no bytes copied to user space and read_cb is not called. Reading one side stops while
+// the other can not take more. Falls back to io_setup_upstream if either is not plain tcp.
+void io_setup_splice(io_t* io1, io_t* io2);
+
+// @tcp_upstream relayed by io_setup_splice instead of io_setup_upstream.
+// @return upstream_io
+io_t* io_setup_tcp_splice_upstream(io_t* io, const char* host, int port);
+
 // @udp_upstream: ev_create -> io_setup_upstream -> io_read_upstream
 // @return upstream_io
 // @see examples/udp_proxy_server
@@ -0,0 +1,65 @@
+#pragma once
+
+#include "../net/sock.hpp"
+#include "loop.hpp"
+
+namespace ars {
+
+namespace sdk {
+
+namespace event {
+
+#define ARS_RESOLVER_MAX_ADDRS 8
+#define ARS_RESOLVER_MAX_NAMESERVERS 3
+#define ARS_RESOLVER_DEFAULT_TIMEOUT 2000  // ms, per attempt
+#define ARS_RESOLVER_DEFAULT_ATTEMPTS 2    // rounds over all nameservers
+#define ARS_RESOLVER_DEFAULT_CACHE_SIZE 256
+#define ARS_RESOLVER_MAX_TTL 86400         // s
+#define ARS_RESOLVER_NEGATIVE_TTL 30       // s, NXDOMAIN without SOA
+#define ARS_RESOLVER_MAX_SEARCH 6
+#define ARS_RESOLVER_DEFAULT_NDOTS 1
+
+typedef struct resolver_setting_s {
+    // "ip[:port]" or "[ipv6]:port" separated by ',' or ' ', NULL: nameserver lines of /etc/resolv.conf
+    const char* nameservers;
+    // NULL: /etc/hosts, "": none
+    const char* hosts;
+    // domains separated by ',' or ' ', NULL: search or domain line of /etc/resolv.conf, "": none
+    const char* search;
+    int timeout_ms;  // 0: ARS_RESOLVER_DEFAULT_TIMEOUT
+    int attempts;    // 0: ARS_RESOLVER_DEFAULT_ATTEMPTS
+    int cache_size;  // entries, 0: ARS_RESOLVER_DEFAULT_CACHE_SIZE, <0: no cache
+} resolver_setting_t;
+
+// @param addrs port is 0, NULL if error
+// @param error 0, ENOENT: no such host, ETIMEDOUT: no answer, EAGAIN: server failure, ECANCELED
+typedef void (*resolve_cb)(loop_t* loop, const char* host, const sock_addr_t* addrs, int naddrs,
+                           int error, void* userdata);
+
+// NOTE: per loop, loop thread only. Created with the default setting by the first loop_resolve,
+// this replaces it, queries pending are failed with ECANCELED. hosts is read once here.
+// @return -1 if no nameserver
+int loop_set_resolver(loop_t* loop, const resolver_setting_t* setting = NULL);
+
+// NOTE: numeric host, hosts file and cache are answered in place, cb is called before return.
+// Else an A query goes to the nameservers by udp on the loop, queries of the same name
+// are sent once and answered together, answers are cached by their ttl.
+// As res_search, a host with fewer dots than ndots of resolv.conf is tried with each search
+// domain first and then as is, other hosts the other way round, on to the next name on ENOENT.
+// A host ending with '.' or found in hosts file is not expanded.
+// @return 0 if cb called, >0 request id for loop_resolve_cancel, -1 if error
+int loop_resolve(loop_t* loop, const char* host, resolve_cb cb, void* userdata = NULL);
+// NOTE: cb of id will not be called, the query goes on for others and the cache.
+void loop_resolve_cancel(loop_t* loop, int id);
+
+// NOTE: like ev_create(SOCK_STREAM), but host is resolved by loop_resolve, so the loop does
+// not block. ev_connect on it connects once resolved, if failed io->error is set to the
+// resolve error and io is closed. Names by dns are ipv4.
+// @return NULL if host is known not to resolve
+io_t* ev_create_async(loop_t* loop, const char* host, int port);
+
+}  // namespace event
+
+}  // namespace sdk
+
+}  // namespace ars
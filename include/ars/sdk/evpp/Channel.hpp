@@ -32,6 +32,7 @@
 
 #include "ars/sdk/event/loop.hpp"
 #include "ars/sdk/net/sock.hpp"
+#include "ars/sdk/patterns/function.hpp"
 #include "Buffer.hpp"
 
 namespace ars {
@@ -52,6 +53,7 @@ public:
             sdk::event::io_setcb_read(io_, on_read);
             sdk::event::io_setcb_write(io_, on_write);
             sdk::event::io_setcb_close(io_, on_close);
+            sdk::event::io_setcb_write_water(io_, on_write_high_water, on_write_low_water);
         }
         status = isOpened() ? OPENED : CLOSED;
     }
@@ -97,6 +99,12 @@ public:
         return !isOpened();
     }
 
+    // NOTE: onread gets one complete frame a time, setting must outlive the channel, see io_set_unpack
+    int setUnpack(sdk::event::unpack_setting_t* setting) {
+        if (!isOpened()) return -1;
+        return sdk::event::io_set_unpack(io_, setting);
+    }
+
     int startRead() {
         if (!isOpened()) return 0;
         return ars_io_read_start(io_);
@@ -120,6 +128,24 @@ public:
         return write(str.data(), str.size());
     }
 
+    // NOTE: onWriteHighWater once bytes not yet written reach high, then onWriteLowWater
+    // once they drain down to low, see io_set_write_water
+    void setWriteWater(size_t high, size_t low = 0) {
+        if (!isOpened()) return;
+        sdk::event::io_set_write_water(io_, high, low);
+    }
+
+    size_t writeBufsize() {
+        if (!isOpened()) return 0;
+        return sdk::event::io_write_bufsize(io_);
+    }
+
+    // NOTE: fd is owned by caller, close it in cb, see io_sendfile
+    int sendFile(int fd, off_t offset, size_t len, sdk::event::sendfile_cb cb = NULL) {
+        if (!isOpened()) return 0;
+        return sdk::event::io_sendfile(io_, fd, offset, len, cb);
+    }
+
     int close() {
         if (!isOpened()) return 0;
         return sdk::event::io_close(io_);
@@ -139,9 +165,12 @@ public:
         CONNECTED,
         DISCONNECTED,
     } status;
-    std::function<void(Buffer*)> onread;
-    std::function<void(Buffer*)> onwrite;
-    std::function<void()>        onclose;
+    sdk::unique_function<void(Buffer*)> onread;
+    sdk::unique_function<void(Buffer*)> onwrite;
+    sdk::unique_function<void()>        onclose;
+    // NOTE: may run in the thread calling write
+    sdk::unique_function<void(size_t)>  onWriteHighWater;
+    sdk::unique_function<void(size_t)>  onWriteLowWater;
 
 private:
     static void on_read(sdk::event::io_t* io, void* data, int readbytes) {
@@ -160,6 +189,20 @@ private:
         }
     }
 
+    static void on_write_high_water(sdk::event::io_t* io, size_t bufsize) {
+        Channel* channel = (Channel*)sdk::event::io_context(io);
+        if (channel && channel->onWriteHighWater) {
+            channel->onWriteHighWater(bufsize);
+        }
+    }
+
+    static void on_write_low_water(sdk::event::io_t* io, size_t bufsize) {
+        Channel* channel = (Channel*)sdk::event::io_context(io);
+        if (channel && channel->onWriteLowWater) {
+            channel->onWriteLowWater(bufsize);
+        }
+    }
+
     static void on_close(sdk::event::io_t* io) {
         Channel* channel = (Channel*)sdk::event::io_context(io);
         if (channel) {
@@ -174,7 +217,7 @@ private:
 class SocketChannel : public Channel {
 public:
     // for TcpClient
-    std::function<void()>   onconnect;
+    sdk::unique_function<void()>   onconnect;
 
     SocketChannel(sdk::event::io_t* io) : Channel(io) {
     }
@@ -64,6 +64,18 @@ struct Timer {
     }
 };
 
+// NOTE: handle of EventLoop::addTimer, the callback lives in the timer_t itself,
+// id checks that timer is still the one added.
+struct TimerHandle {
+    sdk::event::timer_t*       timer;
+    TimerID         id;
+
+    TimerHandle(sdk::event::timer_t* timer = NULL) {
+        this->timer = timer;
+        this->id = timer ? ars_event_id(timer) : INVALID_TIMER_ID;
+    }
+};
+
 typedef std::shared_ptr<Event> EventPtr;
 typedef std::shared_ptr<Timer> TimerPtr;
 
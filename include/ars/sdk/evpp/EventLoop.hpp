@@ -29,6 +29,9 @@
 #include <queue>
 #include <map>
 #include <mutex>
+#include <vector>
+#include <atomic>
+#include <new>
 #include <assert.h>
 
 #include "Event.hpp"
@@ -36,20 +39,36 @@
 #include "ars/sdk/thread/thread_local_storage.hpp"
 #include "ars/sdk/thread/thread.hpp"
 #include "ars/sdk/event/loop.hpp"
+#include "ars/sdk/ds/bounded_queue.hpp"
+#include "ars/sdk/patterns/function.hpp"
 
 namespace ars {
     
 namespace evpp {
 
+// NOTE: functors posted by queueInLoop wait here before the loop picks them up,
+// more goes to a locked overflow list.
+#define EVENTLOOP_FUNCTOR_QUEUE_SIZE 1024
+
+// NOTE: load of an EventLoop, read without lock in any thread, see EventLoopThreadPool.
+struct EventLoopLoad {
+    int         connections;    // channels kept by this loop, counted by servers
+    uint64_t    busy_permille;  // recent time out of poll, see loop_load_t
+    uint64_t    busy_us;
+    uint64_t    nios;
+};
+
 class EventLoop : public Status {
 public:
 
-    typedef std::function<void()> Functor;
+    typedef sdk::unique_function<void()> Functor;
 
     // New an EventLoop using an existing hloop_t object,
     // so we can embed an EventLoop object into the old application based on hloop.
     // NOTE: Be careful to deal with destroy of hloop_t.
-    EventLoop(sdk::event::loop_t* loop = NULL) {
+    EventLoop(sdk::event::loop_t* loop = NULL)
+        : connections_(0), functors_(EVENTLOOP_FUNCTOR_QUEUE_SIZE), functorsPosted_(false),
+          functorsOverflow_(false) {
         setStatus(kInitializing);
         if (loop) {
             loop_ = loop;
@@ -144,6 +163,62 @@ public:
         }
     }
 
+    // Intrusive timer interfaces: addTimer, killTimer, resetTimer by TimerHandle,
+    // no map nor lock, the callback is stored in the timer_t of loop.
+    // NOTE: addTimer in loop thread or before loop runs,
+    // killTimer/resetTimer from other threads are queued in loop.
+    TimerHandle addTimer(int timeout_ms, TimerCallback cb, int repeat = INFINITE) {
+        static_assert(sizeof(TimerCallback) <= ARS_TIMER_DATA_SIZE, "TimerCallback too big");
+        sdk::event::timer_t* htimer = sdk::event::timer_add_data(loop_, onHandleTimer, timeout_ms,
+                                                                 repeat, destroyTimerCallback);
+        if (htimer == NULL) return TimerHandle();
+        new (sdk::event::timer_data(htimer)) TimerCallback(std::move(cb));
+        return TimerHandle(htimer);
+    }
+
+    void killTimer(const TimerHandle& handle) {
+        if (!isInLoopThread()) {
+            queueInLoop([this, handle] { killTimer(handle); });
+            return;
+        }
+        if (sdk::event::timer_alive(handle.timer, handle.id)) {
+            sdk::event::timer_del(handle.timer);
+        }
+    }
+
+    void resetTimer(const TimerHandle& handle) {
+        if (!isInLoopThread()) {
+            queueInLoop([this, handle] { resetTimer(handle); });
+            return;
+        }
+        if (sdk::event::timer_alive(handle.timer, handle.id)) {
+            sdk::event::timer_reset(handle.timer);
+        }
+    }
+
+    EventLoopLoad load() {
+        EventLoopLoad l;
+        memset(&l, 0, sizeof(l));
+        l.connections = connections_.load(std::memory_order_relaxed);
+        if (loop_) {
+            sdk::event::loop_load_t hload;
+            sdk::event::loop_load(loop_, &hload);
+            l.busy_permille = hload.busy_permille;
+            l.busy_us = hload.busy_us;
+            l.nios = hload.nios;
+        }
+        return l;
+    }
+
+    int connectionNum() {
+        return connections_.load(std::memory_order_relaxed);
+    }
+
+    // NOTE: servers count channels they give to this loop for load balance.
+    void addConnectionNum(int n) {
+        connections_.fetch_add(n, std::memory_order_relaxed);
+    }
+
     long tid() {
         if (loop_ == NULL) sdk::gettid();
         return sdk::event::loop_tid(loop_);
@@ -161,14 +236,29 @@ public:
         if (isInLoopThread()) {
             if (fn) fn();
         } else {
-            queueInLoop(fn);
+            queueInLoop(std::move(fn));
         }
     }
 
+    // NOTE: lock-free unless the queue is full, and the functors queued
+    // before the loop wakes up share one posted event.
     void queueInLoop(Functor fn) {
-        postEvent([fn](Event* ev) {
-            if (fn) fn();
-        });
+        if (loop_ == NULL || !fn) return;
+        // NOTE: once overflowed, keep FIFO by following the overflow list until drained.
+        if (functorsOverflow_.load(std::memory_order_acquire) || !functors_.try_push(std::move(fn))) {
+            std::lock_guard<std::mutex> locker(mutex_);
+            overflowFunctors_.push_back(std::move(fn));
+            functorsOverflow_.store(true, std::memory_order_release);
+        }
+        // NOTE: seq_cst, pairs with the store and fence of onFunctors, so either the flag is seen
+        // cleared here or the functor pushed above is seen there.
+        if (!functorsPosted_.exchange(true, std::memory_order_seq_cst)) {
+            sdk::event::event_t ev;
+            memset(&ev, 0, sizeof(ev));
+            ars_event_set_userdata(&ev, this);
+            ev.cb = onFunctors;
+            sdk::event::loop_post_event(loop_, &ev);
+        }
     }
 
     void postEvent(EventCallback cb) {
@@ -217,6 +307,37 @@ private:
         loop->mutex_.unlock();
     }
 
+    static void onFunctors(sdk::event::event_t* hev) {
+        EventLoop* loop = (EventLoop*)ars_event_userdata(hev);
+        // NOTE: clear first, functors queued from now on post a new event.
+        loop->functorsPosted_.store(false, std::memory_order_seq_cst);
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        // NOTE: at most one round of the queue, not to starve the loop by busy producers.
+        Functor fn;
+        for (size_t n = loop->functors_.capacity(); n > 0 && loop->functors_.try_pop(fn); --n) {
+            fn();
+        }
+        if (loop->functorsOverflow_.load(std::memory_order_acquire)) {
+            std::vector<Functor> overflow;
+            loop->mutex_.lock();
+            overflow.swap(loop->overflowFunctors_);
+            loop->functorsOverflow_.store(false, std::memory_order_release);
+            loop->mutex_.unlock();
+            for (auto& f : overflow) {
+                f();
+            }
+        }
+    }
+
+    static void onHandleTimer(sdk::event::timer_t* htimer) {
+        TimerCallback* cb = (TimerCallback*)sdk::event::timer_data(htimer);
+        if (*cb) (*cb)(ars_event_id(htimer));
+    }
+
+    static void destroyTimerCallback(void* data) {
+        ((TimerCallback*)data)->~TimerCallback();
+    }
+
     static void onCustomEvent(sdk::event::event_t* hev) {
         EventLoop* loop = (EventLoop*)ars_event_userdata(hev);
 
@@ -233,6 +354,12 @@ private:
     std::mutex                  mutex_;
     std::queue<EventPtr>        customEvents;   // GUAREDE_BY(mutex_)
     std::map<TimerID, Timer>    timers;         // GUAREDE_BY(mutex_)
+    // NOTE: before functors_, functors left unrun are destroyed first and may undo their counts.
+    std::atomic<int>            connections_;
+    sdk::bounded_mpmc_queue<Functor>    functors_;
+    std::atomic<bool>           functorsPosted_;
+    std::atomic<bool>           functorsOverflow_;
+    std::vector<Functor>        overflowFunctors_;  // GUAREDE_BY(mutex_)
 };
 
 typedef std::shared_ptr<EventLoop> EventLoopPtr;
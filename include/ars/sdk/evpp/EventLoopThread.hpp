@@ -26,19 +26,29 @@
  */
 #pragma once
 #include <thread>
+#include <atomic>
 #include "ars/sdk/time/time.hpp"
+#include "ars/sdk/thread/thread_util.hpp"
 #include "EventLoop.hpp"
 
 namespace ars {
     
 namespace evpp {
 
+struct EventLoopThreadOptions {
+    int cpu;                // pin loop_thread to this cpu, < 0 not pinned
+    int sched_policy;       // SCHED_FIFO, SCHED_RR..., < 0 left as inherited
+    int sched_priority;
+
+    EventLoopThreadOptions() : cpu(-1), sched_policy(-1), sched_priority(0) {}
+};
+
 class EventLoopThread : public Status {
 public:
     // Return 0 means OK, other failed.
     typedef std::function<int()> Functor;
 
-    EventLoopThread(EventLoopPtr loop = NULL) {
+    EventLoopThread(EventLoopPtr loop = NULL) : created_(true) {
         setStatus(kInitializing);
         if (loop) {
             loop_ = loop;
@@ -48,6 +58,14 @@ public:
         setStatus(kInitialized);
     }
 
+    // NOTE: the loop is new'd by loop_thread after pinning, so its readbuf,
+    // io array and pools are first touched on the numa node of that cpu.
+    // loop() is NULL until start.
+    explicit EventLoopThread(const EventLoopThreadOptions& options)
+        : options_(options), created_(false) {
+        setStatus(kInitialized);
+    }
+
     ~EventLoopThread() {
         stop();
         join();
@@ -58,11 +76,11 @@ public:
     }
 
     sdk::event::loop_t* hloop() {
-        return loop_->loop();
+        return loop_ ? loop_->loop() : NULL;
     }
 
     bool isRunning() {
-        return loop_->isRunning();
+        return loop_ && loop_->isRunning();
     }
 
     // @param wait_thread_started: if ture this method will block until loop_thread started.
@@ -76,6 +94,10 @@ public:
         assert(thread_.get() == NULL);
         thread_.reset(new std::thread(&EventLoopThread::loop_thread, this, pre, post));
 
+        while (!created_.load(std::memory_order_acquire)) {
+            sdk::msdelay(1);
+        }
+
         if (wait_thread_started) {
             while (loop_->status() < kRunning) {
                 sdk::msdelay(1);
@@ -86,6 +108,11 @@ public:
     // @param wait_thread_started: if ture this method will block until loop_thread stopped.
     void stop(bool wait_thread_stopped = false) {
         if (status() >= kStopping) return;
+        if (loop_ == NULL) {
+            // NOTE: never started with options, no loop_thread to wait for.
+            setStatus(kStopped);
+            return;
+        }
         setStatus(kStopping);
 
         loop_->stop();
@@ -108,6 +135,17 @@ public:
 
 private:
     void loop_thread(const Functor& pre, const Functor& post) {
+        if (!created_.load(std::memory_order_relaxed)) {
+            // NOTE: best effort, runs unpinned if cpu or policy is not permitted.
+            if (options_.cpu >= 0) {
+                sdk::thread_bind_cpu(pthread_self(), options_.cpu);
+            }
+            if (options_.sched_policy >= 0) {
+                sdk::thread_set_sched(pthread_self(), options_.sched_policy, options_.sched_priority);
+            }
+            loop_.reset(new EventLoop);
+            created_.store(true, std::memory_order_release);
+        }
         // hlogi("EventLoopThread started, tid=%ld", hv_gettid());
         setStatus(kStarted);
 
@@ -133,6 +171,8 @@ private:
 private:
     EventLoopPtr                 loop_;
     std::shared_ptr<std::thread> thread_;
+    EventLoopThreadOptions       options_;
+    std::atomic<bool>            created_;
 };
 
 typedef std::shared_ptr<EventLoopThread> EventLoopThreadPtr;
@@ -25,18 +25,38 @@
  * 
  */
 #pragma once
+#include <algorithm>
+#include <netinet/in.h>
 #include "EventLoopThread.hpp"
+#include "ars/sdk/crypto/murmur_hash.hpp"
 
 namespace ars {
     
 namespace evpp {
 
+// NOTE: virtual nodes of each loop on the ring of kConsistentHash
+#define EVENTLOOP_HASH_VNODES 64
+
 class EventLoopThreadPool : public Status {
 public:
+    enum LoadBalance {
+        kRoundRobin,
+        kLeastConnections,  // EventLoop::connectionNum
+        kLeastBusy,         // recent busy time out of poll, see loop_load_t
+        kConsistentHash,    // on peer ip, a client sticks to one loop while the pool lives
+        kCustom,            // setLoadBalance(LoadBalanceCallback)
+    };
+    // @return index of the loop to pick in loads, out of range falls back to round-robin
+    typedef std::function<int(const std::vector<EventLoopLoad>& loads,
+                              const struct sockaddr* peeraddr)> LoadBalanceCallback;
+
     EventLoopThreadPool(int thread_num = std::thread::hardware_concurrency()) {
         setStatus(kInitializing);
         thread_num_ = thread_num;
         next_loop_idx_ = 0;
+        load_balance_ = kRoundRobin;
+        sched_policy_ = -1;
+        sched_priority_ = 0;
         setStatus(kInitialized);
     }
 
@@ -53,9 +73,65 @@ public:
         thread_num_ = num;
     }
 
-    EventLoopPtr nextLoop() {
+    // NOTE: call it before start.
+    void setLoadBalance(LoadBalance lb) {
+        load_balance_ = lb;
+    }
+    void setLoadBalance(LoadBalanceCallback cb) {
+        load_balance_ = kCustom;
+        load_balance_cb_ = std::move(cb);
+    }
+    LoadBalance loadBalance() {
+        return load_balance_;
+    }
+
+    // NOTE: call them before start.
+    // Loop thread i is pinned to cpus[i % cpus.size()] and news its loop after
+    // pinning, e.g. list the cores of one socket first on a numa box.
+    void setCpuAffinity(std::vector<int> cpus) {
+        cpus_ = std::move(cpus);
+    }
+    // @param policy: SCHED_FIFO, SCHED_RR need CAP_SYS_NICE
+    void setSchedPolicy(int policy, int priority = 0) {
+        sched_policy_ = policy;
+        sched_priority_ = priority;
+    }
+
+    // NOTE: lock-free, peeraddr is for kConsistentHash and kCustom.
+    EventLoopPtr nextLoop(const struct sockaddr* peeraddr = NULL) {
         if (loop_threads_.empty()) return NULL;
-        return loop_threads_[++next_loop_idx_ % loop_threads_.size()]->loop();
+        size_t num = loop_threads_.size();
+        // NOTE: start from the round-robin one, so ties spread over loops.
+        size_t idx = ++next_loop_idx_ % num;
+        switch (load_balance_) {
+        case kLeastConnections:
+            idx = leastLoaded(idx, [](const EventLoopLoad& l) { return connectionsKey(l); });
+            break;
+        case kLeastBusy:
+            idx = leastLoaded(idx, [](const EventLoopLoad& l) {
+                // NOTE: ties of idle loops broken by connections
+                return (l.busy_permille << 32) | connectionsKey(l);
+            });
+            break;
+        case kConsistentHash:
+            if (peeraddr) {
+                idx = hashLoop(peeraddr);
+            }
+            break;
+        case kCustom:
+            if (load_balance_cb_) {
+                std::vector<EventLoopLoad> loads(num);
+                for (size_t i = 0; i < num; ++i) {
+                    loads[i] = loop_threads_[i]->loop()->load();
+                }
+                int ret = load_balance_cb_(loads, peeraddr);
+                if (ret >= 0 && (size_t)ret < num) idx = ret;
+            }
+            break;
+        default:
+            break;
+        }
+        return loop_threads_[idx]->loop();
     }
 
     EventLoopPtr loop(int idx = -1) {
@@ -87,18 +163,30 @@ public:
         std::shared_ptr<std::atomic<int>> exited_cnt(new std::atomic<int>(0));
 
         for (int i = 0; i < thread_num_; ++i) {
-            EventLoopThreadPtr loop_thread(new EventLoopThread);
-            EventLoopPtr loop = loop_thread->loop();
+            EventLoopThreadPtr loop_thread;
+            if (cpus_.empty() && sched_policy_ < 0) {
+                loop_thread.reset(new EventLoopThread);
+            } else {
+                EventLoopThreadOptions options;
+                if (!cpus_.empty()) {
+                    options.cpu = cpus_[i % cpus_.size()];
+                }
+                options.sched_policy = sched_policy_;
+                options.sched_priority = sched_priority_;
+                loop_thread.reset(new EventLoopThread(options));
+            }
+            // NOTE: the loop may be new'd by the thread, loop_threads_ keeps it alive.
+            EventLoopThread* t = loop_thread.get();
             loop_thread->start(false,
-                [this, started_cnt, pre, &loop]() {
+                [this, started_cnt, pre, t]() {
                     if (++(*started_cnt) == thread_num_) {
                         setStatus(kRunning);
                     }
-                    if (pre) pre(loop);
+                    if (pre) pre(t->loop());
                     return 0;
                 },
-                [this, exited_cnt, post, &loop]() {
-                    if (post) post(loop);
+                [this, exited_cnt, post, t]() {
+                    if (post) post(t->loop());
                     if (++(*exited_cnt) == thread_num_) {
                         setStatus(kStopped);
                     }
@@ -107,6 +195,7 @@ public:
             );
             loop_threads_.push_back(loop_thread);
         }
+        buildHashRing();
 
         if (wait_threads_started) {
             while (status() < kRunning) {
@@ -138,10 +227,67 @@ public:
         }
     }
 
+private:
+    // NOTE: connections may go briefly negative while adds and removes race, clamp before packing.
+    static uint64_t connectionsKey(const EventLoopLoad& l) {
+        return (uint32_t)(l.connections > 0 ? l.connections : 0);
+    }
+
+    template <typename Key>
+    size_t leastLoaded(size_t start, Key key) {
+        size_t num = loop_threads_.size();
+        size_t best = start;
+        uint64_t best_key = key(loop_threads_[start]->loop()->load());
+        for (size_t i = 1; i < num && best_key > 0; ++i) {
+            size_t idx = (start + i) % num;
+            uint64_t k = key(loop_threads_[idx]->loop()->load());
+            if (k < best_key) {
+                best = idx;
+                best_key = k;
+            }
+        }
+        return best;
+    }
+
+    void buildHashRing() {
+        hash_ring_.clear();
+        for (size_t i = 0; i < loop_threads_.size(); ++i) {
+            for (uint32_t v = 0; v < EVENTLOOP_HASH_VNODES; ++v) {
+                uint32_t vnode[2] = {(uint32_t)i, v};
+                hash_ring_.emplace_back(sdk::hash32(vnode, sizeof(vnode)), i);
+            }
+        }
+        std::sort(hash_ring_.begin(), hash_ring_.end());
+    }
+
+    size_t hashLoop(const struct sockaddr* peeraddr) {
+        uint32_t h = 0;
+        if (peeraddr->sa_family == AF_INET) {
+            const struct sockaddr_in* sin = (const struct sockaddr_in*)peeraddr;
+            h = sdk::hash32(&sin->sin_addr, sizeof(sin->sin_addr));
+        } else if (peeraddr->sa_family == AF_INET6) {
+            const struct sockaddr_in6* sin6 = (const struct sockaddr_in6*)peeraddr;
+            h = sdk::hash32(&sin6->sin6_addr, sizeof(sin6->sin6_addr));
+        } else {
+            return next_loop_idx_ % loop_threads_.size();
+        }
+        auto iter = std::lower_bound(hash_ring_.begin(), hash_ring_.end(),
+                                     std::make_pair(h, (size_t)0));
+        if (iter == hash_ring_.end()) iter = hash_ring_.begin();
+        return iter->second;
+    }
+
 private:
     int                                         thread_num_;
     std::vector<EventLoopThreadPtr>             loop_threads_;
     std::atomic<unsigned int>                   next_loop_idx_;
+    LoadBalance                                 load_balance_;
+    LoadBalanceCallback                         load_balance_cb_;
+    std::vector<int>                            cpus_;
+    int                                         sched_policy_;
+    int                                         sched_priority_;
+    // (hash, loop index) sorted, built by start
+    std::vector<std::pair<uint32_t, size_t>>    hash_ring_;
 };
 
 } // namespace evpp
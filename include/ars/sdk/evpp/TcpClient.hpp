@@ -74,6 +74,7 @@ public:
         tls = false;
         connect_timeout = 5000;
         enable_reconnect = false;
+        unpack_setting = NULL;
     }
 
     virtual ~TcpClientTmpl() {
@@ -117,6 +118,9 @@ public:
             channel->setConnectTimeout(connect_timeout);
         }
         channel->onconnect = [this]() {
+            if (unpack_setting) {
+                channel->setUnpack(unpack_setting);
+            }
             channel->startRead();
             if (onConnection) {
                 onConnection(channel);
@@ -191,10 +195,21 @@ public:
         return 0;
     }
 
+    // NOTE: e.g. param->ktls, set param->endpoint = 1.
+    int withTLS(sdk::ssl_ctx_init_param_t* param) {
+        tls = true;
+        return sdk::ssl_ctx_init(param) == NULL ? -1 : 0;
+    }
+
     void setConnectTimeout(int ms) {
         connect_timeout = ms;
     }
 
+    // NOTE: framing of channel, see Channel::setUnpack
+    void setUnpack(sdk::event::unpack_setting_t* setting) {
+        unpack_setting = setting;
+    }
+
     void setReconnect(ReconnectInfo* info) {
         enable_reconnect = true;
         reconnect_info = *info;
@@ -208,6 +223,7 @@ public:
     int                     connect_timeout;
     bool                    enable_reconnect;
     ReconnectInfo           reconnect_info;
+    sdk::event::unpack_setting_t* unpack_setting;
 
     // Callback
     std::function<void(const TSocketChannelPtr&)>           onConnection;
@@ -42,33 +42,107 @@ public:
     TcpServer() {
         listenfd = -1;
         tls = false;
+        reuseport = false;
+        load_balance = false;
+        port = 0;
         max_connections = 0xFFFFFFFF;
+        unpack_setting = NULL;
+        acceptors_.emplace_back(new Acceptor(this));
+        next_acceptor_ = 0;
     }
 
     virtual ~TcpServer() {
+        // NOTE: loops close their listenfds with acceptors_, join them before it is gone.
+        loop_threads.stop(false);
+        loop_threads.join();
+    }
+
+    // NOTE: every loop listens on its own SO_REUSEPORT socket and keeps its own channels,
+    // so accept never hops between threads and the channel lock is uncontended.
+    // Call it before createsocket.
+    void setReusePort(bool on = true) {
+        reuseport = on;
     }
 
     //@retval >=0 listenfd, <0 error
     int createsocket(int port, const char* host = "0.0.0.0") {
-        listenfd = sdk::sock_fast_listen(port, host);
+        this->port = port;
+        this->host = host;
+        listenfd = sdk::sock_fast_listen(port, host, SOCK_STREAM, reuseport);
         return listenfd;
     }
 
+    // NOTE: hand each accepted connection over to the loop picked by lb,
+    // else it stays in the loop that accepted it. Ignored in reuseport mode,
+    // and ssl connections stay in the loop which did the handshake.
+    void setLoadBalance(EventLoopThreadPool::LoadBalance lb) {
+        loop_threads.setLoadBalance(lb);
+        load_balance = true;
+    }
+    void setLoadBalance(EventLoopThreadPool::LoadBalanceCallback cb) {
+        loop_threads.setLoadBalance(std::move(cb));
+        load_balance = true;
+    }
+
+    // NOTE: framing of every channel, see Channel::setUnpack
+    void setUnpack(sdk::event::unpack_setting_t* setting) {
+        unpack_setting = setting;
+    }
+
     void setMaxConnectionNum(uint32_t num) {
         max_connections = num;
     }
     void setThreadNum(int num) {
         loop_threads.setThreadNum(num);
     }
-    void start(bool wait_threads_started = true) {
+    // NOTE: see EventLoopThreadPool::setCpuAffinity
+    void setCpuAffinity(std::vector<int> cpus) {
+        loop_threads.setCpuAffinity(std::move(cpus));
+    }
+    void setSchedPolicy(int policy, int priority = 0) {
+        loop_threads.setSchedPolicy(policy, priority);
+    }
+    //@retval 0 started, <0 no listenfd or listen failed
+    int start(bool wait_threads_started = true) {
+        if (listenfd < 0) {
+            return -1;
+        }
+        acceptors_.clear();
+        int num = reuseport ? loop_threads.threadNum() : 1;
+        for (int i = 0; i < num; ++i) {
+            acceptors_.emplace_back(new Acceptor(this));
+        }
+        // NOTE: the first loop takes listenfd, others listen on the same port by their own,
+        // opened here so a failure is returned before any loop starts.
+        acceptors_[0]->listenfd = listenfd;
+        for (int i = 1; i < num; ++i) {
+            int fd = sdk::sock_fast_listen(port, host.c_str(), SOCK_STREAM, true);
+            if (fd < 0) {
+                closeListenfds();
+                acceptors_.resize(1);
+                return fd;
+            }
+            acceptors_[i]->listenfd = fd;
+            acceptors_[i]->owns_listenfd = true;
+        }
+        next_acceptor_ = 0;
         loop_threads.start(wait_threads_started, [this](const EventLoopPtr& loop){
-            assert(listenfd >= 0);
-            sdk::event::io_t* listenio = sdk::event::ev_accept(loop->loop(), listenfd, onAccept);
-            ars_event_set_userdata(listenio, this);
+            Acceptor* acceptor = acceptors_[reuseport ? next_acceptor_++ : 0].get();
+            acceptor->loop = loop.get();
+            sdk::event::io_t* listenio = sdk::event::ev_accept(loop->loop(), acceptor->listenfd, onAccept);
+            ars_event_set_userdata(listenio, acceptor);
             if (tls) {
                 sdk::event::io_enable_ssl(listenio);
             }
+        }, [this](const EventLoopPtr& loop){
+            // NOTE: the loop no longer polls its listenfd, close the one opened by start.
+            for (auto& acceptor : acceptors_) {
+                if (acceptor->loop == loop.get() && acceptor->owns_listenfd) {
+                    acceptor->closeListenfd();
+                }
+            }
         });
+        return 0;
     }
     void stop(bool wait_threads_stopped = true) {
         loop_threads.stop(wait_threads_stopped);
@@ -94,34 +168,163 @@ public:
         return 0;
     }
 
+    // NOTE: for session_cache, no_session_ticket and ktls, set param->endpoint = 0.
+    int withTLS(sdk::ssl_ctx_init_param_t* param) {
+        tls = true;
+        return sdk::ssl_ctx_init(param) == NULL ? -1 : 0;
+    }
+
     // channel
+    // NOTE: in reuseport mode, channels are kept by the acceptor of the io's loop, see onAccept.
     const SocketChannelPtr& addChannel(sdk::event::io_t* io) {
-        std::lock_guard<std::mutex> locker(mutex_);
-        int fd = sdk::event::io_fd(io);
-        channels[fd] = SocketChannelPtr(new SocketChannel(io));
-        return channels[fd];
+        return acceptorOf(io)->addChannel(io);
     }
 
     void removeChannel(const SocketChannelPtr& channel) {
-        std::lock_guard<std::mutex> locker(mutex_);
-        int fd = channel->fd();
-        channels.erase(fd);
+        for (auto& acceptor : acceptors_) {
+            if (acceptor->removeChannel(channel)) {
+                return;
+            }
+        }
     }
 
     size_t connectionNum() {
-        std::lock_guard<std::mutex> locker(mutex_);
-        return channels.size();
+        size_t num = 0;
+        for (auto& acceptor : acceptors_) {
+            num += acceptor->connection_num;
+        }
+        return num;
     }
 
 private:
+    // NOTE: one per loop in reuseport mode, else one shared by all loops.
+    // addChannel/removeChannel of TcpServer may come from any thread, so channels are
+    // always locked, in reuseport mode the lock is taken by its own loop only.
+    struct Acceptor {
+        TcpServer*                      server;
+        EventLoop*                      loop;
+        int                             listenfd;
+        bool                            owns_listenfd;
+        // fd => SocketChannelPtr
+        std::map<int, SocketChannelPtr> channels; // GUAREDE_BY(mutex)
+        std::mutex                      mutex;
+        std::atomic<uint32_t>           connection_num;
+
+        explicit Acceptor(TcpServer* server)
+            : server(server), loop(NULL), listenfd(-1), owns_listenfd(false), connection_num(0) {}
+
+        ~Acceptor() {
+            closeListenfd();
+        }
+
+        void closeListenfd() {
+            if (owns_listenfd && listenfd >= 0) {
+                sdk::sock_close(listenfd);
+            }
+            listenfd = -1;
+            owns_listenfd = false;
+        }
+
+        const SocketChannelPtr& addChannel(sdk::event::io_t* io) {
+            std::lock_guard<std::mutex> locker(mutex);
+            int fd = sdk::event::io_fd(io);
+            SocketChannelPtr& channel = channels[fd];
+            channel = SocketChannelPtr(new SocketChannel(io));
+            ++connection_num;
+            return channel;
+        }
+
+        // @return false if the channel is not kept here
+        bool removeChannel(const SocketChannelPtr& channel) {
+            std::lock_guard<std::mutex> locker(mutex);
+            auto iter = channels.find(channel->fd());
+            if (iter == channels.end() || iter->second != channel) {
+                return false;
+            }
+            channels.erase(iter);
+            --connection_num;
+            return true;
+        }
+    };
+
+    // NOTE: the acceptor of the loop io belongs to, the first one if not a loop of the server.
+    Acceptor* acceptorOf(sdk::event::io_t* io) {
+        if (reuseport) {
+            for (auto& acceptor : acceptors_) {
+                if (acceptor->loop && acceptor->loop->loop() == ars_event_loop(io)) {
+                    return acceptor.get();
+                }
+            }
+        }
+        return acceptors_[0].get();
+    }
+
+    // NOTE: fd detached from the accepting loop on its way to another one,
+    // closed with its count undone if that loop is gone before taking it.
+    struct DetachedFd {
+        EventLoop* loop;
+        int fd;
+
+        DetachedFd(EventLoop* loop, int fd) : loop(loop), fd(fd) {}
+        DetachedFd(DetachedFd&& other) : loop(other.loop), fd(other.fd) {
+            other.fd = -1;
+        }
+        DetachedFd(const DetachedFd&) = delete;
+        ~DetachedFd() {
+            if (fd < 0) return;
+            sdk::sock_close(fd);
+            loop->addConnectionNum(-1);
+        }
+
+        int release() {
+            int ret = fd;
+            fd = -1;
+            return ret;
+        }
+    };
+
+    void closeListenfds() {
+        for (auto& acceptor : acceptors_) {
+            acceptor->closeListenfd();
+        }
+    }
+
     static void onAccept(sdk::event::io_t* connio) {
-        TcpServer* server = (TcpServer*)ars_event_userdata(connio);
+        Acceptor* acceptor = (Acceptor*)ars_event_userdata(connio);
+        TcpServer* server = acceptor->server;
         if (server->connectionNum() >= server->max_connections) {
             // hlogw("over max_connections");
             sdk::event::io_close(connio);
             return;
         }
-        const SocketChannelPtr& channel = server->addChannel(connio);
+        EventLoop* loop = tlsEventLoop();
+        if (server->load_balance && !server->reuseport && !server->tls) {
+            // NOTE: loads are read without lock, count it to the target at once,
+            // so a burst of accepts does not pile on one loop.
+            EventLoopPtr target = server->loop_threads.nextLoop(sdk::event::io_peeraddr(connio));
+            if (target && target.get() != loop) {
+                // NOTE: the functor lives in the target loop, so a raw pointer to it,
+                // and connfd is closed if the functor is dropped without running.
+                EventLoop* tloop = target.get();
+                DetachedFd connfd(tloop, sdk::event::io_fd(connio));
+                sdk::event::io_detach(connio);
+                target->addConnectionNum(1);
+                target->queueInLoop([acceptor, tloop, connfd = std::move(connfd)]() mutable {
+                    if (tloop->loop() == NULL) return;
+                    sdk::event::io_t* io = sdk::event::io_get(tloop->loop(), connfd.release());
+                    ars_event_set_userdata(io, acceptor);
+                    newChannel(acceptor, tloop, io);
+                });
+                return;
+            }
+        }
+        if (loop) loop->addConnectionNum(1);
+        newChannel(acceptor, loop, connio);
+    }
+
+    static void newChannel(Acceptor* acceptor, EventLoop* loop, sdk::event::io_t* connio) {
+        TcpServer* server = acceptor->server;
+        const SocketChannelPtr& channel = acceptor->addChannel(connio);
         channel->status = SocketChannel::CONNECTED;
 
         channel->onread = [server, &channel](Buffer* buf) {
@@ -134,16 +337,20 @@ private:
                 server->onWriteComplete(channel, buf);
             }
         };
-        channel->onclose = [server, &channel]() {
+        channel->onclose = [server, acceptor, loop, &channel]() {
             channel->status = SocketChannel::CLOSED;
             if (server->onConnection) {
                 server->onConnection(channel);
             }
-            server->removeChannel(channel);
+            if (loop) loop->addConnectionNum(-1);
+            acceptor->removeChannel(channel);
             // NOTE: After removeChannel, channel may be destroyed,
             // so in this lambda function, no code should be added below.
         };
 
+        if (server->unpack_setting) {
+            channel->setUnpack(server->unpack_setting);
+        }
         channel->startRead();
         if (server->onConnection) {
             server->onConnection(channel);
@@ -153,18 +360,22 @@ private:
 public:
     int                     listenfd;
     bool                    tls;
+    bool                    reuseport;
+    bool                    load_balance;
+    int                     port;
+    std::string             host;
     // Callback
     ConnectionCallback      onConnection;
     MessageCallback         onMessage;
     WriteCompleteCallback   onWriteComplete;
 
     uint32_t                max_connections;
+    sdk::event::unpack_setting_t* unpack_setting;
 
 private:
-    EventLoopThreadPool     loop_threads;
-    // fd => SocketChannelPtr
-    std::map<int, SocketChannelPtr> channels; // GUAREDE_BY(mutex_)
-    std::mutex                      mutex_;
+    EventLoopThreadPool                     loop_threads;
+    std::vector<std::unique_ptr<Acceptor>>  acceptors_;
+    std::atomic<int>                        next_acceptor_;
 };
 
 } // namespace evpp
@@ -56,6 +56,13 @@ public:
         return channel->fd();
     }
 
+    // 批量收发: recvmmsg/sendmmsg, 需在createsocket之后调用, 见 io_set_mmsg
+    //@retval 0 ok, <0 error
+    int setBatch(int nmsgs = 64, int msgsize = 2048, int flags = 0) {
+        if (channel == NULL) return -1;
+        return sdk::event::io_set_mmsg(channel->io(), nmsgs, msgsize, flags);
+    }
+
     void start(bool wait_threads_started = true) {
         loop_thread.start(wait_threads_started,
             [this]() {
@@ -56,6 +56,13 @@ public:
         return channel->fd();
     }
 
+    // 批量收发: recvmmsg/sendmmsg, 需在createsocket之后调用, 见 io_set_mmsg
+    //@retval 0 ok, <0 error
+    int setBatch(int nmsgs = 64, int msgsize = 2048, int flags = 0) {
+        if (channel == NULL) return -1;
+        return sdk::event::io_set_mmsg(channel->io(), nmsgs, msgsize, flags);
+    }
+
     void start(bool wait_threads_started = true) {
         loop_thread.start(wait_threads_started,
             [this]() {
@@ -80,15 +87,18 @@ public:
     }
 
     int sendto(Buffer* buf, struct sockaddr* peeraddr = NULL) {
-        if (channel == NULL) return 0;
-        if (peeraddr) sdk::event::io_set_peeraddr(channel->io(), peeraddr, ARS_SOCKADDR_LEN(peeraddr));
-        return channel->write(buf);
+        return sendto(buf->data(), buf->size(), peeraddr);
     }
 
     int sendto(const std::string& str, struct sockaddr* peeraddr = NULL) {
+        return sendto(str.data(), str.size(), peeraddr);
+    }
+
+    int sendto(const void* data, int size, struct sockaddr* peeraddr = NULL) {
         if (channel == NULL) return 0;
-        if (peeraddr) sdk::event::io_set_peeraddr(channel->io(), peeraddr, ARS_SOCKADDR_LEN(peeraddr));
-        return channel->write(str);
+        if (peeraddr == NULL) return channel->write(data, size);
+        if (!channel->isOpened()) return 0;
+        return sdk::event::io_sendto(channel->io(), data, size, peeraddr);
     }
 
 public:
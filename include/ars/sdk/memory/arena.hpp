@@ -0,0 +1,208 @@
+/**
+ * Copyright © 2021 <wotsen>.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of this software
+ * and associated documentation files (the “Software”), to deal in the Software without
+ * restriction, including without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sublicense, and/or sell copies of the Software, and to permit persons to whom the
+ *
+ * The above copyright notice and this permission notice shall be included in all copies or
+ * substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED “AS IS”, WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING
+ * BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM,
+ * DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ *
+ * @file arena.hpp
+ * @brief 区域内存分配器
+ * @author wotsen (astralrovers@outlook.com)
+ * @version 1.0.0
+ * @date 2021-06-19
+ *
+ * @copyright MIT
+ *
+ */
+#pragma once
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+#include <new>
+#include <type_traits>
+#include <utility>
+
+namespace ars {
+
+namespace sdk {
+
+/**
+ * @brief 区域分配器，从链起来的块中顺序切分，不单独释放，reset 一次全部回收
+ *
+ * 块用完后挂新块，reset 回到第一块，已有的块留着复用，不归还内存。
+ * 超过块大小 1/4 的分配单独向 ars_malloc 申请，reset 时释放。
+ * 析构函数不会被调用，放入的对象须可平凡析构。非线程安全。
+ */
+class Arena {
+public:
+    /// 位置标记，rewind 回到此处
+    typedef struct {
+        void *chunk;
+        char *pos;
+        void *large;
+    } mark_t;
+
+    /// @param chunk_size 每块大小，不含块头
+    explicit Arena(size_t chunk_size = 4096);
+    ~Arena();
+
+    Arena(const Arena&) = delete;
+    Arena& operator=(const Arena&) = delete;
+
+    /**
+     * @brief 分配内存，内容未初始化
+     * @param align 2 的幂
+     * @return 内存不足返回 NULL
+     */
+    void *alloc(size_t size, size_t align = alignof(max_align_t)) {
+        uintptr_t p = ((uintptr_t)pos_ + align - 1) & ~(uintptr_t)(align - 1);
+        // NOTE: size 为 0 或无当前块时走慢路径
+        if (p + size <= (uintptr_t)end_ && p + size > p) {
+            pos_ = (char*)(p + size);
+            return (void*)p;
+        }
+        return alloc_slow(size, align);
+    }
+
+    /// 分配并清零
+    void *zalloc(size_t size, size_t align = alignof(max_align_t)) {
+        void *p = alloc(size, align);
+        if (p) {
+            memset(p, 0, size);
+        }
+        return p;
+    }
+
+    /// 在 p 原处扩大或另分配并拷贝，旧内存不回收
+    void *realloc(void *p, size_t old_size, size_t new_size, size_t align = alignof(max_align_t));
+
+    char *strdup(const char *s) {
+        return strndup(s, strlen(s));
+    }
+
+    /// 拷贝 n 个字符并补 '\0'
+    char *strndup(const char *s, size_t n) {
+        char *p = (char*)alloc(n + 1, 1);
+        if (p) {
+            memcpy(p, s, n);
+            p[n] = '\0';
+        }
+        return p;
+    }
+
+    template <typename T, typename... Args>
+    T *create(Args&&... args) {
+        static_assert(std::is_trivially_destructible<T>::value, "arena never runs destructors");
+        void *p = alloc(sizeof(T), alignof(T));
+        return p ? new (p) T(std::forward<Args>(args)...) : NULL;
+    }
+
+    /// 回到初始状态，O(1)，只释放单独申请的大块
+    void reset(void);
+
+    mark_t mark(void) const {
+        return mark_t{cur_, pos_, large_};
+    }
+    /// 回到 m，之后的分配全部作废
+    void rewind(const mark_t &m);
+
+    /// 已分配字节数，含对齐填充
+    size_t used(void) const;
+    /// 向系统申请的字节数
+    size_t reserved(void) const { return reserved_; }
+
+private:
+    void *alloc_slow(size_t size, size_t align);
+    void free_large(void *until);
+
+    struct chunk_s;
+
+    size_t chunk_size_;
+    size_t reserved_;
+    struct chunk_s *head_;
+    struct chunk_s *cur_;
+    void *large_;
+    char *pos_;
+    char *end_;
+};
+
+/**
+ * @brief 作用域内的分配在离开时回收
+ *
+ * @code
+ * {
+ *     ArenaScope scope(arena);
+ *     uri_t *u = uri_parse(s, len, arena);
+ * }
+ * @endcode
+ */
+class ArenaScope {
+public:
+    explicit ArenaScope(Arena &arena) : arena_(arena), mark_(arena.mark()) {}
+    ~ArenaScope() { arena_.rewind(mark_); }
+
+    ArenaScope(const ArenaScope&) = delete;
+    ArenaScope& operator=(const ArenaScope&) = delete;
+
+private:
+    Arena &arena_;
+    Arena::mark_t mark_;
+};
+
+/**
+ * @brief STL 分配器适配，deallocate 不回收，容器须在 reset 前析构
+ *
+ * @code
+ * std::vector<int, ArenaAllocator<int>> v(ArenaAllocator<int>(arena));
+ * @endcode
+ */
+template <typename T>
+class ArenaAllocator {
+public:
+    typedef T value_type;
+
+    explicit ArenaAllocator(Arena &arena) noexcept : arena_(&arena) {}
+    template <typename U>
+    ArenaAllocator(const ArenaAllocator<U> &other) noexcept : arena_(other.arena()) {}
+
+    T *allocate(size_t n) {
+        if (n > (size_t)-1 / sizeof(T)) {
+            throw std::bad_alloc();
+        }
+        void *p = arena_->alloc(n * sizeof(T), alignof(T));
+        if (!p) {
+            throw std::bad_alloc();
+        }
+        return (T*)p;
+    }
+
+    void deallocate(T*, size_t) noexcept {}
+
+    Arena *arena(void) const noexcept { return arena_; }
+
+    template <typename U>
+    bool operator==(const ArenaAllocator<U> &other) const noexcept {
+        return arena_ == other.arena();
+    }
+    template <typename U>
+    bool operator!=(const ArenaAllocator<U> &other) const noexcept {
+        return arena_ != other.arena();
+    }
+
+private:
+    Arena *arena_;
+};
+
+} // namespace sdk
+
+} // namespace ars
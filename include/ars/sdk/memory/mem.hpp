@@ -32,6 +32,13 @@ namespace ars {
 
 namespace sdk {
 
+/// 页策略，低8位为页类型，可与 ARS_PAGE_MLOCK 组合
+#define ARS_PAGE_DEFAULT        0       ///< 普通页
+#define ARS_PAGE_THP            1       ///< madvise(MADV_HUGEPAGE) 透明大页
+#define ARS_PAGE_HUGETLB        2       ///< MAP_HUGETLB 显式大页，无预留时退回透明大页
+#define ARS_PAGE_BACKING_MASK   0xff
+#define ARS_PAGE_MLOCK          0x100   ///< mlock 锁定，映射时即触页，避免首次访问缺页
+
 /**
  * @brief 内存分配接口
  */
@@ -41,11 +48,13 @@ typedef struct {
     void *(*realloc)(void *, size_t);
     void *(*calloc)(size_t, size_t);
     void (*free)(void*);
+    /// 页策略，作用于 ars_page_alloc 以及slab池、loop读缓冲、内置分配器的段，0 保持原样
+    int page_policy;
 } memory_conf_t;
 
 /**
  * @brief 内存函数初始化
- * @param conf 配置
+ * @param conf 配置，为空的项保持原样，内置分配器见 sc_alloc.hpp 的 sc_memory_conf
  */
 void ars_memory_init(const memory_conf_t &conf);
 
@@ -69,6 +78,25 @@ void *ars_calloc(size_t nmemb, size_t size);
 void *ars_zalloc(size_t size);
 void ars_free(void *ptr);
 
+/// 当前页策略
+int ars_page_policy(void);
+/// 设置页策略，可设回 ARS_PAGE_DEFAULT，只影响之后的映射
+void ars_set_page_policy(int policy);
+
+/**
+ * @brief 按页策略映射匿名内存
+ * @param size 输入请求大小，输出实际映射大小(页或大页的整数倍)，释放时原样传回
+ * @return 失败返回 NULL
+ */
+void *ars_page_alloc(size_t *size);
+void ars_page_free(void *ptr, size_t size);
+
+/**
+ * @brief 对已有内存按页策略建议透明大页、锁定，显式大页按透明大页处理
+ * @return 0 成功，-1 有一项失败
+ */
+int ars_page_advise(void *addr, size_t len, int policy);
+
 long alloc_cnt(void);
 long free_cnt(void);
 void memroy_check(void);
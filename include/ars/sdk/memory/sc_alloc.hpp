@@ -0,0 +1,73 @@
+/**
+ * Copyright © 2021 <wotsen>.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of this software
+ * and associated documentation files (the “Software”), to deal in the Software without
+ * restriction, including without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sublicense, and/or sell copies of the Software, and to permit persons to whom the
+ *
+ * The above copyright notice and this permission notice shall be included in all copies or
+ * substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED “AS IS”, WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING
+ * BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM,
+ * DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ *
+ * @file sc_alloc.hpp
+ * @brief 内置分级内存分配器
+ * @author wotsen (astralrovers@outlook.com)
+ * @version 1.0.0
+ * @date 2021-06-12
+ *
+ * @copyright MIT
+ *
+ */
+#pragma once
+#include <stddef.h>
+#include "mem.hpp"
+
+namespace ars {
+
+namespace sdk {
+
+/**
+ * 每个线程一个堆，小块按大小分级，从 64K 的span中切分，span取自 4M 对齐的段，
+ * 段以透明大页的方式映射。本线程分配本线程释放不加锁；
+ * 其他线程释放的块无锁挂到span的远程链表上，由所属线程分配时取回。
+ * 线程退出后其堆留给新线程接管。超过 SC_MAX_SMALL_SIZE 的块直接 mmap，
+ * 4M 以内的映射长度按分级取整，释放后缓存(总量有上限)供同级再分配。
+ *
+ * 通过 ars_memory_init(sc_memory_conf()) 启用，必须在任何 ars_malloc 之前调用，
+ * 之前由其他分配器分配的内存不能再由本分配器释放。
+ */
+
+#define SC_MAX_SMALL_SIZE (32 * 1024)
+
+void *sc_malloc(size_t size);
+
+/**
+ * @brief 对齐分配
+ * @param alignment 2 的幂，不超过 64K
+ * @return 0 成功，EINVAL 对齐无效，ENOMEM 内存不足
+ */
+int sc_memalign(void **ptr, size_t alignment, size_t size);
+void *sc_realloc(void *ptr, size_t size);
+void *sc_calloc(size_t nmemb, size_t size);
+void sc_free(void *ptr);
+
+/**
+ * @brief 块的实际可用大小
+ * @param ptr 本分配器返回的地址
+ */
+size_t sc_usable_size(void *ptr);
+
+/**
+ * @brief 内置分配器的配置，交给 ars_memory_init
+ */
+const memory_conf_t &sc_memory_conf(void);
+
+} // namespace sdk
+
+} // namespace ars
@@ -0,0 +1,111 @@
+/**
+ * Copyright © 2021 <wotsen>.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of this software
+ * and associated documentation files (the “Software”), to deal in the Software without
+ * restriction, including without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sublicense, and/or sell copies of the Software, and to permit persons to whom the
+ *
+ * The above copyright notice and this permission notice shall be included in all copies or
+ * substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED “AS IS”, WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING
+ * BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM,
+ * DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ *
+ * @file shm_pool.hpp
+ * @brief 多进程共享内存池
+ * @author wotsen (astralrovers@outlook.com)
+ * @version 1.0.0
+ * @date 2021-06-26
+ *
+ * @copyright MIT
+ *
+ */
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+
+namespace ars {
+
+namespace sdk {
+
+typedef struct shm_pool_hdr_s shm_pool_hdr_t;
+
+/// 共享内存池状态
+typedef struct {
+    size_t pool_size;       /* 区域大小 */
+    size_t carved_size;     /* 已切分的大小，含块头 */
+    size_t used_size;       /* 已分配块的大小，含块头 */
+    size_t used_blocks;
+    size_t free_blocks;     /* 在空闲链表中的块 */
+    size_t detached_blocks; /* 归池所有的块 */
+} shm_pool_stat_t;
+
+/**
+ * @brief 放在共享内存(ipc::shm_map)中的多进程内存池
+ *
+ * 池内只存相对区域首地址的偏移，各进程映射地址不同也可使用，
+ * 进程间传递地址用 offset/ptr 转换。块按大小分级，释放的块进入
+ * 该级的无锁空闲链表(带版本号防ABA)，不合并；链表为空时才在
+ * 健壮互斥锁下从区域尾部切分新块，持锁进程崩溃不会使池卡死。
+ *
+ * 每个块记录分配它的进程号，进程崩溃后由 recover 回收。
+ * 要在进程退出后继续存在的块(如共享的查找表)须 detach 归池所有。
+ *
+ * @note 区域最大 64G，偏移以16字节为单位存在32位中。
+ * 进程在取出空闲块与写入进程号之间崩溃，该块不能回收。
+ * 释放时先把属主改为"释放中|进程号"再放回空闲链表，进程在两步之间
+ * 崩溃，该块同样不能回收：它与已被其他进程取出、尚未写进程号的块
+ * 无法区分，recover 只给仍在链表中的块收尾。
+ */
+class MemoryShmPool {
+public:
+    /**
+     * @param addr 区域首地址，16字节对齐
+     * @param len 区域大小
+     * @param create true 初始化区域，false 挂接其他进程已初始化的区域
+     */
+    MemoryShmPool(void *addr, size_t len, bool create);
+    ~MemoryShmPool();
+
+    /// 初始化或挂接是否成功
+    bool valid(void) const { return hdr_ != NULL; }
+
+    /// @return 失败返回 NULL
+    void *alloc(size_t size);
+    /// 任意进程均可释放，重复释放会被忽略
+    void free(void *p);
+    /// 块改为归池所有，任何进程退出都不回收
+    void detach(void *p);
+
+    /// 地址转偏移，NULL 转为 0
+    uint64_t offset(const void *p) const;
+    /// 偏移转本进程地址，0 转为 NULL
+    void *ptr(uint64_t off) const;
+
+    /// 各进程共享的入口，如查找表的根节点，存为偏移
+    void set_root(void *p);
+    void *root(void) const;
+
+    /**
+     * @brief 回收已退出进程持有的块
+     * @return 回收的块数
+     */
+    size_t recover(void);
+
+    void stat(shm_pool_stat_t &st);
+
+private:
+    void *carve(uint32_t cls);
+
+    shm_pool_hdr_t *hdr_;
+    char *base_;
+};
+
+}  // namespace sdk
+
+}  // namespace ars
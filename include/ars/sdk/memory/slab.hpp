@@ -43,6 +43,7 @@ typedef struct {
     size_t p_small, p_exact, p_big, p_page; /* 四种slab占用的page数 */
     size_t b_small, b_exact, b_big, b_page; /* 四种slab占用的byte数 */
     size_t max_free_pages;                  /* 最大的连续可用page数 */
+    size_t b_cached;                        /* 本进程线程缓存中的空闲byte数，不计入used_size */
 } slab_stat_t;
 
 /// 内存池
@@ -56,6 +57,19 @@ public:
     void free(void *p);
     void stat(slab_stat_t &st);
 
+    /**
+     * @brief 开启线程缓存，小于半页的块按大小类缓存在各线程的空闲链表中，
+     * 空时从池中批量取，满时批量还，每批只加一次锁
+     *
+     * @param batch 每批块数，大块按字节数减少，0关闭
+     * @note 需在多线程使用前调用。缓存在本进程内，池在共享内存中同样可用，
+     * 其他进程缓存的块在本进程stat中算作已用。线程退出时归还，
+     * fork后子进程丢弃继承的缓存
+     */
+    void enable_thread_cache(uint32_t batch = 32);
+    /// 归还本线程缓存的块
+    void flush_thread_cache(void);
+
 private:
     MemorySlabImpl *impl_;
 };
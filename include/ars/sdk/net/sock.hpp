@@ -240,6 +240,9 @@ ssize_t sock_recvfrom(int fd, void* data, size_t len, sock_addr_t& addr, time_t
 // 地址重用
 int sock_set_addr_reuse(int fd);
 
+// 端口重用(SO_REUSEPORT), 多个socket监听同一端口, 内核负载均衡
+int sock_set_port_reuse(int fd, bool en = true);
+
 // 关闭延迟
 int sock_set_nodelay(int fd, bool en = true);
 
@@ -306,7 +309,7 @@ static inline void sock_addr_print(sock_addr_t* addr) {
     puts(buf);
 }
 
-static inline int sock_fast_bind(int port, const char *ip, int type) {
+static inline int sock_fast_bind(int port, const char *ip, int type, bool reuseport = false) {
     sock_addr_t addr;
     memset(&addr, 0, sizeof(addr));
 
@@ -325,6 +328,11 @@ static inline int sock_fast_bind(int port, const char *ip, int type) {
         return socket_errno_negative();
     }
 
+    if (reuseport && sock_set_port_reuse(fd) < 0) {
+        sock_close(fd);
+        return socket_errno_negative();
+    }
+
     if (sock_bind(fd, ip, port) < 0) {
         sock_close(fd);
         return socket_errno_negative();
@@ -333,8 +341,8 @@ static inline int sock_fast_bind(int port, const char *ip, int type) {
     return fd;
 }
 
-static inline int sock_fast_listen(int port, const char *ip, int type=SOCK_STREAM) {
-    int fd = sock_fast_bind(port, ip, type);
+static inline int sock_fast_listen(int port, const char *ip, int type=SOCK_STREAM, bool reuseport = false) {
+    int fd = sock_fast_bind(port, ip, type, reuseport);
     if (fd < 0) {
         return fd;
     }
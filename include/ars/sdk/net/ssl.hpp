@@ -46,6 +46,9 @@ typedef struct {
     const char* ca_file;
     short       verify_peer;
     short       endpoint; // 0: server 1: client
+    int         session_cache;      // server: sessions kept by the cache shared by all loops, 0: backend default
+    short       no_session_ticket;  // server: resume by session cache only, no stateless ticket
+    short       ktls;               // 1: kernel tls after handshake if the backend and kernel support it
 } ssl_ctx_init_param_t;
 
 /*
@@ -67,6 +70,11 @@ ssl_ctx_t ssl_ctx_init(ssl_ctx_init_param_t* param);
 void ssl_ctx_cleanup(ssl_ctx_t ssl_ctx);
 ssl_ctx_t ssl_ctx_instance();
 
+// NOTE: same keys on every process of a service, tickets resume on any of them.
+// @param keys: 80 bytes for openssl, name(16) hmac(32) aes(32)
+// @return 0 ok, -1 unsupported or bad length
+int ssl_ctx_set_ticket_keys(ssl_ctx_t ssl_ctx, const void* keys, int len);
+
 ssl_t ssl_new(ssl_ctx_t ssl_ctx, int fd);
 void ssl_free(ssl_t ssl);
 
@@ -76,6 +84,11 @@ int ssl_read(ssl_t ssl, void* buf, int len);
 int ssl_write(ssl_t ssl, const void* buf, int len);
 int ssl_close(ssl_t ssl);
 
+// @return 1 if session of ssl was resumed
+int ssl_session_reused(ssl_t ssl);
+// @return 1 if records are encrypted by kernel on send, then write/writev/sendfile on fd go as app data
+int ssl_ktls_send(ssl_t ssl);
+
 } // namespace sdk
 
 } // namespace ars
@@ -0,0 +1,204 @@
+/**
+ * Copyright © 2021 <wotsen>.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of this software
+ * and associated documentation files (the “Software”), to deal in the Software without
+ * restriction, including without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sublicense, and/or sell copies of the Software, and to permit persons to whom the
+ *
+ * The above copyright notice and this permission notice shall be included in all copies or
+ * substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED “AS IS”, WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING
+ * BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM,
+ * DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ *
+ * @file function.hpp
+ * @brief 只可移动的函数对象，小对象就地存储
+ * @author wotsen (astralrovers@outlook.com)
+ * @version 1.0.0
+ * @date 2021-05-05
+ *
+ * @copyright MIT
+ *
+ */
+#pragma once
+#include <stddef.h>
+#include <new>          // placement new
+#include <type_traits>  // std::decay, std::enable_if
+#include <utility>      // std::forward, std::move
+
+namespace ars {
+
+namespace sdk {
+
+/// 就地存储容量，lambda 捕获若干指针或一个 std::function 时不分配堆内存
+#define ARS_FUNCTION_INLINE_SIZE (6 * sizeof(void*))
+
+template <typename Signature, size_t Capacity = ARS_FUNCTION_INLINE_SIZE>
+class unique_function;
+
+////////////////////////////////////////////////////////////////
+/// Move-only std::function, callables not bigger than Capacity
+/// and nothrow movable are stored in place without allocation,
+/// so move-only captures (std::unique_ptr, std::packaged_task) work.
+////////////////////////////////////////////////////////////////
+
+template <typename R, typename... Args, size_t Capacity>
+class unique_function<R(Args...), Capacity>
+{
+    struct ops_t {
+        R (*invoke)(void* obj, Args&&... args);
+        // move-construct dst from src, then destroy src
+        void (*relocate)(void* dst, void* src);
+        void (*destroy)(void* obj);
+    };
+
+    template <typename F>
+    struct is_inline
+        : std::integral_constant<bool, sizeof(F) <= Capacity &&
+                                       alignof(F) <= alignof(max_align_t) &&
+                                       std::is_nothrow_move_constructible<F>::value> {};
+
+    template <typename F>
+    struct inline_ops {
+        static R invoke(void* obj, Args&&... args) {
+            return (*static_cast<F*>(obj))(std::forward<Args>(args)...);
+        }
+        static void relocate(void* dst, void* src) {
+            new (dst) F(std::move(*static_cast<F*>(src)));
+            static_cast<F*>(src)->~F();
+        }
+        static void destroy(void* obj) {
+            static_cast<F*>(obj)->~F();
+        }
+        static constexpr ops_t ops = {invoke, relocate, destroy};
+    };
+
+    template <typename F>
+    struct heap_ops {
+        static R invoke(void* obj, Args&&... args) {
+            return (**static_cast<F**>(obj))(std::forward<Args>(args)...);
+        }
+        static void relocate(void* dst, void* src) {
+            *static_cast<F**>(dst) = *static_cast<F**>(src);
+        }
+        static void destroy(void* obj) {
+            delete *static_cast<F**>(obj);
+        }
+        static constexpr ops_t ops = {invoke, relocate, destroy};
+    };
+
+    template <typename F>
+    using enable_if_callable = typename std::enable_if<
+        !std::is_same<typename std::decay<F>::type, unique_function>::value &&
+        std::is_constructible<typename std::decay<F>::type, F&&>::value>::type;
+
+public:
+    unique_function(void) noexcept : ops_(nullptr) {}
+    unique_function(std::nullptr_t) noexcept : ops_(nullptr) {}
+
+    template <typename F, typename = enable_if_callable<F>>
+    unique_function(F&& f) : ops_(nullptr)
+    {
+        assign(std::forward<F>(f));
+    }
+
+    unique_function(unique_function&& rhs) noexcept : ops_(rhs.ops_)
+    {
+        if (ops_) {
+            ops_->relocate(storage_, rhs.storage_);
+            rhs.ops_ = nullptr;
+        }
+    }
+
+    unique_function& operator=(unique_function&& rhs) noexcept
+    {
+        if (this != &rhs) {
+            reset();
+            if (rhs.ops_) {
+                rhs.ops_->relocate(storage_, rhs.storage_);
+                ops_ = rhs.ops_;
+                rhs.ops_ = nullptr;
+            }
+        }
+        return *this;
+    }
+
+    unique_function& operator=(std::nullptr_t) noexcept
+    {
+        reset();
+        return *this;
+    }
+
+    template <typename F, typename = enable_if_callable<F>>
+    unique_function& operator=(F&& f)
+    {
+        reset();
+        assign(std::forward<F>(f));
+        return *this;
+    }
+
+    unique_function(const unique_function&) = delete;
+    unique_function& operator=(const unique_function&) = delete;
+
+    ~unique_function(void) { reset(); }
+
+    explicit operator bool(void) const noexcept { return ops_ != nullptr; }
+
+    // NOTE: const like std::function, the callable itself may be mutable.
+    R operator()(Args... args) const
+    {
+        return ops_->invoke(const_cast<unsigned char*>(storage_), std::forward<Args>(args)...);
+    }
+
+    void swap(unique_function& rhs) noexcept
+    {
+        unique_function tmp(std::move(rhs));
+        rhs = std::move(*this);
+        *this = std::move(tmp);
+    }
+
+private:
+    template <typename F>
+    void assign(F&& f)
+    {
+        typedef typename std::decay<F>::type T;
+        if (is_null(f)) return;
+        if constexpr (is_inline<T>::value) {
+            new (storage_) T(std::forward<F>(f));
+            ops_ = &inline_ops<T>::ops;
+        } else {
+            *reinterpret_cast<T**>(storage_) = new T(std::forward<F>(f));
+            ops_ = &heap_ops<T>::ops;
+        }
+    }
+
+    // empty std::function or null function pointer stays empty
+    template <typename F>
+    static bool is_null(const F& f)
+    {
+        if constexpr (std::is_constructible<bool, const F&>::value) {
+            return !static_cast<bool>(f);
+        } else {
+            return false;
+        }
+    }
+
+    void reset(void) noexcept
+    {
+        if (ops_) {
+            ops_->destroy(storage_);
+            ops_ = nullptr;
+        }
+    }
+
+    alignas(max_align_t) unsigned char storage_[Capacity < sizeof(void*) ? sizeof(void*) : Capacity];
+    const ops_t* ops_;
+};
+
+} // namespace sdk
+
+} // namespace ars
@@ -32,6 +32,8 @@ namespace ars {
     
 namespace sdk {
 
+class Arena;
+
 #define ARS_DNS_PORT        53
 
 #define ARS_DNS_QUERY       0
@@ -117,6 +119,8 @@ int dns_rr_unpack(char* buf, int len, dns_rr_t* rr, int is_question);
 
 int dns_pack(dns_t* dns, char* buf, int len);
 int dns_unpack(char* buf, int len, dns_t* dns);
+// NOTE: rrs are allocated from arena, no dns_free, rr->data points into buf.
+int dns_unpack(char* buf, int len, dns_t* dns, Arena& arena);
 // NOTE: free dns->rrs
 void dns_free(dns_t* dns);
 
@@ -30,6 +30,8 @@ namespace ars {
 
 namespace sdk {
 
+class Arena;
+
 struct uri_t
 {
 	char* scheme;
@@ -61,6 +63,9 @@ struct uri_query_t
 /// @return NULL if parse failed, other-uri_t pointer, free by uri_free
 struct uri_t* uri_parse(const char* uri, int len);
 
+/// same as uri_parse, but uri_t is allocated from arena, no uri_free
+struct uri_t* uri_parse(const char* uri, int len, Arena& arena);
+
 /// @param[in] uri return by uri_parse
 void uri_free(struct uri_t* uri);
 
@@ -72,6 +77,8 @@ int uri_path(const struct uri_t* uri, char* buf, int len);
 int uri_userinfo(const struct uri_t* uri, char* usr, int n1, char* pwd, int n2);
 
 int uri_query(const char* query, const char* end, struct uri_query_t** items);
+/// same as uri_query, but items are allocated from arena, no uri_query_free
+int uri_query(const char* query, const char* end, struct uri_query_t** items, Arena& arena);
 
 void uri_query_free(struct uri_query_t** items);
 
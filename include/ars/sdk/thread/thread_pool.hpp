@@ -38,6 +38,7 @@
 #include <condition_variable>
 #include <utility>
 #include "thread_pool_task_queue.hpp"
+#include "ars/sdk/patterns/function.hpp"
 
 namespace ars {
 
@@ -47,7 +48,7 @@ namespace sdk {
  * @brief 任务接口类型
  * 
  */
-typedef std::function<void(void)> thread_task_t;
+typedef unique_function<void(void)> thread_task_t;
 
 /**
  * @brief 微内核线程池
@@ -85,8 +86,8 @@ public:
     }
 
     // XXX:这里不做不定参数的接口，外部传入时可以自行绑定
-    virtual void add_task(const thread_task_t &task) {
-        queue_.push([task]() { task(); });
+    virtual void add_task(thread_task_t task) {
+        queue_.push(std::move(task));
     }
 
 private:
@@ -114,7 +115,7 @@ private:
 // 实现2
 class ThreadPool {
 public:
-    using Task = std::function<void()>;
+    using Task = unique_function<void()>;
 
     ThreadPool(int size = std::thread::hardware_concurrency())
         : pool_size(size), idle_num(size), status(STOP) {
@@ -201,13 +202,13 @@ public:
     template<class Fn, class... Args>
     auto commit(Fn&& fn, Args&&... args) -> std::future<decltype(fn(args...))> {
         using RetType = decltype(fn(args...));
-        auto task = std::make_shared<std::packaged_task<RetType()> >(
+        std::packaged_task<RetType()> task(
             std::bind(std::forward<Fn>(fn), std::forward<Args>(args)...));
-        std::future<RetType> future = task->get_future();
+        std::future<RetType> future = task.get_future();
         {
             std::lock_guard<std::mutex> locker(_mutex);
-            tasks.emplace([task]{
-                (*task)();
+            tasks.emplace([task = std::move(task)]() mutable {
+                task();
             });
         }
 
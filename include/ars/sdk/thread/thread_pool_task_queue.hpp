@@ -31,6 +31,7 @@
 #include <thread>
 #include <mutex>
 #include <condition_variable>
+#include <utility>
 
 namespace ars {
 
@@ -73,7 +74,7 @@ public:
             return false;
         }
 
-        t = queue_.front();
+        t = std::move(queue_.front());
         queue_.pop_front();
         not_full_.notify_one();
 
@@ -264,6 +264,20 @@ static inline int thread_attr_get_schedpolicy(thread_attr_t *attr, int *policy)
     return ::pthread_attr_getschedpolicy(attr, policy);
 }
 
+/**
+ * @brief 设置运行中线程的调度策略和优先级
+ * 
+ * @param tid 线程号
+ * @param policy 调度属性 SCHED_FIFO,SCHED_RR,SCHED_OTHER
+ * @param priority 优先级，SCHED_OTHER 为 0
+ * @return int 0成功，小于0异常
+ */
+static inline int thread_set_sched(thread_t tid, int policy, int priority) {
+    struct sched_param param;
+    param.sched_priority = priority;
+    return -::pthread_setschedparam(tid, policy, &param);
+}
+
 /**
  * @brief 设置线程属性作用域
  * 
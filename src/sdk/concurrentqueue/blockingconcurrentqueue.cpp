@@ -1,7 +1,8 @@
 #include "concurrentqueue.h"
 #include "ars/sdk/concurrentqueue/blockingconcurrentqueue.h"
+#include "traits.hpp"
 
-typedef moodycamel::BlockingConcurrentQueue<void*> MoodycamelBCQType, *MoodycamelBCQPtr;
+typedef moodycamel::BlockingConcurrentQueue<void*, ArsQueueTraits> MoodycamelBCQType, *MoodycamelBCQPtr;
 
 extern "C" {
 	
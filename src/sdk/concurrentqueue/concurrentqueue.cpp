@@ -1,7 +1,8 @@
 #include "concurrentqueue.h"
 #include "ars/sdk/concurrentqueue/concurrentqueue.h"
+#include "traits.hpp"
 
-typedef moodycamel::ConcurrentQueue<void*> MoodycamelCQType, *MoodycamelCQPtr;
+typedef moodycamel::ConcurrentQueue<void*, ArsQueueTraits> MoodycamelCQType, *MoodycamelCQPtr;
 
 extern "C" {
 
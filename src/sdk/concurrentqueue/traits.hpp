@@ -0,0 +1,10 @@
+#pragma once
+#include "ars/sdk/concurrentqueue/concurrentqueue.h"
+#include "ars/sdk/memory/mem.hpp"
+
+// NOTE: blocks of the C API queues come from ars_malloc, so the memory backend
+// set by ars_memory_init and its page policy apply to them too.
+struct ArsQueueTraits : public moodycamel::ConcurrentQueueDefaultTraits {
+    static inline void* malloc(size_t size) { return ars::sdk::ars_malloc(size); }
+    static inline void free(void* ptr) { ars::sdk::ars_free(ptr); }
+};
@@ -31,6 +31,7 @@
 #include <stdlib.h>
 #include <string.h>
 #include "ars/sdk/memory/mem.hpp"
+#include "ars/sdk/memory/arena.hpp"
 
 namespace ars {
 
@@ -64,9 +65,10 @@ namespace sdk {
 static int dict_resize(dict *d);
 
 /** Replacement for strdup() which is not always provided by libc */
-static char *xstrdup(char *s) {
+static char *xstrdup(dict *d, char *s) {
     char *t;
     if (!s) return NULL;
+    if (d->arena) return d->arena->strdup(s);
     t = (char *)ars_malloc(strlen(s) + 1);
     if (t) {
         strcpy(t, s);
@@ -74,6 +76,16 @@ static char *xstrdup(char *s) {
     return t;
 }
 
+/** Memory of a dict made by dict_new(arena) goes with the arena */
+static void *dict_calloc(dict *d, size_t nmemb, size_t size) {
+    if (d->arena) return d->arena->zalloc(nmemb * size, alignof(keypair));
+    return ars_calloc(nmemb, size);
+}
+
+static void dict_release(dict *d, void *p) {
+    if (!d->arena) ars_free(p);
+}
+
 /**
   This hash function has been taken from an Article in Dr Dobbs Journal.
   There are probably better ones out there but this one does the job.
@@ -233,7 +245,7 @@ int dict_add(dict *d, char *key, char *val) {
     hash = dict_hash(key, strlen(key));
     slot = dict_lookup(d, key, hash);
     if (slot) {
-        slot->key = xstrdup(key);
+        slot->key = xstrdup(d, key);
         if (!(slot->key)) {
             return -1;
         }
@@ -281,7 +293,7 @@ static int dict_resize(dict *d) {
 #endif
     /* Shuffle pointers, re-allocate new table, re-insert data */
     oldtable = d->table;
-    d->table = (keypair *)ars_calloc(newsize, sizeof(keypair));
+    d->table = (keypair *)dict_calloc(d, newsize, sizeof(keypair));
     if (!(d->table)) {
         /* Memory allocation failure */
         // printf("%s: malloc failed %s\n", __func__, strerror(errno));
@@ -296,24 +308,30 @@ static int dict_resize(dict *d) {
             dict_add_p(d, oldtable[i].key, oldtable[i].val);
         }
     }
-    ars_free(oldtable);
+    dict_release(d, oldtable);
     return 0;
 }
 
 /** Public: allocate a new dict */
 dict *dict_new(void) {
-    dict *d = (dict *)ars_calloc(1, sizeof(dict));
+    return dict_new(NULL);
+}
+
+/** Public: allocate a new dict from an arena, or by ars_calloc if NULL */
+dict *dict_new(Arena *arena) {
+    dict *d = arena ? (dict *)arena->zalloc(sizeof(dict), alignof(dict)) : (dict *)ars_calloc(1, sizeof(dict));
     if (!d) {
         // printf("%s: malloc failed %s\n", __func__, strerror(errno));
         return NULL;
     }
+    d->arena = arena;
     d->size = DICT_MIN_SZ;
     d->used = 0;
     d->fill = 0;
-    d->table = (keypair *)ars_calloc(DICT_MIN_SZ, sizeof(keypair));
+    d->table = (keypair *)dict_calloc(d, DICT_MIN_SZ, sizeof(keypair));
     if (!d->table) {
         // printf("%s: malloc failed %s\n", __func__, strerror(errno));
-        ars_free(d);
+        dict_release(d, d);
         return NULL;
     }
     return d;
@@ -323,6 +341,8 @@ dict *dict_new(void) {
 void dict_free(dict *d) {
     uint32_t i;
     if (!d) return;
+    /* Everything goes with the arena */
+    if (d->arena) return;
 
     for (i = 0; i < d->size; i++) {
         if (d->table[i].key && d->table[i].key != DUMMY_PTR) {
@@ -368,7 +388,7 @@ int dict_del(dict *d, char *key) {
     hash = dict_hash(key, strlen(key));
     kp = dict_lookup(d, key, hash);
     if (!kp) return -1;
-    if (kp->key && kp->key != DUMMY_PTR) ars_free(kp->key);
+    if (kp->key && kp->key != DUMMY_PTR) dict_release(d, kp->key);
     kp->key = (char *)DUMMY_PTR;
 #if 0
     if (kp->val)
@@ -432,8 +452,9 @@ void dict_get_key_list(dict *d, key_list **klist) {
     while (1) {
         rank = dict_enumerate(d, rank, &key, &val);
         if (rank < 0) break;
-        knode = (key_list *)ars_calloc(1, sizeof(key_list));
-        knode->key = xstrdup(key);
+        knode = (key_list *)dict_calloc(d, 1, sizeof(key_list));
+        if (!knode) break;
+        knode->key = xstrdup(d, key);
         knode->next = NULL;
         if (*klist == NULL) {
             *klist = knode;
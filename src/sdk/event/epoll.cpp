@@ -23,7 +23,7 @@ typedef struct epoll_ctx_s {
     struct events events;
 } epoll_ctx_t;
 
-int iowatcher_init(loop_t* loop) {
+static int epoll_init(loop_t* loop) {
     if (loop->iowatcher) return 0;
     epoll_ctx_t* epoll_ctx;
     ARS_ALLOC_SIZEOF(epoll_ctx);
@@ -33,7 +33,7 @@ int iowatcher_init(loop_t* loop) {
     return 0;
 }
 
-int iowatcher_cleanup(loop_t* loop) {
+static int epoll_cleanup(loop_t* loop) {
     if (loop->iowatcher == NULL) return 0;
     epoll_ctx_t* epoll_ctx = (epoll_ctx_t*)loop->iowatcher;
     close(epoll_ctx->epfd);
@@ -42,12 +42,53 @@ int iowatcher_cleanup(loop_t* loop) {
     return 0;
 }
 
-int iowatcher_add_event(loop_t* loop, int fd, int events) {
-    if (loop->iowatcher == NULL) {
-        iowatcher_init(loop);
+static void __epoll_register(epoll_ctx_t* epoll_ctx, int fd, uint32_t events) {
+    struct epoll_event ee;
+    memset(&ee, 0, sizeof(ee));
+    ee.data.fd = fd;
+    ee.events = events;
+    epoll_ctl(epoll_ctx->epfd, EPOLL_CTL_ADD, fd, &ee);
+    if (epoll_ctx->events.size == epoll_ctx->events.maxsize) {
+        events_double_resize(&epoll_ctx->events);
+    }
+    epoll_ctx->events.size++;
+}
+
+// NOTE: edge-triggered fd is registered once with both EPOLLIN and EPOLLOUT,
+// io->events only filters what hio_handle_events handles, so most changes need no epoll_ctl.
+static int epoll_add_event_et(loop_t* loop, int fd, int events) {
+    epoll_ctx_t* epoll_ctx = (epoll_ctx_t*)loop->iowatcher;
+    io_t* io = loop->ios.ptr[fd];
+
+    if (io->events == 0) {
+        uint32_t ee_events = EPOLLIN | EPOLLOUT | EPOLLET;
+#ifdef EPOLLEXCLUSIVE
+        // NOTE: wake up only one of the loops sharing a listenfd.
+        if (io->accept) {
+            ee_events = EPOLLIN | EPOLLET | EPOLLEXCLUSIVE;
+        }
+#endif
+        __epoll_register(epoll_ctx, fd, ee_events);
+        return 0;
+    }
+    // NOTE: data may be left in the socket while ARS_IO_READ was off, no edge for it,
+    // rearm by EPOLL_CTL_MOD to report the current state. EPOLLEXCLUSIVE can not MOD.
+    if ((events & ARS_IO_READ) && !(io->events & ARS_IO_READ) && !io->accept) {
+        struct epoll_event ee;
+        memset(&ee, 0, sizeof(ee));
+        ee.data.fd = fd;
+        ee.events = EPOLLIN | EPOLLOUT | EPOLLET;
+        epoll_ctl(epoll_ctx->epfd, EPOLL_CTL_MOD, fd, &ee);
     }
+    return 0;
+}
+
+static int epoll_add_event(loop_t* loop, int fd, int events) {
     epoll_ctx_t* epoll_ctx = (epoll_ctx_t*)loop->iowatcher;
     io_t* io = loop->ios.ptr[fd];
+    if (loop->flags & ARS_LOOP_FLAG_EDGE_TRIGGERED) {
+        return epoll_add_event_et(loop, fd, events);
+    }
 
     struct epoll_event ee;
     memset(&ee, 0, sizeof(ee));
@@ -66,18 +107,15 @@ int iowatcher_add_event(loop_t* loop, int fd, int events) {
     if (events & ARS_IO_WRITE) {
         ee.events |= EPOLLOUT;
     }
-    int op = io->events == 0 ? EPOLL_CTL_ADD : EPOLL_CTL_MOD;
-    epoll_ctl(epoll_ctx->epfd, op, fd, &ee);
-    if (op == EPOLL_CTL_ADD) {
-        if (epoll_ctx->events.size == epoll_ctx->events.maxsize) {
-            events_double_resize(&epoll_ctx->events);
-        }
-        epoll_ctx->events.size++;
+    if (io->events == 0) {
+        __epoll_register(epoll_ctx, fd, ee.events);
+    } else {
+        epoll_ctl(epoll_ctx->epfd, EPOLL_CTL_MOD, fd, &ee);
     }
     return 0;
 }
 
-int iowatcher_del_event(loop_t* loop, int fd, int events) {
+static int epoll_del_event(loop_t* loop, int fd, int events) {
     epoll_ctx_t* epoll_ctx = (epoll_ctx_t*)loop->iowatcher;
     if (epoll_ctx == NULL) return 0;
     io_t* io = loop->ios.ptr[fd];
@@ -99,6 +137,10 @@ int iowatcher_del_event(loop_t* loop, int fd, int events) {
     if (events & ARS_IO_WRITE) {
         ee.events &= ~EPOLLOUT;
     }
+    if ((loop->flags & ARS_LOOP_FLAG_EDGE_TRIGGERED) && ee.events != 0) {
+        // NOTE: keep edge-triggered fd registered until no events at all.
+        return 0;
+    }
     int op = ee.events == 0 ? EPOLL_CTL_DEL : EPOLL_CTL_MOD;
     epoll_ctl(epoll_ctx->epfd, op, fd, &ee);
     if (op == EPOLL_CTL_DEL) {
@@ -107,7 +149,7 @@ int iowatcher_del_event(loop_t* loop, int fd, int events) {
     return 0;
 }
 
-int iowatcher_poll_events(loop_t* loop, int timeout) {
+static int epoll_poll_events(loop_t* loop, int timeout) {
     epoll_ctx_t* epoll_ctx = (epoll_ctx_t*)loop->iowatcher;
     if (epoll_ctx == NULL) return 0;
     if (epoll_ctx->events.size == 0) return 0;
@@ -141,6 +183,10 @@ int iowatcher_poll_events(loop_t* loop, int timeout) {
     return nevents;
 }
 
+const iowatcher_engine_t epoll_engine = {
+    "epoll", epoll_init, epoll_cleanup, epoll_add_event, epoll_del_event, epoll_poll_events, NULL,
+};
+
 }  // namespace event
 
 }  // namespace sdk
@@ -55,6 +55,11 @@ void io_setcb_write(io_t* io, write_cb write_cb) { io->write_cb = write_cb; }
 
 void io_setcb_close(io_t* io, close_cb close_cb) { io->close_cb = close_cb; }
 
+void io_setcb_write_water(io_t* io, write_water_cb high_water_cb, write_water_cb low_water_cb) {
+    io->high_water_cb = high_water_cb;
+    io->low_water_cb = low_water_cb;
+}
+
 void io_set_type(io_t* io, io_type_e type) { io->io_type = type; }
 
 void io_set_localaddr(io_t* io, struct sockaddr* addr, int addrlen) {
@@ -0,0 +1,55 @@
+#include "ars/sdk/atomic/atomic.hpp"
+#include "ars/sdk/event/event.hpp"
+
+namespace ars {
+
+namespace sdk {
+
+namespace event {
+
+iobuf_t* iobuf_new(size_t len) {
+    // NOTE: no need to zero the data, only the header.
+    iobuf_t* buf = (iobuf_t*)ars_malloc(sizeof(iobuf_t) + len);
+    if (buf == NULL) return NULL;
+    buf->base = (char*)(buf + 1);
+    buf->len = len;
+    buf->refcnt = 1;
+    buf->free_fn = NULL;
+    buf->userdata = NULL;
+    return buf;
+}
+
+iobuf_t* iobuf_wrap(void* base, size_t len, iobuf_free_fn free_fn, void* userdata) {
+    iobuf_t* buf;
+    ARS_ALLOC_SIZEOF(buf);
+    buf->base = (char*)base;
+    buf->len = len;
+    buf->refcnt = 1;
+    buf->free_fn = free_fn;
+    buf->userdata = userdata;
+    return buf;
+}
+
+iobuf_t* iobuf_ref(iobuf_t* buf) {
+    atomic_inc(&buf->refcnt);
+    return buf;
+}
+
+void iobuf_unref(iobuf_t* buf) {
+    if (buf == NULL) return;
+    if (atomic_dec(&buf->refcnt) != 0) return;
+    if (buf->free_fn) {
+        buf->free_fn(buf->base, buf->userdata);
+    }
+    ARS_FREE(buf);
+}
+
+void* iobuf_data(iobuf_t* buf) { return buf->base; }
+
+size_t iobuf_len(iobuf_t* buf) { return buf->len; }
+
+}  // namespace event
+
+}  // namespace sdk
+
+}  // namespace ars
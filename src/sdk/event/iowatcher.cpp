@@ -0,0 +1,70 @@
+#include "ars/sdk/event/iowatcher.hpp"
+#include "ars/sdk/event/event.hpp"
+
+namespace ars {
+
+namespace sdk {
+
+namespace event {
+
+static const iowatcher_engine_t* default_engine() {
+#if defined(EVENT_EPOLL)
+    return &epoll_engine;
+#elif defined(EVENT_KQUEUE)
+    return &kqueue_engine;
+#endif
+}
+
+int iowatcher_init(loop_t* loop) {
+    if (loop->iowatcher) return 0;
+#ifdef EVENT_IO_URING
+    if (loop->flags & ARS_LOOP_FLAG_IO_URING) {
+        loop->engine = &uring_engine;
+        if (loop->engine->init(loop) == 0) {
+            loop->flags &= ~ARS_LOOP_FLAG_EDGE_TRIGGERED;
+            return 0;
+        }
+        // NOTE: kernel without io_uring (or disabled by seccomp), fallback to default.
+        loop->flags &= ~ARS_LOOP_FLAG_IO_URING;
+    }
+#endif
+    loop->engine = default_engine();
+#ifndef EVENT_EPOLL
+    loop->flags &= ~ARS_LOOP_FLAG_EDGE_TRIGGERED;
+#endif
+    return loop->engine->init(loop);
+}
+
+int iowatcher_cleanup(loop_t* loop) {
+    if (loop->engine == NULL) return 0;
+    return loop->engine->cleanup(loop);
+}
+
+int iowatcher_add_event(loop_t* loop, int fd, int events) {
+    if (loop->iowatcher == NULL) {
+        iowatcher_init(loop);
+    }
+    return loop->engine->add_event(loop, fd, events);
+}
+
+int iowatcher_del_event(loop_t* loop, int fd, int events) {
+    if (loop->engine == NULL) return 0;
+    return loop->engine->del_event(loop, fd, events);
+}
+
+int iowatcher_poll_events(loop_t* loop, int timeout) {
+    if (loop->engine == NULL) return 0;
+    return loop->engine->poll_events(loop, timeout);
+}
+
+void iowatcher_read_done(loop_t* loop, int fd) {
+    if (loop->engine && loop->engine->read_done) {
+        loop->engine->read_done(loop, fd);
+    }
+}
+
+}  // namespace event
+
+}  // namespace sdk
+
+}  // namespace ars
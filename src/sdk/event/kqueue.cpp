@@ -37,7 +37,7 @@ static void kqueue_ctx_resize(kqueue_ctx_t* kqueue_ctx, int size) {
     kqueue_ctx->capacity = size;
 }
 
-int iowatcher_init(loop_t* loop) {
+static int kqueue_init(loop_t* loop) {
     if (loop->iowatcher) return 0;
     kqueue_ctx_t* kqueue_ctx;
     ARS_ALLOC_SIZEOF(kqueue_ctx);
@@ -51,7 +51,7 @@ int iowatcher_init(loop_t* loop) {
     return 0;
 }
 
-int iowatcher_cleanup(loop_t* loop) {
+static int kqueue_cleanup(loop_t* loop) {
     if (loop->iowatcher == NULL) return 0;
     kqueue_ctx_t* kqueue_ctx = (kqueue_ctx_t*)loop->iowatcher;
     close(kqueue_ctx->kqfd);
@@ -62,9 +62,6 @@ int iowatcher_cleanup(loop_t* loop) {
 }
 
 static int __add_event(loop_t* loop, int fd, int event) {
-    if (loop->iowatcher == NULL) {
-        iowatcher_init(loop);
-    }
     kqueue_ctx_t* kqueue_ctx = (kqueue_ctx_t*)loop->iowatcher;
     io_t* io = loop->ios.ptr[fd];
     int idx = io->event_index[EVENT_INDEX(event)];
@@ -87,7 +84,7 @@ static int __add_event(loop_t* loop, int fd, int event) {
     return 0;
 }
 
-int iowatcher_add_event(loop_t* loop, int fd, int events) {
+static int kqueue_add_event(loop_t* loop, int fd, int events) {
     if (events & ARS_IO_READ) {
         __add_event(loop, fd, EVFILT_READ);
     }
@@ -126,7 +123,7 @@ static int __del_event(loop_t* loop, int fd, int event) {
     return 0;
 }
 
-int iowatcher_del_event(loop_t* loop, int fd, int events) {
+static int kqueue_del_event(loop_t* loop, int fd, int events) {
     if (events & ARS_IO_READ) {
         __del_event(loop, fd, EVFILT_READ);
     }
@@ -136,7 +133,7 @@ int iowatcher_del_event(loop_t* loop, int fd, int events) {
     return 0;
 }
 
-int iowatcher_poll_events(loop_t* loop, int timeout) {
+static int kqueue_poll_events(loop_t* loop, int timeout) {
     kqueue_ctx_t* kqueue_ctx = (kqueue_ctx_t*)loop->iowatcher;
     if (kqueue_ctx == NULL) return 0;
     if (kqueue_ctx->nchanges == 0) return 0;
@@ -178,6 +175,11 @@ int iowatcher_poll_events(loop_t* loop, int timeout) {
     return nevents;
 }
 
+const iowatcher_engine_t kqueue_engine = {
+    "kqueue", kqueue_init, kqueue_cleanup, kqueue_add_event, kqueue_del_event, kqueue_poll_events,
+    NULL,
+};
+
 }  // namespace event
 
 }  // namespace sdk
@@ -1,6 +1,11 @@
 #include "ars/sdk/event/loop.hpp"
+#ifdef ARS_OS_LINUX
+#include <sys/eventfd.h>
+#endif
+#include "ars/sdk/atomic/atomic.hpp"
 #include "ars/sdk/event/event.hpp"
 #include "ars/sdk/event/iowatcher.hpp"
+#include "ars/sdk/event/resolver.hpp"
 #include "ars/sdk/macros/attr.hpp"
 #include "ars/sdk/math/math.hpp"
 #include "ars/sdk/net/sock.hpp"
@@ -18,13 +23,21 @@ namespace event {
 #define HLOOP_STAT_TIMEOUT 60000   // ms
 
 #define IO_ARRAY_INIT_SIZE 1024
-#define CUSTOM_EVENT_QUEUE_INIT_SIZE 16
 
-#define SOCKPAIR_WRITE_INDEX 0
-#define SOCKPAIR_READ_INDEX 1
+#define EVENTFDS_WRITE_INDEX 0
+#define EVENTFDS_READ_INDEX 1
+
+// NOTE: io and its addrs in one object of loop->io_pool.
+typedef struct io_slot_s {
+    io_t io;
+    sock_addr_t localaddr;
+    sock_addr_t peeraddr;
+} io_slot_t;
 
 static void __hidle_del(idle_t* idle);
 static void __htimer_del(timer_t* timer);
+static inline int __custom_events_empty(loop_t* loop);
+static int hloop_process_customs(loop_t* loop);
 
 static int timers_compare(const struct heap_node* lhs, const struct heap_node* rhs) {
     return ARS_TIMER_ENTRY(lhs)->next_timeout < ARS_TIMER_ENTRY(rhs)->next_timeout;
@@ -51,39 +64,100 @@ static int hloop_process_idles(loop_t* loop) {
     return nidles;
 }
 
+// NOTE: timewheel tick is 1ms, round up so that timer never expires early.
+static inline uint64_t __htimer_tick(uint64_t hrtime) { return (hrtime + 999) / 1000; }
+
+static void __htimer_insert(loop_t* loop, timer_t* timer) {
+    if (loop->flags & ARS_LOOP_FLAG_TIMER_HEAP) {
+        heap_insert(&loop->timers, &timer->node);
+        return;
+    }
+    if (loop->timewheel.nelts == 0) {
+        // NOTE: empty wheel, catch up with loop time.
+        loop->timewheel.base = loop_now_hrtime(loop) / 1000;
+    }
+    timewheel_add(&loop->timewheel, &timer->wheel_node, __htimer_tick(timer->next_timeout));
+}
+
+static void __htimer_remove(loop_t* loop, timer_t* timer) {
+    if (loop->flags & ARS_LOOP_FLAG_TIMER_HEAP) {
+        heap_remove(&loop->timers, &timer->node);
+    } else {
+        timewheel_remove(&loop->timewheel, &timer->wheel_node);
+    }
+}
+
+// @return 0 if no timer
+static int __htimer_next_timeout(loop_t* loop, uint64_t* next_timeout) {
+    if (loop->flags & ARS_LOOP_FLAG_TIMER_HEAP) {
+        if (loop->timers.root == NULL) return 0;
+        *next_timeout = ARS_TIMER_ENTRY(loop->timers.root)->next_timeout;
+        return 1;
+    }
+    if (loop->timewheel.nelts == 0) return 0;
+    *next_timeout = timewheel_next_expires(&loop->timewheel) * 1000;
+    return 1;
+}
+
+static void __htimer_expire(loop_t* loop, timer_t* timer, uint64_t now_hrtime) {
+    if (loop->metrics) {
+        histogram_record(&loop->metrics->lateness, now_hrtime - timer->next_timeout);
+    }
+    if (timer->repeat != INFINITE) {
+        --timer->repeat;
+    }
+    if (timer->repeat == 0) {
+        // NOTE: Just mark it as destroy and remove from timers.
+        // Real deletion occurs after hloop_process_pendings.
+        __htimer_del(timer);
+    } else {
+        // NOTE: calc next timeout, then re-insert timers.
+        __htimer_remove(loop, timer);
+        if (timer->event_type == EVENT_TYPE_TIMEOUT) {
+            while (timer->next_timeout <= now_hrtime) {
+                timer->next_timeout += ((timeout_t*)timer)->timeout * 1000;
+            }
+        } else if (timer->event_type == EVENT_TYPE_PERIOD) {
+            period_t* period = (period_t*)timer;
+            timer->next_timeout = cron_next_timeout(period->minute, period->hour, period->day,
+                                                    period->week, period->month) *
+                                  1000000;
+        }
+        __htimer_insert(loop, timer);
+    }
+    ARS_EVENT_PENDING(timer);
+}
+
 static int hloop_process_timers(loop_t* loop) {
     int ntimers = 0;
     timer_t* timer = NULL;
     uint64_t now_hrtime = loop_now_hrtime(loop);
-    while (loop->timers.root) {
-        // NOTE: root of minheap has min timeout.
-        timer = ARS_TIMER_ENTRY(loop->timers.root);
-        if (timer->next_timeout > now_hrtime) {
-            break;
-        }
-        if (timer->repeat != INFINITE) {
-            --timer->repeat;
-        }
-        if (timer->repeat == 0) {
-            // NOTE: Just mark it as destroy and remove from heap.
-            // Real deletion occurs after hloop_process_pendings.
-            __htimer_del(timer);
-        } else {
-            // NOTE: calc next timeout, then re-insert heap.
-            heap_dequeue(&loop->timers);
-            if (timer->event_type == EVENT_TYPE_TIMEOUT) {
-                while (timer->next_timeout <= now_hrtime) {
-                    timer->next_timeout += ((timeout_t*)timer)->timeout * 1000;
-                }
-            } else if (timer->event_type == EVENT_TYPE_PERIOD) {
-                period_t* period = (period_t*)timer;
-                timer->next_timeout = cron_next_timeout(period->minute, period->hour, period->day,
-                                                        period->week, period->month) *
-                                      1000000;
+    if (loop->flags & ARS_LOOP_FLAG_TIMER_HEAP) {
+        while (loop->timers.root) {
+            // NOTE: root of minheap has min timeout.
+            timer = ARS_TIMER_ENTRY(loop->timers.root);
+            if (timer->next_timeout > now_hrtime) {
+                break;
             }
-            heap_insert(&loop->timers, &timer->node);
+            __htimer_expire(loop, timer, now_hrtime);
+            ++ntimers;
         }
-        ARS_EVENT_PENDING(timer);
+        return ntimers;
+    }
+
+    // NOTE: take all expired slots out of the wheel at once.
+    struct list_head expired;
+    list_init(&expired);
+    timewheel_expire(&loop->timewheel, now_hrtime / 1000, &expired);
+    while (!list_empty(&expired)) {
+        timer = ARS_TIMER_WHEEL_ENTRY(expired.next);
+        list_del(expired.next);
+        if (timer->next_timeout > now_hrtime) {
+            // NOTE: clamped by TIMEWHEEL_MAX_SPAN, put it back.
+            __htimer_insert(loop, timer);
+            continue;
+        }
+        __htimer_expire(loop, timer, now_hrtime);
         ++ntimers;
     }
     return ntimers;
@@ -99,6 +173,9 @@ static int hloop_process_ios(loop_t* loop, int timeout) {
 }
 
 static int hloop_process_pendings(loop_t* loop) {
+    if (loop->metrics) {
+        histogram_record(&loop->metrics->depth, loop->npendings);
+    }
     if (loop->npendings == 0) return 0;
 
     event_t* cur = NULL;
@@ -129,18 +206,50 @@ static int hloop_process_pendings(loop_t* loop) {
 }
 
 // hloop_process_ios -> hloop_process_timers -> hloop_process_idles -> hloop_process_pendings
+// NOTE: record the phase since *start, then start next phase from now.
+static inline void __hloop_metrics_phase(loop_t* loop, struct histogram* phase, uint64_t* start) {
+    uint64_t now = gethrtime_us();
+    histogram_record(phase, now - *start);
+    *start = now;
+}
+
+// NOTE: account time since last poll as busy, close the window every ARS_LOOP_LOAD_INTERVAL.
+static void __hloop_load_update(loop_t* loop, uint64_t poll_start) {
+    loop_load_t* load = &loop->load;
+    if (loop->poll_end_hrtime) {
+        uint64_t busy = poll_start - loop->poll_end_hrtime;
+        stat_counter_add(&load->busy_us, busy);
+        loop->load_window_busy += busy;
+    }
+    uint64_t window = poll_start - loop->load_window_start;
+    if (window >= ARS_LOOP_LOAD_INTERVAL * 1000) {
+        uint64_t permille = loop->load_window_busy * 1000 / window;
+        if (permille > 1000) permille = 1000;
+        __atomic_store_n(&load->busy_permille, (load->busy_permille + permille) / 2,
+                         __ATOMIC_RELAXED);
+        loop->load_window_start = poll_start;
+        loop->load_window_busy = 0;
+    }
+    __atomic_store_n(&load->nios, (uint64_t)loop->nios, __ATOMIC_RELAXED);
+}
+
 static int hloop_process_events(loop_t* loop) {
     // ios -> timers -> idles
     int ARS_UNUSED(nios);
     int ntimers;
     int nidles;
     nios = ntimers = nidles = 0;
+    loop_metrics_t* metrics = loop->metrics;
+    uint64_t iteration_start = 0, phase_start = 0, poll_time = 0;
+    if (metrics) {
+        iteration_start = phase_start = gethrtime_us();
+    }
 
     // calc blocktime
     int32_t blocktime = HLOOP_MAX_BLOCK_TIME;
-    if (loop->timers.root) {
+    uint64_t next_min_timeout = 0;
+    if (__htimer_next_timeout(loop, &next_min_timeout)) {
         loop_update_time(loop);
-        uint64_t next_min_timeout = ARS_TIMER_ENTRY(loop->timers.root)->next_timeout;
         int64_t blocktime_us = next_min_timeout - loop_now_hrtime(loop);
         if (blocktime_us <= 0) goto process_timers;
         blocktime = blocktime_us / 1000;
@@ -148,12 +257,27 @@ static int hloop_process_events(loop_t* loop) {
         blocktime = ARS_MIN(blocktime, HLOOP_MAX_BLOCK_TIME);
     }
 
+    phase_start = gethrtime_us();
+    __hloop_load_update(loop, phase_start);
     if (loop->nios) {
+        // NOTE: publish sleeping before checking custom_events, pair with loop_post_event.
+        atomic_set(&loop->sleeping, 1);
+        if (!__custom_events_empty(loop)) {
+            blocktime = 0;
+        }
         nios = hloop_process_ios(loop, blocktime);
+        atomic_set(&loop->sleeping, 0);
     } else {
         msdelay(blocktime);
     }
     loop_update_time(loop);
+    loop->poll_end_hrtime = loop->cur_hrtime;
+    if (metrics) {
+        poll_time = loop->cur_hrtime - phase_start;
+        histogram_record(&metrics->poll, poll_time);
+        phase_start = loop->cur_hrtime;
+    }
+    hloop_process_customs(loop);
     // wakeup by loop_stop
     if (loop->status == LOOP_STATUS_STOP) {
         return 0;
@@ -163,6 +287,9 @@ process_timers:
     if (loop->ntimers) {
         ntimers = hloop_process_timers(loop);
     }
+    if (metrics) {
+        __hloop_metrics_phase(loop, &metrics->timers, &phase_start);
+    }
 
     int npendings = loop->npendings;
     if (npendings == 0) {
@@ -170,7 +297,18 @@ process_timers:
             nidles = hloop_process_idles(loop);
         }
     }
+    if (metrics) {
+        __hloop_metrics_phase(loop, &metrics->idles, &phase_start);
+    }
     int ncbs = hloop_process_pendings(loop);
+    if (!list_empty(&loop->mmsg_flushes)) {
+        loop_flush_mmsgs(loop);
+    }
+    if (metrics) {
+        __hloop_metrics_phase(loop, &metrics->pendings, &phase_start);
+        histogram_record(&metrics->busy, phase_start - iteration_start - poll_time);
+        stat_counter_add(&metrics->loop_cnt, 1);
+    }
     // printd("blocktime=%d nios=%d/%u ntimers=%d/%u nidles=%d/%u nactives=%d npendings=%d
     // ncbs=%d\n",
     //         blocktime, nios, loop->nios, ntimers, loop->ntimers, nidles, loop->nidles,
@@ -187,37 +325,126 @@ static void ARS_UNUSED(hloop_stat_timer_cb)(timer_t* timer) {
     //     loop->nactives, loop->nios, loop->ntimers, loop->nidles);
 }
 
-static void sockpair_read_cb(io_t* io, void* buf, int readbytes) {
-    loop_t* loop = io->loop;
-    event_t* pev = NULL;
-    event_t ev;
-    for (int i = 0; i < readbytes; ++i) {
-        mutex_lock(&loop->custom_events_mutex);
-        if (event_queue_empty(&loop->custom_events)) {
-            goto unlock;
+// NOTE: seq_cst with the publish in __custom_ring_push, pairs sleeping like the list does,
+// else the loop may miss a post and the producer skip the wakeup.
+static inline int __custom_ring_ready(loop_t* loop) {
+    uint64_t pos = loop->custom_ring_deq;
+    custom_slot_t* slot = &loop->custom_ring[pos & (ARS_CUSTOM_RING_SIZE - 1)];
+    return atomic_get(&slot->seq) == pos + 1;
+}
+
+static inline int __custom_events_empty(loop_t* loop) {
+    return !__custom_ring_ready(loop) && loop->custom_events_tail == &loop->custom_events_stub &&
+           atomic_get(&loop->custom_events_stub.next) == NULL;
+}
+
+// Vyukov's bounded queue, claim a slot by enq, publish it by seq.
+// @return -1 if full
+static int __custom_ring_push(loop_t* loop, const event_t* ev) {
+    uint64_t pos = atomic_get(&loop->custom_ring_enq);
+    for (;;) {
+        custom_slot_t* slot = &loop->custom_ring[pos & (ARS_CUSTOM_RING_SIZE - 1)];
+        uint64_t seq = __atomic_load_n(&slot->seq, __ATOMIC_ACQUIRE);
+        if (seq == pos) {
+            uint64_t old = atomic_compare_swap(&loop->custom_ring_enq, pos, pos + 1);
+            if (old == pos) {
+                slot->ev = *ev;
+                atomic_set(&slot->seq, pos + 1);
+                return 0;
+            }
+            pos = old;
+        } else if ((int64_t)(seq - pos) < 0) {
+            // NOTE: slot of the last round is not popped yet
+            return -1;
+        } else {
+            pos = atomic_get(&loop->custom_ring_enq);
         }
-        pev = event_queue_front(&loop->custom_events);
-        if (pev == NULL) {
-            goto unlock;
+    }
+}
+
+// NOTE: only called in loop thread, a slot claimed but not published yet reads as empty,
+// its producer wakes the loop after publishing.
+static int __custom_ring_pop(loop_t* loop, event_t* ev) {
+    if (!__custom_ring_ready(loop)) {
+        return -1;
+    }
+    uint64_t pos = loop->custom_ring_deq;
+    custom_slot_t* slot = &loop->custom_ring[pos & (ARS_CUSTOM_RING_SIZE - 1)];
+    *ev = slot->ev;
+    loop->custom_ring_deq = pos + 1;
+    __atomic_store_n(&slot->seq, pos + ARS_CUSTOM_RING_SIZE, __ATOMIC_RELEASE);
+    return 0;
+}
+
+static void __custom_events_push(loop_t* loop, custom_event_t* node) {
+    atomic_set(&node->next, (custom_event_t*)NULL);
+    custom_event_t* prev = atomic_swap(&loop->custom_events_head, node);
+    // NOTE: between swap and set, the loop sees the queue busy, see __custom_events_pop.
+    atomic_set(&prev->next, node);
+}
+
+// Vyukov's intrusive MPSC queue, only called in loop thread.
+// NOTE: returns NULL while a producer is in the middle of push, never waits for it,
+// the producer wakes the loop after push and the next iteration retries.
+static custom_event_t* __custom_events_pop(loop_t* loop) {
+    custom_event_t* stub = &loop->custom_events_stub;
+    custom_event_t* tail = loop->custom_events_tail;
+    custom_event_t* next = atomic_get(&tail->next);
+    if (tail == stub) {
+        if (next == NULL) {
+            return NULL;
+        }
+        loop->custom_events_tail = next;
+        tail = next;
+        next = atomic_get(&next->next);
+    }
+    if (next) {
+        loop->custom_events_tail = next;
+        return tail;
+    }
+    if (tail != atomic_get(&loop->custom_events_head)) {
+        return NULL;
+    }
+    __custom_events_push(loop, stub);
+    next = atomic_get(&tail->next);
+    if (next) {
+        loop->custom_events_tail = next;
+        return tail;
+    }
+    return NULL;
+}
+
+static int hloop_process_customs(loop_t* loop) {
+    int ncustoms = 0;
+    event_t ev;
+    // NOTE: ring first, posts go to the overflow list only after the ring filled up.
+    while (__custom_ring_pop(loop, &ev) == 0) {
+        if (ev.cb) {
+            ev.cb(&ev);
         }
-        ev = *pev;
-        event_queue_pop_front(&loop->custom_events);
-        // NOTE: unlock before cb, avoid deadlock if loop_post_event called in cb.
-        mutex_unlock(&loop->custom_events_mutex);
+        ++ncustoms;
+    }
+    custom_event_t* node;
+    while ((node = __custom_events_pop(loop)) != NULL) {
+        ev = node->ev;
+        ARS_FREE(node);
+        atomic_dec(&loop->ncustom_overflows);
         if (ev.cb) {
             ev.cb(&ev);
         }
+        ++ncustoms;
     }
-    return;
-unlock:
-    mutex_unlock(&loop->custom_events_mutex);
+    return ncustoms;
 }
 
-void loop_post_event(loop_t* loop, event_t* ev) {
-    char buf = '1';
+static void eventfd_read_cb(io_t* io, void* buf, int readbytes) {
+    // NOTE: custom_events are processed by hloop_process_customs, just rearm the wakeup.
+    atomic_set(&io->loop->wakeup_pending, 0);
+}
 
-    if (loop->sockpair[0] == -1 || loop->sockpair[1] == -1) {
-        // hlogw("socketpair not created!");
+void loop_post_event(loop_t* loop, event_t* ev) {
+    if (loop->eventfds[EVENTFDS_WRITE_INDEX] == -1) {
+        // hlogw("eventfd not created!");
         return;
     }
 
@@ -231,10 +458,93 @@ void loop_post_event(loop_t* loop, event_t* ev) {
         ev->event_id = loop_next_event_id();
     }
 
-    mutex_lock(&loop->custom_events_mutex);
-    ev_write(loop, loop->sockpair[SOCKPAIR_WRITE_INDEX], &buf, 1, NULL);
-    event_queue_push_back(&loop->custom_events, ev);
-    mutex_unlock(&loop->custom_events_mutex);
+    // NOTE: keep behind the overflowed ones, so the events of one thread stay in order.
+    if (atomic_get(&loop->ncustom_overflows) != 0 || __custom_ring_push(loop, ev) != 0) {
+        custom_event_t* node = (custom_event_t*)ars_malloc(sizeof(custom_event_t));
+        node->ev = *ev;
+        atomic_inc(&loop->ncustom_overflows);
+        __custom_events_push(loop, node);
+    }
+    atomic_inc(&loop->nposts);
+
+    // NOTE: wakeup only if loop is blocking and nobody has woken it up.
+    if (atomic_get(&loop->sleeping) && atomic_swap(&loop->wakeup_pending, 1) == 0) {
+#ifdef ARS_OS_LINUX
+        uint64_t one = 1;
+#else
+        char one = '1';
+#endif
+        ssize_t ARS_UNUSED(nwrite) = write(loop->eventfds[EVENTFDS_WRITE_INDEX], &one, sizeof(one));
+        atomic_inc(&loop->nwakeups);
+    } else {
+        atomic_inc(&loop->ncoalesced);
+    }
+}
+
+void loop_load(loop_t* loop, loop_load_t* load) {
+    load->busy_us = stat_counter_get(&loop->load.busy_us);
+    load->busy_permille = __atomic_load_n(&loop->load.busy_permille, __ATOMIC_RELAXED);
+    load->nios = __atomic_load_n(&loop->load.nios, __ATOMIC_RELAXED);
+}
+
+void loop_post_stat(loop_t* loop, loop_post_stat_t* stat) {
+    stat->posts = atomic_get(&loop->nposts);
+    stat->wakeups = atomic_get(&loop->nwakeups);
+    stat->coalesced = atomic_get(&loop->ncoalesced);
+}
+
+int loop_metrics(loop_t* loop, loop_metrics_t* metrics) {
+    loop_metrics_t* src = loop->metrics;
+    if (src == NULL) return -1;
+    metrics->loop_cnt = stat_counter_get(&src->loop_cnt);
+    histogram_snapshot(&metrics->poll, &src->poll);
+    histogram_snapshot(&metrics->timers, &src->timers);
+    histogram_snapshot(&metrics->idles, &src->idles);
+    histogram_snapshot(&metrics->pendings, &src->pendings);
+    histogram_snapshot(&metrics->busy, &src->busy);
+    histogram_snapshot(&metrics->lateness, &src->lateness);
+    histogram_snapshot(&metrics->depth, &src->depth);
+    metrics->read_calls = stat_counter_get(&src->read_calls);
+    metrics->read_bytes = stat_counter_get(&src->read_bytes);
+    metrics->write_calls = stat_counter_get(&src->write_calls);
+    metrics->write_bytes = stat_counter_get(&src->write_bytes);
+    return 0;
+}
+
+// NOTE: room for a full pool of every class, one huge page under THP,
+// mlocked or on huge pages if the page policy says so.
+// each class carves from its own area, class c starts after the areas of classes below it.
+#define READBUF_REGION_AREA(cls) (ARS_READBUF_POOL_SIZE * ARS_LOOP_READ_BUFSIZE * ((1 << (cls)) - 1))
+#define READBUF_REGION_SIZE READBUF_REGION_AREA(ARS_READBUF_CLASSES)
+
+typedef struct readbuf_region_s {
+    char* base;
+    size_t maplen;
+    int carved[ARS_READBUF_CLASSES];
+    // released slices of each class, linked through their first bytes, pushed by any thread,
+    // popped only by the loop thread
+    char* freed[ARS_READBUF_CLASSES];
+    int refcnt;  // the loop and each carved buf, retained bufs may be unref'd by other threads
+} readbuf_region_t;
+
+static void readbuf_region_unref(readbuf_region_t* region) {
+    if (region == NULL || atomic_dec(&region->refcnt) != 0) return;
+    ars_page_free(region->base, region->maplen);
+    ARS_FREE(region);
+}
+
+static void readbuf_region_release(void* base, void* userdata) {
+    readbuf_region_t* region = (readbuf_region_t*)userdata;
+    size_t area = ((char*)base - region->base) / (ARS_READBUF_POOL_SIZE * ARS_LOOP_READ_BUFSIZE);
+    int cls = 31 - __builtin_clz((unsigned)area + 1);
+    char* head = atomic_get(&region->freed[cls]);
+    for (;;) {
+        *(char**)base = head;
+        char* prev = atomic_compare_swap(&region->freed[cls], head, (char*)base);
+        if (prev == head) break;
+        head = prev;
+    }
+    readbuf_region_unref(region);
 }
 
 static void hloop_init(loop_t* loop) {
@@ -259,8 +569,16 @@ static void hloop_init(loop_t* loop) {
     // idles
     list_init(&loop->idles);
 
+    // pools
+    event_pool_init(&loop->idle_pool, sizeof(idle_t));
+    event_pool_init(&loop->timeout_pool, sizeof(timeout_t));
+    event_pool_init(&loop->data_timeout_pool, sizeof(data_timeout_t));
+    event_pool_init(&loop->period_pool, sizeof(period_t));
+    event_pool_init(&loop->io_pool, sizeof(io_slot_t));
+
     // timers
     heap_init(&loop->timers, timers_compare);
+    timewheel_init(&loop->timewheel, 0);
 
     // ios
     io_array_init(&loop->ios, IO_ARRAY_INIT_SIZE);
@@ -272,12 +590,33 @@ static void hloop_init(loop_t* loop) {
     // iowatcher
     iowatcher_init(loop);
 
+    // mmsg
+    list_init(&loop->mmsg_flushes);
+
     // custom_events
-    mutex_lock_init(&loop->custom_events_mutex);
-    event_queue_init(&loop->custom_events, CUSTOM_EVENT_QUEUE_INIT_SIZE);
-    loop->sockpair[0] = loop->sockpair[1] = -1;
-    if (socketpair(AF_INET, SOCK_STREAM, 0, loop->sockpair) != 0) {
-        // hloge("socketpair create failed!");
+    ARS_ALLOC(loop->custom_ring, sizeof(custom_slot_t) * ARS_CUSTOM_RING_SIZE);
+    for (uint64_t i = 0; i < ARS_CUSTOM_RING_SIZE; ++i) {
+        loop->custom_ring[i].seq = i;
+    }
+    loop->custom_ring_enq = loop->custom_ring_deq = 0;
+    loop->ncustom_overflows = 0;
+    loop->custom_events_stub.next = NULL;
+    loop->custom_events_head = loop->custom_events_tail = &loop->custom_events_stub;
+    loop->eventfds[0] = loop->eventfds[1] = -1;
+#ifdef ARS_OS_LINUX
+    loop->eventfds[0] = loop->eventfds[1] = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+#else
+    int fds[2];
+    if (pipe(fds) == 0) {
+        loop->eventfds[EVENTFDS_READ_INDEX] = fds[0];
+        loop->eventfds[EVENTFDS_WRITE_INDEX] = fds[1];
+        sock_set_nonblock(fds[1]);
+    }
+#endif
+
+    // metrics
+    if (loop->flags & ARS_LOOP_FLAG_METRICS) {
+        ARS_ALLOC_SIZEOF(loop->metrics);
     }
 
     // NOTE: init start_time here, because timer_add use it.
@@ -292,6 +631,10 @@ static void hloop_cleanup(loop_t* loop) {
         loop->pendings[i] = NULL;
     }
 
+    // resolver
+    // NOTE: before ios, its ios and timers are freed with the others.
+    loop_resolver_cleanup(loop);
+
     // ios
     printd("cleanup ios...\n");
     for (size_t i = 0; i < loop->ios.maxsize; ++i) {
@@ -309,7 +652,7 @@ static void hloop_cleanup(loop_t* loop) {
     while (node != &loop->idles) {
         idle = ARS_IDLE_ENTRY(node);
         node = node->next;
-        ARS_FREE(idle);
+        event_pool_free(&loop->idle_pool, idle);
     }
     list_init(&loop->idles);
 
@@ -319,9 +662,23 @@ static void hloop_cleanup(loop_t* loop) {
     while (loop->timers.root) {
         timer = ARS_TIMER_ENTRY(loop->timers.root);
         heap_dequeue(&loop->timers);
-        ARS_FREE(timer);
+        event_free((event_t*)timer);
     }
     heap_init(&loop->timers, NULL);
+    struct timewheel_node* wheel_node;
+    while ((wheel_node = timewheel_any(&loop->timewheel)) != NULL) {
+        timewheel_remove(&loop->timewheel, wheel_node);
+        timer = container_of(wheel_node, timer_t, wheel_node);
+        event_free((event_t*)timer);
+    }
+
+    // pools
+    // NOTE: also frees events deleted but still pending.
+    event_pool_cleanup(&loop->idle_pool);
+    event_pool_cleanup(&loop->timeout_pool);
+    event_pool_cleanup(&loop->data_timeout_pool);
+    event_pool_cleanup(&loop->period_pool);
+    event_pool_cleanup(&loop->io_pool);
 
     // readbuf
     if (loop->readbuf.base && loop->readbuf.len) {
@@ -329,27 +686,51 @@ static void hloop_cleanup(loop_t* loop) {
         loop->readbuf.base = NULL;
         loop->readbuf.len = 0;
     }
+    for (int i = 0; i < ARS_READBUF_CLASSES; ++i) {
+        while (loop->readbufs[i]) {
+            iobuf_t* buf = loop->readbufs[i];
+            loop->readbufs[i] = buf->next;
+            iobuf_unref(buf);
+        }
+        loop->nreadbufs[i] = 0;
+    }
+    // NOTE: retained readbufs keep the region mapped until they are unref'd.
+    readbuf_region_unref(loop->readbuf_region);
+    loop->readbuf_region = NULL;
+
+    // splice pipes
+    loop_splice_cleanup(loop);
 
     // iowatcher
     iowatcher_cleanup(loop);
 
     // custom_events
-    mutex_lock(&loop->custom_events_mutex);
-    if (loop->sockpair[0] != -1 && loop->sockpair[1] != -1) {
-        close(loop->sockpair[0]);
-        close(loop->sockpair[1]);
-        loop->sockpair[0] = loop->sockpair[1] = -1;
+    custom_event_t* custom;
+    while ((custom = __custom_events_pop(loop)) != NULL) {
+        ARS_FREE(custom);
+    }
+    ARS_FREE(loop->custom_ring);
+    if (loop->eventfds[EVENTFDS_READ_INDEX] != -1) {
+        close(loop->eventfds[EVENTFDS_READ_INDEX]);
+    }
+    if (loop->eventfds[EVENTFDS_WRITE_INDEX] != -1 &&
+        loop->eventfds[EVENTFDS_WRITE_INDEX] != loop->eventfds[EVENTFDS_READ_INDEX]) {
+        close(loop->eventfds[EVENTFDS_WRITE_INDEX]);
+    }
+    loop->eventfds[0] = loop->eventfds[1] = -1;
+
+    // metrics
+    if (loop->metrics) {
+        ARS_FREE(loop->metrics);
     }
-    event_queue_cleanup(&loop->custom_events);
-    mutex_unlock(&loop->custom_events_mutex);
-    mutex_lock_deinit(&loop->custom_events_mutex);
 }
 
 loop_t* loop_new(int flags) {
     loop_t* loop;
     ARS_ALLOC_SIZEOF(loop);
+    // NOTE: set flags before hloop_init, iowatcher_init use it to select engine.
+    loop->flags = flags;
     hloop_init(loop);
-    loop->flags |= flags;
     return loop;
 }
 
@@ -368,9 +749,9 @@ int loop_run(loop_t* loop) {
 
     // intern events
     uint32_t intern_events = 0;
-    if (loop->sockpair[0] != -1 && loop->sockpair[1] != -1) {
-        ev_read(loop, loop->sockpair[SOCKPAIR_READ_INDEX], loop->readbuf.base, loop->readbuf.len,
-                sockpair_read_cb);
+    if (loop->eventfds[EVENTFDS_READ_INDEX] != -1) {
+        ev_read(loop, loop->eventfds[EVENTFDS_READ_INDEX], loop->readbuf.base, loop->readbuf.len,
+                eventfd_read_cb);
         ++intern_events;
     }
 #ifdef DEBUG
@@ -471,8 +852,7 @@ void loop_set_userdata(loop_t* loop, void* userdata) { loop->userdata = userdata
 void* loop_userdata(loop_t* loop) { return loop->userdata; }
 
 idle_t* idle_add(loop_t* loop, idle_cb cb, uint32_t repeat) {
-    idle_t* idle;
-    ARS_ALLOC_SIZEOF(idle);
+    idle_t* idle = (idle_t*)event_pool_alloc(&loop->idle_pool);
     idle->event_type = EVENT_TYPE_IDLE;
     idle->priority = ARS_EVENT_LOWEST_PRIORITY;
     idle->repeat = repeat;
@@ -495,22 +875,46 @@ void idle_del(idle_t* idle) {
     ARS_EVENT_DEL(idle);
 }
 
-timer_t* timer_add(loop_t* loop, timer_cb cb, uint32_t timeout, uint32_t repeat) {
-    if (timeout == 0) return NULL;
-    timeout_t* timer;
-    ARS_ALLOC_SIZEOF(timer);
+static timer_t* __timer_add(loop_t* loop, timeout_t* timer, timer_cb cb, uint32_t timeout,
+                            uint32_t repeat) {
     timer->event_type = EVENT_TYPE_TIMEOUT;
     timer->priority = ARS_EVENT_HIGHEST_PRIORITY;
     timer->repeat = repeat;
     timer->timeout = timeout;
     loop_update_time(loop);
     timer->next_timeout = loop_now_hrtime(loop) + timeout * 1000;
-    heap_insert(&loop->timers, &timer->node);
+    __htimer_insert(loop, (timer_t*)timer);
     ARS_EVENT_ADD(loop, timer, cb);
     loop->ntimers++;
     return (timer_t*)timer;
 }
 
+timer_t* timer_add(loop_t* loop, timer_cb cb, uint32_t timeout, uint32_t repeat) {
+    if (timeout == 0) return NULL;
+    timeout_t* timer = (timeout_t*)event_pool_alloc(&loop->timeout_pool);
+    return __timer_add(loop, timer, cb, timeout, repeat);
+}
+
+timer_t* timer_add_data(loop_t* loop, timer_cb cb, uint32_t timeout, uint32_t repeat,
+                        timer_data_dtor dtor) {
+    if (timeout == 0) return NULL;
+    data_timeout_t* timer = (data_timeout_t*)event_pool_alloc(&loop->data_timeout_pool);
+    timer->timeout.has_data = 1;
+    timer->dtor = dtor;
+    return __timer_add(loop, &timer->timeout, cb, timeout, repeat);
+}
+
+void* timer_data(timer_t* timer) {
+    if (timer->event_type != EVENT_TYPE_TIMEOUT || !((timeout_t*)timer)->has_data) {
+        return NULL;
+    }
+    return ((data_timeout_t*)timer)->data.buf;
+}
+
+int timer_alive(timer_t* timer, uint64_t event_id) {
+    return timer && timer->event_id == event_id && timer->active;
+}
+
 void timer_reset(timer_t* timer) {
     if (timer->event_type != EVENT_TYPE_TIMEOUT) {
         return;
@@ -520,13 +924,13 @@ void timer_reset(timer_t* timer) {
     if (timer->destroy) {
         loop->ntimers++;
     } else {
-        heap_remove(&loop->timers, &timer->node);
+        __htimer_remove(loop, timer);
     }
     if (timer->repeat == 0) {
         timer->repeat = 1;
     }
     timer->next_timeout = loop_now_hrtime(loop) + timeout->timeout * 1000;
-    heap_insert(&loop->timers, &timer->node);
+    __htimer_insert(loop, timer);
     ARS_EVENT_RESET(timer);
 }
 
@@ -535,8 +939,7 @@ timer_t* timer_add_period(loop_t* loop, timer_cb cb, int8_t minute, int8_t hour,
     if (minute > 59 || hour > 23 || day > 31 || week > 6 || month > 12) {
         return NULL;
     }
-    period_t* timer;
-    ARS_ALLOC_SIZEOF(timer);
+    period_t* timer = (period_t*)event_pool_alloc(&loop->period_pool);
     timer->event_type = EVENT_TYPE_PERIOD;
     timer->priority = ARS_EVENT_HIGH_PRIORITY;
     timer->repeat = repeat;
@@ -546,7 +949,7 @@ timer_t* timer_add_period(loop_t* loop, timer_cb cb, int8_t minute, int8_t hour,
     timer->month = month;
     timer->week = week;
     timer->next_timeout = cron_next_timeout(minute, hour, day, week, month) * 1000000;
-    heap_insert(&loop->timers, &timer->node);
+    __htimer_insert(loop, (timer_t*)timer);
     ARS_EVENT_ADD(loop, timer, cb);
     loop->ntimers++;
     return (timer_t*)timer;
@@ -554,7 +957,7 @@ timer_t* timer_add_period(loop_t* loop, timer_cb cb, int8_t minute, int8_t hour,
 
 static void __htimer_del(timer_t* timer) {
     if (timer->destroy) return;
-    heap_remove(&timer->loop->timers, &timer->node);
+    __htimer_remove(timer->loop, timer);
     timer->loop->ntimers--;
     timer->destroy = 1;
 }
@@ -583,6 +986,13 @@ const char* io_engine() {
 #endif
 }
 
+const char* io_engine(loop_t* loop) {
+    if (loop == NULL || loop->engine == NULL) {
+        return io_engine();
+    }
+    return loop->engine->name;
+}
+
 static void fill_io_type(io_t* io) {
     int type = 0;
     socklen_t optlen = sizeof(int);
@@ -626,13 +1036,7 @@ static void fill_io_type(io_t* io) {
 static void hio_socket_init(io_t* io) {
     // nonblocking
     sock_set_nonblock(io->fd);
-    // fill io->localaddr io->peeraddr
-    if (io->localaddr == NULL) {
-        ARS_ALLOC(io->localaddr, sizeof(sock_addr_t));
-    }
-    if (io->peeraddr == NULL) {
-        ARS_ALLOC(io->peeraddr, sizeof(sock_addr_t));
-    }
+    // fill io->localaddr io->peeraddr, allocated with io by io_get
     socklen_t addrlen = sizeof(sock_addr_t);
     int ARS_UNUSED(ret) = getsockname(io->fd, io->localaddr, &addrlen);
     printd("getsockname fd=%d ret=%d errno=%d\n", io->fd, ret, errno);
@@ -648,6 +1052,139 @@ static void hio_socket_init(io_t* io) {
     }
 }
 
+#define EVENT_POOL_ALIGN 16
+#define EVENT_POOL_ALIGN_UP(n) (((n) + EVENT_POOL_ALIGN - 1) & ~(size_t)(EVENT_POOL_ALIGN - 1))
+
+void event_pool_init(event_pool_t* pool, size_t objsize) {
+    memset(pool, 0, sizeof(*pool));
+    // NOTE: free objects are linked by their first pointer.
+    pool->objsize = EVENT_POOL_ALIGN_UP(objsize < sizeof(void*) ? sizeof(void*) : objsize);
+}
+
+void* event_pool_alloc(event_pool_t* pool) {
+    void* obj = pool->free_list;
+    if (obj) {
+        pool->free_list = *(void**)obj;
+    } else {
+        if (pool->ncarve == 0) {
+            // NOTE: slab header is the link of slabs, objects follow it.
+            char* slab = (char*)ars_malloc(EVENT_POOL_ALIGN + pool->objsize * ARS_EVENT_POOL_SLAB_OBJS);
+            *(void**)slab = pool->slabs;
+            pool->slabs = slab;
+            pool->carve = slab + EVENT_POOL_ALIGN;
+            pool->ncarve = ARS_EVENT_POOL_SLAB_OBJS;
+            pool->nslabs++;
+        }
+        obj = pool->carve;
+        pool->carve += pool->objsize;
+        pool->ncarve--;
+    }
+    pool->nused++;
+    memset(obj, 0, pool->objsize);
+    return obj;
+}
+
+void event_pool_free(event_pool_t* pool, void* obj) {
+    if (obj == NULL) return;
+    *(void**)obj = pool->free_list;
+    pool->free_list = obj;
+    pool->nused--;
+}
+
+void event_pool_cleanup(event_pool_t* pool) {
+    while (pool->slabs) {
+        void* slab = pool->slabs;
+        pool->slabs = *(void**)slab;
+        ars_free(slab);
+    }
+    size_t objsize = pool->objsize;
+    memset(pool, 0, sizeof(*pool));
+    pool->objsize = objsize;
+}
+
+void event_free(event_t* ev) {
+    loop_t* loop = ev->loop;
+    switch (ev->event_type) {
+        case EVENT_TYPE_IDLE:
+            event_pool_free(&loop->idle_pool, ev);
+            break;
+        case EVENT_TYPE_TIMEOUT:
+            if (((timeout_t*)ev)->has_data) {
+                data_timeout_t* timer = (data_timeout_t*)ev;
+                if (timer->dtor) {
+                    timer->dtor(timer->data.buf);
+                }
+                event_pool_free(&loop->data_timeout_pool, ev);
+            } else {
+                event_pool_free(&loop->timeout_pool, ev);
+            }
+            break;
+        case EVENT_TYPE_PERIOD:
+            event_pool_free(&loop->period_pool, ev);
+            break;
+        default:
+            ARS_FREE(ev);
+            break;
+    }
+}
+
+static iobuf_t* readbuf_region_carve(loop_t* loop, int cls) {
+    readbuf_region_t* region = loop->readbuf_region;
+    if (region == NULL) {
+        size_t maplen = READBUF_REGION_SIZE;
+        char* base = (char*)ars_page_alloc(&maplen);
+        if (base == NULL) return NULL;
+        ARS_ALLOC_SIZEOF(region);
+        region->base = base;
+        region->maplen = maplen;
+        region->refcnt = 1;
+        loop->readbuf_region = region;
+    }
+    size_t len = ARS_LOOP_READ_BUFSIZE << cls;
+    // NOTE: single consumer, a slice at the head cannot be popped and pushed back under us.
+    char* slice = atomic_get(&region->freed[cls]);
+    while (slice) {
+        char* prev = atomic_compare_swap(&region->freed[cls], slice, *(char**)slice);
+        if (prev == slice) break;
+        slice = prev;
+    }
+    if (slice == NULL) {
+        if (region->carved[cls] >= ARS_READBUF_POOL_SIZE) {
+            return NULL;
+        }
+        slice = region->base + READBUF_REGION_AREA(cls) + len * region->carved[cls]++;
+    }
+    iobuf_t* buf = iobuf_wrap(slice, len, readbuf_region_release, region);
+    atomic_inc(&region->refcnt);
+    return buf;
+}
+
+iobuf_t* loop_readbuf_get(loop_t* loop, int cls) {
+    iobuf_t* buf = loop->readbufs[cls];
+    if (buf) {
+        loop->readbufs[cls] = buf->next;
+        loop->nreadbufs[cls]--;
+        return buf;
+    }
+    buf = readbuf_region_carve(loop, cls);
+    return buf ? buf : iobuf_new(ARS_LOOP_READ_BUFSIZE << cls);
+}
+
+void loop_readbuf_put(loop_t* loop, iobuf_t* buf) {
+    int cls = 0;
+    while (cls < ARS_READBUF_CLASSES - 1 && (ARS_LOOP_READ_BUFSIZE << cls) < (int)buf->len) {
+        ++cls;
+    }
+    // NOTE: a dropped carved buf goes back to the region, as do retained ones unref'd elsewhere.
+    if (loop->nreadbufs[cls] >= ARS_READBUF_POOL_SIZE) {
+        iobuf_unref(buf);
+        return;
+    }
+    buf->next = loop->readbufs[cls];
+    loop->readbufs[cls] = buf;
+    loop->nreadbufs[cls]++;
+}
+
 void io_init(io_t* io) {
     // alloc localaddr,peeraddr when hio_socket_init
     /*
@@ -685,6 +1222,12 @@ void io_ready(io_t* io) {
     io->close_cb = NULL;
     io->accept_cb = NULL;
     io->connect_cb = NULL;
+    io->recvmmsg_cb = NULL;
+    io->high_water_cb = NULL;
+    io->low_water_cb = NULL;
+    io->write_bufsize = 0;
+    io->write_high_water = io->write_low_water = 0;
+    io->write_over_high = io->pause_upstream = io->upstream_paused = 0;
     // timers
     io->connect_timeout = 0;
     io->connect_timer = NULL;
@@ -697,10 +1240,22 @@ void io_ready(io_t* io) {
     io->heartbeat_timer = NULL;
     // upstream
     io->upstream_io = NULL;
+    io->splice = 0;
+    io->splice_drain = 0;
+    io->ktls = 0;
+    io->resolving = 0;
+    io->connect_pending = 0;
+    io->splice_pipe[0] = io->splice_pipe[1] = -1;
+    io->splice_pending = 0;
+    io->unpack_setting = NULL;
     // private:
     io->event_index[0] = io->event_index[1] = -1;
     io->hovlp = NULL;
     io->ssl = NULL;
+    io->lent_readbuf = NULL;
+    io->readbuf_class = 0;
+    io->readbuf_small = 0;
+    memset(&io->stat, 0, sizeof(io->stat));
 
     // io_type
     fill_io_type(io);
@@ -715,15 +1270,28 @@ void io_done(io_t* io) {
 
     hio_del(io, ARS_IO_RDWR);
 
-    offset_buf_t* pbuf = NULL;
+    write_buf_t* pbuf = NULL;
     mutex_lock(&io->write_mutex);
     while (!write_queue_empty(&io->write_queue)) {
         pbuf = write_queue_front(&io->write_queue);
-        ARS_FREE(pbuf->base);
+        write_buf_t dropped = *pbuf;
         write_queue_pop_front(&io->write_queue);
+        iobuf_unref(dropped.buf);
+        if (dropped.fd >= 0 && dropped.cb) {
+            // NOTE: unlocked, cb may close the fd or write to other ios.
+            mutex_unlock(&io->write_mutex);
+            dropped.cb(io, dropped.fd, io->error ? io->error : ECANCELED);
+            mutex_lock(&io->write_mutex);
+        }
     }
     write_queue_cleanup(&io->write_queue);
+    io->write_bufsize = 0;
+    io->write_over_high = 0;
     mutex_unlock(&io->write_mutex);
+
+    io_mmsg_free(io);
+    io_splice_free(io);
+    io_unpack_free(io);
 }
 
 void io_free(io_t* io) {
@@ -733,9 +1301,31 @@ void io_free(io_t* io) {
     // NOTE: call io_close to call close_cb
     io_close(io);
     mutex_lock_deinit(&io->write_mutex);
-    ARS_FREE(io->localaddr);
-    ARS_FREE(io->peeraddr);
-    ARS_FREE(io);
+    event_pool_free(&io->loop->io_pool, io);
+}
+
+void io_detach(io_t* io) {
+    if (io == NULL) return;
+    // NOTE: same timers as __close_cb deletes
+    if (io->connect_timer) {
+        timer_del(io->connect_timer);
+        io->connect_timer = NULL;
+    }
+    if (io->close_timer) {
+        timer_del(io->close_timer);
+        io->close_timer = NULL;
+    }
+    if (io->keepalive_timer) {
+        timer_del(io->keepalive_timer);
+        io->keepalive_timer = NULL;
+    }
+    if (io->heartbeat_timer) {
+        timer_del(io->heartbeat_timer);
+        io->heartbeat_timer = NULL;
+    }
+    io_done(io);
+    // NOTE: keep the slot in loop->ios, io_get reuses it when the fd number comes back.
+    io->closed = 1;
 }
 
 bool io_is_opened(io_t* io) {
@@ -748,6 +1338,13 @@ bool io_is_closed(io_t* io) {
     return io->ready == 0 && io->closed == 1;
 }
 
+void io_stat(io_t* io, io_stat_t* stat) {
+    stat->read_calls = stat_counter_get(&io->stat.read_calls);
+    stat->read_bytes = stat_counter_get(&io->stat.read_bytes);
+    stat->write_calls = stat_counter_get(&io->stat.write_calls);
+    stat->write_bytes = stat_counter_get(&io->stat.write_bytes);
+}
+
 io_t* io_get(loop_t* loop, int fd) {
     if (fd < 0) return nullptr;
     if ((uint32_t)fd >= loop->ios.maxsize) {
@@ -757,7 +1354,10 @@ io_t* io_get(loop_t* loop, int fd) {
 
     io_t* io = loop->ios.ptr[fd];
     if (io == NULL) {
-        ARS_ALLOC_SIZEOF(io);
+        io_slot_t* slot = (io_slot_t*)event_pool_alloc(&loop->io_pool);
+        io = &slot->io;
+        io->localaddr = &slot->localaddr.sa;
+        io->peeraddr = &slot->peeraddr.sa;
         io_init(io);
         io->event_type = EVENT_TYPE_IO;
         io->loop = loop;
@@ -936,7 +1536,7 @@ io_t* loop_create_tcp_server(loop_t* loop, const char* host, int port, accept_cb
 }
 
 io_t* loop_create_tcp_client(loop_t* loop, const char* host, int port, connect_cb connect_cb) {
-    io_t* io = ev_create(loop, host, port, SOCK_STREAM);
+    io_t* io = ev_create_async(loop, host, port);
     if (io == NULL) return NULL;
     ev_connect(loop, io->fd, connect_cb);
     return io;
@@ -987,7 +1587,7 @@ void io_setup_upstream(io_t* io1, io_t* io2) {
 io_t* io_get_upstream(io_t* io) { return io->upstream_io; }
 
 io_t* io_setup_tcp_upstream(io_t* io, const char* host, int port, int ssl) {
-    io_t* upstream_io = ev_create(io->loop, host, port, SOCK_STREAM);
+    io_t* upstream_io = ev_create_async(io->loop, host, port);
     if (upstream_io == NULL) return NULL;
     if (ssl) io_enable_ssl(upstream_io);
     io_setup_upstream(io, upstream_io);
@@ -997,6 +1597,16 @@ io_t* io_setup_tcp_upstream(io_t* io, const char* host, int port, int ssl) {
     return upstream_io;
 }
 
+io_t* io_setup_tcp_splice_upstream(io_t* io, const char* host, int port) {
+    io_t* upstream_io = ev_create_async(io->loop, host, port);
+    if (upstream_io == NULL) return NULL;
+    io_setup_splice(io, upstream_io);
+    io_setcb_close(io, io_close_upstream);
+    io_setcb_close(upstream_io, io_close_upstream);
+    ev_connect(io->loop, upstream_io->fd, io_read_upstream);
+    return upstream_io;
+}
+
 io_t* io_setup_udp_upstream(io_t* io, const char* host, int port) {
     io_t* upstream_io = ev_create(io->loop, host, port, SOCK_DGRAM);
     if (upstream_io == NULL) return NULL;
@@ -0,0 +1,407 @@
+#include "ars/sdk/event/event.hpp"
+#include "ars/sdk/net/sock.hpp"
+#include "ars/sdk/thread/thread.hpp"
+
+#ifdef ARS_OS_LINUX
+#include <netinet/in.h>
+#include <netinet/udp.h>
+#include <sys/socket.h>
+#endif
+
+namespace ars {
+
+namespace sdk {
+
+namespace event {
+
+#ifdef ARS_OS_LINUX
+
+#ifndef SOL_UDP
+#define SOL_UDP IPPROTO_UDP
+#endif
+
+// NOTE: limits of one UDP_SEGMENT send, see UDP_MAX_SEGMENTS in kernel.
+#define MMSG_GSO_SEGS 64
+#define MMSG_GSO_BYTES 65000
+#define MMSG_GRO_MSGSIZE 65535
+#define MMSG_CMSG_SPACE CMSG_SPACE(sizeof(int))
+
+typedef struct mmsg_dgram_s {
+    iobuf_t* buf;
+    sock_addr_t addr;
+} mmsg_dgram_t;
+ARS_QUEUE_DECL(mmsg_dgram_t, dgram_queue);
+
+struct io_mmsg_s {
+    io_t* io;
+    int nmsgs;
+    int msgsize;
+    int flags;
+    char* bufs;             // nmsgs * msgsize, for recvmmsg
+    char* cmsgs;            // nmsgs * MMSG_CMSG_SPACE
+    struct mmsghdr* hdrs;   // nmsgs, for recvmmsg and sendmmsg
+    struct iovec* iovs;     // nmsgs
+    sock_addr_t* addrs;     // nmsgs
+    io_dgram_t* dgrams;     // nmsgs
+    struct dgram_queue sendq;  // locked by io->write_mutex
+    struct list_head flush_node;
+    // NOTE: not bitfields, flush_pending is loop thread only, flush_posted locked by io->write_mutex.
+    unsigned char flush_pending;  // in loop->mmsg_flushes
+    unsigned char flush_posted;   // loop_post_event by other thread
+};
+
+int io_set_mmsg(io_t* io, int nmsgs, int msgsize, int flags) {
+    if (io->io_type != IO_TYPE_UDP || io->mmsg || nmsgs <= 0 || msgsize <= 0) return -1;
+    if (flags & ARS_IO_MMSG_GRO) {
+#ifdef UDP_GRO
+        int on = 1;
+        if (setsockopt(io->fd, SOL_UDP, UDP_GRO, &on, sizeof(on)) != 0) {
+            flags &= ~ARS_IO_MMSG_GRO;
+        } else if (msgsize < MMSG_GRO_MSGSIZE) {
+            msgsize = MMSG_GRO_MSGSIZE;
+        }
+#else
+        flags &= ~ARS_IO_MMSG_GRO;
+#endif
+    }
+#ifndef UDP_SEGMENT
+    flags &= ~ARS_IO_MMSG_GSO;
+#endif
+    io_mmsg_s* mmsg;
+    ARS_ALLOC_SIZEOF(mmsg);
+    mmsg->io = io;
+    mmsg->nmsgs = nmsgs;
+    mmsg->msgsize = msgsize;
+    mmsg->flags = flags;
+    mmsg->bufs = (char*)ars_malloc((size_t)nmsgs * msgsize);
+    ARS_ALLOC(mmsg->cmsgs, (size_t)nmsgs * MMSG_CMSG_SPACE);
+    ARS_ALLOC(mmsg->hdrs, sizeof(struct mmsghdr) * nmsgs);
+    ARS_ALLOC(mmsg->iovs, sizeof(struct iovec) * nmsgs);
+    ARS_ALLOC(mmsg->addrs, sizeof(sock_addr_t) * nmsgs);
+    ARS_ALLOC(mmsg->dgrams, sizeof(io_dgram_t) * nmsgs);
+    dgram_queue_init(&mmsg->sendq, nmsgs);
+    list_init(&mmsg->flush_node);
+    io->mmsg = mmsg;
+    return 0;
+}
+
+static void __mmsg_read_cb(io_t* io, void* buf, int len, int segsize) {
+    // NOTE: split GRO coalesced datagrams for read_cb.
+    if (segsize <= 0) segsize = len;
+    for (int off = 0; off < len && io->read_cb && !io->closed; off += segsize) {
+        int n = len - off < segsize ? len - off : segsize;
+        io->read_cb(io, (char*)buf + off, n);
+    }
+}
+
+static int __mmsg_segsize(struct msghdr* msg) {
+#ifdef UDP_GRO
+    for (struct cmsghdr* cmsg = CMSG_FIRSTHDR(msg); cmsg; cmsg = CMSG_NXTHDR(msg, cmsg)) {
+        if (cmsg->cmsg_level == SOL_UDP && cmsg->cmsg_type == UDP_GRO) {
+            int segsize;
+            memcpy(&segsize, CMSG_DATA(cmsg), sizeof(segsize));
+            return segsize;
+        }
+    }
+#endif
+    return 0;
+}
+
+void io_mmsg_read(io_t* io) {
+    io_mmsg_s* mmsg = io->mmsg;
+    int gro = mmsg->flags & ARS_IO_MMSG_GRO;
+read:
+    for (int i = 0; i < mmsg->nmsgs; ++i) {
+        struct msghdr* msg = &mmsg->hdrs[i].msg_hdr;
+        mmsg->iovs[i].iov_base = mmsg->bufs + (size_t)i * mmsg->msgsize;
+        mmsg->iovs[i].iov_len = mmsg->msgsize;
+        msg->msg_name = &mmsg->addrs[i];
+        msg->msg_namelen = sizeof(sock_addr_t);
+        msg->msg_iov = &mmsg->iovs[i];
+        msg->msg_iovlen = 1;
+        msg->msg_control = gro ? mmsg->cmsgs + (size_t)i * MMSG_CMSG_SPACE : NULL;
+        msg->msg_controllen = gro ? MMSG_CMSG_SPACE : 0;
+        msg->msg_flags = 0;
+    }
+    int nmsgs = recvmmsg(io->fd, mmsg->hdrs, mmsg->nmsgs, 0, NULL);
+    int err = socket_errno();
+    if (nmsgs < 0) {
+        io_count_read(io, -1);
+        if (err == EAGAIN || err == EINTR) {
+            return;
+        }
+        io->error = err;
+        io_close(io);
+        return;
+    }
+    int nbytes = 0;
+    for (int i = 0; i < nmsgs; ++i) {
+        nbytes += mmsg->hdrs[i].msg_len;
+    }
+    io_count_read(io, nbytes);
+    if (io->keepalive_timer) {
+        timer_reset(io->keepalive_timer);
+    }
+    for (int i = 0; i < nmsgs; ++i) {
+        io_dgram_t* dgram = &mmsg->dgrams[i];
+        dgram->buf = mmsg->iovs[i].iov_base;
+        dgram->len = mmsg->hdrs[i].msg_len;
+        dgram->segsize = gro ? __mmsg_segsize(&mmsg->hdrs[i].msg_hdr) : 0;
+        dgram->peeraddr = &mmsg->addrs[i].sa;
+        dgram->peeraddrlen = mmsg->hdrs[i].msg_hdr.msg_namelen;
+    }
+    if (io->recvmmsg_cb) {
+        io->recvmmsg_cb(io, mmsg->dgrams, nmsgs);
+    } else {
+        for (int i = 0; i < nmsgs && !io->closed; ++i) {
+            io_dgram_t* dgram = &mmsg->dgrams[i];
+            // NOTE: not hdrs[i], an io_sendto in read_cb may flush and reuse hdrs.
+            io_set_peeraddr(io, dgram->peeraddr, dgram->peeraddrlen);
+            __mmsg_read_cb(io, dgram->buf, dgram->len, dgram->segsize);
+        }
+    }
+    // NOTE: io_close in callbacks frees mmsg.
+    if (io->closed || io->mmsg != mmsg || !(io->events & ARS_IO_READ)) {
+        return;
+    }
+    // NOTE: a full batch means more are waiting, edge-triggered reads until EAGAIN.
+    if (nmsgs == mmsg->nmsgs || (io->loop->flags & ARS_LOOP_FLAG_EDGE_TRIGGERED)) {
+        goto read;
+    }
+}
+
+static inline int __mmsg_same_peer(mmsg_dgram_t* a, mmsg_dgram_t* b) {
+    return memcmp(&a->addr, &b->addr, sock_addr_len(&a->addr)) == 0;
+}
+
+// NOTE: called with io->write_mutex locked, wait ARS_IO_WRITE on EAGAIN if rearm.
+// @return -1 if io error
+static int __mmsg_flush(io_t* io, int rearm) {
+    io_mmsg_s* mmsg = io->mmsg;
+    while (!dgram_queue_empty(&mmsg->sendq)) {
+        mmsg_dgram_t* dgrams = dgram_queue_data(&mmsg->sendq);
+        int ndgrams = dgram_queue_size(&mmsg->sendq);
+        if (ndgrams > mmsg->nmsgs) ndgrams = mmsg->nmsgs;
+        int gso = mmsg->flags & ARS_IO_MMSG_GSO;
+        int nhdrs = 0;
+        for (int i = 0; i < ndgrams;) {
+            struct msghdr* msg = &mmsg->hdrs[nhdrs].msg_hdr;
+            memset(msg, 0, sizeof(*msg));
+            // NOTE: no address, sent to the peer of connected socket.
+            if (dgrams[i].addr.sa.sa_family != AF_UNSPEC) {
+                msg->msg_name = &dgrams[i].addr;
+                msg->msg_namelen = sock_addr_len(&dgrams[i].addr);
+            }
+            msg->msg_iov = &mmsg->iovs[i];
+            int segsize = dgrams[i].buf->len;
+            size_t total = 0;
+            int nsegs = 0;
+            do {
+                mmsg->iovs[i].iov_base = dgrams[i].buf->base;
+                mmsg->iovs[i].iov_len = dgrams[i].buf->len;
+                total += dgrams[i].buf->len;
+                ++nsegs;
+                ++i;
+                // NOTE: GSO segments have same size except the last one.
+            } while (gso && i < ndgrams && nsegs < MMSG_GSO_SEGS &&
+                     (int)dgrams[i - 1].buf->len == segsize && segsize > 0 &&
+                     dgrams[i].buf->len > 0 && (int)dgrams[i].buf->len <= segsize &&
+                     total + dgrams[i].buf->len <= MMSG_GSO_BYTES &&
+                     __mmsg_same_peer(&dgrams[i - 1], &dgrams[i]));
+            msg->msg_iovlen = nsegs;
+#ifdef UDP_SEGMENT
+            if (nsegs > 1) {
+                char* control = mmsg->cmsgs + (size_t)nhdrs * MMSG_CMSG_SPACE;
+                memset(control, 0, MMSG_CMSG_SPACE);
+                msg->msg_control = control;
+                msg->msg_controllen = CMSG_SPACE(sizeof(uint16_t));
+                struct cmsghdr* cmsg = CMSG_FIRSTHDR(msg);
+                cmsg->cmsg_level = SOL_UDP;
+                cmsg->cmsg_type = UDP_SEGMENT;
+                cmsg->cmsg_len = CMSG_LEN(sizeof(uint16_t));
+                uint16_t gso_size = segsize;
+                memcpy(CMSG_DATA(cmsg), &gso_size, sizeof(gso_size));
+            }
+#endif
+            ++nhdrs;
+        }
+        int nsent = sendmmsg(io->fd, mmsg->hdrs, nhdrs, 0);
+        if (nsent < 0) {
+            int err = socket_errno();
+            io_count_write(io, -1);
+            if (err == EAGAIN) {
+                if (rearm) {
+                    io_wait_write(io);
+                }
+                return 0;
+            }
+            if (err == EINTR) {
+                continue;
+            }
+            if (gso && err == EIO) {
+                // NOTE: NIC without checksum offload can not GSO, send them one by one.
+                mmsg->flags &= ~ARS_IO_MMSG_GSO;
+                continue;
+            }
+            if (err == EDESTADDRREQ) {
+                // NOTE: no address for unconnected socket, drop it like a failed sendto.
+                for (size_t k = 0; k < mmsg->hdrs[0].msg_hdr.msg_iovlen; ++k) {
+                    iobuf_unref(dgram_queue_front(&mmsg->sendq)->buf);
+                    dgram_queue_pop_front(&mmsg->sendq);
+                }
+                continue;
+            }
+            io->error = err;
+            return -1;
+        }
+        int nbytes = 0;
+        for (int h = 0; h < nsent; ++h) {
+            nbytes += mmsg->hdrs[h].msg_len;
+            for (size_t k = 0; k < mmsg->hdrs[h].msg_hdr.msg_iovlen; ++k) {
+                iobuf_unref(dgram_queue_front(&mmsg->sendq)->buf);
+                dgram_queue_pop_front(&mmsg->sendq);
+            }
+        }
+        io_count_write(io, nbytes);
+        if (io->keepalive_timer) {
+            timer_reset(io->keepalive_timer);
+        }
+    }
+    return 0;
+}
+
+static void __mmsg_flush_and_check(io_t* io, int posted = 0) {
+    mutex_lock(&io->write_mutex);
+    if (posted) {
+        io->mmsg->flush_posted = 0;
+    }
+    int ret = __mmsg_flush(io, 1);
+    mutex_unlock(&io->write_mutex);
+    if (ret < 0) {
+        io_close(io);
+    }
+}
+
+void io_mmsg_write(io_t* io) {
+    __mmsg_flush_and_check(io);
+}
+
+static void __mmsg_flush_event_cb(event_t* ev) {
+    io_t* io = (io_t*)ev->userdata;
+    uint32_t id = (uintptr_t)ev->privdata;
+    if (io->id != id || io->mmsg == NULL) return;
+    __mmsg_flush_and_check(io, 1);
+}
+
+int io_mmsg_send(io_t* io, iobuf_t* buf, struct sockaddr* addr) {
+    int len = buf->len;
+    if (io->closed || io->mmsg == NULL) {
+        iobuf_unref(buf);
+        return -1;
+    }
+    io_mmsg_s* mmsg = io->mmsg;
+    mmsg_dgram_t dgram;
+    dgram.buf = buf;
+    memset(&dgram.addr, 0, sizeof(dgram.addr));
+    // NOTE: peeraddr of io is unset if not io_set_peeraddr, e.g. connected by user.
+    if (addr && addr->sa_family != AF_UNSPEC) {
+        memcpy(&dgram.addr, addr, ARS_SOCKADDR_LEN(addr));
+    }
+    int in_loop = (long)gettid() == io->loop->tid;
+    int post = 0;
+    int ret = 0;
+    mutex_lock(&io->write_mutex);
+    dgram_queue_push_back(&mmsg->sendq, &dgram);
+    if (in_loop) {
+        if (dgram_queue_size(&mmsg->sendq) >= mmsg->nmsgs) {
+            ret = __mmsg_flush(io, 1);
+        } else if (!mmsg->flush_pending) {
+            mmsg->flush_pending = 1;
+            list_add_tail(&mmsg->flush_node, &io->loop->mmsg_flushes);
+        }
+    } else if (!mmsg->flush_posted) {
+        mmsg->flush_posted = post = 1;
+    }
+    mutex_unlock(&io->write_mutex);
+    if (ret < 0) {
+        io_close(io);
+        return -1;
+    }
+    if (post) {
+        event_t ev;
+        memset(&ev, 0, sizeof(ev));
+        ev.cb = __mmsg_flush_event_cb;
+        ev.userdata = io;
+        ev.privdata = (void*)(uintptr_t)io->id;
+        loop_post_event(io->loop, &ev);
+    }
+    return len;
+}
+
+void loop_flush_mmsgs(loop_t* loop) {
+    while (!list_empty(&loop->mmsg_flushes)) {
+        io_mmsg_s* mmsg = container_of(loop->mmsg_flushes.next, io_mmsg_s, flush_node);
+        list_del_init(&mmsg->flush_node);
+        mmsg->flush_pending = 0;
+        __mmsg_flush_and_check(mmsg->io);
+    }
+}
+
+void io_mmsg_free(io_t* io) {
+    io_mmsg_s* mmsg = io->mmsg;
+    if (mmsg == NULL) return;
+    mutex_lock(&io->write_mutex);
+    // NOTE: best effort, datagrams left by EAGAIN are dropped.
+    if (io->error == 0) {
+        __mmsg_flush(io, 0);
+    }
+    while (!dgram_queue_empty(&mmsg->sendq)) {
+        iobuf_unref(dgram_queue_front(&mmsg->sendq)->buf);
+        dgram_queue_pop_front(&mmsg->sendq);
+    }
+    io->mmsg = NULL;
+    mutex_unlock(&io->write_mutex);
+    if (mmsg->flush_pending) {
+        list_del(&mmsg->flush_node);
+    }
+    dgram_queue_cleanup(&mmsg->sendq);
+    ars_free(mmsg->bufs);
+    ARS_FREE(mmsg->cmsgs);
+    ARS_FREE(mmsg->hdrs);
+    ARS_FREE(mmsg->iovs);
+    ARS_FREE(mmsg->addrs);
+    ARS_FREE(mmsg->dgrams);
+    ARS_FREE(mmsg);
+}
+
+#else
+
+int io_set_mmsg(io_t* io, int nmsgs, int msgsize, int flags) { return -1; }
+int io_mmsg_send(io_t* io, iobuf_t* buf, struct sockaddr* addr) {
+    iobuf_unref(buf);
+    return -1;
+}
+void io_mmsg_read(io_t* io) {}
+void io_mmsg_write(io_t* io) {}
+void io_mmsg_free(io_t* io) {}
+void loop_flush_mmsgs(loop_t* loop) {}
+
+#endif
+
+void io_setcb_recvmmsg(io_t* io, recvmmsg_cb recvmmsg_cb) { io->recvmmsg_cb = recvmmsg_cb; }
+
+int io_sendto(io_t* io, const void* buf, size_t len, struct sockaddr* addr) {
+    if (io->mmsg == NULL) {
+        io_set_peeraddr(io, addr, ARS_SOCKADDR_LEN(addr));
+        return io_write(io, buf, len);
+    }
+    iobuf_t* dgram = iobuf_new(len);
+    memcpy(dgram->base, buf, len);
+    return io_mmsg_send(io, dgram, addr);
+}
+
+}  // namespace event
+
+}  // namespace sdk
+
+}  // namespace ars
@@ -1,11 +1,16 @@
 #include "ars/sdk/event/iowatcher.hpp"
 #ifndef EVENT_IOCP
+#include <limits.h>
+#include <sys/uio.h>
 #include <unistd.h>
 #include "ars/sdk/event/event.hpp"
 #include "ars/sdk/macros/attr.hpp"
 #include "ars/sdk/net/sock.hpp"
 #include "ars/sdk/net/ssl.hpp"
 #include "ars/sdk/thread/thread.hpp"
+#ifdef ARS_OS_LINUX
+#include <sys/sendfile.h>
+#endif
 
 namespace ars {
 
@@ -13,6 +18,18 @@ namespace sdk {
 
 namespace event {
 
+// NOTE: iovec array lives on the loop thread stack, keep it small and below IOV_MAX.
+#define NIO_WRITEV_MAX 64
+#if defined(IOV_MAX) && IOV_MAX < NIO_WRITEV_MAX
+#undef NIO_WRITEV_MAX
+#define NIO_WRITEV_MAX IOV_MAX
+#endif
+
+// NOTE: linux sendfile writes at most 0x7ffff000 bytes a call.
+#define NIO_SENDFILE_MAX 0x7ffff000
+// NOTE: region read into one iobuf at a time where sendfile does not fit
+#define NIO_SENDFILE_CHUNK (64 * 1024)
+
 static void __connect_timeout_cb(timer_t* timer) {
     io_t* io = (io_t*)timer->privdata;
     if (io) {
@@ -82,7 +99,9 @@ static void __read_cb(io_t* io, void* buf, int readbytes) {
         timer_reset(io->keepalive_timer);
     }
 
-    if (io->read_cb) {
+    if (io->unpack_setting) {
+        io_unpack(io, buf, readbytes);
+    } else if (io->read_cb) {
         // printd("read_cb------\n");
         io->read_cb(io, buf, readbytes);
         // printd("read_cb======\n");
@@ -102,6 +121,42 @@ static void __write_cb(io_t* io, const void* buf, int writebytes) {
     }
 }
 
+// NOTE: with write_mutex locked.
+// @return 1 if write_bufsize just reached the high mark, call __write_high_water after unlock
+static int __write_over_high(io_t* io) {
+    if (io->write_high_water == 0 || io->write_over_high ||
+        io->write_bufsize < io->write_high_water) {
+        return 0;
+    }
+    io->write_over_high = 1;
+    return 1;
+}
+
+static void __write_high_water(io_t* io) {
+    io_t* upstream_io = io->upstream_io;
+    if (io->pause_upstream && upstream_io && !upstream_io->closed &&
+        (upstream_io->events & ARS_IO_READ) && (long)gettid() == io->loop->tid) {
+        hio_del(upstream_io, ARS_IO_READ);
+        io->upstream_paused = 1;
+    }
+    if (io->high_water_cb) {
+        io->high_water_cb(io, io->write_bufsize);
+    }
+}
+
+static void __write_low_water(io_t* io) {
+    io_t* upstream_io = io->upstream_io;
+    if (io->upstream_paused) {
+        io->upstream_paused = 0;
+        if (upstream_io && !upstream_io->closed) {
+            io_read(upstream_io);
+        }
+    }
+    if (io->low_water_cb) {
+        io->low_water_cb(io, io->write_bufsize);
+    }
+}
+
 static void __close_cb(io_t* io) {
     // printd("close fd=%d\n", io->fd);
     if (io->connect_timer) {
@@ -141,9 +196,13 @@ static void ssl_server_handshark(io_t* io) {
     int ret = ssl_accept(io->ssl);
     if (ret == 0) {
         // handshark finish
-        iowatcher_del_event(io->loop, io->fd, ARS_IO_READ);
-        io->events &= ~ARS_IO_READ;
+        // NOTE: may finish at the first call, READ is not watched then.
+        if (io->events & ARS_IO_READ) {
+            iowatcher_del_event(io->loop, io->fd, ARS_IO_READ);
+            io->events &= ~ARS_IO_READ;
+        }
         io->cb = NULL;
+        io->ktls = ssl_ktls_send(io->ssl);
         printd("ssl handshark finished.\n");
         __accept_cb(io);
     } else if (ret == SSL_WANT_READ) {
@@ -161,9 +220,12 @@ static void ssl_client_handshark(io_t* io) {
     int ret = ssl_connect(io->ssl);
     if (ret == 0) {
         // handshark finish
-        iowatcher_del_event(io->loop, io->fd, ARS_IO_READ);
-        io->events &= ~ARS_IO_READ;
+        if (io->events & ARS_IO_READ) {
+            iowatcher_del_event(io->loop, io->fd, ARS_IO_READ);
+            io->events &= ~ARS_IO_READ;
+        }
         io->cb = NULL;
+        io->ktls = ssl_ktls_send(io->ssl);
         printd("ssl handshark finished.\n");
         __connect_cb(io);
     } else if (ret == SSL_WANT_READ) {
@@ -258,6 +320,30 @@ connect_failed:
     io_close(io);
 }
 
+// NOTE: single writer in loop thread.
+void io_count_read(io_t* io, int nread) {
+    uint64_t bytes = nread > 0 ? nread : 0;
+    stat_counter_add(&io->stat.read_calls, 1);
+    stat_counter_add(&io->stat.read_bytes, bytes);
+    loop_metrics_t* metrics = io->loop->metrics;
+    if (metrics) {
+        stat_counter_add(&metrics->read_calls, 1);
+        stat_counter_add(&metrics->read_bytes, bytes);
+    }
+}
+
+// NOTE: io_write may run out of the loop thread, so the counters take locked adds.
+void io_count_write(io_t* io, int nwrite) {
+    uint64_t bytes = nwrite > 0 ? nwrite : 0;
+    stat_counter_add_shared(&io->stat.write_calls, 1);
+    stat_counter_add_shared(&io->stat.write_bytes, bytes);
+    loop_metrics_t* metrics = io->loop->metrics;
+    if (metrics) {
+        stat_counter_add_shared(&metrics->write_calls, 1);
+        stat_counter_add_shared(&metrics->write_bytes, bytes);
+    }
+}
+
 static int __nio_read(io_t* io, void* buf, int len) {
     int nread = 0;
     switch (io->io_type) {
@@ -280,6 +366,7 @@ static int __nio_read(io_t* io, void* buf, int len) {
             nread = read(io->fd, buf, len);
             break;
     }
+    io_count_read(io, nread);
     return nread;
 }
 
@@ -287,6 +374,10 @@ static int __nio_write(io_t* io, const void* buf, int len) {
     int nwrite = 0;
     switch (io->io_type) {
         case IO_TYPE_SSL:
+            if (io->ktls) {
+                nwrite = write(io->fd, buf, len);
+                break;
+            }
             nwrite = ssl_write(io->ssl, buf, len);
             break;
         case IO_TYPE_TCP:
@@ -304,27 +395,202 @@ static int __nio_write(io_t* io, const void* buf, int len) {
             nwrite = write(io->fd, buf, len);
             break;
     }
+    io_count_write(io, nwrite);
+    return nwrite;
+}
+
+// NOTE: ssl and datagram must be written one buf by one write,
+// so gather only one iov for them, callers compare nwrite with what they gathered.
+static int __nio_writev_max(io_t* io) {
+    if ((io->io_type == IO_TYPE_SSL && !io->ktls) || io->io_type == IO_TYPE_UDP ||
+        io->io_type == IO_TYPE_IP) {
+        return 1;
+    }
+    return NIO_WRITEV_MAX;
+}
+
+static int __nio_writev(io_t* io, const struct iovec* iov, int cnt) {
+    if (cnt == 1) {
+        return __nio_write(io, iov[0].iov_base, iov[0].iov_len);
+    }
+    int nwrite = writev(io->fd, iov, cnt);
+    io_count_write(io, nwrite);
+    return nwrite;
+}
+
+// NOTE: sendfile until EAGAIN or the region done, offset moves with the bytes written.
+// @return bytes written, -1 if nothing written and error, 0 if file EOF first
+static int __nio_sendfile(io_t* io, write_buf_t* pbuf) {
+#ifdef ARS_OS_LINUX
+    int nwrite = 0;
+    while (pbuf->offset < pbuf->len) {
+        off_t off = pbuf->fileoff + pbuf->offset;
+        size_t n = pbuf->len - pbuf->offset;
+        if (n > (size_t)(NIO_SENDFILE_MAX - nwrite)) n = NIO_SENDFILE_MAX - nwrite;
+        ssize_t ret = sendfile(io->fd, pbuf->fd, &off, n);
+        io_count_write(io, ret);
+        if (ret < 0) {
+            if (socket_errno() == EINTR) continue;
+            if (nwrite > 0 && socket_errno() == EAGAIN) break;
+            return -1;
+        }
+        if (ret == 0) {
+            // NOTE: region beyond the file end, the stream is broken anyway.
+            return 0;
+        }
+        pbuf->offset += ret;
+        nwrite += ret;
+        if (nwrite >= NIO_SENDFILE_MAX) break;
+    }
+    if (nwrite > 0 && io->keepalive_timer) {
+        timer_reset(io->keepalive_timer);
+    }
+    return nwrite;
+#else
+    errno = ENOSYS;
+    return -1;
+#endif
+}
+
+// NOTE: same as __nio_sendfile, for ssl or where sendfile is not supported.
+// The region is pread into pbuf->buf one chunk at a time, the next chunk only once it is written.
+static int __nio_sendcopy(io_t* io, write_buf_t* pbuf) {
+    int nwrite = 0;
+    while (pbuf->offset < pbuf->len) {
+        if (pbuf->buf == NULL) {
+            size_t n = pbuf->len - pbuf->offset;
+            if (n > NIO_SENDFILE_CHUNK) n = NIO_SENDFILE_CHUNK;
+            iobuf_t* buf = iobuf_new(n);
+            ssize_t nread = pread(pbuf->fd, buf->base, n, pbuf->fileoff + pbuf->offset);
+            if (nread <= 0) {
+                iobuf_unref(buf);
+                if (nread < 0 && errno == EINTR) continue;
+                return nread < 0 ? -1 : 0;
+            }
+            buf->len = nread;
+            pbuf->buf = buf;
+            pbuf->base = buf->base;
+        }
+        int n = pbuf->buf->base + pbuf->buf->len - pbuf->base;
+        if (n > NIO_SENDFILE_MAX - nwrite) n = NIO_SENDFILE_MAX - nwrite;
+        int ret = __nio_write(io, pbuf->base, n);
+        if (ret < 0) {
+            if (socket_errno() == EINTR) continue;
+            if (nwrite > 0 && socket_errno() == EAGAIN) break;
+            return -1;
+        }
+        if (ret == 0) {
+            errno = EPIPE;
+            return -1;
+        }
+        pbuf->base += ret;
+        pbuf->offset += ret;
+        nwrite += ret;
+        if (pbuf->base == pbuf->buf->base + pbuf->buf->len) {
+            iobuf_unref(pbuf->buf);
+            pbuf->buf = NULL;
+            pbuf->base = NULL;
+        }
+        if (nwrite >= NIO_SENDFILE_MAX) break;
+    }
+    if (nwrite > 0 && io->keepalive_timer) {
+        timer_reset(io->keepalive_timer);
+    }
     return nwrite;
 }
 
+static int __nio_sendregion(io_t* io, write_buf_t* pbuf) {
+#ifdef ARS_OS_LINUX
+    if (io->io_type == IO_TYPE_TCP || io->ktls) {
+        return __nio_sendfile(io, pbuf);
+    }
+#endif
+    return __nio_sendcopy(io, pbuf);
+}
+
+// NOTE: grow readbuf when read fills it, shrink after several small reads.
+#define READBUF_SHRINK_READS 4
+static void __readbuf_adapt(io_t* io, int nread, int len) {
+    if (nread == len) {
+        if (io->readbuf_class < ARS_READBUF_CLASSES - 1) {
+            ++io->readbuf_class;
+        }
+        io->readbuf_small = 0;
+    } else if (nread <= len / 4 && io->readbuf_class > 0) {
+        if (++io->readbuf_small >= READBUF_SHRINK_READS) {
+            --io->readbuf_class;
+            io->readbuf_small = 0;
+        }
+    } else {
+        io->readbuf_small = 0;
+    }
+}
+
 static void nio_read(io_t* io) {
     // printd("nio_read fd=%d\n", io->fd);
     void* buf;
-    int len, nread;
+    int len, nread, err;
+    if (io->mmsg) {
+        io_mmsg_read(io);
+        return;
+    }
+    if (io->splice) {
+        io_splice_read(io);
+        return;
+    }
+    if (io->hovlp) {
+        // NOTE: completion-based iowatcher already read into its own buffer,
+        // give it back by iowatcher_read_done after read_cb.
+        iocomp_t* comp = (iocomp_t*)io->hovlp;
+        io->hovlp = NULL;
+        buf = comp->buf;
+        nread = comp->nread;
+        io_count_read(io, nread);
+        if (nread > 0) {
+            __read_cb(io, buf, nread);
+        } else if (nread < 0) {
+            io->error = -nread;
+        }
+        iowatcher_read_done(io->loop, io->fd);
+        if (nread <= 0) {
+            io_close(io);
+        }
+        return;
+    }
 read:
-    if (io->readbuf.base == NULL || io->readbuf.len == 0) {
-        io_set_readbuf(io, io->loop->readbuf.base, io->loop->readbuf.len);
+    if (ARS_IO_DEFAULT_READBUF(io)) {
+        // NOTE: borrow from loop readbuf pool, give it back after read_cb unless retained.
+        iobuf_t* rb = loop_readbuf_get(io->loop, io->readbuf_class);
+        buf = rb->base;
+        len = rb->len;
+        nread = __nio_read(io, buf, len);
+        err = socket_errno();
+        if (nread > 0) {
+            __readbuf_adapt(io, nread, len);
+            io->lent_readbuf = rb;
+            __read_cb(io, buf, nread);
+            rb = io->lent_readbuf;
+            io->lent_readbuf = NULL;
+        }
+        if (rb) {
+            loop_readbuf_put(io->loop, rb);
+        }
+    } else {
+        buf = io->readbuf.base;
+        len = io->readbuf.len;
+        nread = __nio_read(io, buf, len);
+        err = socket_errno();
+        if (nread > 0) {
+            __read_cb(io, buf, nread);
+        }
     }
-    buf = io->readbuf.base;
-    len = io->readbuf.len;
-    nread = __nio_read(io, buf, len);
     // printd("read retval=%d\n", nread);
     if (nread < 0) {
-        if (socket_errno() == EAGAIN) {
+        if (err == EAGAIN) {
             // goto read_done;
             return;
         } else {
-            io->error = socket_errno();
+            io->error = err;
             // perror("read");
             goto read_error;
         }
@@ -332,8 +598,13 @@ read:
     if (nread == 0) {
         goto disconnect;
     }
-    __read_cb(io, buf, nread);
-    if (nread == len) {
+    // NOTE: read_cb may stop reading, e.g. io_set_write_water pause_upstream.
+    if (nread == len && !io->closed && (io->events & ARS_IO_READ)) {
+        goto read;
+    }
+    // NOTE: edge-triggered, no more event until drained to EAGAIN.
+    if ((io->loop->flags & ARS_LOOP_FLAG_EDGE_TRIGGERED) && !io->closed &&
+        (io->events & ARS_IO_READ)) {
         goto read;
     }
     return;
@@ -345,43 +616,129 @@ disconnect:
 static void nio_write(io_t* io) {
     // printd("nio_write fd=%d\n", io->fd);
     int nwrite = 0;
+    struct iovec iov[NIO_WRITEV_MAX];
+    if (io->mmsg) {
+        io_mmsg_write(io);
+        return;
+    }
     mutex_lock(&io->write_mutex);
 write:
     if (write_queue_empty(&io->write_queue)) {
         mutex_unlock(&io->write_mutex);
+        // NOTE: bytes queued by io_write go first, then the spliced ones.
+        if (io->splice && io_splice_write(io) != 0) {
+            return;
+        }
         if (io->close) {
             io->close = 0;
             io_close(io);
         }
         return;
     }
-    offset_buf_t* pbuf = write_queue_front(&io->write_queue);
-    char* buf = pbuf->base + pbuf->offset;
-    int len = pbuf->len - pbuf->offset;
-    nwrite = __nio_write(io, buf, len);
-    // printd("write retval=%d\n", nwrite);
-    if (nwrite < 0) {
-        if (socket_errno() == EAGAIN) {
-            // goto write_done;
-            mutex_unlock(&io->write_mutex);
-            return;
-        } else {
+    if (write_queue_front(&io->write_queue)->fd >= 0) {
+        write_buf_t* pbuf = write_queue_front(&io->write_queue);
+        nwrite = __nio_sendregion(io, pbuf);
+        if (nwrite < 0) {
+            if (socket_errno() == EAGAIN) {
+                mutex_unlock(&io->write_mutex);
+                return;
+            }
             io->error = socket_errno();
-            // perror("write");
             goto write_error;
         }
-    }
-    if (nwrite == 0) {
-        goto disconnect;
-    }
-    __write_cb(io, buf, nwrite);
-    pbuf->offset += nwrite;
-    if (nwrite == len) {
-        ARS_FREE(pbuf->base);
-        write_queue_pop_front(&io->write_queue);
-        // write next
+        if (nwrite == 0) {
+            // NOTE: file is shorter than the region, the stream can not go on.
+            io->error = EIO;
+            goto write_error;
+        }
+        io->write_bufsize -= nwrite;
+        if (io->write_over_high && io->write_bufsize <= io->write_low_water) {
+            io->write_over_high = 0;
+            mutex_unlock(&io->write_mutex);
+            __write_low_water(io);
+            if (io->closed) return;
+            mutex_lock(&io->write_mutex);
+            pbuf = write_queue_front(&io->write_queue);
+        }
+        if (pbuf->offset < pbuf->len) {
+            if (nwrite < NIO_SENDFILE_MAX) {
+                // NOTE: EAGAIN
+                mutex_unlock(&io->write_mutex);
+                return;
+            }
+            goto write;
+        }
+        {
+            write_buf_t done = *pbuf;
+            write_queue_pop_front(&io->write_queue);
+            mutex_unlock(&io->write_mutex);
+            if (done.cb) done.cb(io, done.fd, 0);
+            if (io->closed) return;
+            mutex_lock(&io->write_mutex);
+        }
         goto write;
     }
+    {
+        // NOTE: gather the write_queue up to the first file region, then write it by one writev.
+        write_buf_t* pbuf = write_queue_data(&io->write_queue);
+        int cnt = write_queue_size(&io->write_queue);
+        int max = __nio_writev_max(io);
+        if (cnt > max) cnt = max;
+        size_t len = 0;
+        for (int i = 0; i < cnt; ++i) {
+            if (pbuf[i].fd >= 0) {
+                cnt = i;
+                break;
+            }
+            iov[i].iov_base = pbuf[i].base + pbuf[i].offset;
+            iov[i].iov_len = pbuf[i].len - pbuf[i].offset;
+            len += iov[i].iov_len;
+        }
+        nwrite = __nio_writev(io, iov, cnt);
+        // printd("write retval=%d\n", nwrite);
+        if (nwrite < 0) {
+            if (socket_errno() == EAGAIN) {
+                // goto write_done;
+                mutex_unlock(&io->write_mutex);
+                return;
+            } else {
+                io->error = socket_errno();
+                // perror("write");
+                goto write_error;
+            }
+        }
+        if (nwrite == 0) {
+            goto disconnect;
+        }
+        int left = nwrite;
+        while (left > 0) {
+            pbuf = write_queue_front(&io->write_queue);
+            char* buf = pbuf->base + pbuf->offset;
+            int n = pbuf->len - pbuf->offset;
+            if (n > left) n = left;
+            iobuf_t* done = NULL;
+            pbuf->offset += n;
+            left -= n;
+            if (pbuf->offset == pbuf->len) {
+                done = pbuf->buf;
+                write_queue_pop_front(&io->write_queue);
+            }
+            __write_cb(io, buf, n);
+            iobuf_unref(done);
+        }
+        io->write_bufsize -= nwrite;
+        if (io->write_over_high && io->write_bufsize <= io->write_low_water) {
+            io->write_over_high = 0;
+            mutex_unlock(&io->write_mutex);
+            __write_low_water(io);
+            if (io->closed) return;
+            mutex_lock(&io->write_mutex);
+        }
+        if ((size_t)nwrite == len) {
+            // write next
+            goto write;
+        }
+    }
     mutex_unlock(&io->write_mutex);
     return;
 write_error:
@@ -400,9 +757,11 @@ static void hio_handle_events(io_t* io) {
     }
 
     if ((io->events & ARS_IO_WRITE) && (io->revents & ARS_IO_WRITE)) {
-        // NOTE: del ARS_IO_WRITE, if write_queue empty
+        // NOTE: del ARS_IO_WRITE, if write_queue empty,
+        // edge-triggered keeps it to save epoll_ctl, nio_write does nothing then.
         mutex_lock(&io->write_mutex);
-        if (write_queue_empty(&io->write_queue)) {
+        if (write_queue_empty(&io->write_queue) &&
+            !(io->loop->flags & ARS_LOOP_FLAG_EDGE_TRIGGERED)) {
             iowatcher_del_event(io->loop, io->fd, ARS_IO_WRITE);
             io->events &= ~ARS_IO_WRITE;
         }
@@ -421,6 +780,8 @@ static void hio_handle_events(io_t* io) {
     io->revents = 0;
 }
 
+int io_wait_write(io_t* io) { return io_add(io, hio_handle_events, ARS_IO_WRITE); }
+
 int io_accept(io_t* io) {
     io->accept = 1;
     io_add(io, hio_handle_events, ARS_IO_READ);
@@ -428,6 +789,11 @@ int io_accept(io_t* io) {
 }
 
 int io_connect(io_t* io) {
+    // NOTE: the resolver connects once peeraddr is known.
+    if (io->resolving) {
+        io->connect_pending = 1;
+        return 0;
+    }
     int ret = connect(io->fd, io->peeraddr, ARS_SOCKADDR_LEN(io->peeraddr));
 #ifdef OS_WIN
     if (ret < 0 && socket_errno() != WSAEWOULDBLOCK) {
@@ -450,6 +816,12 @@ int io_connect(io_t* io) {
     return io_add(io, hio_handle_events, ARS_IO_WRITE);
 }
 
+iobuf_t* io_retain_readbuf(io_t* io) {
+    iobuf_t* buf = io->lent_readbuf;
+    io->lent_readbuf = NULL;
+    return buf;
+}
+
 int io_read(io_t* io) {
     if (io->closed) {
         // hloge("io_read called but fd[%d] already closed!", io->fd);
@@ -458,12 +830,33 @@ int io_read(io_t* io) {
     return io_add(io, hio_handle_events, ARS_IO_READ);
 }
 
+size_t io_write_bufsize(io_t* io) {
+    mutex_lock(&io->write_mutex);
+    size_t bufsize = io->write_bufsize;
+    mutex_unlock(&io->write_mutex);
+    return bufsize;
+}
+
+void io_set_write_water(io_t* io, size_t high, size_t low, int pause_upstream) {
+    mutex_lock(&io->write_mutex);
+    io->write_high_water = high;
+    io->write_low_water = low < high ? low : high;
+    io->pause_upstream = pause_upstream ? 1 : 0;
+    int high_crossed = __write_over_high(io);
+    mutex_unlock(&io->write_mutex);
+    if (high_crossed) __write_high_water(io);
+}
+
 int io_write(io_t* io, const void* buf, size_t len) {
     if (io->closed) {
         // hloge("io_write called but fd[%d] already closed!", io->fd);
         return -1;
     }
+    if (io->mmsg) {
+        return io_sendto(io, buf, len, io->peeraddr);
+    }
     int nwrite = 0;
+    int high = 0;
     mutex_lock(&io->write_mutex);
     if (write_queue_empty(&io->write_queue)) {
         // try_write:
@@ -493,18 +886,23 @@ int io_write(io_t* io, const void* buf, size_t len) {
         io_add(io, hio_handle_events, ARS_IO_WRITE);
     }
     if (nwrite < (int)len) {
-        offset_buf_t rest;
-        rest.len = len;
-        rest.offset = nwrite;
-        // NOTE: free in nio_write
-        ARS_ALLOC(rest.base, rest.len);
-        memcpy(rest.base, buf, rest.len);
+        // NOTE: copy the rest only, unref in nio_write
+        write_buf_t rest;
+        rest.buf = iobuf_new(len - nwrite);
+        memcpy(rest.buf->base, (const char*)buf + nwrite, len - nwrite);
+        rest.base = rest.buf->base;
+        rest.len = rest.buf->len;
+        rest.offset = 0;
+        rest.fd = -1;
         if (io->write_queue.maxsize == 0) {
             write_queue_init(&io->write_queue, 4);
         }
         write_queue_push_back(&io->write_queue, &rest);
+        io->write_bufsize += rest.len;
     }
+    high = __write_over_high(io);
     mutex_unlock(&io->write_mutex);
+    if (high) __write_high_water(io);
     return nwrite;
 write_error:
 disconnect:
@@ -513,6 +911,175 @@ disconnect:
     return nwrite;
 }
 
+int io_write_bufs(io_t* io, iobuf_t** bufs, int nbufs) {
+    int i = 0;
+    size_t offset = 0;
+    int ret = -1;
+    if (io->closed) {
+        // hloge("io_write_bufs called but fd[%d] already closed!", io->fd);
+        goto unref;
+    }
+    if (io->mmsg) {
+        // NOTE: one datagram per buf, refs handed over.
+        for (ret = 0; i < nbufs; ++i) {
+            int n = io_mmsg_send(io, bufs[i], io->peeraddr);
+            if (n < 0) {
+                ret = n;
+                ++i;
+                goto unref;
+            }
+            ret += n;
+        }
+        return ret;
+    }
+    {
+        int nwrite = 0;
+        int high = 0;
+        mutex_lock(&io->write_mutex);
+        if (write_queue_empty(&io->write_queue)) {
+            // try_write:
+            struct iovec iov[NIO_WRITEV_MAX];
+            int cnt = 0;
+            int max = __nio_writev_max(io);
+            for (int j = 0; j < nbufs && cnt < max; ++j) {
+                if (bufs[j]->len == 0) continue;
+                iov[cnt].iov_base = bufs[j]->base;
+                iov[cnt].iov_len = bufs[j]->len;
+                ++cnt;
+            }
+            if (cnt == 0) {
+                mutex_unlock(&io->write_mutex);
+                ret = 0;
+                goto unref;
+            }
+            nwrite = __nio_writev(io, iov, cnt);
+            // printd("writev retval=%d\n", nwrite);
+            if (nwrite < 0) {
+                if (socket_errno() == EAGAIN) {
+                    nwrite = 0;
+                    goto enqueue;
+                } else {
+                    // perror("writev");
+                    io->error = socket_errno();
+                    goto write_error;
+                }
+            }
+            if (nwrite == 0) {
+                goto disconnect;
+            }
+            for (int left = nwrite; i < nbufs; ++i, offset = 0) {
+                int n = bufs[i]->len;
+                if (n > left) n = left;
+                if (n > 0) {
+                    __write_cb(io, bufs[i]->base, n);
+                    left -= n;
+                }
+                if ((size_t)n < bufs[i]->len) {
+                    offset = n;
+                    break;
+                }
+                iobuf_unref(bufs[i]);
+            }
+            if (i == nbufs) {
+                // goto write_done;
+                mutex_unlock(&io->write_mutex);
+                return nwrite;
+            }
+        enqueue:
+            io_add(io, hio_handle_events, ARS_IO_WRITE);
+        }
+        if (io->write_queue.maxsize == 0) {
+            write_queue_init(&io->write_queue, 4);
+        }
+        // NOTE: queue the rest without copy, unref in nio_write
+        for (; i < nbufs; ++i, offset = 0) {
+            if (bufs[i]->len == 0) {
+                iobuf_unref(bufs[i]);
+                continue;
+            }
+            write_buf_t rest;
+            rest.base = bufs[i]->base;
+            rest.len = bufs[i]->len;
+            rest.offset = offset;
+            rest.buf = bufs[i];
+            rest.fd = -1;
+            write_queue_push_back(&io->write_queue, &rest);
+            io->write_bufsize += rest.len - rest.offset;
+        }
+        high = __write_over_high(io);
+        mutex_unlock(&io->write_mutex);
+        if (high) __write_high_water(io);
+        return nwrite;
+    write_error:
+    disconnect:
+        mutex_unlock(&io->write_mutex);
+        io_close(io);
+    }
+unref:
+    for (; i < nbufs; ++i) {
+        iobuf_unref(bufs[i]);
+    }
+    return ret;
+}
+
+int io_sendfile(io_t* io, int fd, off_t offset, size_t len, sendfile_cb cb) {
+    if (io->closed) {
+        // hloge("io_sendfile called but fd[%d] already closed!", io->fd);
+        return -1;
+    }
+    if (len == 0) {
+        if (cb) cb(io, fd, 0);
+        return 0;
+    }
+    write_buf_t region;
+    memset(&region, 0, sizeof(region));
+    region.len = len;
+    region.fd = fd;
+    region.fileoff = offset;
+    region.cb = cb;
+    int nwrite = 0;
+    int high = 0;
+    mutex_lock(&io->write_mutex);
+    if (write_queue_empty(&io->write_queue)) {
+        // try_write:
+        nwrite = __nio_sendregion(io, &region);
+        if (nwrite < 0) {
+            if (socket_errno() == EAGAIN) {
+                nwrite = 0;
+                goto enqueue;
+            }
+            io->error = socket_errno();
+            goto write_error;
+        }
+        if (nwrite == 0) {
+            io->error = EIO;
+            goto write_error;
+        }
+        if (region.offset == region.len) {
+            mutex_unlock(&io->write_mutex);
+            if (cb) cb(io, fd, 0);
+            return nwrite;
+        }
+    enqueue:
+        io_add(io, hio_handle_events, ARS_IO_WRITE);
+    }
+    if (io->write_queue.maxsize == 0) {
+        write_queue_init(&io->write_queue, 4);
+    }
+    write_queue_push_back(&io->write_queue, &region);
+    io->write_bufsize += region.len - region.offset;
+    high = __write_over_high(io);
+    mutex_unlock(&io->write_mutex);
+    if (high) __write_high_water(io);
+    return nwrite;
+write_error:
+    mutex_unlock(&io->write_mutex);
+    iobuf_unref(region.buf);
+    if (cb) cb(io, fd, io->error);
+    io_close(io);
+    return nwrite;
+}
+
 static void hio_close_event_cb(event_t* ev) {
     io_t* io = (io_t*)ev->userdata;
     uint32_t id = (uintptr_t)ev->privdata;
@@ -533,7 +1100,10 @@ int io_close(io_t* io) {
         return 0;
     }
     mutex_lock(&io->write_mutex);
-    if (!write_queue_empty(&io->write_queue) && io->error == 0 && io->close == 0) {
+    int pending = !write_queue_empty(&io->write_queue) ||
+                  (io->splice && io->upstream_io && io->upstream_io->splice_pending > 0) ||
+                  (io->splice_drain && io->splice_pending > 0);
+    if (pending && io->error == 0 && io->close == 0) {
         mutex_unlock(&io->write_mutex);
         io->close = 1;
         // hlogw("write_queue not empty, close later.");
@@ -548,6 +1118,10 @@ int io_close(io_t* io) {
     io_done(io);
     __close_cb(io);
     if (io->ssl) {
+        // NOTE: close_notify on a clean close, else the session is dropped from cache.
+        if (io->error == 0) {
+            ssl_close(io->ssl);
+        }
         ssl_free(io->ssl);
         io->ssl = NULL;
     }
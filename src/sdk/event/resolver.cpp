@@ -0,0 +1,801 @@
+#include "ars/sdk/event/resolver.hpp"
+#include <assert.h>
+#include <ctype.h>
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+#include <algorithm>
+#include <list>
+#include <random>
+#include <string>
+#include <unordered_map>
+#include <vector>
+#include "ars/sdk/event/event.hpp"
+#include "ars/sdk/memory/arena.hpp"
+#include "ars/sdk/protocol/dns.hpp"
+
+namespace ars {
+
+namespace sdk {
+
+namespace event {
+
+#define RESOLV_CONF "/etc/resolv.conf"
+#define HOSTS_FILE "/etc/hosts"
+#define DNS_PACKET_MAXLEN 512
+
+typedef struct resolve_waiter_s {
+    int id;
+    resolve_cb cb;
+    void* userdata;
+} resolve_waiter_t;
+
+typedef struct resolve_query_s {
+    std::string name;
+    uint16_t txid;
+    int tries;
+    sock_addr_t nameserver;  // the last one sent to
+    timer_t* timer;
+    std::vector<resolve_waiter_t> waiters;
+} resolve_query_t;
+
+typedef struct resolve_cache_entry_s {
+    std::string name;
+    uint64_t expire_ms;
+    int error;
+    int naddrs;
+    sock_addr_t addrs[ARS_RESOLVER_MAX_ADDRS];
+} resolve_cache_entry_t;
+
+typedef std::list<resolve_cache_entry_t> resolve_lru_t;
+
+// NOTE: names of a host expanded by the search domains, queried one by one.
+typedef struct resolve_search_s {
+    int id;   // given to the caller
+    int wid;  // waiter of the name pending
+    std::string host;
+    std::vector<std::string> names;
+    size_t next;
+    resolve_cb cb;
+    void* userdata;
+} resolve_search_t;
+
+// NOTE: holds the rrs of a full udp answer without going to ars_malloc.
+#define RESOLVER_ARENA_CHUNK (32 * 1024)
+
+struct resolver_s {
+    loop_t* loop;
+    std::vector<sock_addr_t> nameservers;
+    int timeout_ms;
+    int attempts;
+    int cache_size;
+    std::vector<std::string> search;
+    int ndots;
+    std::unordered_map<std::string, std::vector<sock_addr_t>> hosts;
+    // cache: most recently used at front
+    resolve_lru_t lru;
+    std::unordered_map<std::string, resolve_lru_t::iterator> cache;
+    // queries pending, by name for coalescing, by transaction id for answers
+    std::unordered_map<std::string, resolve_query_t*> queries;
+    std::unordered_map<uint16_t, resolve_query_t*> txids;
+    std::unordered_map<int, resolve_search_t*> searches;
+    io_t* ios[2];  // AF_INET, AF_INET6, opened on first query
+    std::mt19937 rng;
+    int next_id;
+    // answers are unpacked here, reset before each
+    Arena arena{RESOLVER_ARENA_CHUNK};
+};
+
+static void __resolver_read(io_t* io, void* buf, int readbytes);
+
+static bool __addr_equal(const sock_addr_t* a, const sock_addr_t* b) {
+    if (a->sa.sa_family != b->sa.sa_family) return false;
+    if (a->sa.sa_family == AF_INET) {
+        return a->sin.sin_port == b->sin.sin_port && a->sin.sin_addr.s_addr == b->sin.sin_addr.s_addr;
+    }
+    return a->sin6.sin6_port == b->sin6.sin6_port &&
+           memcmp(&a->sin6.sin6_addr, &b->sin6.sin6_addr, sizeof(struct in6_addr)) == 0;
+}
+
+// @return 0 if host is an ipv4/ipv6 literal
+static int __numeric_addr(const char* host, sock_addr_t* addr) {
+    memset(addr, 0, sizeof(sock_addr_t));
+    if (inet_pton(AF_INET, host, &addr->sin.sin_addr) == 1) {
+        addr->sa.sa_family = AF_INET;
+        return 0;
+    }
+    if (inet_pton(AF_INET6, host, &addr->sin6.sin6_addr) == 1) {
+        addr->sa.sa_family = AF_INET6;
+        return 0;
+    }
+    return -1;
+}
+
+// lowercase without the trailing dot.
+// @return -1 if not a valid name to query
+static int __normalize(const char* host, std::string* name) {
+    size_t len = strlen(host);
+    if (len > 0 && host[len - 1] == '.') --len;
+    if (len == 0 || len >= ARS_DNS_NAME_MAXLEN - 2) return -1;
+    name->resize(len);
+    size_t label = 0;
+    for (size_t i = 0; i < len; ++i) {
+        char c = host[i];
+        if (c == '.') {
+            if (label == 0) return -1;
+            label = 0;
+        } else if (++label > 63 || (unsigned char)c <= ' ') {
+            return -1;
+        }
+        (*name)[i] = tolower((unsigned char)c);
+    }
+    return 0;
+}
+
+// "ip", "ip:port", "[ipv6]:port" or "ipv6"
+static int __parse_nameserver(const std::string& str, sock_addr_t* addr) {
+    std::string ip = str;
+    int port = ARS_DNS_PORT;
+    if (!str.empty() && str[0] == '[') {
+        size_t end = str.find(']');
+        if (end == std::string::npos) return -1;
+        ip = str.substr(1, end - 1);
+        if (end + 1 < str.size()) {
+            if (str[end + 1] != ':') return -1;
+            port = atoi(str.c_str() + end + 2);
+        }
+    } else if (std::count(str.begin(), str.end(), ':') == 1) {
+        size_t colon = str.find(':');
+        ip = str.substr(0, colon);
+        port = atoi(str.c_str() + colon + 1);
+    }
+    if (port <= 0 || port > 65535 || __numeric_addr(ip.c_str(), addr) != 0) return -1;
+    sock_set_port(addr, port);
+    return 0;
+}
+
+static int __parse_nameservers(resolver_s* r, const char* str) {
+    const char* p = str;
+    while (*p) {
+        while (*p == ',' || isspace((unsigned char)*p)) ++p;
+        const char* begin = p;
+        while (*p && *p != ',' && !isspace((unsigned char)*p)) ++p;
+        if (p == begin) break;
+        sock_addr_t addr;
+        if (__parse_nameserver(std::string(begin, p - begin), &addr) != 0) return -1;
+        if (r->nameservers.size() < ARS_RESOLVER_MAX_NAMESERVERS) {
+            r->nameservers.push_back(addr);
+        }
+    }
+    return r->nameservers.empty() ? -1 : 0;
+}
+
+// @return -1 if a domain is not a valid name
+static int __parse_search(resolver_s* r, const char* str) {
+    r->search.clear();
+    const char* p = str;
+    while (*p) {
+        while (*p == ',' || isspace((unsigned char)*p)) ++p;
+        const char* begin = p;
+        while (*p && *p != ',' && !isspace((unsigned char)*p)) ++p;
+        if (p == begin) break;
+        std::string domain;
+        if (__normalize(std::string(begin, p - begin).c_str(), &domain) != 0) return -1;
+        if (r->search.size() < ARS_RESOLVER_MAX_SEARCH) {
+            r->search.push_back(domain);
+        }
+    }
+    return 0;
+}
+
+// nameserver, search, domain and options timeout:n attempts:n ndots:n, as res_init does,
+// what setting gives is not taken from here.
+static void __load_resolv_conf(resolver_s* r, const resolver_setting_t* setting) {
+    FILE* fp = fopen(RESOLV_CONF, "r");
+    if (fp == NULL) return;
+    char line[256];
+    char word[64];
+    char value[128];
+    while (fgets(line, sizeof(line), fp)) {
+        if (sscanf(line, "%63s %127s", word, value) != 2) continue;
+        if (strcmp(word, "nameserver") == 0) {
+            sock_addr_t addr;
+            if (setting->nameservers == NULL &&
+                r->nameservers.size() < ARS_RESOLVER_MAX_NAMESERVERS &&
+                __parse_nameserver(value, &addr) == 0) {
+                r->nameservers.push_back(addr);
+            }
+        } else if (strcmp(word, "search") == 0 || strcmp(word, "domain") == 0) {
+            // NOTE: the last search or domain line wins.
+            if (setting->search == NULL) {
+                __parse_search(r, strcmp(word, "domain") == 0 ? value : line + strlen(word));
+            }
+        } else if (strcmp(word, "options") == 0) {
+            const char* opt;
+            if ((opt = strstr(line, "timeout:")) && setting->timeout_ms == 0) {
+                r->timeout_ms = atoi(opt + 8) * 1000;
+            }
+            if ((opt = strstr(line, "attempts:")) && setting->attempts == 0) {
+                r->attempts = atoi(opt + 9);
+            }
+            if ((opt = strstr(line, "ndots:"))) {
+                r->ndots = std::min(atoi(opt + 6), 15);
+            }
+        }
+    }
+    fclose(fp);
+}
+
+// NOTE: every address of a name is kept, in file order.
+static void __load_hosts(resolver_s* r, const char* path) {
+    FILE* fp = fopen(path, "r");
+    if (fp == NULL) return;
+    char line[1024];
+    while (fgets(line, sizeof(line), fp)) {
+        char* comment = strchr(line, '#');
+        if (comment) *comment = '\0';
+        char* save = NULL;
+        char* ip = strtok_r(line, " \t\r\n", &save);
+        sock_addr_t addr;
+        if (ip == NULL || __numeric_addr(ip, &addr) != 0) continue;
+        char* host;
+        std::string name;
+        while ((host = strtok_r(NULL, " \t\r\n", &save)) != NULL) {
+            if (__normalize(host, &name) != 0) continue;
+            std::vector<sock_addr_t>& addrs = r->hosts[name];
+            if (addrs.size() < ARS_RESOLVER_MAX_ADDRS) {
+                addrs.push_back(addr);
+            }
+        }
+    }
+    fclose(fp);
+}
+
+static resolver_s* __resolver_new(loop_t* loop, const resolver_setting_t* setting) {
+    resolver_setting_t def;
+    if (setting == NULL) {
+        memset(&def, 0, sizeof(def));
+        setting = &def;
+    }
+    resolver_s* r = new resolver_s;
+    r->loop = loop;
+    r->timeout_ms = setting->timeout_ms;
+    r->attempts = setting->attempts;
+    r->cache_size = setting->cache_size ? setting->cache_size : ARS_RESOLVER_DEFAULT_CACHE_SIZE;
+    r->ndots = ARS_RESOLVER_DEFAULT_NDOTS;
+    r->ios[0] = r->ios[1] = NULL;
+    r->rng.seed(std::random_device()());
+    r->next_id = 0;
+    if ((setting->nameservers && __parse_nameservers(r, setting->nameservers) != 0) ||
+        (setting->search && __parse_search(r, setting->search) != 0)) {
+        delete r;
+        return NULL;
+    }
+    __load_resolv_conf(r, setting);
+    if (r->nameservers.empty()) {
+        // NOTE: same default as res_init
+        sock_addr_t addr;
+        __parse_nameserver("127.0.0.1", &addr);
+        r->nameservers.push_back(addr);
+    }
+    if (r->timeout_ms <= 0) r->timeout_ms = ARS_RESOLVER_DEFAULT_TIMEOUT;
+    if (r->attempts <= 0) r->attempts = ARS_RESOLVER_DEFAULT_ATTEMPTS;
+    const char* hosts = setting->hosts ? setting->hosts : HOSTS_FILE;
+    if (*hosts) {
+        __load_hosts(r, hosts);
+    }
+    return r;
+}
+
+// @param cancel call waiters with ECANCELED
+static void __resolver_free(resolver_s* r, int cancel) {
+    std::vector<resolve_waiter_t> waiters;
+    std::vector<std::string> names;
+    for (auto& it : r->queries) {
+        resolve_query_t* q = it.second;
+        // NOTE: at loop_free the loop frees timers and ios itself.
+        if (cancel && q->timer) {
+            timer_del(q->timer);
+        }
+        for (auto& w : q->waiters) {
+            waiters.push_back(w);
+            names.push_back(q->name);
+        }
+        delete q;
+    }
+    // NOTE: waiters of searches find nothing by their id once r is gone, searches are called here.
+    std::vector<resolve_waiter_t> searches;
+    std::vector<std::string> hosts;
+    for (auto& it : r->searches) {
+        resolve_search_t* search = it.second;
+        resolve_waiter_t w = {search->id, search->cb, search->userdata};
+        searches.push_back(w);
+        hosts.push_back(search->host);
+        delete search;
+    }
+    for (int i = 0; i < 2; ++i) {
+        io_t* io = r->ios[i];
+        if (io == NULL) continue;
+        io_setcb_read(io, NULL);
+        if (cancel) {
+            io_close(io);
+        }
+    }
+    loop_t* loop = r->loop;
+    delete r;
+    if (cancel) {
+        for (size_t i = 0; i < waiters.size(); ++i) {
+            waiters[i].cb(loop, names[i].c_str(), NULL, 0, ECANCELED, waiters[i].userdata);
+        }
+        for (size_t i = 0; i < searches.size(); ++i) {
+            searches[i].cb(loop, hosts[i].c_str(), NULL, 0, ECANCELED, searches[i].userdata);
+        }
+    }
+}
+
+void loop_resolver_cleanup(loop_t* loop) {
+    if (loop->resolver) {
+        __resolver_free(loop->resolver, 0);
+        loop->resolver = NULL;
+    }
+}
+
+int loop_set_resolver(loop_t* loop, const resolver_setting_t* setting) {
+    resolver_s* r = __resolver_new(loop, setting);
+    if (r == NULL) return -1;
+    resolver_s* old = loop->resolver;
+    loop->resolver = r;
+    if (old) {
+        // NOTE: ids go on, an id of old is never one of r.
+        r->next_id = old->next_id;
+        __resolver_free(old, 1);
+    }
+    return 0;
+}
+
+//-----------------cache---------------------------------------------
+// @return 0 if hit, addrs/naddrs/error filled
+static int __lookup(resolver_s* r, const std::string& name, sock_addr_t* addrs, int* naddrs, int* error) {
+    auto host = r->hosts.find(name);
+    if (host != r->hosts.end()) {
+        *naddrs = (int)host->second.size();
+        memcpy(addrs, host->second.data(), *naddrs * sizeof(sock_addr_t));
+        *error = 0;
+        return 0;
+    }
+    auto it = r->cache.find(name);
+    if (it == r->cache.end()) return -1;
+    resolve_cache_entry_t& entry = *it->second;
+    if (entry.expire_ms <= loop_now_ms(r->loop)) {
+        r->lru.erase(it->second);
+        r->cache.erase(it);
+        return -1;
+    }
+    r->lru.splice(r->lru.begin(), r->lru, it->second);
+    *naddrs = entry.naddrs;
+    memcpy(addrs, entry.addrs, entry.naddrs * sizeof(sock_addr_t));
+    *error = entry.error;
+    return 0;
+}
+
+static void __cache_put(resolver_s* r, const std::string& name, const sock_addr_t* addrs, int naddrs,
+                        int error, uint32_t ttl) {
+    if (r->cache_size <= 0 || ttl == 0) return;
+    if (ttl > ARS_RESOLVER_MAX_TTL) ttl = ARS_RESOLVER_MAX_TTL;
+    auto it = r->cache.find(name);
+    if (it != r->cache.end()) {
+        r->lru.erase(it->second);
+        r->cache.erase(it);
+    } else if ((int)r->cache.size() >= r->cache_size) {
+        r->cache.erase(r->lru.back().name);
+        r->lru.pop_back();
+    }
+    r->lru.emplace_front();
+    resolve_cache_entry_t& entry = r->lru.front();
+    entry.name = name;
+    entry.expire_ms = loop_now_ms(r->loop) + (uint64_t)ttl * 1000;
+    entry.error = error;
+    entry.naddrs = naddrs;
+    memcpy(entry.addrs, addrs, naddrs * sizeof(sock_addr_t));
+    r->cache[name] = r->lru.begin();
+}
+
+//-----------------query---------------------------------------------
+static io_t* __resolver_io(resolver_s* r, int family) {
+    int i = family == AF_INET ? 0 : 1;
+    if (r->ios[i] == NULL) {
+        int fd = socket(family, SOCK_DGRAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+        if (fd < 0) return NULL;
+        io_t* io = io_get(r->loop, fd);
+        io_setcb_read(io, __resolver_read);
+        r->ios[i] = io;
+    }
+    return r->ios[i];
+}
+
+// NOTE: stop reading while nothing pending, so it does not keep the loop active.
+static void __resolver_idle(resolver_s* r) {
+    for (int i = 0; i < 2; ++i) {
+        if (r->ios[i] && (r->ios[i]->events & ARS_IO_READ)) {
+            hio_del(r->ios[i], ARS_IO_READ);
+        }
+    }
+}
+
+static void __query_timeout(timer_t* timer);
+
+// NOTE: each try goes to the next nameserver with a new random transaction id.
+static void __query_send(resolver_s* r, resolve_query_t* q) {
+    if (q->tries > 0) {
+        r->txids.erase(q->txid);
+    }
+    std::uniform_int_distribution<int> dist(0, 0xFFFF);
+    do {
+        q->txid = (uint16_t)dist(r->rng);
+    } while (r->txids.count(q->txid));
+    r->txids[q->txid] = q;
+    q->nameserver = r->nameservers[q->tries % r->nameservers.size()];
+    ++q->tries;
+    q->timer = timer_add(r->loop, __query_timeout, r->timeout_ms, 1);
+    ars_event_set_userdata(q->timer, q);
+
+    dns_t query;
+    memset(&query, 0, sizeof(query));
+    query.hdr.transaction_id = q->txid;
+    query.hdr.qr = ARS_DNS_QUERY;
+    query.hdr.rd = 1;
+    query.hdr.nquestion = 1;
+    dns_rr_t question;
+    memset(&question, 0, sizeof(question));
+    memcpy(question.name, q->name.c_str(), q->name.size() + 1);
+    question.rtype = ARS_DNS_TYPE_A;
+    question.rclass = ARS_DNS_CLASS_IN;
+    query.questions = &question;
+    char buf[DNS_PACKET_MAXLEN];
+    int len = dns_pack(&query, buf, sizeof(buf));
+    io_t* io = __resolver_io(r, q->nameserver.sa.sa_family);
+    if (len < 0 || io == NULL) return;
+    io_read(io);
+    // NOTE: lost like a dropped datagram if it fails, the timer tries again.
+    int nsend = sendto(io->fd, buf, len, 0, &q->nameserver.sa, sock_addr_len(&q->nameserver));
+    io_count_write(io, nsend);
+}
+
+// @param ttl seconds to cache, 0: not cached
+static void __query_done(resolver_s* r, resolve_query_t* q, const sock_addr_t* addrs, int naddrs,
+                         int error, uint32_t ttl) {
+    r->queries.erase(q->name);
+    r->txids.erase(q->txid);
+    if (q->timer) {
+        timer_del(q->timer);
+    }
+    __cache_put(r, q->name, addrs, naddrs, error, ttl);
+    if (r->queries.empty()) {
+        __resolver_idle(r);
+    }
+    std::string name;
+    name.swap(q->name);
+    std::vector<resolve_waiter_t> waiters;
+    waiters.swap(q->waiters);
+    delete q;
+    // NOTE: r may be replaced by a cb, not touched from here.
+    loop_t* loop = r->loop;
+    for (auto& w : waiters) {
+        w.cb(loop, name.c_str(), error ? NULL : addrs, error ? 0 : naddrs, error, w.userdata);
+    }
+}
+
+static void __query_timeout(timer_t* timer) {
+    resolve_query_t* q = (resolve_query_t*)ars_event_userdata(timer);
+    resolver_s* r = ars_event_loop(timer)->resolver;
+    q->timer = NULL;
+    if (q->tries >= r->attempts * (int)r->nameservers.size()) {
+        __query_done(r, q, NULL, 0, ETIMEDOUT, 0);
+    } else {
+        __query_send(r, q);
+    }
+}
+
+// @return ttl of the negative answer, by SOA if any
+static uint32_t __negative_ttl(dns_t* resp) {
+    for (int i = 0; i < resp->hdr.nauthority; ++i) {
+        if (resp->authorities[i].rtype == ARS_DNS_TYPE_SOA) {
+            uint32_t ttl = resp->authorities[i].ttl;
+            return ttl < 3600 ? ttl : 3600;
+        }
+    }
+    return ARS_RESOLVER_NEGATIVE_TTL;
+}
+
+static void __resolver_read(io_t* io, void* buf, int readbytes) {
+    resolver_s* r = io->loop->resolver;
+    if (r == NULL || (io != r->ios[0] && io != r->ios[1])) return;
+    dns_t resp;
+    // NOTE: not by ArenaScope, r may be gone after the callbacks of __query_done.
+    r->arena.reset();
+    if (dns_unpack((char*)buf, readbytes, &resp, r->arena) < 0) {
+        return;
+    }
+    auto it = r->txids.find(resp.hdr.transaction_id);
+    resolve_query_t* q = it == r->txids.end() ? NULL : it->second;
+    // NOTE: only the answer from where we asked, to the name we asked.
+    if (q == NULL || resp.hdr.qr != ARS_DNS_RESPONSE || resp.hdr.nquestion != 1 ||
+        !__addr_equal((sock_addr_t*)io_peeraddr(io), &q->nameserver) ||
+        strcasecmp(resp.questions[0].name, q->name.c_str()) != 0 ||
+        resp.questions[0].rtype != ARS_DNS_TYPE_A) {
+        return;
+    }
+    sock_addr_t addrs[ARS_RESOLVER_MAX_ADDRS];
+    int naddrs = 0;
+    uint32_t ttl = ARS_RESOLVER_MAX_TTL;
+    if (resp.hdr.rcode == 0) {
+        // NOTE: CNAMEs are followed by the server, their ttl bounds the answer too.
+        for (int i = 0; i < resp.hdr.nanswer; ++i) {
+            dns_rr_t* rr = resp.answers + i;
+            if (rr->rclass != ARS_DNS_CLASS_IN) continue;
+            if (rr->rtype == ARS_DNS_TYPE_CNAME) {
+                if (rr->ttl < ttl) ttl = rr->ttl;
+            } else if (rr->rtype == ARS_DNS_TYPE_A && rr->datalen == 4 && naddrs < ARS_RESOLVER_MAX_ADDRS) {
+                memset(&addrs[naddrs], 0, sizeof(sock_addr_t));
+                addrs[naddrs].sin.sin_family = AF_INET;
+                memcpy(&addrs[naddrs].sin.sin_addr, rr->data, 4);
+                ++naddrs;
+                if (rr->ttl < ttl) ttl = rr->ttl;
+            }
+        }
+        if (naddrs > 0) {
+            __query_done(r, q, addrs, naddrs, 0, ttl);
+            return;
+        }
+    }
+    // NOTE: truncated without answers, no tcp fallback, treated as server failure.
+    if ((resp.hdr.rcode == 0 && !resp.hdr.tc) || resp.hdr.rcode == 3) {
+        // no data or NXDOMAIN
+        ttl = __negative_ttl(&resp);
+        __query_done(r, q, NULL, 0, ENOENT, ttl);
+        return;
+    }
+    // SERVFAIL, REFUSED...: the next nameserver at once
+    if (q->timer) {
+        timer_del(q->timer);
+        q->timer = NULL;
+    }
+    if (q->tries >= r->attempts * (int)r->nameservers.size()) {
+        __query_done(r, q, NULL, 0, EAGAIN, 0);
+    } else {
+        __query_send(r, q);
+    }
+}
+
+// @return 0 if answered in place, addrs/naddrs/error filled and cb not called,
+// else the waiter id of the query, cb called once answered.
+static int __resolve_name(resolver_s* r, const std::string& name, resolve_cb cb, void* userdata,
+                          sock_addr_t* addrs, int* naddrs, int* error) {
+    if (__lookup(r, name, addrs, naddrs, error) == 0) {
+        return 0;
+    }
+    if (++r->next_id <= 0) r->next_id = 1;
+    resolve_waiter_t waiter = {r->next_id, cb, userdata};
+    auto it = r->queries.find(name);
+    if (it != r->queries.end()) {
+        it->second->waiters.push_back(waiter);
+        return waiter.id;
+    }
+    resolve_query_t* q = new resolve_query_t;
+    q->name = name;
+    q->txid = 0;
+    q->tries = 0;
+    q->timer = NULL;
+    q->waiters.push_back(waiter);
+    r->queries[name] = q;
+    __query_send(r, q);
+    return waiter.id;
+}
+
+// @return -1 if host is not a valid name
+static int __search_names(resolver_s* r, const char* host, std::vector<std::string>* names) {
+    std::string name;
+    if (__normalize(host, &name) != 0) return -1;
+    if (r->search.empty() || host[strlen(host) - 1] == '.' || r->hosts.count(name)) {
+        names->push_back(name);
+        return 0;
+    }
+    int ndots = (int)std::count(name.begin(), name.end(), '.');
+    if (ndots >= r->ndots) names->push_back(name);
+    for (const std::string& domain : r->search) {
+        std::string full = name + "." + domain;
+        if (full.size() < ARS_DNS_NAME_MAXLEN - 2) names->push_back(full);
+    }
+    if (ndots < r->ndots) names->push_back(name);
+    return 0;
+}
+
+static void __search_done(loop_t* loop, resolver_s* r, resolve_search_t* search,
+                          const sock_addr_t* addrs, int naddrs, int error) {
+    r->searches.erase(search->id);
+    resolve_cb cb = search->cb;
+    void* userdata = search->userdata;
+    std::string host;
+    host.swap(search->host);
+    delete search;
+    cb(loop, host.c_str(), error ? NULL : addrs, error ? 0 : naddrs, error, userdata);
+}
+
+static void __search_cb(loop_t* loop, const char* name, const sock_addr_t* addrs, int naddrs,
+                        int error, void* userdata);
+
+// NOTE: names answered in place are gone through here, stops at the first one to query.
+// @return 0 if done and cb called
+static int __search_next(loop_t* loop, resolver_s* r, resolve_search_t* search) {
+    sock_addr_t addrs[ARS_RESOLVER_MAX_ADDRS];
+    int naddrs = 0;
+    int error = ENOENT;
+    while (search->next < search->names.size()) {
+        const std::string& name = search->names[search->next++];
+        int wid = __resolve_name(r, name, __search_cb, (void*)(intptr_t)search->id, addrs, &naddrs, &error);
+        if (wid > 0) {
+            search->wid = wid;
+            return wid;
+        }
+        if (error != ENOENT) break;
+    }
+    __search_done(loop, r, search, addrs, naddrs, error);
+    return 0;
+}
+
+// NOTE: by id, the search may be canceled or its resolver replaced meanwhile.
+static void __search_cb(loop_t* loop, const char* name, const sock_addr_t* addrs, int naddrs,
+                        int error, void* userdata) {
+    resolver_s* r = loop->resolver;
+    if (r == NULL) return;
+    auto it = r->searches.find((int)(intptr_t)userdata);
+    if (it == r->searches.end()) return;
+    resolve_search_t* search = it->second;
+    if (error == ENOENT && search->next < search->names.size()) {
+        __search_next(loop, r, search);
+        return;
+    }
+    __search_done(loop, r, search, addrs, naddrs, error);
+}
+
+int loop_resolve(loop_t* loop, const char* host, resolve_cb cb, void* userdata) {
+    if (host == NULL || cb == NULL) return -1;
+    sock_addr_t addrs[ARS_RESOLVER_MAX_ADDRS];
+    if (__numeric_addr(host, &addrs[0]) == 0) {
+        cb(loop, host, addrs, 1, 0, userdata);
+        return 0;
+    }
+    if (loop->resolver == NULL && loop_set_resolver(loop, NULL) != 0) return -1;
+    resolver_s* r = loop->resolver;
+    std::vector<std::string> names;
+    if (__search_names(r, host, &names) != 0) return -1;
+    if (names.size() == 1) {
+        int naddrs = 0;
+        int error = 0;
+        int id = __resolve_name(r, names[0], cb, userdata, addrs, &naddrs, &error);
+        if (id == 0) {
+            cb(loop, host, error ? NULL : addrs, naddrs, error, userdata);
+        }
+        return id;
+    }
+    resolve_search_t* search = new resolve_search_t;
+    if (++r->next_id <= 0) r->next_id = 1;
+    search->id = r->next_id;
+    search->wid = 0;
+    search->host = host;
+    search->names.swap(names);
+    search->next = 0;
+    search->cb = cb;
+    search->userdata = userdata;
+    r->searches[search->id] = search;
+    int id = search->id;
+    return __search_next(loop, r, search) ? id : 0;
+}
+
+static void __waiter_cancel(resolver_s* r, int id) {
+    for (auto& it : r->queries) {
+        std::vector<resolve_waiter_t>& waiters = it.second->waiters;
+        for (auto w = waiters.begin(); w != waiters.end(); ++w) {
+            if (w->id == id) {
+                waiters.erase(w);
+                return;
+            }
+        }
+    }
+}
+
+void loop_resolve_cancel(loop_t* loop, int id) {
+    resolver_s* r = loop->resolver;
+    if (r == NULL || id <= 0) return;
+    auto it = r->searches.find(id);
+    if (it != r->searches.end()) {
+        resolve_search_t* search = it->second;
+        r->searches.erase(it);
+        __waiter_cancel(r, search->wid);
+        delete search;
+        return;
+    }
+    __waiter_cancel(r, id);
+}
+
+//-----------------connect---------------------------------------------
+// NOTE: the io is found again by fd and id, it may be closed before resolved.
+static void __connect_resolved(loop_t* loop, const char* host, const sock_addr_t* addrs, int naddrs,
+                               int error, void* userdata) {
+    uint64_t key = (uint64_t)(uintptr_t)userdata;
+    int fd = (int)(key & 0xFFFFFFFF);
+    uint32_t id = (uint32_t)(key >> 32);
+    if (fd >= (int)loop->ios.maxsize) return;
+    io_t* io = loop->ios.ptr[fd];
+    if (io == NULL || io->id != id || io->closed || !io->resolving) return;
+    io->resolving = 0;
+    const sock_addr_t* addr = NULL;
+    for (int i = 0; i < naddrs; ++i) {
+        if (addrs[i].sa.sa_family == io->peeraddr->sa_family) {
+            addr = addrs + i;
+            break;
+        }
+    }
+    if (addr == NULL) {
+        io->error = error ? error : ENOENT;
+        io_close(io);
+        return;
+    }
+    sock_addr_t peeraddr = *addr;
+    sock_set_port(&peeraddr, sock_addr_port((sock_addr_t*)io->peeraddr));
+    io_set_peeraddr(io, &peeraddr.sa, sock_addr_len(&peeraddr));
+    // NOTE: not yet if ev_connect is still to come.
+    if (io->connect_pending) {
+        io->connect_pending = 0;
+        io_connect(io);
+    }
+}
+
+io_t* ev_create_async(loop_t* loop, const char* host, int port) {
+    sock_addr_t peeraddr;
+    sock_addr_t addrs[ARS_RESOLVER_MAX_ADDRS];
+    int naddrs = 0;
+    int error = 0;
+    std::vector<std::string> names;
+    int known = __numeric_addr(host, &peeraddr) == 0;
+    if (!known) {
+        if (loop->resolver == NULL && loop_set_resolver(loop, NULL) != 0) return NULL;
+        if (__search_names(loop->resolver, host, &names) != 0) return NULL;
+        // NOTE: a search goes by loop_resolve, which may answer before ev_connect too.
+        if (names.size() == 1 && __lookup(loop->resolver, names[0], addrs, &naddrs, &error) == 0) {
+            if (error) return NULL;
+            peeraddr = addrs[0];
+            known = 1;
+        }
+    }
+    if (!known) {
+        // NOTE: answers by dns are ipv4
+        memset(&peeraddr, 0, sizeof(peeraddr));
+        peeraddr.sa.sa_family = AF_INET;
+    }
+    sock_set_port(&peeraddr, port);
+    int connfd = socket(peeraddr.sa.sa_family, SOCK_STREAM, 0);
+    if (connfd < 0) {
+        perror("socket");
+        return NULL;
+    }
+    io_t* io = io_get(loop, connfd);
+    assert(io != NULL);
+    io_set_peeraddr(io, &peeraddr.sa, sock_addr_len(&peeraddr));
+    if (known) return io;
+    io->resolving = 1;
+    uint64_t key = ((uint64_t)io->id << 32) | (uint32_t)connfd;
+    if (loop_resolve(loop, host, __connect_resolved, (void*)(uintptr_t)key) < 0) {
+        io_close(io);
+        return NULL;
+    }
+    // NOTE: every name of the search answered in place and failed, io closed by then.
+    if (io->closed) return NULL;
+    return io;
+}
+
+}  // namespace event
+
+}  // namespace sdk
+
+}  // namespace ars
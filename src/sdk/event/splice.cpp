@@ -0,0 +1,211 @@
+#include "ars/sdk/event/event.hpp"
+#include "ars/sdk/net/sock.hpp"
+
+#ifdef ARS_OS_LINUX
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+namespace ars {
+
+namespace sdk {
+
+namespace event {
+
+#ifdef ARS_OS_LINUX
+
+// NOTE: default pipe capacity, splice more than it just returns less.
+#define SPLICE_CHUNK (64 * 1024)
+#define SPLICE_FLAGS (SPLICE_F_MOVE | SPLICE_F_NONBLOCK)
+
+static int __splice_pipe_get(io_t* io) {
+    loop_t* loop = io->loop;
+    if (loop->nsplice_pipes > 0) {
+        --loop->nsplice_pipes;
+        io->splice_pipe[0] = loop->splice_pipes[loop->nsplice_pipes][0];
+        io->splice_pipe[1] = loop->splice_pipes[loop->nsplice_pipes][1];
+        return 0;
+    }
+    return pipe2(io->splice_pipe, O_NONBLOCK | O_CLOEXEC);
+}
+
+// NOTE: only an empty pipe goes back to the pool.
+static void __splice_pipe_put(io_t* io) {
+    loop_t* loop = io->loop;
+    if (io->splice_pipe[0] == -1) return;
+    if (io->splice_pending == 0 && loop->nsplice_pipes < ARS_SPLICE_PIPE_POOL_SIZE) {
+        loop->splice_pipes[loop->nsplice_pipes][0] = io->splice_pipe[0];
+        loop->splice_pipes[loop->nsplice_pipes][1] = io->splice_pipe[1];
+        ++loop->nsplice_pipes;
+    } else {
+        close(io->splice_pipe[0]);
+        close(io->splice_pipe[1]);
+    }
+    io->splice_pipe[0] = io->splice_pipe[1] = -1;
+    io->splice_pending = 0;
+}
+
+static void __splice_keepalive(io_t* io) {
+    if (io->keepalive_timer) {
+        timer_reset(io->keepalive_timer);
+    }
+}
+
+// move bytes of src's pipe into dst.
+// @return 0 if the pipe is drained, 1 if dst is full, -1 if dst error
+static int __splice_flush(io_t* src, io_t* dst) {
+    while (src->splice_pending > 0) {
+        ssize_t n = splice(src->splice_pipe[0], NULL, dst->fd, NULL, src->splice_pending, SPLICE_FLAGS);
+        if (n < 0) {
+            int err = socket_errno();
+            io_count_write(dst, -1);
+            if (err == EAGAIN) return 1;
+            if (err == EINTR) continue;
+            dst->error = err;
+            return -1;
+        }
+        io_count_write(dst, n);
+        src->splice_pending -= n;
+        __splice_keepalive(dst);
+    }
+    __splice_pipe_put(src);
+    return 0;
+}
+
+void io_splice_read(io_t* io) {
+    io_t* dst = io->upstream_io;
+    if (dst == NULL || dst->closed) {
+        io_close(io);
+        return;
+    }
+    for (;;) {
+        if (io->splice_pipe[0] == -1 && __splice_pipe_get(io) != 0) {
+            io->error = socket_errno();
+            io_close(io);
+            return;
+        }
+        ssize_t n = splice(io->fd, NULL, io->splice_pipe[1], NULL, SPLICE_CHUNK, SPLICE_FLAGS);
+        int err = socket_errno();
+        io_count_read(io, n);
+        if (n < 0) {
+            if (err == EINTR) continue;
+            if (io->splice_pending == 0) {
+                __splice_pipe_put(io);
+            }
+            if (err == EAGAIN) return;
+            io->error = err;
+            io_close(io);
+            return;
+        }
+        if (n == 0) {
+            // NOTE: pipe is empty here, else reading was stopped.
+            __splice_pipe_put(io);
+            io_close(io);
+            return;
+        }
+        io->splice_pending += n;
+        __splice_keepalive(io);
+        // NOTE: keep order with bytes queued by io_write.
+        mutex_lock(&dst->write_mutex);
+        int queued = !write_queue_empty(&dst->write_queue);
+        mutex_unlock(&dst->write_mutex);
+        int ret = queued ? 1 : __splice_flush(io, dst);
+        if (ret < 0) {
+            io_close(dst);
+            return;
+        }
+        if (ret > 0) {
+            // NOTE: backpressure, stop reading until dst drains the pipe.
+            hio_del(io, ARS_IO_READ);
+            io_wait_write(dst);
+            return;
+        }
+    }
+}
+
+int io_splice_write(io_t* io) {
+    io_t* src = io->splice_drain ? io : io->upstream_io;
+    if (src == NULL || src->closed || src->splice_pending == 0) return 0;
+    int ret = __splice_flush(src, io);
+    if (ret < 0) {
+        io_close(io);
+        return -1;
+    }
+    if (ret > 0) {
+        io_wait_write(io);
+        return 1;
+    }
+    if (src == io) {
+        io->splice_drain = 0;
+        return 0;
+    }
+    io_read(src);
+    return 0;
+}
+
+// NOTE: io is closing with bytes in its pipe, e.g. closed by keepalive timeout or by a
+// write error of the other way, upstream_io takes the pipe over and drains it into itself,
+// io_close of upstream_io waits for it like for write_queue.
+// @return 0 if taken over
+static int __splice_handover(io_t* io) {
+    io_t* dst = io->upstream_io;
+    // NOTE: not while loop_free frees all ios, dst may be freed already.
+    if (io->splice_pending == 0 || io->loop->status == LOOP_STATUS_STOP) {
+        return -1;
+    }
+    if (dst == NULL || dst->closed || !dst->splice || dst->error) {
+        return -1;
+    }
+    // NOTE: bytes of dst for io go nowhere now.
+    __splice_pipe_put(dst);
+    dst->splice_pipe[0] = io->splice_pipe[0];
+    dst->splice_pipe[1] = io->splice_pipe[1];
+    dst->splice_pending = io->splice_pending;
+    dst->splice_drain = 1;
+    io->splice_pipe[0] = io->splice_pipe[1] = -1;
+    io->splice_pending = 0;
+    // NOTE: io may be reused by another fd, dst stops reading and forgets it.
+    dst->upstream_io = NULL;
+    hio_del(dst, ARS_IO_READ);
+    io_wait_write(dst);
+    return 0;
+}
+
+void io_splice_free(io_t* io) {
+    if (__splice_handover(io) != 0) {
+        __splice_pipe_put(io);
+    }
+}
+
+void loop_splice_cleanup(loop_t* loop) {
+    for (int i = 0; i < loop->nsplice_pipes; ++i) {
+        close(loop->splice_pipes[i][0]);
+        close(loop->splice_pipes[i][1]);
+    }
+    loop->nsplice_pipes = 0;
+}
+
+void io_setup_splice(io_t* io1, io_t* io2) {
+    io_setup_upstream(io1, io2);
+    // NOTE: SSL must be decrypted in user space, keep the copy path.
+    if (io1->io_type == IO_TYPE_TCP && io2->io_type == IO_TYPE_TCP) {
+        io1->splice = io2->splice = 1;
+    }
+}
+
+#else
+
+void io_splice_read(io_t* io) {}
+int io_splice_write(io_t* io) { return 0; }
+void io_splice_free(io_t* io) {}
+void loop_splice_cleanup(loop_t* loop) {}
+
+void io_setup_splice(io_t* io1, io_t* io2) { io_setup_upstream(io1, io2); }
+
+#endif
+
+}  // namespace event
+
+}  // namespace sdk
+
+}  // namespace ars
@@ -0,0 +1,226 @@
+#include "ars/sdk/event/event.hpp"
+
+namespace ars {
+
+namespace sdk {
+
+namespace event {
+
+// NOTE: unpack_buf starts at this size, then doubles up to package_max_length.
+#define UNPACK_BUF_INIT_SIZE 4096
+
+static inline size_t __max_length(const unpack_setting_t* s) {
+    return s->package_max_length ? s->package_max_length : ARS_DEFAULT_PACKAGE_MAX_LENGTH;
+}
+
+static inline size_t __head_length(const unpack_setting_t* s) {
+    return s->length_field_offset + s->length_field_bytes;
+}
+
+// fixed length or length field.
+// @return frame length, 0 if more bytes needed to know it, -1 if invalid
+static int64_t __frame_length(const unpack_setting_t* s, const uint8_t* p, size_t n) {
+    if (s->mode == UNPACK_BY_FIXED_LENGTH) {
+        return s->fixed_length;
+    }
+    if (n < __head_length(s)) return 0;
+    const uint8_t* field = p + s->length_field_offset;
+    uint64_t value = 0;
+    if (s->length_field_coding == ENCODE_BY_LITTLE_ENDIAN) {
+        for (int i = s->length_field_bytes - 1; i >= 0; --i) {
+            value = (value << 8) | field[i];
+        }
+    } else {
+        for (int i = 0; i < s->length_field_bytes; ++i) {
+            value = (value << 8) | field[i];
+        }
+    }
+    if (value > __max_length(s)) return -1;
+    int64_t len = (int64_t)s->body_offset + (int64_t)value + s->length_adjustment;
+    if (len < (int64_t)s->body_offset || len <= 0) return -1;
+    return len;
+}
+
+static const uint8_t* __find_delimiter(const unpack_setting_t* s, const uint8_t* p, size_t n) {
+    size_t d = s->delimiter_bytes;
+    const uint8_t* end = p + n;
+    while ((size_t)(end - p) >= d) {
+        p = (const uint8_t*)memchr(p, s->delimiter[0], end - p - d + 1);
+        if (p == NULL) return NULL;
+        if (memcmp(p, s->delimiter, d) == 0) return p;
+        ++p;
+    }
+    return NULL;
+}
+
+// NOTE: head holds no delimiter, it may begin in head and end in p.
+// @return bytes of p up to the end of frame, 0 if not found
+static size_t __delimiter_end(const unpack_setting_t* s, const uint8_t* head, size_t have,
+                              const uint8_t* p, size_t n) {
+    size_t d = s->delimiter_bytes;
+    for (size_t k = 1; k < d && k <= n; ++k) {
+        if (have >= d - k && memcmp(head + have - (d - k), s->delimiter, d - k) == 0 &&
+            memcmp(p, s->delimiter + d - k, k) == 0) {
+            return k;
+        }
+    }
+    const uint8_t* q = __find_delimiter(s, p, n);
+    return q ? q - p + d : 0;
+}
+
+// @param hint expected frame length, 0 if unknown
+static int __unpack_append(io_t* io, const uint8_t* p, size_t n, size_t hint) {
+    size_t need = io->unpack_len + n;
+    if (need > io->unpack_buf.len) {
+        size_t size = io->unpack_buf.len ? io->unpack_buf.len * 2 : UNPACK_BUF_INIT_SIZE;
+        if (size < need) size = need;
+        if (size < hint) size = hint;
+        size_t max = __max_length(io->unpack_setting);
+        if (size > max) size = max;
+        char* base = (char*)ars_realloc(io->unpack_buf.base, size, io->unpack_buf.len);
+        if (base == NULL) return -1;
+        io->unpack_buf.base = base;
+        io->unpack_buf.len = size;
+    }
+    memcpy(io->unpack_buf.base + io->unpack_len, p, n);
+    io->unpack_len = need;
+    return 0;
+}
+
+// @return -1 if io closed or unpack_setting changed by read_cb
+static int __unpack_deliver(io_t* io, unpack_setting_t* s, void* frame, size_t len, int copied) {
+    // NOTE: a copied frame is not in the lent readbuf, io_retain_readbuf returns NULL then.
+    iobuf_t* lent = io->lent_readbuf;
+    if (copied) io->lent_readbuf = NULL;
+    if (io->read_cb) {
+        io->read_cb(io, frame, len);
+    }
+    if (copied) io->lent_readbuf = lent;
+    return (io->closed || io->unpack_setting != s) ? -1 : 0;
+}
+
+void io_unpack(io_t* io, void* buf, int readbytes) {
+    unpack_setting_t* s = io->unpack_setting;
+    const uint8_t* p = (const uint8_t*)buf;
+    size_t n = readbytes;
+    size_t max = __max_length(s);
+    int64_t flen = 0;
+
+    // complete the frame split over reads, copy no more than it needs.
+    while (io->unpack_len > 0 && n > 0) {
+        const uint8_t* head = (const uint8_t*)io->unpack_buf.base;
+        size_t have = io->unpack_len;
+        size_t copy = n;
+        int complete = 0;
+        flen = 0;
+        if (s->mode == UNPACK_BY_DELIMITER) {
+            size_t end = __delimiter_end(s, head, have, p, n);
+            if (end) {
+                copy = end;
+                complete = 1;
+            }
+        } else {
+            flen = __frame_length(s, head, have);
+            if (flen < 0 || (size_t)flen > max) goto error;
+            if (flen == 0) {
+                copy = __head_length(s) - have;
+            } else {
+                copy = flen - have;
+                complete = 1;
+            }
+            if (copy > n) {
+                copy = n;
+                complete = 0;
+            }
+        }
+        if (have + copy > max) goto error;
+        if (__unpack_append(io, p, copy, flen) != 0) goto error;
+        p += copy;
+        n -= copy;
+        if (complete) {
+            size_t len = io->unpack_len;
+            io->unpack_len = 0;
+            if (__unpack_deliver(io, s, io->unpack_buf.base, len, 1) != 0) goto stopped;
+        }
+    }
+
+    // frames whole in buf are passed in place.
+    while (n > 0) {
+        if (s->mode == UNPACK_BY_DELIMITER) {
+            const uint8_t* q = __find_delimiter(s, p, n);
+            if (q == NULL) {
+                if (n > max) goto error;
+                flen = 0;
+                break;
+            }
+            flen = q - p + s->delimiter_bytes;
+        } else {
+            flen = __frame_length(s, p, n);
+            if (flen < 0 || (size_t)flen > max) goto error;
+            if (flen == 0 || (size_t)flen > n) break;
+        }
+        const uint8_t* frame = p;
+        p += flen;
+        n -= flen;
+        if (__unpack_deliver(io, s, (void*)frame, flen, 0) != 0) goto stopped;
+    }
+    if (n > 0 && __unpack_append(io, p, n, flen) != 0) goto error;
+    return;
+
+stopped:
+    // NOTE: read_cb changed the setting, the rest goes by the new one.
+    if (io->closed || n == 0) return;
+    if (io->unpack_setting) {
+        io_unpack(io, (void*)p, n);
+    } else if (io->read_cb) {
+        io->read_cb(io, (void*)p, n);
+    }
+    return;
+error:
+    io->error = EMSGSIZE;
+    io_close(io);
+}
+
+void io_unpack_free(io_t* io) {
+    if (io->unpack_buf.base) {
+        ARS_FREE(io->unpack_buf.base);
+    }
+    io->unpack_buf.len = 0;
+    io->unpack_len = 0;
+}
+
+int io_set_unpack(io_t* io, unpack_setting_t* setting) {
+    if (setting == NULL) return -1;
+    switch (setting->mode) {
+    case UNPACK_BY_FIXED_LENGTH:
+        if (setting->fixed_length == 0 || setting->fixed_length > __max_length(setting)) return -1;
+        break;
+    case UNPACK_BY_DELIMITER:
+        if (setting->delimiter_bytes == 0 ||
+            setting->delimiter_bytes > ARS_PACKAGE_MAX_DELIMITER_BYTES) return -1;
+        break;
+    case UNPACK_BY_LENGTH_FIELD:
+        if (setting->length_field_bytes == 0 || setting->length_field_bytes > 8 ||
+            setting->body_offset < __head_length(setting)) return -1;
+        if (setting->length_field_coding != ENCODE_BY_LITTLE_ENDIAN &&
+            setting->length_field_coding != ENCODE_BY_BIG_ENDIAN) return -1;
+        break;
+    default:
+        return -1;
+    }
+    // NOTE: a frame already split over reads goes on by the new setting.
+    io->unpack_setting = setting;
+    return 0;
+}
+
+void io_unset_unpack(io_t* io) {
+    // NOTE: keep unpack_buf, read_cb may still hold a frame in it, io_done frees it.
+    io->unpack_setting = NULL;
+    io->unpack_len = 0;
+}
+
+}  // namespace event
+
+}  // namespace sdk
+
+}  // namespace ars
@@ -0,0 +1,589 @@
+#include "ars/sdk/event/iowatcher.hpp"
+
+#ifdef EVENT_IO_URING
+#include "ars/sdk/ds/array.hpp"
+#include "ars/sdk/event/event.hpp"
+#include "ars/sdk/macros/defs.hpp"
+#include "ars/sdk/memory/mem.hpp"
+
+#include <errno.h>
+#include <poll.h>
+#include <signal.h>
+#include <stdio.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#include <linux/io_uring.h>
+
+#ifndef __NR_io_uring_setup
+#define __NR_io_uring_setup 425
+#endif
+#ifndef __NR_io_uring_enter
+#define __NR_io_uring_enter 426
+#endif
+
+namespace ars {
+
+namespace sdk {
+
+namespace event {
+
+/*
+ * io_uring iowatcher:
+ * - interest changes (io_add/hio_del) only mark fd dirty, the poll/recv/cancel sqes
+ *   are staged at iowatcher_poll_events and submitted together with the wait,
+ *   so one io_uring_enter per loop iteration, no epoll_ctl at all.
+ * - poll is oneshot (level-triggered like epoll LT), rearmed in the same batch.
+ * - plain tcp read is completed in kernel by IORING_OP_RECV into provided buffers,
+ *   nio_read takes the data from io->hovlp without read(2).
+ * - accept/connect/write/ssl/udp are still readiness based.
+ */
+
+#define URING_SQ_ENTRIES 256
+#define URING_CQ_ENTRIES 4096
+#define URING_FDS_INIT_SIZE 64
+
+// provided buffers for IORING_OP_RECV
+#define URING_RBUF_GROUP 1
+#define URING_RBUF_COUNT 256
+#define URING_RBUF_SIZE ARS_LOOP_READ_BUFSIZE
+
+// user_data: | op:8 | gen:24 | fd:32 |
+#define URING_OP_POLL 1
+#define URING_OP_RECV 2
+#define URING_OP_CTRL 3  // poll_remove, async_cancel
+#define URING_OP_PBUF 4  // provide_buffers
+#define URING_GEN_MASK 0xFFFFFF
+#define URING_UDATA(op, gen, fd) \
+    (((uint64_t)(op) << 56) | ((uint64_t)((gen)&URING_GEN_MASK) << 32) | (uint32_t)(fd))
+#define URING_UDATA_OP(ud) ((int)((ud) >> 56))
+#define URING_UDATA_GEN(ud) ((uint32_t)((ud) >> 32) & URING_GEN_MASK)
+#define URING_UDATA_FD(ud) ((int)(uint32_t)(ud))
+
+typedef struct uring_slot_s {
+    uint32_t io_id;  // owner of armed ops, io->id
+    uint32_t pgen;   // generation of poll
+    uint32_t rgen;   // generation of recv
+    uint32_t pmask;  // armed poll mask, 0 if not armed
+    unsigned recv_armed : 1;
+    unsigned recv_cancel : 1;
+    unsigned nobufs : 1;  // no provided buffer, poll once then read(2)
+    unsigned has_comp : 1;
+    unsigned dirty : 1;
+    unsigned ready : 1;
+    int bid;        // provided buffer held by comp, -1 if none
+    iocomp_t comp;  // completed recv, pass to nio_read by io->hovlp
+} uring_slot_t;
+
+ARS_ARRAY_DECL(int, uring_fds);
+
+typedef struct uring_ctx_s {
+    int ringfd;
+    // sq
+    unsigned* sq_head;
+    unsigned* sq_tail;
+    unsigned* sq_array;
+    unsigned sq_mask;
+    unsigned sq_entries;
+    unsigned sq_staged;  // local tail, published at submit
+    struct io_uring_sqe* sqes;
+    // cq
+    unsigned* cq_head;
+    unsigned* cq_tail;
+    unsigned cq_mask;
+    struct io_uring_cqe* cqes;
+    // mmap
+    void* sq_ring;
+    size_t sq_ring_sz;
+    void* cq_ring;
+    size_t cq_ring_sz;
+    size_t sqes_sz;
+    // fd => slot
+    uring_slot_t** slots;
+    int nslots;
+    struct uring_fds dirty;
+    struct uring_fds ready;
+    int ninflight;  // poll/recv waiting for cqe
+    // provided buffers
+    char* rbufs;
+    int ring_recv;
+} uring_ctx_t;
+
+static int __sys_uring_setup(unsigned entries, struct io_uring_params* p) {
+    return (int)syscall(__NR_io_uring_setup, entries, p);
+}
+
+static int __sys_uring_enter(int fd, unsigned to_submit, unsigned min_complete, unsigned flags,
+                             void* arg, size_t argsz) {
+    return (int)syscall(__NR_io_uring_enter, fd, to_submit, min_complete, flags, arg, argsz);
+}
+
+static unsigned uring_publish(uring_ctx_t* ctx) {
+    __atomic_store_n(ctx->sq_tail, ctx->sq_staged, __ATOMIC_RELEASE);
+    return ctx->sq_staged - __atomic_load_n(ctx->sq_head, __ATOMIC_ACQUIRE);
+}
+
+static struct io_uring_sqe* uring_get_sqe(uring_ctx_t* ctx) {
+    unsigned head = __atomic_load_n(ctx->sq_head, __ATOMIC_ACQUIRE);
+    if (ctx->sq_staged - head >= ctx->sq_entries) {
+        // NOTE: sq full, submit what we have without waiting.
+        // EBUSY if the cq overflowed, the caller retries after the cq is reaped.
+        if (__sys_uring_enter(ctx->ringfd, uring_publish(ctx), 0, 0, NULL, 0) < 0) {
+            return NULL;
+        }
+        head = __atomic_load_n(ctx->sq_head, __ATOMIC_ACQUIRE);
+        if (ctx->sq_staged - head >= ctx->sq_entries) {
+            return NULL;
+        }
+    }
+    unsigned idx = ctx->sq_staged & ctx->sq_mask;
+    struct io_uring_sqe* sqe = ctx->sqes + idx;
+    memset(sqe, 0, sizeof(*sqe));
+    ctx->sq_array[idx] = idx;
+    ctx->sq_staged++;
+    return sqe;
+}
+
+// NOTE: the sqe helpers return -1 if no sqe, slot state is left as it was,
+// so the slot can be marked dirty and synced again.
+static int uring_provide_buffers(uring_ctx_t* ctx, int bid, int nbufs) {
+    struct io_uring_sqe* sqe = uring_get_sqe(ctx);
+    if (sqe == NULL) return -1;
+    sqe->opcode = IORING_OP_PROVIDE_BUFFERS;
+    sqe->fd = nbufs;
+    sqe->addr = (uint64_t)(uintptr_t)(ctx->rbufs + (size_t)bid * URING_RBUF_SIZE);
+    sqe->len = URING_RBUF_SIZE;
+    sqe->off = bid;
+    sqe->buf_group = URING_RBUF_GROUP;
+    sqe->user_data = URING_UDATA(URING_OP_PBUF, 0, 0);
+    return 0;
+}
+
+static int uring_poll_add(uring_ctx_t* ctx, uring_slot_t* slot, int fd, uint32_t mask) {
+    struct io_uring_sqe* sqe = uring_get_sqe(ctx);
+    if (sqe == NULL) return -1;
+    sqe->opcode = IORING_OP_POLL_ADD;
+    sqe->fd = fd;
+    sqe->poll32_events = mask;
+    sqe->user_data = URING_UDATA(URING_OP_POLL, slot->pgen, fd);
+    slot->pmask = mask;
+    ctx->ninflight++;
+    return 0;
+}
+
+static int uring_poll_remove(uring_ctx_t* ctx, uring_slot_t* slot, int fd) {
+    struct io_uring_sqe* sqe = uring_get_sqe(ctx);
+    if (sqe == NULL) return -1;
+    sqe->opcode = IORING_OP_POLL_REMOVE;
+    sqe->fd = -1;
+    sqe->addr = URING_UDATA(URING_OP_POLL, slot->pgen, fd);
+    sqe->user_data = URING_UDATA(URING_OP_CTRL, 0, fd);
+    slot->pmask = 0;
+    return 0;
+}
+
+static int uring_recv(uring_ctx_t* ctx, uring_slot_t* slot, int fd) {
+    struct io_uring_sqe* sqe = uring_get_sqe(ctx);
+    if (sqe == NULL) return -1;
+    sqe->opcode = IORING_OP_RECV;
+    sqe->flags = IOSQE_BUFFER_SELECT;
+    sqe->fd = fd;
+    sqe->len = URING_RBUF_SIZE;
+    sqe->buf_group = URING_RBUF_GROUP;
+    sqe->user_data = URING_UDATA(URING_OP_RECV, slot->rgen, fd);
+    slot->recv_armed = 1;
+    ctx->ninflight++;
+    return 0;
+}
+
+static int uring_recv_cancel(uring_ctx_t* ctx, uring_slot_t* slot, int fd) {
+    struct io_uring_sqe* sqe = uring_get_sqe(ctx);
+    if (sqe == NULL) return -1;
+    sqe->opcode = IORING_OP_ASYNC_CANCEL;
+    sqe->fd = -1;
+    sqe->addr = URING_UDATA(URING_OP_RECV, slot->rgen, fd);
+    sqe->user_data = URING_UDATA(URING_OP_CTRL, 0, fd);
+    slot->recv_cancel = 1;
+    return 0;
+}
+
+// NOTE: slot->bid is kept if it cannot be given back now, uring_sync_slot retries.
+static int uring_drop_comp(uring_ctx_t* ctx, uring_slot_t* slot) {
+    slot->has_comp = 0;
+    if (slot->bid >= 0) {
+        if (uring_provide_buffers(ctx, slot->bid, 1) != 0) return -1;
+        slot->bid = -1;
+    }
+    return 0;
+}
+
+static uring_slot_t* uring_slot(uring_ctx_t* ctx, int fd) {
+    if (fd >= ctx->nslots) {
+        int newsize = ctx->nslots ? ctx->nslots : URING_FDS_INIT_SIZE;
+        while (newsize <= fd) newsize *= 2;
+        ctx->slots = (uring_slot_t**)ars_realloc(ctx->slots, sizeof(uring_slot_t*) * newsize,
+                                                 sizeof(uring_slot_t*) * ctx->nslots);
+        ctx->nslots = newsize;
+    }
+    uring_slot_t* slot = ctx->slots[fd];
+    if (slot == NULL) {
+        // NOTE: slot never move, io->hovlp point to slot->comp.
+        ARS_ALLOC_SIZEOF(slot);
+        slot->bid = -1;
+        ctx->slots[fd] = slot;
+    }
+    return slot;
+}
+
+static void uring_mark_dirty(uring_ctx_t* ctx, uring_slot_t* slot, int fd) {
+    if (slot->dirty) return;
+    slot->dirty = 1;
+    uring_fds_push_back(&ctx->dirty, &fd);
+}
+
+static void uring_mark_ready(uring_ctx_t* ctx, uring_slot_t* slot, int fd) {
+    if (slot->ready) return;
+    slot->ready = 1;
+    uring_fds_push_back(&ctx->ready, &fd);
+}
+
+static bool uring_can_recv(loop_t* loop, uring_ctx_t* ctx, uring_slot_t* slot, io_t* io) {
+    if (!ctx->ring_recv || slot->nobufs) return false;
+    if (io->io_type != IO_TYPE_TCP || io->accept || io->connect || io->splice) return false;
+    // NOTE: user readbuf set by ev_read/io_set_readbuf must be filled by read(2).
+    return ARS_IO_DEFAULT_READBUF(io);
+}
+
+// stage sqes to make armed ops match io->events
+// @return -1 if the sq is full, the slot is marked dirty again for the next poll.
+static int uring_sync_slot(loop_t* loop, uring_ctx_t* ctx, int fd) {
+    uring_slot_t* slot = ctx->slots[fd];
+    slot->dirty = 0;
+    io_t* io = (size_t)fd < loop->ios.maxsize ? loop->ios.ptr[fd] : NULL;
+    int events = 0;
+    bool recv = false;
+    uint32_t pmask = 0;
+    if (!slot->has_comp && slot->bid >= 0 && uring_drop_comp(ctx, slot) != 0) {
+        goto retry;
+    }
+    if (io == NULL || !io->ready || slot->io_id != io->id) {
+        // NOTE: io closed or fd reused by another io, drop all of the old one.
+        if (slot->pmask && uring_poll_remove(ctx, slot, fd) != 0) {
+            goto retry;
+        }
+        slot->pgen++;
+        if (slot->recv_armed && !slot->recv_cancel && uring_recv_cancel(ctx, slot, fd) != 0) {
+            goto retry;
+        }
+        if (uring_drop_comp(ctx, slot) != 0) {
+            goto retry;
+        }
+        slot->rgen++;
+        slot->recv_armed = slot->recv_cancel = 0;
+        slot->nobufs = 0;
+        slot->io_id = (io && io->ready) ? io->id : 0;
+    }
+    events = (io && io->ready) ? io->events : 0;
+
+    recv = (events & ARS_IO_READ) && uring_can_recv(loop, ctx, slot, io);
+    if ((events & ARS_IO_READ) && !recv) {
+        pmask |= POLLIN;
+    }
+    if (events & ARS_IO_WRITE) {
+        pmask |= POLLOUT;
+    }
+    if (slot->pmask != pmask) {
+        if (slot->pmask && uring_poll_remove(ctx, slot, fd) != 0) {
+            goto retry;
+        }
+        slot->pgen++;
+        if (pmask && uring_poll_add(ctx, slot, fd, pmask) != 0) {
+            goto retry;
+        }
+    }
+
+    if (recv) {
+        if (!slot->recv_armed && !slot->has_comp && uring_recv(ctx, slot, fd) != 0) {
+            goto retry;
+        }
+    } else if (slot->recv_armed && !slot->recv_cancel) {
+        // NOTE: keep rgen, data raced with cancel still belongs to this io.
+        if (uring_recv_cancel(ctx, slot, fd) != 0) {
+            goto retry;
+        }
+    }
+
+    if (slot->has_comp && (events & ARS_IO_READ)) {
+        uring_mark_ready(ctx, slot, fd);
+    }
+    return 0;
+
+retry:
+    uring_mark_dirty(ctx, slot, fd);
+    return -1;
+}
+
+static int uring_cleanup(loop_t* loop);
+
+static int uring_init(loop_t* loop) {
+    if (loop->iowatcher) return 0;
+    struct io_uring_params params;
+    memset(&params, 0, sizeof(params));
+    params.flags = IORING_SETUP_CQSIZE | IORING_SETUP_CLAMP;
+    params.cq_entries = URING_CQ_ENTRIES;
+    int ringfd = __sys_uring_setup(URING_SQ_ENTRIES, &params);
+    if (ringfd < 0) {
+        return -1;
+    }
+    // NOTE: EXT_ARG for timeout wait (5.11+), NODROP to never lose cqe.
+    if (!(params.features & IORING_FEAT_EXT_ARG) || !(params.features & IORING_FEAT_NODROP)) {
+        close(ringfd);
+        return -1;
+    }
+
+    uring_ctx_t* ctx;
+    ARS_ALLOC_SIZEOF(ctx);
+    ctx->ringfd = ringfd;
+    loop->iowatcher = ctx;
+
+    ctx->sq_ring_sz = params.sq_off.array + params.sq_entries * sizeof(unsigned);
+    ctx->cq_ring_sz = params.cq_off.cqes + params.cq_entries * sizeof(struct io_uring_cqe);
+    if (params.features & IORING_FEAT_SINGLE_MMAP) {
+        ctx->sq_ring_sz = ctx->cq_ring_sz = ARS_MAX(ctx->sq_ring_sz, ctx->cq_ring_sz);
+    }
+    ctx->sq_ring = mmap(NULL, ctx->sq_ring_sz, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE,
+                        ringfd, IORING_OFF_SQ_RING);
+    if (ctx->sq_ring == MAP_FAILED) {
+        ctx->sq_ring = NULL;
+        goto error;
+    }
+    if (params.features & IORING_FEAT_SINGLE_MMAP) {
+        ctx->cq_ring = ctx->sq_ring;
+    } else {
+        ctx->cq_ring = mmap(NULL, ctx->cq_ring_sz, PROT_READ | PROT_WRITE,
+                            MAP_SHARED | MAP_POPULATE, ringfd, IORING_OFF_CQ_RING);
+        if (ctx->cq_ring == MAP_FAILED) {
+            ctx->cq_ring = NULL;
+            goto error;
+        }
+    }
+    ctx->sqes_sz = params.sq_entries * sizeof(struct io_uring_sqe);
+    ctx->sqes = (struct io_uring_sqe*)mmap(NULL, ctx->sqes_sz, PROT_READ | PROT_WRITE,
+                                           MAP_SHARED | MAP_POPULATE, ringfd, IORING_OFF_SQES);
+    if (ctx->sqes == MAP_FAILED) {
+        ctx->sqes = NULL;
+        goto error;
+    }
+
+    ctx->sq_head = (unsigned*)((char*)ctx->sq_ring + params.sq_off.head);
+    ctx->sq_tail = (unsigned*)((char*)ctx->sq_ring + params.sq_off.tail);
+    ctx->sq_array = (unsigned*)((char*)ctx->sq_ring + params.sq_off.array);
+    ctx->sq_mask = *(unsigned*)((char*)ctx->sq_ring + params.sq_off.ring_mask);
+    ctx->sq_entries = params.sq_entries;
+    ctx->sq_staged = *ctx->sq_tail;
+    ctx->cq_head = (unsigned*)((char*)ctx->cq_ring + params.cq_off.head);
+    ctx->cq_tail = (unsigned*)((char*)ctx->cq_ring + params.cq_off.tail);
+    ctx->cq_mask = *(unsigned*)((char*)ctx->cq_ring + params.cq_off.ring_mask);
+    ctx->cqes = (struct io_uring_cqe*)((char*)ctx->cq_ring + params.cq_off.cqes);
+
+    uring_fds_init(&ctx->dirty, URING_FDS_INIT_SIZE);
+    uring_fds_init(&ctx->ready, URING_FDS_INIT_SIZE);
+
+    // NOTE: submitted with the first wait, recv falls back to poll if not supported.
+    ARS_ALLOC(ctx->rbufs, (size_t)URING_RBUF_COUNT * URING_RBUF_SIZE);
+    ctx->ring_recv = 1;
+    uring_provide_buffers(ctx, 0, URING_RBUF_COUNT);
+    return 0;
+
+error:
+    uring_cleanup(loop);
+    return -1;
+}
+
+static int uring_cleanup(loop_t* loop) {
+    if (loop->iowatcher == NULL) return 0;
+    uring_ctx_t* ctx = (uring_ctx_t*)loop->iowatcher;
+    // NOTE: close ring first, kernel cancels all inflight ops before rbufs freed.
+    close(ctx->ringfd);
+    if (ctx->sqes) munmap(ctx->sqes, ctx->sqes_sz);
+    if (ctx->cq_ring && ctx->cq_ring != ctx->sq_ring) munmap(ctx->cq_ring, ctx->cq_ring_sz);
+    if (ctx->sq_ring) munmap(ctx->sq_ring, ctx->sq_ring_sz);
+    for (int i = 0; i < ctx->nslots; ++i) {
+        ARS_FREE(ctx->slots[i]);
+    }
+    ARS_FREE(ctx->slots);
+    uring_fds_cleanup(&ctx->dirty);
+    uring_fds_cleanup(&ctx->ready);
+    ARS_FREE(ctx->rbufs);
+    ARS_FREE(loop->iowatcher);
+    return 0;
+}
+
+static int uring_add_event(loop_t* loop, int fd, int events) {
+    uring_ctx_t* ctx = (uring_ctx_t*)loop->iowatcher;
+    uring_mark_dirty(ctx, uring_slot(ctx, fd), fd);
+    return 0;
+}
+
+static int uring_del_event(loop_t* loop, int fd, int events) {
+    uring_ctx_t* ctx = (uring_ctx_t*)loop->iowatcher;
+    if (ctx == NULL) return 0;
+    uring_mark_dirty(ctx, uring_slot(ctx, fd), fd);
+    return 0;
+}
+
+static int uring_reap(loop_t* loop, uring_ctx_t* ctx) {
+    int nevents = 0;
+    unsigned head = *ctx->cq_head;
+    unsigned tail = __atomic_load_n(ctx->cq_tail, __ATOMIC_ACQUIRE);
+    for (; head != tail; ++head) {
+        struct io_uring_cqe* cqe = ctx->cqes + (head & ctx->cq_mask);
+        int op = URING_UDATA_OP(cqe->user_data);
+        int fd = URING_UDATA_FD(cqe->user_data);
+        uint32_t gen = URING_UDATA_GEN(cqe->user_data);
+        int res = cqe->res;
+        if (op == URING_OP_PBUF) {
+            if (res < 0) {
+                ctx->ring_recv = 0;
+            }
+            continue;
+        }
+        if (op == URING_OP_CTRL) continue;
+        ctx->ninflight--;
+        uring_slot_t* slot = fd < ctx->nslots ? ctx->slots[fd] : NULL;
+        if (slot == NULL) continue;
+        io_t* io = (size_t)fd < loop->ios.maxsize ? loop->ios.ptr[fd] : NULL;
+        if (op == URING_OP_POLL) {
+            if (gen != (slot->pgen & URING_GEN_MASK)) continue;
+            slot->pmask = 0;
+            slot->nobufs = 0;
+            uring_mark_dirty(ctx, slot, fd);
+            if (io == NULL || io->id != slot->io_id) continue;
+            uint32_t revents = res < 0 ? (POLLERR | POLLHUP) : res;
+            if (revents & (POLLIN | POLLHUP | POLLERR)) {
+                io->revents |= ARS_IO_READ;
+            }
+            if (revents & (POLLOUT | POLLHUP | POLLERR)) {
+                io->revents |= ARS_IO_WRITE;
+            }
+            ARS_EVENT_PENDING(io);
+            ++nevents;
+        } else if (op == URING_OP_RECV) {
+            int bid = (cqe->flags & IORING_CQE_F_BUFFER) ? (cqe->flags >> IORING_CQE_BUFFER_SHIFT)
+                                                         : -1;
+            if (gen != (slot->rgen & URING_GEN_MASK)) {
+                if (bid >= 0) uring_provide_buffers(ctx, bid, 1);
+                continue;
+            }
+            slot->recv_armed = slot->recv_cancel = 0;
+            uring_mark_dirty(ctx, slot, fd);
+            if (res == -ECANCELED) continue;
+            if (res == -ENOBUFS || res == -EAGAIN) {
+                slot->nobufs = 1;
+                continue;
+            }
+            if (res == -EINVAL) {
+                // NOTE: kernel not support buffer select, always poll.
+                ctx->ring_recv = 0;
+                continue;
+            }
+            slot->has_comp = 1;
+            slot->bid = bid;
+            slot->comp.buf = bid >= 0 ? ctx->rbufs + (size_t)bid * URING_RBUF_SIZE : NULL;
+            slot->comp.nread = res;
+        }
+    }
+    __atomic_store_n(ctx->cq_head, head, __ATOMIC_RELEASE);
+    return nevents;
+}
+
+static int uring_poll_events(loop_t* loop, int timeout) {
+    uring_ctx_t* ctx = (uring_ctx_t*)loop->iowatcher;
+    if (ctx == NULL) return 0;
+    int nevents = 0;
+
+    // NOTE: slots failed for a full sq are pushed back behind the ones synced now.
+    size_t ndirty = ctx->dirty.size;
+    for (size_t i = 0; i < ndirty; ++i) {
+        uring_sync_slot(loop, ctx, ctx->dirty.ptr[i]);
+    }
+    ctx->dirty.size -= ndirty;
+    memmove(ctx->dirty.ptr, ctx->dirty.ptr + ndirty, ctx->dirty.size * sizeof(int));
+
+    unsigned to_submit = uring_publish(ctx);
+    if (to_submit == 0 && ctx->ninflight == 0 && ctx->ready.size == 0 && ctx->dirty.size == 0) {
+        return 0;
+    }
+    if (ctx->ready.size || ctx->dirty.size) {
+        timeout = 0;
+    }
+    if (to_submit || timeout != 0) {
+        struct __kernel_timespec ts;
+        struct io_uring_getevents_arg arg;
+        memset(&arg, 0, sizeof(arg));
+        arg.sigmask_sz = _NSIG / 8;
+        if (timeout >= 0 && timeout != (int)INFINITE) {
+            ts.tv_sec = timeout / 1000;
+            ts.tv_nsec = (timeout % 1000) * 1000000LL;
+            arg.ts = (uint64_t)(uintptr_t)&ts;
+        }
+        unsigned flags = IORING_ENTER_EXT_ARG;
+        unsigned min_complete = 0;
+        if (timeout != 0) {
+            flags |= IORING_ENTER_GETEVENTS;
+            min_complete = 1;
+        }
+        int ret = __sys_uring_enter(ctx->ringfd, to_submit, min_complete, flags, &arg, sizeof(arg));
+        if (ret < 0 && errno != ETIME && errno != EINTR && errno != EAGAIN && errno != EBUSY) {
+            perror("io_uring_enter");
+            return -errno;
+        }
+    }
+
+    nevents += uring_reap(loop, ctx);
+
+    // NOTE: new completed recv make slots dirty, sync them now to find ready ones.
+    for (size_t i = 0; i < ctx->dirty.size; ++i) {
+        int fd = ctx->dirty.ptr[i];
+        uring_slot_t* slot = ctx->slots[fd];
+        io_t* io = loop->ios.ptr[fd];
+        if (slot->has_comp && io && io->ready && io->id == slot->io_id &&
+            (io->events & ARS_IO_READ)) {
+            uring_mark_ready(ctx, slot, fd);
+        }
+    }
+    for (size_t i = 0; i < ctx->ready.size; ++i) {
+        int fd = ctx->ready.ptr[i];
+        uring_slot_t* slot = ctx->slots[fd];
+        slot->ready = 0;
+        io_t* io = loop->ios.ptr[fd];
+        if (!slot->has_comp || io == NULL || !io->ready || io->id != slot->io_id) continue;
+        io->hovlp = &slot->comp;
+        io->revents |= ARS_IO_READ;
+        ARS_EVENT_PENDING(io);
+        ++nevents;
+    }
+    ctx->ready.size = 0;
+    return nevents;
+}
+
+static void uring_read_done(loop_t* loop, int fd) {
+    uring_ctx_t* ctx = (uring_ctx_t*)loop->iowatcher;
+    if (ctx == NULL || fd >= ctx->nslots || ctx->slots[fd] == NULL) return;
+    uring_slot_t* slot = ctx->slots[fd];
+    uring_drop_comp(ctx, slot);
+    uring_mark_dirty(ctx, slot, fd);
+}
+
+const iowatcher_engine_t uring_engine = {
+    "io_uring",       uring_init,        uring_cleanup,   uring_add_event,
+    uring_del_event, uring_poll_events, uring_read_done,
+};
+
+}  // namespace event
+
+}  // namespace sdk
+
+}  // namespace ars
+
+#endif
@@ -0,0 +1,167 @@
+/**
+ * Copyright © 2021 <wotsen>.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of this software
+ * and associated documentation files (the “Software”), to deal in the Software without
+ * restriction, including without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sublicense, and/or sell copies of the Software, and to permit persons to whom the
+ *
+ * The above copyright notice and this permission notice shall be included in all copies or
+ * substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED “AS IS”, WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING
+ * BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM,
+ * DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ *
+ * @file arena.cpp
+ * @brief 区域内存分配器
+ * @author wotsen (astralrovers@outlook.com)
+ * @version 1.0.0
+ * @date 2021-06-19
+ *
+ * @copyright MIT
+ *
+ */
+#include "ars/sdk/memory/arena.hpp"
+#include "ars/sdk/memory/mem.hpp"
+
+namespace ars {
+
+namespace sdk {
+
+struct alignas(max_align_t) Arena::chunk_s {
+    struct chunk_s *next;
+    size_t size;
+    // 数据紧随块头
+};
+
+// 单独申请的大块，新的在表头
+typedef struct alignas(max_align_t) arena_large_s {
+    struct arena_large_s *next;
+    size_t size;
+} arena_large_t;
+
+#define ARENA_CHUNK_DATA(c) ((char*)((c) + 1))
+
+Arena::Arena(size_t chunk_size)
+    : chunk_size_(chunk_size < 256 ? 256 : chunk_size), reserved_(0), head_(NULL), cur_(NULL),
+      large_(NULL), pos_(NULL), end_(NULL) {}
+
+Arena::~Arena() {
+    free_large(NULL);
+    struct chunk_s *c = head_;
+    while (c) {
+        struct chunk_s *next = c->next;
+        ars_free(c);
+        c = next;
+    }
+}
+
+void *Arena::alloc_slow(size_t size, size_t align) {
+    if (size == 0) {
+        size = 1;
+    }
+    if (size > chunk_size_ / 4 || size + align > chunk_size_) {
+        size_t total = sizeof(arena_large_t) + size + align;
+        if (total < size) {
+            return NULL;
+        }
+        arena_large_t *l = (arena_large_t*)ars_malloc(total);
+        if (!l) {
+            return NULL;
+        }
+        l->next = (arena_large_t*)large_;
+        l->size = total;
+        large_ = l;
+        reserved_ += total;
+        return (void*)(((uintptr_t)(l + 1) + align - 1) & ~(uintptr_t)(align - 1));
+    }
+
+    // 先复用 reset/rewind 留下的块
+    struct chunk_s *next = cur_ ? cur_->next : head_;
+    if (!next) {
+        next = (struct chunk_s*)ars_malloc(sizeof(struct chunk_s) + chunk_size_);
+        if (!next) {
+            return NULL;
+        }
+        next->next = NULL;
+        next->size = chunk_size_;
+        if (cur_) {
+            cur_->next = next;
+        } else {
+            head_ = next;
+        }
+        reserved_ += sizeof(struct chunk_s) + chunk_size_;
+    }
+    cur_ = next;
+    pos_ = ARENA_CHUNK_DATA(cur_);
+    end_ = pos_ + cur_->size;
+    return alloc(size, align);
+}
+
+void *Arena::realloc(void *p, size_t old_size, size_t new_size, size_t align) {
+    if (!p) {
+        return alloc(new_size, align);
+    }
+    // 最近一次分配且块内放得下，原处扩大
+    if ((char*)p + old_size == pos_ && new_size <= (size_t)(end_ - (char*)p)) {
+        pos_ = (char*)p + new_size;
+        return p;
+    }
+    if (new_size <= old_size) {
+        return p;
+    }
+    void *q = alloc(new_size, align);
+    if (q) {
+        memcpy(q, p, old_size);
+    }
+    return q;
+}
+
+void Arena::free_large(void *until) {
+    arena_large_t *l = (arena_large_t*)large_;
+    while (l && l != until) {
+        arena_large_t *next = l->next;
+        reserved_ -= l->size;
+        ars_free(l);
+        l = next;
+    }
+    large_ = l;
+}
+
+void Arena::reset(void) {
+    free_large(NULL);
+    cur_ = NULL;
+    pos_ = end_ = NULL;
+}
+
+void Arena::rewind(const mark_t &m) {
+    free_large(m.large);
+    cur_ = (struct chunk_s*)m.chunk;
+    if (cur_) {
+        pos_ = m.pos;
+        end_ = ARENA_CHUNK_DATA(cur_) + cur_->size;
+    } else {
+        pos_ = end_ = NULL;
+    }
+}
+
+size_t Arena::used(void) const {
+    size_t n = 0;
+    if (cur_) {
+        for (struct chunk_s *c = head_; c != cur_; c = c->next) {
+            n += c->size;
+        }
+        n += pos_ - ARENA_CHUNK_DATA(cur_);
+    }
+    for (arena_large_t *l = (arena_large_t*)large_; l; l = l->next) {
+        n += l->size - sizeof(arena_large_t);
+    }
+    return n;
+}
+
+} // namespace sdk
+
+} // namespace ars
@@ -25,10 +25,16 @@
  * 
  */
 #include "ars/sdk/memory/mem.hpp"
+#include <stdint.h>
 #include <stdlib.h>
 #include <stdio.h>
 #include <string.h>
+#include <pthread.h>
+#include <unistd.h>
+#include <sys/mman.h>
 #include <atomic>
+#include <mutex>
+#include <new>
 
 namespace ars {
 
@@ -40,21 +46,206 @@ static void *(*__realloc)(void *, size_t) = ::realloc;
 static void *(*__calloc)(size_t, size_t) = ::calloc;
 static void (*__free)(void*) = ::free;
 
-static std::atomic_long s_alloc_cnt(0);
-static std::atomic_long s_free_cnt(0);
+// NOTE: 计数按线程分开，只由所属线程写，不做原子加，读时汇总，
+// 避免所有核争用同一缓存行。线程退出后计数块留给新线程继续累加。
+typedef struct alignas(64) mem_counter_s {
+    std::atomic_long alloc{0};
+    std::atomic_long free{0};
+    struct mem_counter_s *next;         // 全部计数块
+    struct mem_counter_s *next_idle;    // 空闲计数块
+} mem_counter_t;
+
+static thread_local mem_counter_t *tls_counter = NULL;
+static std::mutex s_counter_mtx;
+static mem_counter_t *s_counters = NULL;
+static mem_counter_t *s_idle_counters = NULL;
+static pthread_key_t s_counter_key;
+
+static void counter_release(void *arg) {
+    mem_counter_t *c = (mem_counter_t*)arg;
+    tls_counter = NULL;
+    std::lock_guard<std::mutex> lck(s_counter_mtx);
+    c->next_idle = s_idle_counters;
+    s_idle_counters = c;
+}
+
+static mem_counter_t *counter_get(void) {
+    static std::once_flag once;
+    std::call_once(once, [] { pthread_key_create(&s_counter_key, counter_release); });
+    mem_counter_t *c = NULL;
+    {
+        std::lock_guard<std::mutex> lck(s_counter_mtx);
+        if (s_idle_counters) {
+            c = s_idle_counters;
+            s_idle_counters = c->next_idle;
+        } else {
+            // NOTE: 计数块不经过 __malloc，避免与替换的分配器相互递归
+            c = new (std::nothrow) mem_counter_t();
+            if (!c) {
+                return NULL;
+            }
+            c->next = s_counters;
+            s_counters = c;
+        }
+    }
+    tls_counter = c;
+    pthread_setspecific(s_counter_key, c);
+    return c;
+}
+
+static inline void counter_add(long alloc, long free) {
+    mem_counter_t *c = tls_counter;
+    if (!c && !(c = counter_get())) {
+        return;
+    }
+    if (alloc) {
+        c->alloc.store(c->alloc.load(std::memory_order_relaxed) + alloc, std::memory_order_relaxed);
+    }
+    if (free) {
+        c->free.store(c->free.load(std::memory_order_relaxed) + free, std::memory_order_relaxed);
+    }
+}
 
 long alloc_cnt(void) {
-    return s_alloc_cnt;
+    long n = 0;
+    std::lock_guard<std::mutex> lck(s_counter_mtx);
+    for (mem_counter_t *c = s_counters; c; c = c->next) {
+        n += c->alloc.load(std::memory_order_relaxed);
+    }
+    return n;
 }
 
 long free_cnt(void) {
-    return s_free_cnt;
+    long n = 0;
+    std::lock_guard<std::mutex> lck(s_counter_mtx);
+    for (mem_counter_t *c = s_counters; c; c = c->next) {
+        n += c->free.load(std::memory_order_relaxed);
+    }
+    return n;
 }
 
 void memroy_check(void) {
     printf("Memcheck => alloc:%ld free:%ld\n", alloc_cnt(), free_cnt());
 }
 
+static std::atomic_int s_page_policy(ARS_PAGE_DEFAULT);
+
+int ars_page_policy(void) {
+    return s_page_policy.load(std::memory_order_relaxed);
+}
+
+void ars_set_page_policy(int policy) {
+    s_page_policy.store(policy, std::memory_order_relaxed);
+}
+
+static size_t page_size(void) {
+    static size_t size = (size_t)sysconf(_SC_PAGESIZE);
+    return size;
+}
+
+// 默认大页大小，取自 /proc/meminfo
+static size_t huge_page_size(void) {
+    static size_t size = [] {
+        size_t kb = 2048;
+        FILE *fp = fopen("/proc/meminfo", "r");
+        if (fp) {
+            char line[128];
+            while (fgets(line, sizeof(line), fp)) {
+                if (sscanf(line, "Hugepagesize: %zu kB", &kb) == 1) {
+                    break;
+                }
+            }
+            fclose(fp);
+        }
+        return kb * 1024;
+    }();
+    return size;
+}
+
+// NOTE: RLIMIT_MEMLOCK 不足时每次分配都会失败，只报第一次
+static int page_mlock(void *addr, size_t len) {
+    static std::once_flag s_mlock_report;
+    if (mlock(addr, len) != 0) {
+        std::call_once(s_mlock_report, [len] {
+            fprintf(stderr, "mlock %zu bytes failed, check RLIMIT_MEMLOCK!\n", len);
+        });
+        return -1;
+    }
+    return 0;
+}
+
+int ars_page_advise(void *addr, size_t len, int policy) {
+    int ret = 0;
+    if (!addr || !len) {
+        return 0;
+    }
+    if ((policy & ARS_PAGE_BACKING_MASK) != ARS_PAGE_DEFAULT) {
+#ifdef MADV_HUGEPAGE
+        // NOTE: madvise 要求页对齐，只取区域内的整页
+        uintptr_t start = ((uintptr_t)addr + page_size() - 1) & ~(uintptr_t)(page_size() - 1);
+        uintptr_t end = ((uintptr_t)addr + len) & ~(uintptr_t)(page_size() - 1);
+        if (end > start && madvise((void *)start, end - start, MADV_HUGEPAGE) != 0) {
+            ret = -1;
+        }
+#endif
+    }
+    if ((policy & ARS_PAGE_MLOCK) && page_mlock(addr, len) != 0) {
+        ret = -1;
+    }
+    return ret;
+}
+
+void *ars_page_alloc(size_t *size) {
+    int policy = ars_page_policy();
+    int backing = policy & ARS_PAGE_BACKING_MASK;
+    int flags = MAP_PRIVATE | MAP_ANONYMOUS;
+    size_t align = backing == ARS_PAGE_DEFAULT ? page_size() : huge_page_size();
+    size_t len = (*size + align - 1) & ~(align - 1);
+    void *ptr = MAP_FAILED;
+
+    // NOTE: 不用 MAP_POPULATE，先 madvise 再由 mlock 触页，缺页时才能拿到透明大页
+#ifdef MAP_HUGETLB
+    if (backing == ARS_PAGE_HUGETLB) {
+        ptr = mmap(NULL, len, PROT_READ | PROT_WRITE, flags | MAP_HUGETLB, -1, 0);
+        if (ptr != MAP_FAILED) {
+            if (policy & ARS_PAGE_MLOCK) {
+                page_mlock(ptr, len);
+            }
+            *size = len;
+            return ptr;
+        }
+        // 没有预留大页，退回透明大页
+    }
+#endif
+    // 多映射一个大页再裁掉头尾，起址按大页对齐，整段都能由透明大页承载
+    size_t extra = align > page_size() ? align : 0;
+    char *p = (char *)mmap(NULL, len + extra, PROT_READ | PROT_WRITE, flags, -1, 0);
+    if (p == MAP_FAILED) {
+        fprintf(stderr, "mmap %zu bytes failed!\n", len);
+        return nullptr;
+    }
+    if (extra) {
+        char *start = (char *)(((uintptr_t)p + align - 1) & ~(uintptr_t)(align - 1));
+        if (start > p) {
+            munmap(p, start - p);
+        }
+        if (start + len < p + len + extra) {
+            munmap(start + len, p + len + extra - (start + len));
+        }
+        p = start;
+    }
+    ptr = p;
+    ars_page_advise(ptr, len, policy);
+    *size = len;
+    return ptr;
+}
+
+void ars_page_free(void *ptr, size_t size) {
+    if (ptr) {
+        munmap(ptr, size);
+    }
+}
+
 void ars_memory_init(const memory_conf_t &conf) {
     if (conf.malloc) {
         __malloc = conf.malloc;
@@ -71,10 +262,13 @@ void ars_memory_init(const memory_conf_t &conf) {
     if (conf.free) {
         __free = conf.free;
     }
+    if (conf.page_policy) {
+        ars_set_page_policy(conf.page_policy);
+    }
 }
 
 void *ars_malloc(size_t size) {
-    s_alloc_cnt++;
+    counter_add(1, 0);
     void *ptr = __malloc(size);
     if (!ptr) {
         fprintf(stderr, "malloc failed!\n");
@@ -84,7 +278,7 @@ void *ars_malloc(size_t size) {
 }
 
 int ars_memalign(void **ptr, size_t alignment, size_t size) {
-    s_alloc_cnt++;
+    counter_add(1, 0);
     int ret = __memalign(ptr, alignment, size);
     if (ret != 0) {
         fprintf(stderr, "memalign failed!\n");
@@ -94,8 +288,7 @@ int ars_memalign(void **ptr, size_t alignment, size_t size) {
 }
 
 void *ars_realloc(void *oldptr, size_t newsize, size_t oldsize) {
-    s_alloc_cnt++;
-    s_free_cnt++;
+    counter_add(1, 1);
     void* ptr = __realloc(oldptr, newsize);
     if (!ptr) {
         fprintf(stderr, "realloc failed!\n");
@@ -108,7 +301,7 @@ void *ars_realloc(void *oldptr, size_t newsize, size_t oldsize) {
 }
 
 void *ars_calloc(size_t nmemb, size_t size) {
-    s_alloc_cnt++;
+    counter_add(1, 0);
     void* ptr =  __calloc(nmemb, size);
     if (!ptr) {
         fprintf(stderr, "calloc failed!\n");
@@ -118,7 +311,7 @@ void *ars_calloc(size_t nmemb, size_t size) {
 }
 
 void *ars_zalloc(size_t size) {
-    s_alloc_cnt++;
+    counter_add(1, 0);
     void* ptr = __malloc(size);
     if (!ptr) {
         fprintf(stderr, "malloc failed!\n");
@@ -130,9 +323,8 @@ void *ars_zalloc(size_t size) {
 
 void ars_free(void *ptr) {
     if (ptr) {
-        free(ptr);
-        ptr = NULL;
-        s_free_cnt++;
+        __free(ptr);
+        counter_add(0, 1);
     }
 }
 
@@ -0,0 +1,570 @@
+/**
+ * Copyright © 2021 <wotsen>.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of this software
+ * and associated documentation files (the “Software”), to deal in the Software without
+ * restriction, including without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sublicense, and/or sell copies of the Software, and to permit persons to whom the
+ *
+ * The above copyright notice and this permission notice shall be included in all copies or
+ * substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED “AS IS”, WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING
+ * BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM,
+ * DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ *
+ * @file sc_alloc.cpp
+ * @brief 内置分级内存分配器
+ * @author wotsen (astralrovers@outlook.com)
+ * @version 1.0.0
+ * @date 2021-06-12
+ *
+ * @copyright MIT
+ *
+ */
+#include "ars/sdk/memory/sc_alloc.hpp"
+#include <errno.h>
+#include <stddef.h>
+#include <pthread.h>
+#include <stdint.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <atomic>
+#include <mutex>
+#include <new>
+
+namespace ars {
+
+namespace sdk {
+
+#define SC_SEGMENT_SHIFT 22                     // 4M，大页的整数倍
+#define SC_SEGMENT_SIZE ((size_t)1 << SC_SEGMENT_SHIFT)
+#define SC_SPAN_SHIFT 16                        // 64K
+#define SC_SPAN_SIZE ((size_t)1 << SC_SPAN_SHIFT)
+#define SC_SPANS (SC_SEGMENT_SIZE / SC_SPAN_SIZE)
+#define SC_MAX_ALIGN SC_SPAN_SIZE
+#define SC_CLASSES 40                           // 16..128 步长 16，之后每个 2 倍分 4 级到 32K
+#define SC_LARGE_CLASSES (8 + (SC_SEGMENT_SHIFT - 7) * 4)  // 大块映射沿用分级到 4M
+#define SC_LARGE_CACHE_BYTES ((size_t)64 << 20) // 缓存的已释放大块映射总量上限
+
+#define SC_SEGMENT_SMALL 0
+#define SC_SEGMENT_LARGE 1
+
+#define SC_SPAN_FREE 0                          // 在堆的空闲span链表
+#define SC_SPAN_AVAIL 1                         // 在分级的可分配链表
+#define SC_SPAN_FULL 2                          // 在分级的已满链表
+
+typedef struct sc_block_s {
+    struct sc_block_s *next;
+} sc_block_t;
+
+struct sc_heap_s;
+
+// NOTE: remote/full 会被其他线程访问，其余字段只有所属线程读写
+typedef struct alignas(64) sc_span_s {
+    sc_block_t *free;           // 本地空闲链表
+    char *bump;                 // 未切分区域
+    char *end;
+    char *start;
+    uint32_t block_size;
+    uint32_t used;              // 已分配块数，含远程释放但未取回的
+    uint16_t cls;
+    uint8_t state;
+    struct sc_span_s *prev;
+    struct sc_span_s *next;
+    std::atomic<sc_block_t*> remote;
+    std::atomic<uint32_t> full;
+    std::atomic<uint8_t> aligned;   // 有块经 memalign 分配，释放的地址可能不在块首
+} sc_span_t;
+
+typedef struct sc_segment_s {
+    uint32_t kind;
+    size_t map_size;            // 大块映射的长度
+    size_t offset;              // 大块用户地址相对段首的偏移
+    struct sc_heap_s *heap;     // 段的所属堆，不会改变
+    struct sc_segment_s *next;  // 缓存的大块映射链表
+    sc_span_t spans[SC_SPANS];
+} sc_segment_t;
+
+typedef struct alignas(64) sc_heap_s {
+    sc_span_t *avail[SC_CLASSES];   // 表头即当前分配的span
+    sc_span_t *full[SC_CLASSES];
+    sc_span_t *free_spans;
+    sc_segment_t *segment;          // 正在切分span的段
+    uint32_t segment_next;
+    struct sc_heap_s *next;         // 废弃堆链表
+    alignas(64) std::atomic<long> remote_full;  // 已满span收到远程释放的次数
+} sc_heap_t;
+
+static thread_local sc_heap_t *tls_heap = NULL;
+static pthread_key_t s_heap_key;
+static std::once_flag s_heap_key_once;
+static std::mutex s_abandoned_mtx;
+static sc_heap_t *s_abandoned = NULL;
+
+// NOTE: 已释放的大块映射按分级缓存，同级再分配不再 mmap/munmap
+static std::mutex s_large_mtx;
+static sc_segment_t *s_large_cache[SC_LARGE_CLASSES];
+static size_t s_large_cached = 0;
+
+static inline size_t sc_align_up(size_t n, size_t align) {
+    return (n + align - 1) & ~(align - 1);
+}
+
+static inline uint32_t sc_size_class(size_t size) {
+    if (size <= 128) {
+        return size ? (uint32_t)((size + 15) >> 4) - 1 : 0;
+    }
+    size_t w = size - 1;
+    uint32_t b = 63 - __builtin_clzl(w);
+    return 8 + (b - 7) * 4 + (uint32_t)((w >> (b - 2)) & 3);
+}
+
+static inline uint32_t sc_class_size(uint32_t cls) {
+    if (cls < 8) {
+        return (cls + 1) << 4;
+    }
+    uint32_t k = cls - 8;
+    uint32_t b = 7 + k / 4;
+    return (1u << b) + ((k % 4 + 1) << (b - 2));
+}
+
+static inline sc_segment_t *sc_segment_of(const void *ptr) {
+    return (sc_segment_t*)((uintptr_t)ptr & ~(SC_SEGMENT_SIZE - 1));
+}
+
+static inline sc_span_t *sc_span_of(sc_segment_t *seg, const void *ptr) {
+    return &seg->spans[((uintptr_t)ptr - (uintptr_t)seg) >> SC_SPAN_SHIFT];
+}
+
+// 映射按段大小对齐的区域
+static void *sc_map_aligned(size_t size) {
+    size_t len = size + SC_SEGMENT_SIZE;
+    char *p = (char*)mmap(NULL, len, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (p == MAP_FAILED) {
+        return NULL;
+    }
+    char *base = (char*)sc_align_up((uintptr_t)p, SC_SEGMENT_SIZE);
+    if (base > p) {
+        munmap(p, base - p);
+    }
+    if (p + len > base + size) {
+        munmap(base + size, p + len - (base + size));
+    }
+    return base;
+}
+
+static sc_segment_t *sc_segment_new(sc_heap_t *heap) {
+    sc_segment_t *seg = (sc_segment_t*)sc_map_aligned(SC_SEGMENT_SIZE);
+    if (!seg) {
+        return NULL;
+    }
+    // 段至少用透明大页，页策略要求时再锁定
+    ars_page_advise(seg, SC_SEGMENT_SIZE, (ars_page_policy() & ARS_PAGE_MLOCK) | ARS_PAGE_THP);
+    seg->kind = SC_SEGMENT_SMALL;
+    seg->heap = heap;
+    for (size_t i = 0; i < SC_SPANS; ++i) {
+        sc_span_t *span = &seg->spans[i];
+        new (&span->remote) std::atomic<sc_block_t*>(NULL);
+        new (&span->full) std::atomic<uint32_t>(0);
+        new (&span->aligned) std::atomic<uint8_t>(0);
+        span->start = (char*)seg + i * SC_SPAN_SIZE;
+        span->end = span->start + SC_SPAN_SIZE;
+    }
+    // 第一个span让出段头
+    seg->spans[0].start = (char*)seg + sc_align_up(sizeof(sc_segment_t), 64);
+    return seg;
+}
+
+/* 链表操作 */
+static inline void sc_list_push(sc_span_t **head, sc_span_t *span) {
+    span->prev = NULL;
+    span->next = *head;
+    if (*head) {
+        (*head)->prev = span;
+    }
+    *head = span;
+}
+
+static inline void sc_list_remove(sc_span_t **head, sc_span_t *span) {
+    if (span->prev) {
+        span->prev->next = span->next;
+    } else {
+        *head = span->next;
+    }
+    if (span->next) {
+        span->next->prev = span->prev;
+    }
+    span->prev = span->next = NULL;
+}
+
+static sc_heap_t *sc_heap_new(void) {
+    size_t size = sc_align_up(sizeof(sc_heap_t), 4096);
+    void *p = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (p == MAP_FAILED) {
+        return NULL;
+    }
+    // NOTE: 堆不会释放，线程退出后由新线程接管，span上仍可能有远程释放
+    return new (p) sc_heap_t();
+}
+
+static void sc_heap_abandon(void *arg) {
+    sc_heap_t *heap = (sc_heap_t*)arg;
+    tls_heap = NULL;
+    std::lock_guard<std::mutex> lck(s_abandoned_mtx);
+    heap->next = s_abandoned;
+    s_abandoned = heap;
+}
+
+static void sc_heap_key_create(void) {
+    pthread_key_create(&s_heap_key, sc_heap_abandon);
+}
+
+static sc_heap_t *sc_heap_get(void) {
+    std::call_once(s_heap_key_once, sc_heap_key_create);
+    sc_heap_t *heap = NULL;
+    {
+        std::lock_guard<std::mutex> lck(s_abandoned_mtx);
+        if (s_abandoned) {
+            heap = s_abandoned;
+            s_abandoned = heap->next;
+            heap->next = NULL;
+        }
+    }
+    if (!heap) {
+        heap = sc_heap_new();
+        if (!heap) {
+            return NULL;
+        }
+    }
+    tls_heap = heap;
+    pthread_setspecific(s_heap_key, heap);
+    return heap;
+}
+
+// 取回远程释放的块
+static inline void sc_span_collect(sc_span_t *span) {
+    sc_block_t *b = span->remote.exchange(NULL, std::memory_order_acquire);
+    if (!b) {
+        return;
+    }
+    uint32_t n = 1;
+    sc_block_t *tail = b;
+    while (tail->next) {
+        tail = tail->next;
+        ++n;
+    }
+    tail->next = span->free;
+    span->free = b;
+    span->used -= n;
+}
+
+static sc_span_t *sc_span_new(sc_heap_t *heap, uint32_t cls) {
+    sc_span_t *span = heap->free_spans;
+    if (span) {
+        sc_list_remove(&heap->free_spans, span);
+    } else {
+        if (!heap->segment || heap->segment_next == SC_SPANS) {
+            sc_segment_t *seg = sc_segment_new(heap);
+            if (!seg) {
+                return NULL;
+            }
+            heap->segment = seg;
+            heap->segment_next = 0;
+        }
+        span = &heap->segment->spans[heap->segment_next++];
+    }
+    span->cls = cls;
+    span->block_size = sc_class_size(cls);
+    span->free = NULL;
+    span->bump = span->start;
+    span->used = 0;
+    span->aligned.store(0, std::memory_order_relaxed);
+    span->full.store(0, std::memory_order_relaxed);
+    span->state = SC_SPAN_AVAIL;
+    sc_list_push(&heap->avail[cls], span);
+    return span;
+}
+
+// 已满span收到过远程释放，放回可分配链表
+static void sc_heap_reclaim_full(sc_heap_t *heap) {
+    if (heap->remote_full.load(std::memory_order_relaxed) == 0 ||
+        heap->remote_full.exchange(0, std::memory_order_acquire) == 0) {
+        return;
+    }
+    for (uint32_t c = 0; c < SC_CLASSES; ++c) {
+        sc_span_t *span = heap->full[c];
+        while (span) {
+            sc_span_t *next = span->next;
+            if (span->remote.load(std::memory_order_relaxed)) {
+                sc_list_remove(&heap->full[c], span);
+                span->full.store(0, std::memory_order_relaxed);
+                span->state = SC_SPAN_AVAIL;
+                sc_list_push(&heap->avail[c], span);
+            }
+            span = next;
+        }
+    }
+}
+
+static inline void *sc_span_pop(sc_span_t *span) {
+    sc_block_t *b = span->free;
+    if (b) {
+        span->free = b->next;
+    } else if (span->bump + span->block_size <= span->end) {
+        b = (sc_block_t*)span->bump;
+        span->bump += span->block_size;
+    } else {
+        return NULL;
+    }
+    span->used++;
+    return b;
+}
+
+static void *sc_alloc_slow(sc_heap_t *heap, uint32_t cls) {
+    for (int round = 0; round < 2; ++round) {
+        sc_span_t *span = heap->avail[cls];
+        while (span) {
+            sc_span_t *next = span->next;
+            sc_span_collect(span);
+            void *p = sc_span_pop(span);
+            if (p) {
+                if (span != heap->avail[cls]) {
+                    sc_list_remove(&heap->avail[cls], span);
+                    sc_list_push(&heap->avail[cls], span);
+                }
+                return p;
+            }
+            // NOTE: 先置满再检查远程链表，与远程释放的先入链再读满标志配对
+            sc_list_remove(&heap->avail[cls], span);
+            span->full.store(1, std::memory_order_seq_cst);
+            if (span->remote.load(std::memory_order_seq_cst)) {
+                span->full.store(0, std::memory_order_relaxed);
+                sc_list_push(&heap->avail[cls], span);
+                continue;
+            }
+            span->state = SC_SPAN_FULL;
+            sc_list_push(&heap->full[cls], span);
+            span = next;
+        }
+        if (round == 0) {
+            sc_heap_reclaim_full(heap);
+        }
+    }
+    sc_span_t *span = sc_span_new(heap, cls);
+    return span ? sc_span_pop(span) : NULL;
+}
+
+static void *sc_alloc_large(size_t size, size_t align) {
+    size_t offset = sc_align_up(offsetof(sc_segment_t, spans), align < 64 ? 64 : align);
+    size_t need = offset + size;
+    if (need < size) {
+        return NULL;
+    }
+    // 4M 以内按分级取整映射长度，以便释放后被同级复用
+    sc_segment_t *seg = NULL;
+    uint32_t cls = SC_LARGE_CLASSES;
+    size_t map_size = sc_align_up(need, 4096);
+    if (need <= SC_SEGMENT_SIZE) {
+        cls = sc_size_class(need);
+        map_size = sc_class_size(cls);
+        std::lock_guard<std::mutex> lck(s_large_mtx);
+        seg = s_large_cache[cls];
+        if (seg) {
+            s_large_cache[cls] = seg->next;
+            s_large_cached -= map_size;
+        }
+    }
+    if (!seg) {
+        seg = (sc_segment_t*)sc_map_aligned(map_size);
+        if (!seg) {
+            return NULL;
+        }
+        seg->kind = SC_SEGMENT_LARGE;
+        seg->map_size = map_size;
+        seg->heap = NULL;
+    }
+    seg->offset = offset;
+    seg->next = NULL;
+    return (char*)seg + offset;
+}
+
+static void sc_free_large(sc_segment_t *seg) {
+    if (seg->map_size <= SC_SEGMENT_SIZE) {
+        uint32_t cls = sc_size_class(seg->map_size);
+        std::lock_guard<std::mutex> lck(s_large_mtx);
+        if (s_large_cached + seg->map_size <= SC_LARGE_CACHE_BYTES) {
+            seg->next = s_large_cache[cls];
+            s_large_cache[cls] = seg;
+            s_large_cached += seg->map_size;
+            return;
+        }
+    }
+    munmap(seg, seg->map_size);
+}
+
+static inline void *sc_alloc(size_t size) {
+    if (size > SC_MAX_SMALL_SIZE) {
+        return sc_alloc_large(size, 64);
+    }
+    sc_heap_t *heap = tls_heap;
+    if (!heap && !(heap = sc_heap_get())) {
+        return NULL;
+    }
+    uint32_t cls = sc_size_class(size);
+    sc_span_t *span = heap->avail[cls];
+    if (span) {
+        void *p = sc_span_pop(span);
+        if (p) {
+            return p;
+        }
+    }
+    return sc_alloc_slow(heap, cls);
+}
+
+static void sc_free_local(sc_heap_t *heap, sc_span_t *span, sc_block_t *b) {
+    b->next = span->free;
+    span->free = b;
+    if (--span->used == 0 && span != heap->avail[span->cls]) {
+        // 空span还给堆，可换作其他分级
+        sc_list_remove(span->state == SC_SPAN_FULL ? &heap->full[span->cls] : &heap->avail[span->cls], span);
+        span->full.store(0, std::memory_order_relaxed);
+        span->state = SC_SPAN_FREE;
+        sc_list_push(&heap->free_spans, span);
+    } else if (span->state == SC_SPAN_FULL) {
+        sc_list_remove(&heap->full[span->cls], span);
+        span->full.store(0, std::memory_order_relaxed);
+        span->state = SC_SPAN_AVAIL;
+        // NOTE: 放在当前span之后，不打断当前span的切分
+        sc_span_t *head = heap->avail[span->cls];
+        if (head) {
+            span->prev = head;
+            span->next = head->next;
+            if (head->next) {
+                head->next->prev = span;
+            }
+            head->next = span;
+        } else {
+            sc_list_push(&heap->avail[span->cls], span);
+        }
+    }
+}
+
+static void sc_free_remote(sc_segment_t *seg, sc_span_t *span, sc_block_t *b) {
+    sc_block_t *head = span->remote.load(std::memory_order_relaxed);
+    do {
+        b->next = head;
+    } while (!span->remote.compare_exchange_weak(head, b, std::memory_order_seq_cst,
+                                                 std::memory_order_relaxed));
+    if (span->full.load(std::memory_order_seq_cst)) {
+        seg->heap->remote_full.fetch_add(1, std::memory_order_release);
+    }
+}
+
+void sc_free(void *ptr) {
+    if (!ptr) {
+        return;
+    }
+    sc_segment_t *seg = sc_segment_of(ptr);
+    if (seg->kind == SC_SEGMENT_LARGE) {
+        sc_free_large(seg);
+        return;
+    }
+    sc_span_t *span = sc_span_of(seg, ptr);
+    char *p = (char*)ptr;
+    if (span->aligned.load(std::memory_order_relaxed)) {
+        p -= (size_t)(p - span->start) % span->block_size;
+    }
+    if (seg->heap == tls_heap) {
+        sc_free_local(seg->heap, span, (sc_block_t*)p);
+    } else {
+        sc_free_remote(seg, span, (sc_block_t*)p);
+    }
+}
+
+size_t sc_usable_size(void *ptr) {
+    if (!ptr) {
+        return 0;
+    }
+    sc_segment_t *seg = sc_segment_of(ptr);
+    if (seg->kind == SC_SEGMENT_LARGE) {
+        return seg->map_size - ((char*)ptr - (char*)seg);
+    }
+    sc_span_t *span = sc_span_of(seg, ptr);
+    size_t off = (size_t)((char*)ptr - span->start) % span->block_size;
+    return span->block_size - off;
+}
+
+void *sc_malloc(size_t size) {
+    return sc_alloc(size);
+}
+
+int sc_memalign(void **ptr, size_t alignment, size_t size) {
+    if (alignment == 0 || (alignment & (alignment - 1)) || alignment > SC_MAX_ALIGN ||
+        alignment % sizeof(void*)) {
+        return EINVAL;
+    }
+    if (alignment <= 16) {
+        *ptr = sc_alloc(size);
+        return *ptr ? 0 : ENOMEM;
+    }
+    if (size + alignment - 1 > SC_MAX_SMALL_SIZE) {
+        *ptr = sc_alloc_large(size, alignment);
+        return *ptr ? 0 : ENOMEM;
+    }
+    // 多分配 alignment - 1，返回块内对齐的地址，释放时回退到块首
+    char *p = (char*)sc_alloc(size + alignment - 1);
+    if (!p) {
+        return ENOMEM;
+    }
+    char *q = (char*)sc_align_up((uintptr_t)p, alignment);
+    if (q != p) {
+        sc_span_of(sc_segment_of(p), p)->aligned.store(1, std::memory_order_relaxed);
+    }
+    *ptr = q;
+    return 0;
+}
+
+void *sc_realloc(void *ptr, size_t size) {
+    if (!ptr) {
+        return sc_alloc(size);
+    }
+    if (size == 0) {
+        sc_free(ptr);
+        return NULL;
+    }
+    size_t old = sc_usable_size(ptr);
+    // 同级内或大块缩小一半以内不搬移
+    if (size <= old && (size > old / 2 || old <= 16)) {
+        return ptr;
+    }
+    void *p = sc_alloc(size);
+    if (p) {
+        memcpy(p, ptr, old < size ? old : size);
+        sc_free(ptr);
+    }
+    return p;
+}
+
+void *sc_calloc(size_t nmemb, size_t size) {
+    size_t total;
+    if (__builtin_mul_overflow(nmemb, size, &total)) {
+        return NULL;
+    }
+    void *p = sc_alloc(total);
+    if (p) {
+        memset(p, 0, total);
+    }
+    return p;
+}
+
+const memory_conf_t &sc_memory_conf(void) {
+    static const memory_conf_t conf = {sc_malloc, sc_memalign, sc_realloc, sc_calloc, sc_free, 0};
+    return conf;
+}
+
+} // namespace sdk
+
+} // namespace ars
@@ -0,0 +1,387 @@
+/**
+ * Copyright © 2021 <wotsen>.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of this software
+ * and associated documentation files (the “Software”), to deal in the Software without
+ * restriction, including without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sublicense, and/or sell copies of the Software, and to permit persons to whom the
+ *
+ * The above copyright notice and this permission notice shall be included in all copies or
+ * substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED “AS IS”, WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING
+ * BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM,
+ * DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ *
+ * @file shm_pool.cpp
+ * @brief 多进程共享内存池
+ * @author wotsen (astralrovers@outlook.com)
+ * @version 1.0.0
+ * @date 2021-06-26
+ *
+ * @copyright MIT
+ *
+ */
+#define ARS_LOG_MODULE_NAME "sdk-memory-shm"
+
+#include "ars/sdk/memory/shm_pool.hpp"
+#include "sdk/log/in_log.hpp"
+
+#include <errno.h>
+#include <pthread.h>
+#include <signal.h>
+#include <string.h>
+#include <unistd.h>
+
+#include <atomic>
+#include <mutex>
+
+#define SHM_POOL_LOG(severity) ARS_IN_LOG(severity)
+
+#define SHM_POOL_MAGIC 0x617273706f6f6c31ULL   /* "arspool1" */
+#define SHM_POOL_CLASSES 140                    /* 16..128 步长16，之后每个2倍分4级到 2^40 */
+#define SHM_POOL_ALIGN 16
+#define SHM_POOL_MAX_SIZE ((uint64_t)1 << 36)   /* 偏移/16 存在32位中 */
+
+#define SHM_BLOCK_MAGIC 0x5348                  /* "SH" */
+#define SHM_OWNER_FREE 0                        /* 在空闲链表中 */
+#define SHM_OWNER_POOL 0xffffffff               /* 已detach，归池所有 */
+#define SHM_OWNER_FREEING 0x80000000            /* 释放中|进程号，进程号不超过 2^22 */
+
+#define SHM_OWNER_IS_FREEING(o) (((o) & SHM_OWNER_FREEING) && (o) != SHM_OWNER_POOL)
+
+#define SHM_HEAD_OFF(h) (((h) & 0xffffffffULL) << 4)
+#define SHM_HEAD_TAG(h) ((h) >> 32)
+#define SHM_HEAD(tag, off) (((uint64_t)(tag) << 32) | ((off) >> 4))
+
+namespace ars {
+
+namespace sdk {
+
+static_assert(std::atomic<uint64_t>::is_always_lock_free, "shm pool needs address-free 64-bit atomics");
+static_assert(std::atomic<uint32_t>::is_always_lock_free, "shm pool needs address-free 32-bit atomics");
+
+// 块头，紧接着是用户数据
+typedef struct {
+    std::atomic<uint32_t> owner;    // 进程号，或 SHM_OWNER_FREE/SHM_OWNER_POOL/SHM_OWNER_FREEING|进程号
+    uint16_t cls;
+    uint16_t magic;
+    std::atomic<uint64_t> next;     // 空闲时下一块的偏移
+} shm_block_t;
+
+static_assert(sizeof(shm_block_t) == SHM_POOL_ALIGN, "block header keeps data 16 bytes aligned");
+
+struct shm_pool_hdr_s {
+    std::atomic<uint64_t> magic;
+    uint64_t size;
+    uint64_t data;                  // 第一个块的偏移
+    pthread_mutex_t mtx;            // 进程共享、健壮，只保护切分
+    std::atomic<uint64_t> top;      // 未切分区域的偏移
+    std::atomic<uint64_t> root;
+    // 各级空闲链表头: 版本号(高32位) | 偏移/16(低32位)
+    std::atomic<uint64_t> heads[SHM_POOL_CLASSES];
+};
+
+static uint32_t s_pid = 0;
+static std::once_flag s_pid_once;
+
+static void shm_pool_pid_update(void) {
+    s_pid = (uint32_t)getpid();
+}
+
+// NOTE: 进程号缓存在本进程，fork后子进程更新
+static inline uint32_t shm_pool_pid(void) {
+    std::call_once(s_pid_once, [] {
+        shm_pool_pid_update();
+        pthread_atfork(NULL, NULL, shm_pool_pid_update);
+    });
+    return s_pid;
+}
+
+static inline uint32_t shm_size_class(size_t size) {
+    if (size <= 128) {
+        return size ? (uint32_t)((size + 15) >> 4) - 1 : 0;
+    }
+    size_t w = size - 1;
+    uint32_t b = 63 - __builtin_clzl(w);
+    return 8 + (b - 7) * 4 + (uint32_t)((w >> (b - 2)) & 3);
+}
+
+static inline uint64_t shm_class_size(uint32_t cls) {
+    if (cls < 8) {
+        return (uint64_t)(cls + 1) << 4;
+    }
+    uint32_t k = cls - 8;
+    uint32_t b = 7 + k / 4;
+    return ((uint64_t)1 << b) + ((uint64_t)(k % 4 + 1) << (b - 2));
+}
+
+static int shm_pool_lock(shm_pool_hdr_t *hdr) {
+    int ret = pthread_mutex_lock(&hdr->mtx);
+    if (ret == EOWNERDEAD) {
+        // 持锁进程崩溃，块头写完才发布top，区域仍一致
+        SHM_POOL_LOG(INFO) << "lock owner died, pool made consistent\n";
+        pthread_mutex_consistent(&hdr->mtx);
+        ret = 0;
+    }
+    return ret;
+}
+
+static bool shm_pid_dead(uint32_t pid) {
+    return kill((pid_t)pid, 0) != 0 && errno == ESRCH;
+}
+
+MemoryShmPool::MemoryShmPool(void *addr, size_t len, bool create)
+    : hdr_(NULL), base_((char *)addr) {
+    shm_pool_hdr_t *hdr = (shm_pool_hdr_t *)addr;
+    uint64_t data = (sizeof(shm_pool_hdr_t) + 63) & ~(uint64_t)63;
+
+    if (!addr || ((uintptr_t)addr & (SHM_POOL_ALIGN - 1))) {
+        SHM_POOL_LOG(ERROR) << "bad pool address\n";
+        return;
+    }
+
+    if (!create) {
+        if (len < sizeof(shm_pool_hdr_t) || hdr->magic.load(std::memory_order_acquire) != SHM_POOL_MAGIC ||
+            hdr->size > len) {
+            SHM_POOL_LOG(ERROR) << "not an initialized pool\n";
+            return;
+        }
+        hdr_ = hdr;
+        return;
+    }
+
+    if (len < data + 4096 || len > SHM_POOL_MAX_SIZE) {
+        SHM_POOL_LOG(ERROR) << "bad pool size " << len << "\n";
+        return;
+    }
+
+    memset((void *)hdr, 0, sizeof(shm_pool_hdr_t));
+    pthread_mutexattr_t attr;
+    pthread_mutexattr_init(&attr);
+    pthread_mutexattr_setpshared(&attr, PTHREAD_PROCESS_SHARED);
+    pthread_mutexattr_setrobust(&attr, PTHREAD_MUTEX_ROBUST);
+    int ret = pthread_mutex_init(&hdr->mtx, &attr);
+    pthread_mutexattr_destroy(&attr);
+    if (ret != 0) {
+        SHM_POOL_LOG(ERROR) << "mutex init failed " << ret << "\n";
+        return;
+    }
+
+    hdr->size = len & ~(uint64_t)(SHM_POOL_ALIGN - 1);
+    hdr->data = data;
+    hdr->top.store(data, std::memory_order_relaxed);
+    hdr->root.store(0, std::memory_order_relaxed);
+    for (uint32_t i = 0; i < SHM_POOL_CLASSES; i++) {
+        hdr->heads[i].store(0, std::memory_order_relaxed);
+    }
+    // 最后写magic，与挂接方的 acquire 配对，看到magic时其余已就绪
+    hdr->magic.store(SHM_POOL_MAGIC, std::memory_order_release);
+    hdr_ = hdr;
+}
+
+// NOTE: 池在共享内存中，析构不动区域
+MemoryShmPool::~MemoryShmPool() {}
+
+void *MemoryShmPool::carve(uint32_t cls) {
+    uint64_t need = sizeof(shm_block_t) + shm_class_size(cls);
+    shm_block_t *b = NULL;
+
+    if (shm_pool_lock(hdr_) != 0) {
+        return NULL;
+    }
+    uint64_t top = hdr_->top.load(std::memory_order_relaxed);
+    if (need <= hdr_->size - top) {
+        b = (shm_block_t *)(base_ + top);
+        b->owner.store(shm_pool_pid(), std::memory_order_relaxed);
+        b->cls = (uint16_t)cls;
+        b->magic = SHM_BLOCK_MAGIC;
+        b->next.store(0, std::memory_order_relaxed);
+        // NOTE: 块头写完再发布，recover 按块头遍历到top
+        hdr_->top.store(top + need, std::memory_order_release);
+    }
+    pthread_mutex_unlock(&hdr_->mtx);
+
+    return b ? (void *)(b + 1) : NULL;
+}
+
+void *MemoryShmPool::alloc(size_t size) {
+    if (!hdr_ || size > hdr_->size) {
+        return NULL;
+    }
+    uint32_t cls = shm_size_class(size);
+    std::atomic<uint64_t> *head = &hdr_->heads[cls];
+
+    // 无锁出栈，版本号每次加一，被别人取走再放回的块CAS会失败
+    uint64_t h = head->load(std::memory_order_acquire);
+    while (SHM_HEAD_OFF(h)) {
+        shm_block_t *b = (shm_block_t *)(base_ + SHM_HEAD_OFF(h));
+        uint64_t next = b->next.load(std::memory_order_relaxed);
+        if (head->compare_exchange_weak(h, SHM_HEAD(SHM_HEAD_TAG(h) + 1, next),
+                                        std::memory_order_acquire, std::memory_order_acquire)) {
+            b->owner.store(shm_pool_pid(), std::memory_order_relaxed);
+            return b + 1;
+        }
+    }
+
+    return carve(cls);
+}
+
+static void shm_pool_push(shm_pool_hdr_t *hdr, char *base, shm_block_t *b) {
+    std::atomic<uint64_t> *head = &hdr->heads[b->cls];
+    uint64_t off = (char *)b - base;
+    uint64_t h = head->load(std::memory_order_relaxed);
+    do {
+        b->next.store(SHM_HEAD_OFF(h), std::memory_order_relaxed);
+    } while (!head->compare_exchange_weak(h, SHM_HEAD(SHM_HEAD_TAG(h) + 1, off),
+                                          std::memory_order_release, std::memory_order_relaxed));
+}
+
+static shm_block_t *shm_pool_block(shm_pool_hdr_t *hdr, char *base, void *p) {
+    if (!hdr || !p) {
+        return NULL;
+    }
+    uint64_t off = (char *)p - base;
+    if ((char *)p < base || off < hdr->data + sizeof(shm_block_t) ||
+        off > hdr->top.load(std::memory_order_acquire) || (off & (SHM_POOL_ALIGN - 1))) {
+        SHM_POOL_LOG(ERROR) << "outside of pool\n";
+        return NULL;
+    }
+    shm_block_t *b = (shm_block_t *)p - 1;
+    if (b->magic != SHM_BLOCK_MAGIC || b->cls >= SHM_POOL_CLASSES) {
+        SHM_POOL_LOG(ERROR) << "pointer to wrong block\n";
+        return NULL;
+    }
+    return b;
+}
+
+// 块是否在该级空闲链表中，遍历超过 limit 块视为在
+static bool shm_pool_linked(shm_pool_hdr_t *hdr, char *base, shm_block_t *b, uint64_t limit) {
+    uint64_t target = (char *)b - base;
+    uint64_t off = SHM_HEAD_OFF(hdr->heads[b->cls].load(std::memory_order_acquire));
+    while (off && limit--) {
+        if (off == target) {
+            return true;
+        }
+        off = ((shm_block_t *)(base + off))->next.load(std::memory_order_relaxed);
+    }
+    return off != 0;
+}
+
+void MemoryShmPool::free(void *p) {
+    shm_block_t *b = shm_pool_block(hdr_, base_, p);
+    if (!b) {
+        return;
+    }
+    // 先标记释放中再入链表，进程在两步之间崩溃由 recover 判断是否已入链
+    uint32_t freeing = SHM_OWNER_FREEING | shm_pool_pid();
+    uint32_t owner = b->owner.load(std::memory_order_relaxed);
+    do {
+        if (owner == SHM_OWNER_FREE || SHM_OWNER_IS_FREEING(owner)) {
+            SHM_POOL_LOG(ERROR) << "block is already free\n";
+            return;
+        }
+    } while (!b->owner.compare_exchange_weak(owner, freeing, std::memory_order_acq_rel,
+                                             std::memory_order_relaxed));
+    shm_pool_push(hdr_, base_, b);
+    // NOTE: 入链后可能已被 alloc 取走并改写属主，此时不动
+    b->owner.compare_exchange_strong(freeing, SHM_OWNER_FREE, std::memory_order_relaxed);
+}
+
+void MemoryShmPool::detach(void *p) {
+    shm_block_t *b = shm_pool_block(hdr_, base_, p);
+    if (b) {
+        b->owner.store(SHM_OWNER_POOL, std::memory_order_relaxed);
+    }
+}
+
+uint64_t MemoryShmPool::offset(const void *p) const {
+    return p ? (uint64_t)((const char *)p - base_) : 0;
+}
+
+void *MemoryShmPool::ptr(uint64_t off) const {
+    return off ? base_ + off : NULL;
+}
+
+void MemoryShmPool::set_root(void *p) {
+    if (hdr_) {
+        hdr_->root.store(offset(p), std::memory_order_release);
+    }
+}
+
+void *MemoryShmPool::root(void) const {
+    return hdr_ ? ptr(hdr_->root.load(std::memory_order_acquire)) : NULL;
+}
+
+size_t MemoryShmPool::recover(void) {
+    size_t n = 0;
+
+    if (!hdr_ || shm_pool_lock(hdr_) != 0) {
+        return 0;
+    }
+    uint64_t top = hdr_->top.load(std::memory_order_acquire);
+    uint64_t off = hdr_->data;
+    uint64_t limit = (top - off) / (sizeof(shm_block_t) + SHM_POOL_ALIGN);
+    uint32_t last_dead = 0;
+    while (off < top) {
+        shm_block_t *b = (shm_block_t *)(base_ + off);
+        uint32_t owner = b->owner.load(std::memory_order_relaxed);
+        uint32_t pid = SHM_OWNER_IS_FREEING(owner) ? owner & ~SHM_OWNER_FREEING : owner;
+        if (owner != SHM_OWNER_FREE && owner != SHM_OWNER_POOL &&
+            (pid == last_dead || shm_pid_dead(pid))) {
+            last_dead = pid;
+            if (SHM_OWNER_IS_FREEING(owner)) {
+                // NOTE: 不在链表中的块可能已被 alloc 取出还没写进程号，再放回会重复分配，
+                // 只给链表中的收尾；alloc 取出后直接写属主，与这里的CAS谁先都不影响
+                if (shm_pool_linked(hdr_, base_, b, limit)) {
+                    b->owner.compare_exchange_strong(owner, SHM_OWNER_FREE, std::memory_order_relaxed);
+                }
+            } else if (b->owner.compare_exchange_strong(owner, SHM_OWNER_FREE,
+                                                        std::memory_order_acq_rel)) {
+                // NOTE: 与并发的 free 竞争，只有一方能把块放回链表
+                shm_pool_push(hdr_, base_, b);
+                n++;
+            }
+        }
+        off += sizeof(shm_block_t) + shm_class_size(b->cls);
+    }
+    pthread_mutex_unlock(&hdr_->mtx);
+
+    if (n) {
+        SHM_POOL_LOG(INFO) << "recovered " << n << " blocks\n";
+    }
+    return n;
+}
+
+void MemoryShmPool::stat(shm_pool_stat_t &st) {
+    memset(&st, 0, sizeof(st));
+    if (!hdr_ || shm_pool_lock(hdr_) != 0) {
+        return;
+    }
+    uint64_t top = hdr_->top.load(std::memory_order_acquire);
+    uint64_t off = hdr_->data;
+    st.pool_size = hdr_->size;
+    st.carved_size = top - hdr_->data;
+    while (off < top) {
+        shm_block_t *b = (shm_block_t *)(base_ + off);
+        uint64_t size = sizeof(shm_block_t) + shm_class_size(b->cls);
+        uint32_t owner = b->owner.load(std::memory_order_relaxed);
+        if (owner == SHM_OWNER_FREE || SHM_OWNER_IS_FREEING(owner)) {
+            st.free_blocks++;
+        } else {
+            st.used_blocks++;
+            st.used_size += size;
+            if (owner == SHM_OWNER_POOL) {
+                st.detached_blocks++;
+            }
+        }
+        off += size;
+    }
+    pthread_mutex_unlock(&hdr_->mtx);
+}
+
+}  // namespace sdk
+
+}  // namespace ars
@@ -27,11 +27,18 @@
 #define ARS_LOG_MODULE_NAME "sdk-memory-slab"
 
 #include "ars/sdk/memory/slab.hpp"
+#include "ars/sdk/memory/mem.hpp"
 #include "sdk/log/in_log.hpp"
 
+#include <pthread.h>
 #include <string.h>
 #include <unistd.h>
 
+#include <atomic>
+#include <memory>
+#include <mutex>
+#include <vector>
+
 #include "ars/sdk/macros/defs.hpp"
 
 #define SLAB_LOG(severity) ARS_IN_LOG(severity)
@@ -93,25 +100,105 @@ struct slab_pool_s {
     void *addr;
 };
 
+/* 线程缓存 */
+#define SLAB_CACHE_CLASSES 16              /* 缓存的大小类上限 */
+#define SLAB_CACHE_BATCH_BYTES (16 * 1024) /* 每批最多字节数 */
+
+typedef struct slab_cache_class_s {
+    void *head; /* 空闲块链表，next指针存在块首 */
+    uint32_t count;
+} slab_cache_class_t;
+
+typedef struct slab_thread_cache_s slab_thread_cache_t;
+
+/* 池的缓存登记，池析构后仍由线程缓存持有，线程退出时据此判断能否归还 */
+typedef struct slab_cache_registry_s {
+    std::mutex mtx;
+    bool alive;
+    MemorySlabImpl *slab;
+    std::vector<slab_thread_cache_t *> caches;
+} slab_cache_registry_t;
+
+struct slab_thread_cache_s {
+    uint64_t slab_id;
+    unsigned fork_gen;
+    std::shared_ptr<slab_cache_registry_t> registry;
+    std::atomic<size_t> cached_bytes;
+    slab_cache_class_t classes[SLAB_CACHE_CLASSES];
+};
+
+/* 本线程各池的缓存，线程退出时归还 */
+struct slab_thread_caches_s {
+    std::vector<slab_thread_cache_t *> caches;
+    slab_thread_cache_t *last = nullptr;
+
+    ~slab_thread_caches_s();
+};
+
+static thread_local slab_thread_caches_s tls_slab_caches;
+static std::atomic<uint64_t> slab_next_id(1);
+/* fork后加1，子进程中继承的缓存块仍属父进程 */
+static std::atomic<unsigned> slab_fork_gen(0);
+static std::once_flag slab_atfork_once;
+
 class MemorySlabImpl {
 public:
     MemorySlabImpl(void *addr, size_t len, ILock *mem_lock,
                    uint8_t min_size_shift)
-        : mtx_(mem_lock) {
+        : mtx_(mem_lock), cache_on_(false), id_(slab_next_id++) {
         pool_ = (slab_pool_t *)addr;
 
+        // 按页策略建议透明大页、锁定池内存，避免运行中缺页
+        int policy = ars_page_policy();
+        if (policy != ARS_PAGE_DEFAULT) {
+            ars_page_advise(addr, len, policy);
+        }
+
         pool_->addr = addr;
         pool_->min_shift = min_size_shift;
         pool_->end = (uint8_t *)addr + len;
 
+        memset(cache_batch_, 0, sizeof(cache_batch_));
+        registry_ = std::make_shared<slab_cache_registry_t>();
+        registry_->alive = true;
+        registry_->slab = this;
+
         init();
     }
 
-    ~MemorySlabImpl() {}
+    ~MemorySlabImpl() {
+        // NOTE: 缓存的块随池一起失效，线程退出时不再归还
+        std::lock_guard<std::mutex> guard(registry_->mtx);
+        registry_->alive = false;
+    }
 
     void *alloc(size_t size) {
         void *p;
 
+        if (cache_on_ && size < slab_max_size_) {
+            uintptr_t shift = size_shift(size);
+            uintptr_t slot = shift - pool_->min_shift;
+
+            if (slot < SLAB_CACHE_CLASSES && cache_batch_[slot]) {
+                slab_thread_cache_t *c = thread_cache();
+                slab_cache_class_t *cl = &c->classes[slot];
+
+                if (cl->count == 0) {
+                    cache_refill(c, slot, shift);
+                    if (cl->count == 0) {
+                        return NULL;
+                    }
+                }
+
+                p = cl->head;
+                cl->head = *(void **)p;
+                cl->count--;
+                cache_count(c, -(ssize_t)((size_t)1 << shift));
+
+                return p;
+            }
+        }
+
         mtx_->lock();
         p = _alloc(size);
         mtx_->unlock();
@@ -120,11 +207,72 @@ public:
     }
 
     void free(void *p) {
+        if (cache_on_) {
+            uintptr_t shift;
+            int slot = cache_slot(p, &shift);
+
+            if (slot >= 0) {
+                slab_thread_cache_t *c = thread_cache();
+                slab_cache_class_t *cl = &c->classes[slot];
+
+                *(void **)p = cl->head;
+                cl->head = p;
+                cl->count++;
+                cache_count(c, (ssize_t)((size_t)1 << shift));
+
+                if (cl->count >= 2 * cache_batch_[slot]) {
+                    cache_flush(c, slot, cache_batch_[slot]);
+                }
+
+                return;
+            }
+        }
+
         mtx_->lock();
         _free(p);
         mtx_->unlock();
     }
 
+    void enable_thread_cache(uint32_t batch) {
+        std::call_once(slab_atfork_once, [] {
+            pthread_atfork(NULL, NULL, [] { slab_fork_gen++; });
+        });
+
+        for (uintptr_t slot = 0; slot < SLAB_CACHE_CLASSES; slot++) {
+            uintptr_t shift = pool_->min_shift + slot;
+            uintptr_t size = (uintptr_t)1 << shift;
+
+            // NOTE: 块要放得下next指针，半页及以上按整页分配不缓存
+            if (size >= slab_max_size_ || size < sizeof(void *)) {
+                cache_batch_[slot] = 0;
+                continue;
+            }
+
+            uintptr_t n = SLAB_CACHE_BATCH_BYTES / size;
+            cache_batch_[slot] = n < batch ? (n ? n : 1) : batch;
+        }
+
+        cache_on_ = batch != 0;
+    }
+
+    void flush_thread_cache(void) {
+        for (auto c : tls_slab_caches.caches) {
+            if (c->slab_id == id_) {
+                cache_flush_all(c);
+                break;
+            }
+        }
+    }
+
+    // NOTE: 线程退出时持有registry->mtx调用
+    void cache_flush_all(slab_thread_cache_t *c) {
+        for (uintptr_t slot = 0; slot < SLAB_CACHE_CLASSES; slot++) {
+            if (c->classes[slot].count) {
+                cache_flush(c, slot, c->classes[slot].count);
+            }
+        }
+    }
+
     void stat(slab_stat_t &st) {
         uintptr_t m, n, mask, slab;
         uintptr_t *bitmap;
@@ -231,6 +379,21 @@ public:
             page = pool_->pages + i + 1;
         }
 
+        {
+            // NOTE: 缓存块在池中是已分配的
+            std::lock_guard<std::mutex> guard(registry_->mtx);
+            unsigned gen = slab_fork_gen.load(std::memory_order_relaxed);
+
+            for (auto c : registry_->caches) {
+                if (c->fork_gen == gen) {
+                    st.b_cached +=
+                        c->cached_bytes.load(std::memory_order_relaxed);
+                }
+            }
+        }
+
+        st.used_size -= st.b_cached < st.used_size ? st.b_cached : st.used_size;
+
         st.pool_size = pool_->end - pool_->start;
         st.used_pct = st.used_size * 100 / st.pool_size;
 
@@ -251,9 +414,179 @@ public:
                   << ", \tbytes : " << st.b_page << "\n";
 
         SLAB_LOG(INFO) << "max free pages : " << st.max_free_pages << "\n";
+        SLAB_LOG(INFO) << "thread cached : " << st.b_cached << " bytes\n";
     }
 
 private:
+    uintptr_t size_shift(size_t size) {
+        uintptr_t shift;
+        size_t s;
+
+        if (size <= pool_->min_size) {
+            return pool_->min_shift;
+        }
+
+        shift = 1;
+        for (s = size - 1; s >>= 1; shift++) { /* void */
+        }
+
+        return shift;
+    }
+
+    // NOTE: 只有所属线程写，stat读，不必原子加
+    static void cache_count(slab_thread_cache_t *c, ssize_t bytes) {
+        c->cached_bytes.store(
+            c->cached_bytes.load(std::memory_order_relaxed) + bytes,
+            std::memory_order_relaxed);
+    }
+
+    slab_thread_cache_t *thread_cache(void) {
+        slab_thread_caches_s &tls = tls_slab_caches;
+        slab_thread_cache_t *c = tls.last;
+
+        if (c == NULL || c->slab_id != id_) {
+            c = NULL;
+            for (auto x : tls.caches) {
+                if (x->slab_id == id_) {
+                    c = x;
+                    break;
+                }
+            }
+
+            if (c == NULL) {
+                c = cache_new(tls);
+            }
+
+            tls.last = c;
+        }
+
+        unsigned gen = slab_fork_gen.load(std::memory_order_relaxed);
+        if (c->fork_gen != gen) {
+            // NOTE: 子进程，丢弃继承的块，它们还在父进程中使用
+            memset(c->classes, 0, sizeof(c->classes));
+            c->cached_bytes.store(0, std::memory_order_relaxed);
+            c->fork_gen = gen;
+        }
+
+        return c;
+    }
+
+    slab_thread_cache_t *cache_new(slab_thread_caches_s &tls) {
+        // NOTE: 顺便清掉已析构的池的缓存
+        for (auto it = tls.caches.begin(); it != tls.caches.end();) {
+            slab_thread_cache_t *x = *it;
+            std::unique_lock<std::mutex> guard(x->registry->mtx);
+
+            if (x->registry->alive) {
+                ++it;
+                continue;
+            }
+
+            guard.unlock();
+            it = tls.caches.erase(it);
+            delete x;
+        }
+
+        slab_thread_cache_t *c = new slab_thread_cache_t;
+
+        c->slab_id = id_;
+        c->fork_gen = slab_fork_gen.load(std::memory_order_relaxed);
+        c->registry = registry_;
+        c->cached_bytes.store(0, std::memory_order_relaxed);
+        memset(c->classes, 0, sizeof(c->classes));
+
+        {
+            std::lock_guard<std::mutex> guard(registry_->mtx);
+            registry_->caches.push_back(c);
+        }
+        tls.caches.push_back(c);
+
+        return c;
+    }
+
+    // @return 可缓存的块的大小类，否则-1
+    int cache_slot(void *p, uintptr_t *shift) {
+        uintptr_t n, type, slab, slot;
+        slab_page_t *page;
+
+        if ((uint8_t *)p < pool_->start || (uint8_t *)p >= pool_->end) {
+            return -1;
+        }
+
+        // NOTE: 块未释放时其page的类型和大小不变，其余位可能被其他线程加锁修改
+        n = ((uint8_t *)p - pool_->start) >> pagesize_shift_;
+        page = &pool_->pages[n];
+        type = __atomic_load_n(&page->prev, __ATOMIC_RELAXED) &
+               NCX_SLAB_PAGE_MASK;
+        slab = __atomic_load_n(&page->slab, __ATOMIC_RELAXED);
+
+        switch (type) {
+            case NCX_SLAB_SMALL:
+            case NCX_SLAB_BIG:
+                *shift = slab & NCX_SLAB_SHIFT_MASK;
+                break;
+
+            case NCX_SLAB_EXACT:
+                *shift = slab_exact_shift_;
+                break;
+
+            default:
+                return -1;
+        }
+
+        // NOTE: 错位的指针走加锁路径报错
+        if ((uintptr_t)p & (((uintptr_t)1 << *shift) - 1)) {
+            return -1;
+        }
+
+        slot = *shift - pool_->min_shift;
+        if (slot >= SLAB_CACHE_CLASSES || cache_batch_[slot] == 0) {
+            return -1;
+        }
+
+        return (int)slot;
+    }
+
+    void cache_refill(slab_thread_cache_t *c, uintptr_t slot, uintptr_t shift) {
+        slab_cache_class_t *cl = &c->classes[slot];
+        size_t size = (size_t)1 << shift;
+        uint32_t n;
+        void *p;
+
+        mtx_->lock();
+        for (n = 0; n < cache_batch_[slot]; n++) {
+            p = _alloc(size);
+            if (p == NULL) {
+                break;
+            }
+
+            *(void **)p = cl->head;
+            cl->head = p;
+        }
+        mtx_->unlock();
+
+        cl->count += n;
+        cache_count(c, (ssize_t)(n * size));
+    }
+
+    void cache_flush(slab_thread_cache_t *c, uintptr_t slot, uint32_t n) {
+        slab_cache_class_t *cl = &c->classes[slot];
+        size_t size = (size_t)1 << (pool_->min_shift + slot);
+        uint32_t i;
+        void *p;
+
+        mtx_->lock();
+        for (i = 0; i < n && cl->head; i++) {
+            p = cl->head;
+            cl->head = *(void **)p;
+            _free(p);
+        }
+        mtx_->unlock();
+
+        cl->count -= i;
+        cache_count(c, -(ssize_t)(i * size));
+    }
+
     void *_alloc(size_t size) {
         size_t s;
         uintptr_t p, n, m, mask, *bitmap;
@@ -688,7 +1021,8 @@ private:
 
         slab_max_size_ = pagesize_ / 2;
         slab_exact_size_ = pagesize_ / (8 * sizeof(uintptr_t));
-        for (n = slab_exact_size_; n >>= 1; slab_exact_shift_++) {
+        for (n = slab_exact_size_, slab_exact_shift_ = 0; n >>= 1;
+             slab_exact_shift_++) {
             /* void */
         }
 
@@ -851,6 +1185,12 @@ private:
 
 private:
     ILock *mtx_;
+    // 线程缓存
+    bool cache_on_;
+    uint64_t id_;
+    uint32_t cache_batch_[SLAB_CACHE_CLASSES];
+    std::shared_ptr<slab_cache_registry_t> registry_;
+
     slab_pool_t *pool_;
     uintptr_t slab_max_size_;
     uintptr_t slab_exact_size_;
@@ -860,6 +1200,30 @@ private:
     uintptr_t real_pages_;
 };
 
+slab_thread_caches_s::~slab_thread_caches_s() {
+    for (auto c : caches) {
+        {
+            std::lock_guard<std::mutex> guard(c->registry->mtx);
+
+            if (c->registry->alive) {
+                if (c->fork_gen == slab_fork_gen.load(std::memory_order_relaxed)) {
+                    c->registry->slab->cache_flush_all(c);
+                }
+
+                auto &v = c->registry->caches;
+                for (auto it = v.begin(); it != v.end(); ++it) {
+                    if (*it == c) {
+                        v.erase(it);
+                        break;
+                    }
+                }
+            }
+        }
+
+        delete c;
+    }
+}
+
 MemorySlab::MemorySlab(void *addr, size_t len, ILock *mem_lock,
                        uint8_t min_size_shift) {
     impl_ = new MemorySlabImpl(addr, len, mem_lock, min_size_shift);
@@ -873,6 +1237,12 @@ void MemorySlab::free(void *p) { impl_->free(p); }
 
 void MemorySlab::stat(slab_stat_t &st) { impl_->stat(st); }
 
+void MemorySlab::enable_thread_cache(uint32_t batch) {
+    impl_->enable_thread_cache(batch);
+}
+
+void MemorySlab::flush_thread_cache(void) { impl_->flush_thread_cache(); }
+
 }  // namespace sdk
 
 }  // namespace ars
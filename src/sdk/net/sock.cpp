@@ -529,6 +529,17 @@ int sock_set_addr_reuse(int fd) {
     return setsockopt(fd, SOL_SOCKET, SO_REUSEADDR, &v, sizeof(v));
 }
 
+// 端口重用
+int sock_set_port_reuse(int fd, bool en) {
+#ifdef SO_REUSEPORT
+    int v = en ? 1 : 0;
+    return setsockopt(fd, SOL_SOCKET, SO_REUSEPORT, &v, sizeof(v));
+#else
+    errno = ENOPROTOOPT;
+    return -1;
+#endif
+}
+
 // 关闭延迟
 int sock_set_nodelay(int fd, bool en) {
     int v = en ? 1 : 0;
@@ -30,6 +30,11 @@
 #include <unistd.h>
 #include <stdlib.h>
 #include <sys/types.h>
+#include <time.h>
+#include <list>
+#include <mutex>
+#include <string>
+#include <unordered_map>
 
 namespace ars {
 
@@ -59,6 +64,117 @@ ssl_ctx_t ssl_ctx_instance() {
 #include <openssl/ssl.h>
 #include <openssl/err.h>
 
+// NOTE: shards of the server session cache, handshakes on different loops
+// seldom wait for the same lock.
+#define SSL_SESSION_CACHE_SHARDS 16
+
+struct ssl_session_shard_t {
+    typedef std::list<std::string> lru_t;
+    struct entry_t {
+        SSL_SESSION* session;
+        lru_t::iterator lru;
+    };
+    std::mutex mutex;
+    std::unordered_map<std::string, entry_t> sessions;
+    lru_t lru;  // least recently used at front
+};
+
+struct ssl_session_cache_t {
+    size_t capacity;  // of each shard
+    ssl_session_shard_t shards[SSL_SESSION_CACHE_SHARDS];
+};
+
+static int s_session_cache_index = -1;
+
+static ssl_session_shard_t* __session_shard(SSL_CTX* ctx, const unsigned char* id, unsigned int len) {
+    ssl_session_cache_t* cache = (ssl_session_cache_t*)SSL_CTX_get_ex_data(ctx, s_session_cache_index);
+    if (cache == NULL || len == 0) return NULL;
+    // NOTE: session ids are random bytes.
+    return &cache->shards[id[0] % SSL_SESSION_CACHE_SHARDS];
+}
+
+static void __session_erase(ssl_session_shard_t* shard, const std::string& key) {
+    auto iter = shard->sessions.find(key);
+    if (iter == shard->sessions.end()) return;
+    SSL_SESSION_free(iter->second.session);
+    shard->lru.erase(iter->second.lru);
+    shard->sessions.erase(iter);
+}
+
+// @return 1 the cache holds the reference of session
+static int __session_new_cb(SSL* ssl, SSL_SESSION* session) {
+    SSL_CTX* ctx = SSL_get_SSL_CTX(ssl);
+    unsigned int len = 0;
+    const unsigned char* id = SSL_SESSION_get_id(session, &len);
+    ssl_session_shard_t* shard = __session_shard(ctx, id, len);
+    if (shard == NULL) return 0;
+    ssl_session_cache_t* cache = (ssl_session_cache_t*)SSL_CTX_get_ex_data(ctx, s_session_cache_index);
+    std::string key((const char*)id, len);
+    std::lock_guard<std::mutex> lock(shard->mutex);
+    __session_erase(shard, key);
+    while (!shard->sessions.empty() && shard->sessions.size() >= cache->capacity) {
+        __session_erase(shard, shard->lru.front());
+    }
+    shard->lru.push_back(key);
+    ssl_session_shard_t::entry_t entry = {session, --shard->lru.end()};
+    shard->sessions.emplace(std::move(key), entry);
+    return 1;
+}
+
+static SSL_SESSION* __session_get_cb(SSL* ssl, const unsigned char* id, int len, int* copy) {
+    *copy = 0;
+    ssl_session_shard_t* shard = __session_shard(SSL_get_SSL_CTX(ssl), id, len);
+    if (shard == NULL) return NULL;
+    std::string key((const char*)id, len);
+    std::lock_guard<std::mutex> lock(shard->mutex);
+    auto iter = shard->sessions.find(key);
+    if (iter == shard->sessions.end()) return NULL;
+    SSL_SESSION* session = iter->second.session;
+    if (SSL_SESSION_get_time(session) + SSL_SESSION_get_timeout(session) < (long)time(NULL)) {
+        __session_erase(shard, key);
+        return NULL;
+    }
+    shard->lru.splice(shard->lru.end(), shard->lru, iter->second.lru);
+    // NOTE: referenced under the lock, an eviction on another loop may free the cache's one
+    // as soon as it is released, openssl owns the returned reference with copy 0.
+    SSL_SESSION_up_ref(session);
+    return session;
+}
+
+static void __session_remove_cb(SSL_CTX* ctx, SSL_SESSION* session) {
+    unsigned int len = 0;
+    const unsigned char* id = SSL_SESSION_get_id(session, &len);
+    ssl_session_shard_t* shard = __session_shard(ctx, id, len);
+    if (shard == NULL) return;
+    std::lock_guard<std::mutex> lock(shard->mutex);
+    __session_erase(shard, std::string((const char*)id, len));
+}
+
+static void __session_cache_free(void* parent, void* ptr, CRYPTO_EX_DATA* ad, int idx, long argl, void* argp) {
+    ssl_session_cache_t* cache = (ssl_session_cache_t*)ptr;
+    if (cache == NULL) return;
+    for (auto& shard : cache->shards) {
+        for (auto& kv : shard.sessions) {
+            SSL_SESSION_free(kv.second.session);
+        }
+    }
+    delete cache;
+}
+
+static int __session_cache_init(SSL_CTX* ctx, int size) {
+    ssl_session_cache_t* cache = new ssl_session_cache_t;
+    cache->capacity = (size + SSL_SESSION_CACHE_SHARDS - 1) / SSL_SESSION_CACHE_SHARDS;
+    if (!SSL_CTX_set_ex_data(ctx, s_session_cache_index, cache)) {
+        delete cache;
+        return -1;
+    }
+    SSL_CTX_set_session_cache_mode(ctx, SSL_SESS_CACHE_SERVER | SSL_SESS_CACHE_NO_INTERNAL);
+    SSL_CTX_sess_set_new_cb(ctx, __session_new_cb);
+    SSL_CTX_sess_set_get_cb(ctx, __session_get_cb);
+    SSL_CTX_sess_set_remove_cb(ctx, __session_remove_cb);
+    return 0;
+}
+
 ssl_ctx_t ssl_ctx_init(ssl_ctx_init_param_t* param) {
     static int s_initialized = 0;
     if (s_initialized == 0) {
@@ -68,6 +184,7 @@ ssl_ctx_t ssl_ctx_init(ssl_ctx_init_param_t* param) {
 #else
         OPENSSL_init_ssl(OPENSSL_INIT_SSL_DEFAULT, NULL);
 #endif
+        s_session_cache_index = SSL_CTX_get_ex_new_index(0, NULL, NULL, NULL, __session_cache_free);
         s_initialized = 1;
     }
 
@@ -105,6 +222,23 @@ ssl_ctx_t ssl_ctx_init(ssl_ctx_init_param_t* param) {
         if (param->verify_peer) {
             mode = SSL_VERIFY_PEER;
         }
+        if (param->endpoint == 0) {
+            // NOTE: sessions may only be resumed within the same context id.
+            static const unsigned char sid_ctx[] = "ars";
+            SSL_CTX_set_session_id_context(ctx, sid_ctx, sizeof(sid_ctx) - 1);
+            if (param->session_cache > 0 && __session_cache_init(ctx, param->session_cache) != 0) {
+                fprintf(stderr, "ssl session cache error!\n");
+                goto error;
+            }
+            if (param->no_session_ticket) {
+                SSL_CTX_set_options(ctx, SSL_OP_NO_TICKET);
+            }
+        }
+        if (param->ktls) {
+#ifdef SSL_OP_ENABLE_KTLS
+            SSL_CTX_set_options(ctx, SSL_OP_ENABLE_KTLS);
+#endif
+        }
     }
     SSL_CTX_set_verify(ctx, mode, NULL);
     s_ssl_ctx = ctx;
@@ -128,6 +262,8 @@ ssl_t ssl_new(ssl_ctx_t ssl_ctx, int fd) {
     SSL* ssl = SSL_new((SSL_CTX*)ssl_ctx);
     if (ssl == NULL) return NULL;
     SSL_set_fd(ssl, fd);
+    // NOTE: a write got SSL_WANT_WRITE is queued by copy and retried from the write_queue.
+    SSL_set_mode(ssl, SSL_MODE_ACCEPT_MOVING_WRITE_BUFFER);
     return ssl;
 }
 
@@ -175,8 +311,29 @@ int ssl_write(ssl_t ssl, const void* buf, int len) {
 }
 
 int ssl_close(ssl_t ssl) {
-    SSL_shutdown((SSL*)ssl);
+    // NOTE: nonblocking, the alert is not resent if the socket is full.
+    if (SSL_is_init_finished((SSL*)ssl)) {
+        SSL_shutdown((SSL*)ssl);
+    }
+    ERR_clear_error();
+    return 0;
+}
+
+int ssl_ctx_set_ticket_keys(ssl_ctx_t ssl_ctx, const void* keys, int len) {
+    if (ssl_ctx == NULL || keys == NULL) return -1;
+    return SSL_CTX_set_tlsext_ticket_keys((SSL_CTX*)ssl_ctx, (void*)keys, len) == 1 ? 0 : -1;
+}
+
+int ssl_session_reused(ssl_t ssl) {
+    return SSL_session_reused((SSL*)ssl) == 1;
+}
+
+int ssl_ktls_send(ssl_t ssl) {
+#ifdef SSL_OP_ENABLE_KTLS
+    return BIO_get_ktls_send(SSL_get_wbio((SSL*)ssl)) ? 1 : 0;
+#else
     return 0;
+#endif
 }
 
 #elif defined(WITH_MBEDTLS)
@@ -253,6 +410,9 @@ ssl_ctx_t ssl_ctx_init(ssl_ctx_init_param_t* param) {
     mbedtls_ssl_conf_rng(&ctx->conf, mbedtls_ctr_drbg_random, &ctx->ctr_drbg);
 
 #if defined(MBEDTLS_SSL_CACHE_C)
+    if (param && param->session_cache > 0) {
+        mbedtls_ssl_cache_set_max_entries(&ctx->cache, param->session_cache);
+    }
     mbedtls_ssl_conf_session_cache(&ctx->conf, &ctx->cache, mbedtls_ssl_cache_get, mbedtls_ssl_cache_set);
 #endif
 
@@ -352,6 +512,18 @@ int ssl_close(ssl_t ssl) {
     return 0;
 }
 
+int ssl_ctx_set_ticket_keys(ssl_ctx_t ssl_ctx, const void* keys, int len) {
+    return -1;
+}
+
+int ssl_session_reused(ssl_t ssl) {
+    return 0;
+}
+
+int ssl_ktls_send(ssl_t ssl) {
+    return 0;
+}
+
 #else
 
 ssl_ctx_t ssl_ctx_init(ssl_ctx_init_param_t* param) {
@@ -390,6 +562,18 @@ int ssl_write(ssl_t ssl, const void* buf, int len) {
 int ssl_close(ssl_t ssl) {
     return 0;
 }
+
+int ssl_ctx_set_ticket_keys(ssl_ctx_t ssl_ctx, const void* keys, int len) {
+    return -1;
+}
+
+int ssl_session_reused(ssl_t ssl) {
+    return 0;
+}
+
+int ssl_ktls_send(ssl_t ssl) {
+    return 0;
+}
 #endif
 
 } // namespace sdk
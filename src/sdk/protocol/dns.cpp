@@ -28,6 +28,7 @@
 #include "ars/sdk/macros/defs.hpp"
 #include "ars/sdk/err/err.hpp"
 #include "ars/sdk/memory/mem.hpp"
+#include "ars/sdk/memory/arena.hpp"
 #include "ars/sdk/net/sock.hpp"
 #include <unistd.h>
 #include <string.h>
@@ -37,10 +38,11 @@ namespace ars {
 namespace sdk {
 
 void dns_free(dns_t* dns) {
-    ARS_SAFE_FREE(dns->questions);
-    ARS_SAFE_FREE(dns->answers);
-    ARS_SAFE_FREE(dns->authorities);
-    ARS_SAFE_FREE(dns->addtionals);
+    // NOTE: rrs come from ARS_ALLOC, free them the same way.
+    ARS_FREE(dns->questions);
+    ARS_FREE(dns->answers);
+    ARS_FREE(dns->authorities);
+    ARS_FREE(dns->addtionals);
 }
 
 // www.example.com => 3www7example3com
@@ -132,16 +134,26 @@ int dns_rr_pack(dns_rr_t* rr, char* buf, int len) {
 int dns_rr_unpack(char* buf, int len, dns_rr_t* rr, int is_question) {
     char* p = buf;
     int off = 0;
+    // NOTE: walk labels within len first, the packet comes from network.
     int namelen = 0;
-    if (*(uint8_t*)p >= 192) {
-        // name off, we ignore
-        namelen = 2;
-        //uint16_t nameoff = (*(uint8_t*)p - 192) * 256 + *(uint8_t*)(p+1);
+    int compressed = 0;
+    for (;;) {
+        if (namelen >= len) return -1;
+        uint8_t label = *(uint8_t*)(buf + namelen);
+        if (label >= 192) {
+            // name off, we ignore
+            compressed = 1;
+            namelen += 2;
+            break;
+        }
+        ++namelen;
+        if (label == 0) break;
+        namelen += label;
     }
-    else {
-        namelen = dns_name_decode(buf, rr->name);
+    if (namelen > len || namelen > ARS_DNS_NAME_MAXLEN) return -1;
+    if (!compressed && namelen > 1) {
+        dns_name_decode(buf, rr->name);
     }
-    if (namelen < 0) return -1;
     p += namelen;
     off += namelen;
 
@@ -207,7 +219,31 @@ int dns_pack(dns_t* dns, char* buf, int len) {
     return off;
 }
 
-int dns_unpack(char* buf, int len, dns_t* dns) {
+// @param arena NULL: rrs by ARS_ALLOC
+static dns_rr_t* dns_rrs_alloc(int n, Arena* arena) {
+    dns_rr_t* rrs = NULL;
+    if (arena) {
+        rrs = (dns_rr_t*)arena->zalloc(n * sizeof(dns_rr_t), alignof(dns_rr_t));
+    } else {
+        ARS_ALLOC(rrs, n * sizeof(dns_rr_t));
+    }
+    return rrs;
+}
+
+static int dns_rrs_unpack(char* buf, int len, int n, dns_rr_t** rrs, int is_question, Arena* arena) {
+    if (n == 0) return 0;
+    *rrs = dns_rrs_alloc(n, arena);
+    if (*rrs == NULL) return -1;
+    int off = 0;
+    for (int i = 0; i < n; ++i) {
+        int packetlen = dns_rr_unpack(buf+off, len-off, *rrs+i, is_question);
+        if (packetlen < 0) return -1;
+        off += packetlen;
+    }
+    return off;
+}
+
+static int dns_unpack_impl(char* buf, int len, dns_t* dns, Arena* arena) {
     memset(dns, 0, sizeof(dns_t));
     if ((size_t)len < sizeof(dnshdr_t)) return -1;
     int off = 0;
@@ -219,46 +255,29 @@ int dns_unpack(char* buf, int len, dns_t* dns) {
     hdr->nanswer = ntohs(hdr->nanswer);
     hdr->nauthority = ntohs(hdr->nauthority);
     hdr->naddtional = ntohs(hdr->naddtional);
-    int i;
-    if (hdr->nquestion) {
-        int bytes = hdr->nquestion * sizeof(dns_rr_t);
-        ARS_ALLOC(dns->questions, bytes);
-        for (i = 0; i < hdr->nquestion; ++i) {
-            int packetlen = dns_rr_unpack(buf+off, len-off, dns->questions+i, 1);
-            if (packetlen < 0) return -1;
-            off += packetlen;
-        }
-    }
-    if (hdr->nanswer) {
-        int bytes = hdr->nanswer * sizeof(dns_rr_t);
-        ARS_ALLOC(dns->answers, bytes);
-        for (i = 0; i < hdr->nanswer; ++i) {
-            int packetlen = dns_rr_unpack(buf+off, len-off, dns->answers+i, 0);
-            if (packetlen < 0) return -1;
-            off += packetlen;
-        }
-    }
-    if (hdr->nauthority) {
-        int bytes = hdr->nauthority * sizeof(dns_rr_t);
-        ARS_ALLOC(dns->authorities, bytes);
-        for (i = 0; i < hdr->nauthority; ++i) {
-            int packetlen = dns_rr_unpack(buf+off, len-off, dns->authorities+i, 0);
-            if (packetlen < 0) return -1;
-            off += packetlen;
-        }
-    }
-    if (hdr->naddtional) {
-        int bytes = hdr->naddtional * sizeof(dns_rr_t);
-        ARS_ALLOC(dns->addtionals, bytes);
-        for (i = 0; i < hdr->naddtional; ++i) {
-            int packetlen = dns_rr_unpack(buf+off, len-off, dns->addtionals+i, 0);
-            if (packetlen < 0) return -1;
-            off += packetlen;
-        }
-    }
+    int packetlen = dns_rrs_unpack(buf+off, len-off, hdr->nquestion, &dns->questions, 1, arena);
+    if (packetlen < 0) return -1;
+    off += packetlen;
+    packetlen = dns_rrs_unpack(buf+off, len-off, hdr->nanswer, &dns->answers, 0, arena);
+    if (packetlen < 0) return -1;
+    off += packetlen;
+    packetlen = dns_rrs_unpack(buf+off, len-off, hdr->nauthority, &dns->authorities, 0, arena);
+    if (packetlen < 0) return -1;
+    off += packetlen;
+    packetlen = dns_rrs_unpack(buf+off, len-off, hdr->naddtional, &dns->addtionals, 0, arena);
+    if (packetlen < 0) return -1;
+    off += packetlen;
     return off;
 }
 
+int dns_unpack(char* buf, int len, dns_t* dns) {
+    return dns_unpack_impl(buf, len, dns, NULL);
+}
+
+int dns_unpack(char* buf, int len, dns_t* dns, Arena& arena) {
+    return dns_unpack_impl(buf, len, dns, &arena);
+}
+
 // dns_pack -> sendto -> recvfrom -> dns_unpack
 int dns_query(dns_t* query, dns_t* response, const char* nameserver) {
     char buf[1024];
@@ -32,6 +32,7 @@
 // sub-delims = "!" / "$" / "&" / "'" / "(" / ")" / "*" / "+" / "," / ";" / "="
 
 #include "ars/sdk/str/uri.hpp"
+#include "ars/sdk/memory/arena.hpp"
 #include <stdint.h>
 #include <stdlib.h>
 #include <string.h>
@@ -90,6 +91,27 @@ struct uri_t* uri_parse(const char* uri, int len)
 	return u;
 }
 
+struct uri_t* uri_parse(const char* uri, int len, Arena& arena)
+{
+	struct uri_t* u;
+
+	if (NULL == uri || 0 == *uri || len < 1)
+		return NULL;
+
+	Arena::mark_t mark = arena.mark();
+	u = (struct uri_t*)arena.alloc(sizeof(*u) + len + 5, alignof(struct uri_t));
+	if (NULL == u)
+		return NULL;
+
+	if (0 != uri_parse_complex(u, uri, len))
+	{
+		arena.rewind(mark);
+		return NULL;
+	}
+
+	return u;
+}
+
 void uri_free(struct uri_t* uri)
 {
 	if(uri) free(uri);
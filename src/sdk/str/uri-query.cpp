@@ -25,6 +25,7 @@
  * 
  */
 #include "ars/sdk/str/uri.hpp"
+#include "ars/sdk/memory/arena.hpp"
 #include <stdlib.h>
 #include <string.h>
 #include <assert.h>
@@ -36,7 +37,8 @@ namespace sdk {
 
 #define N 64
 
-int uri_query(const char* query, const char* end, struct uri_query_t** items)
+// @param arena NULL: items by malloc
+static int uri_query_parse(const char* query, const char* end, struct uri_query_t** items, Arena* arena)
 {
 	int count;
 	int capacity;
@@ -62,7 +64,10 @@ int uri_query(const char* query, const char* end, struct uri_query_t** items)
 			}
 			else
 			{
-				uri_query_free(items);
+				if (arena)
+					*items = NULL;
+				else
+					uri_query_free(items);
 				return -1;  // no-name k1=v1&=v2
 			}
 		}
@@ -76,7 +81,10 @@ int uri_query(const char* query, const char* end, struct uri_query_t** items)
 			if (count >= capacity)
 			{
 				capacity = count + 64;
-				pp = (struct uri_query_t*)realloc(*items, capacity * sizeof(struct uri_query_t));
+				if (arena)
+					pp = (struct uri_query_t*)arena->realloc(*items, count * sizeof(struct uri_query_t), capacity * sizeof(struct uri_query_t));
+				else
+					pp = (struct uri_query_t*)realloc(*items, capacity * sizeof(struct uri_query_t));
 				if (!pp) return -ENOMEM;
 				*items = pp;
 			}
@@ -104,7 +112,10 @@ int uri_query(const char* query, const char* end, struct uri_query_t** items)
 
 	if (count <= N && count > 0)
 	{
-		*items = (struct uri_query_t*)malloc(count * sizeof(struct uri_query_t));
+		if (arena)
+			*items = (struct uri_query_t*)arena->alloc(count * sizeof(struct uri_query_t));
+		else
+			*items = (struct uri_query_t*)malloc(count * sizeof(struct uri_query_t));
 		if (!*items) return -ENOMEM;
 		memcpy(*items, items0, count * sizeof(struct uri_query_t));
 	}
@@ -116,6 +127,16 @@ int uri_query(const char* query, const char* end, struct uri_query_t** items)
 	return count;
 }
 
+int uri_query(const char* query, const char* end, struct uri_query_t** items)
+{
+	return uri_query_parse(query, end, items, NULL);
+}
+
+int uri_query(const char* query, const char* end, struct uri_query_t** items, Arena& arena)
+{
+	return uri_query_parse(query, end, items, &arena);
+}
+
 void uri_query_free(struct uri_query_t** items)
 {
 	if (items && *items)
@@ -0,0 +1,52 @@
+/**
+ * Copyright © 2021 <wotsen>.
+ * 
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of this software
+ * and associated documentation files (the “Software”), to deal in the Software without
+ * restriction, including without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sublicense, and/or sell copies of the Software, and to permit persons to whom the
+ * 
+ * The above copyright notice and this permission notice shall be included in all copies or
+ * substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED “AS IS”, WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING
+ * BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM,
+ * DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ * 
+ * @file thread_util.cpp
+ * @brief 线程基本接口
+ * @author wotsen (astralrovers@outlook.com)
+ * @version 1.0.0
+ * @date 2021-05-06
+ * 
+ * @copyright MIT
+ * 
+ */
+#include "ars/sdk/thread/thread_util.hpp"
+#include <errno.h>
+
+namespace ars {
+    
+namespace sdk {
+
+int thread_bind_cpu(pthread_t tid, int cpu) {
+#if !defined(__APPLE__) && defined(__linux__)
+    if (cpu < 0 || cpu >= CPU_SETSIZE) {
+        return -EINVAL;
+    }
+    cpu_set_t cpuset;
+    CPU_ZERO(&cpuset);
+    CPU_SET(cpu, &cpuset);
+    return -::pthread_setaffinity_np(tid, sizeof(cpuset), &cpuset);
+#else
+    if (tid) {}
+    if (cpu) {}
+    return -1;
+#endif
+}
+
+} // namespace sdk
+
+} // namespace ars
@@ -0,0 +1,591 @@
+/**
+ * Copyright © 2021 <wotsen>.
+ * 
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of this software
+ * and associated documentation files (the “Software”), to deal in the Software without
+ * restriction, including without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sublicense, and/or sell copies of the Software, and to permit persons to whom the
+ * 
+ * The above copyright notice and this permission notice shall be included in all copies or
+ * substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED “AS IS”, WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING
+ * BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM,
+ * DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ * 
+ * @file ut_event.cpp
+ * @brief 
+ * @author wotsen (astralrovers@outlook.com)
+ * @version 1.0.0
+ * @date 2021-06-27
+ * 
+ * @copyright MIT
+ * 
+ */
+#include <gtest/gtest.h>
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <unistd.h>
+#include <atomic>
+#include <thread>
+#include <vector>
+
+#include "ars/sdk/event/event.hpp"
+#include "ars/sdk/event/loop.hpp"
+#include "ars/sdk/net/ssl.hpp"
+#include "ut_ssl.hpp"
+
+using namespace ars::sdk;
+using namespace ars::sdk::event;
+
+#define UT_ET_PORT 23510
+#define UT_ET_BIG_BUFS 64
+#define UT_ET_BIG_BUFSIZE (64 * 1024)
+#define UT_ET_SMALL_BUFS 64
+#define UT_ET_SMALL_BUFSIZE 1024
+#define UT_ET_TOTAL (UT_ET_BIG_BUFS * UT_ET_BIG_BUFSIZE + UT_ET_SMALL_BUFS * UT_ET_SMALL_BUFSIZE)
+
+// NOTE: the client does not read yet, the big bufs fill the socket and get queued,
+// the small ones are queued behind. Once the socket drained, a write short of the queue
+// raises no more EPOLLOUT under edge-triggered.
+static void et_ssl_accept_cb(io_t* io) {
+    static char buf[UT_ET_BIG_BUFSIZE];
+    size_t pos = 0;
+    for (int i = 0; i < UT_ET_BIG_BUFS + UT_ET_SMALL_BUFS; ++i) {
+        size_t len = i < UT_ET_BIG_BUFS ? UT_ET_BIG_BUFSIZE : UT_ET_SMALL_BUFSIZE;
+        for (size_t j = 0; j < len; ++j) {
+            buf[j] = (char)((pos + j) % 251);
+        }
+        io_write(io, buf, len);
+        pos += len;
+    }
+}
+
+TEST(Event, EdgeTriggeredSslWriteQueue) {
+    std::string crt, key;
+    ASSERT_TRUE(ut_make_cert(crt, key));
+    ssl_ctx_init_param_t param;
+    memset(&param, 0, sizeof(param));
+    param.crt_file = crt.c_str();
+    param.key_file = key.c_str();
+    param.endpoint = 0;
+    ssl_ctx_t ctx = ssl_ctx_init(&param);
+    ASSERT_TRUE(ctx != NULL);
+
+    loop_t* loop = loop_new(ARS_LOOP_FLAG_EDGE_TRIGGERED);
+    io_t* listenio = loop_create_tcp_server(loop, "127.0.0.1", UT_ET_PORT, et_ssl_accept_cb);
+    ASSERT_TRUE(listenio != NULL);
+    io_enable_ssl(listenio);
+    std::thread runner([loop] { loop_run(loop); });
+
+    SSL_CTX* client_ctx = SSL_CTX_new(TLS_client_method());
+    SSL* ssl = ut_ssl_connect(client_ctx, UT_ET_PORT);
+    ASSERT_TRUE(ssl != NULL);
+    // NOTE: let the server fill the socket and queue the rest, then drain.
+    usleep(200 * 1000);
+    struct timeval tv = {5, 0};
+    setsockopt(SSL_get_fd(ssl), SOL_SOCKET, SO_RCVTIMEO, &tv, sizeof(tv));
+    static char buf[UT_ET_BIG_BUFSIZE];
+    size_t total = 0;
+    bool in_order = true;
+    while (total < UT_ET_TOTAL) {
+        int n = SSL_read(ssl, buf, sizeof(buf));
+        if (n <= 0) break;
+        for (int i = 0; i < n; ++i) {
+            if (buf[i] != (char)((total + i) % 251)) in_order = false;
+        }
+        total += n;
+    }
+    EXPECT_EQ(total, (size_t)UT_ET_TOTAL);
+    EXPECT_TRUE(in_order);
+
+    close(SSL_get_fd(ssl));
+    SSL_free(ssl);
+    SSL_CTX_free(client_ctx);
+    loop_stop(loop);
+    runner.join();
+    loop_free(&loop);
+    ssl_ctx_cleanup(ctx);
+}
+
+#define UT_SPLICE_PORT 23511
+#define UT_SPLICE_UPSTREAM_PORT 23512
+// NOTE: fits in the splice pipe, the upstream io has read all of it when it is closed.
+#define UT_SPLICE_BYTES 60000
+
+static int ut_listen(int port) {
+    int fd = socket(AF_INET, SOCK_STREAM, 0);
+    int on = 1;
+    setsockopt(fd, SOL_SOCKET, SO_REUSEADDR, &on, sizeof(on));
+    struct sockaddr_in addr;
+    memset(&addr, 0, sizeof(addr));
+    addr.sin_family = AF_INET;
+    addr.sin_port = htons(port);
+    addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    if (bind(fd, (struct sockaddr*)&addr, sizeof(addr)) != 0 || listen(fd, 8) != 0) {
+        close(fd);
+        return -1;
+    }
+    return fd;
+}
+
+static void splice_proxy_accept_cb(io_t* io) {
+    // NOTE: small buffers toward the slow client, the rest stays in the splice pipe.
+    int size = 4096;
+    setsockopt(io_fd(io), SOL_SOCKET, SO_SNDBUF, &size, sizeof(size));
+    io_t* upstream_io = io_setup_tcp_splice_upstream(io, "127.0.0.1", UT_SPLICE_UPSTREAM_PORT);
+    ASSERT_TRUE(upstream_io != NULL);
+    // NOTE: upstream io is idle while its pipe waits for the client, closed with bytes in it.
+    io_set_keepalive_timeout(upstream_io, 100);
+}
+
+TEST(Event, SpliceDrainsPipeAfterUpstreamClosed) {
+    int upstream_fd = ut_listen(UT_SPLICE_UPSTREAM_PORT);
+    ASSERT_GE(upstream_fd, 0);
+    std::thread upstream([upstream_fd] {
+        int fd = accept(upstream_fd, NULL, NULL);
+        static char buf[UT_SPLICE_BYTES];
+        for (int i = 0; i < UT_SPLICE_BYTES; ++i) {
+            buf[i] = (char)(i % 251);
+        }
+        for (int n = 0; n < UT_SPLICE_BYTES;) {
+            int ret = write(fd, buf + n, UT_SPLICE_BYTES - n);
+            if (ret <= 0) break;
+            n += ret;
+        }
+        close(fd);
+    });
+
+    loop_t* loop = loop_new(0);
+    ASSERT_TRUE(loop_create_tcp_server(loop, "127.0.0.1", UT_SPLICE_PORT, splice_proxy_accept_cb) != NULL);
+    std::thread runner([loop] { loop_run(loop); });
+
+    int fd = socket(AF_INET, SOCK_STREAM, 0);
+    int size = 4096;
+    setsockopt(fd, SOL_SOCKET, SO_RCVBUF, &size, sizeof(size));
+    struct sockaddr_in addr;
+    memset(&addr, 0, sizeof(addr));
+    addr.sin_family = AF_INET;
+    addr.sin_port = htons(UT_SPLICE_PORT);
+    addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    ASSERT_EQ(connect(fd, (struct sockaddr*)&addr, sizeof(addr)), 0);
+    // NOTE: slow client, upstream has sent all and closed, its io timed out meanwhile.
+    usleep(500 * 1000);
+    struct timeval tv = {5, 0};
+    setsockopt(fd, SOL_SOCKET, SO_RCVTIMEO, &tv, sizeof(tv));
+    static char buf[UT_SPLICE_BYTES];
+    int total = 0;
+    bool in_order = true;
+    for (;;) {
+        int n = read(fd, buf, sizeof(buf));
+        if (n <= 0) break;
+        for (int i = 0; i < n; ++i) {
+            if (buf[i] != (char)((total + i) % 251)) in_order = false;
+        }
+        total += n;
+    }
+    EXPECT_EQ(total, UT_SPLICE_BYTES);
+    EXPECT_TRUE(in_order);
+
+    close(fd);
+    upstream.join();
+    close(upstream_fd);
+    loop_stop(loop);
+    runner.join();
+    loop_free(&loop);
+}
+
+#define UT_SF_PORT 23513
+#define UT_SF_BYTES (4 * 1024 * 1024 + 123)
+#define UT_SF_HIGH_WATER (1024 * 1024)
+
+static int sf_fd = -1;
+static int sf_error = -1;
+static size_t sf_bufsize = 0;
+static int sf_high_water = 0;
+
+static void sf_done_cb(io_t* io, int fd, int error) {
+    sf_error = error;
+}
+
+static void sf_high_water_cb(io_t* io, size_t bufsize) {
+    ++sf_high_water;
+}
+
+// NOTE: ssl io can not sendfile, the region is read chunk by chunk and counted as queued.
+static void sf_ssl_accept_cb(io_t* io) {
+    int size = 64 * 1024;
+    setsockopt(io_fd(io), SOL_SOCKET, SO_SNDBUF, &size, sizeof(size));
+    io_set_write_water(io, UT_SF_HIGH_WATER, UT_SF_HIGH_WATER / 2);
+    io_setcb_write_water(io, sf_high_water_cb);
+    io_sendfile(io, sf_fd, 0, UT_SF_BYTES, sf_done_cb);
+    sf_bufsize = io_write_bufsize(io);
+}
+
+TEST(Event, SslSendfileChunked) {
+    char path[] = "/tmp/ars_ut_sf_XXXXXX";
+    sf_fd = mkstemp(path);
+    ASSERT_GE(sf_fd, 0);
+    unlink(path);
+    static char buf[UT_ET_BIG_BUFSIZE];
+    for (size_t pos = 0; pos < UT_SF_BYTES;) {
+        size_t len = UT_SF_BYTES - pos < sizeof(buf) ? UT_SF_BYTES - pos : sizeof(buf);
+        for (size_t j = 0; j < len; ++j) {
+            buf[j] = (char)((pos + j) % 251);
+        }
+        ASSERT_EQ(write(sf_fd, buf, len), (ssize_t)len);
+        pos += len;
+    }
+
+    std::string crt, key;
+    ASSERT_TRUE(ut_make_cert(crt, key));
+    ssl_ctx_init_param_t param;
+    memset(&param, 0, sizeof(param));
+    param.crt_file = crt.c_str();
+    param.key_file = key.c_str();
+    param.endpoint = 0;
+    ssl_ctx_t ctx = ssl_ctx_init(&param);
+    ASSERT_TRUE(ctx != NULL);
+
+    loop_t* loop = loop_new(0);
+    io_t* listenio = loop_create_tcp_server(loop, "127.0.0.1", UT_SF_PORT, sf_ssl_accept_cb);
+    ASSERT_TRUE(listenio != NULL);
+    io_enable_ssl(listenio);
+    std::thread runner([loop] { loop_run(loop); });
+
+    SSL_CTX* client_ctx = SSL_CTX_new(TLS_client_method());
+    SSL* ssl = ut_ssl_connect(client_ctx, UT_SF_PORT);
+    ASSERT_TRUE(ssl != NULL);
+    usleep(200 * 1000);
+    struct timeval tv = {5, 0};
+    setsockopt(SSL_get_fd(ssl), SOL_SOCKET, SO_RCVTIMEO, &tv, sizeof(tv));
+    size_t total = 0;
+    bool in_order = true;
+    while (total < UT_SF_BYTES) {
+        int n = SSL_read(ssl, buf, sizeof(buf));
+        if (n <= 0) break;
+        for (int i = 0; i < n; ++i) {
+            if (buf[i] != (char)((total + i) % 251)) in_order = false;
+        }
+        total += n;
+    }
+    EXPECT_EQ(total, (size_t)UT_SF_BYTES);
+    EXPECT_TRUE(in_order);
+    EXPECT_GT(sf_bufsize, (size_t)UT_SF_HIGH_WATER);
+    EXPECT_EQ(sf_high_water, 1);
+    usleep(100 * 1000);
+    EXPECT_EQ(sf_error, 0);
+
+    close(SSL_get_fd(ssl));
+    SSL_free(ssl);
+    SSL_CTX_free(client_ctx);
+    loop_stop(loop);
+    runner.join();
+    loop_free(&loop);
+    ssl_ctx_cleanup(ctx);
+    close(sf_fd);
+}
+
+#define UT_URING_PORT 23514
+// NOTE: more connections than sq entries, syncing them all at once overflows the sq.
+#define UT_URING_CONNS 300
+#define UT_URING_BYTES 16384
+
+static std::atomic<int> uring_accepted(0);
+
+static void uring_echo_read_cb(io_t* io, void* buf, int readbytes) {
+    io_write(io, buf, readbytes);
+}
+
+static void uring_echo_accept_cb(io_t* io) {
+    ++uring_accepted;
+    io_setcb_read(io, uring_echo_read_cb);
+    io_read(io);
+}
+
+static bool ut_read_full(int fd, char* buf, size_t len) {
+    for (size_t n = 0; n < len;) {
+        ssize_t ret = read(fd, buf + n, len - n);
+        if (ret <= 0) return false;
+        n += ret;
+    }
+    return true;
+}
+
+TEST(Event, UringEchoManyConnections) {
+    loop_t* loop = loop_new(ARS_LOOP_FLAG_IO_URING);
+    if (strcmp(io_engine(loop), "io_uring") != 0) {
+        loop_free(&loop);
+        GTEST_SKIP() << "io_uring not supported";
+    }
+    ASSERT_TRUE(loop_create_tcp_server(loop, "127.0.0.1", UT_URING_PORT, uring_echo_accept_cb) != NULL);
+    std::thread runner([loop] { loop_run(loop); });
+
+    std::vector<int> fds;
+    struct sockaddr_in addr;
+    memset(&addr, 0, sizeof(addr));
+    addr.sin_family = AF_INET;
+    addr.sin_port = htons(UT_URING_PORT);
+    addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    struct timeval tv = {5, 0};
+    for (int i = 0; i < UT_URING_CONNS; ++i) {
+        int fd = socket(AF_INET, SOCK_STREAM, 0);
+        setsockopt(fd, SOL_SOCKET, SO_RCVTIMEO, &tv, sizeof(tv));
+        ASSERT_EQ(connect(fd, (struct sockaddr*)&addr, sizeof(addr)), 0);
+        fds.push_back(fd);
+    }
+    static char buf[UT_URING_BYTES];
+    static char got[UT_URING_BYTES];
+    for (int round = 0; round < 2; ++round) {
+        for (int i = 0; i < UT_URING_CONNS; ++i) {
+            memset(buf, (char)(i + round), sizeof(buf));
+            ASSERT_EQ(write(fds[i], buf, sizeof(buf)), (ssize_t)sizeof(buf));
+        }
+        for (int i = 0; i < UT_URING_CONNS; ++i) {
+            memset(buf, (char)(i + round), sizeof(buf));
+            ASSERT_TRUE(ut_read_full(fds[i], got, sizeof(got))) << "conn " << i;
+            ASSERT_EQ(memcmp(buf, got, sizeof(got)), 0);
+        }
+    }
+    EXPECT_EQ(uring_accepted, UT_URING_CONNS);
+
+    for (int fd : fds) {
+        close(fd);
+    }
+    loop_stop(loop);
+    runner.join();
+    loop_free(&loop);
+}
+
+#define UT_POST_PRODUCERS 4
+// NOTE: far more than ARS_CUSTOM_RING_SIZE, posted while the loop is held, so they overflow.
+#define UT_POST_EVENTS 20000
+#define UT_POST_WAKEUPS 300
+
+static std::atomic<bool> post_hold(false);
+static std::atomic<long> post_got(0);
+static std::atomic<long> post_disorder(0);
+static long post_last[UT_POST_PRODUCERS + 1];
+
+static void post_hold_cb(event_t* ev) {
+    while (post_hold) {
+        usleep(1000);
+    }
+}
+
+static void post_cb(event_t* ev) {
+    long producer = (long)ev->privdata;
+    long seq = (long)ev->userdata;
+    if (seq != post_last[producer] + 1) {
+        ++post_disorder;
+    }
+    post_last[producer] = seq;
+    ++post_got;
+}
+
+static void ut_post(loop_t* loop, event_cb cb, long producer, long seq) {
+    event_t ev;
+    memset(&ev, 0, sizeof(ev));
+    ev.cb = cb;
+    ev.privdata = (void*)producer;
+    ev.userdata = (void*)seq;
+    loop_post_event(loop, &ev);
+}
+
+static bool ut_wait_posts(long n) {
+    for (int i = 0; i < 5000 && post_got < n; ++i) {
+        usleep(1000);
+    }
+    return post_got == n;
+}
+
+TEST(Event, PostEventStress) {
+    for (long& last : post_last) {
+        last = -1;
+    }
+    loop_t* loop = loop_new(0);
+    std::thread runner([loop] { loop_run(loop); });
+
+    // NOTE: hold the loop in a callback, producers fill the ring and go on into the overflow list.
+    post_hold = true;
+    ut_post(loop, post_hold_cb, 0, 0);
+    std::vector<std::thread> producers;
+    for (long p = 0; p < UT_POST_PRODUCERS; ++p) {
+        producers.emplace_back([loop, p] {
+            for (long i = 0; i < UT_POST_EVENTS; ++i) {
+                ut_post(loop, post_cb, p, i);
+            }
+        });
+    }
+    for (auto& producer : producers) {
+        producer.join();
+    }
+    producers.clear();
+    post_hold = false;
+    long total = (long)UT_POST_PRODUCERS * UT_POST_EVENTS;
+    ASSERT_TRUE(ut_wait_posts(total)) << post_got << "/" << total;
+
+    // NOTE: the loop sleeps between posts, each post must wake it up.
+    post_last[UT_POST_PRODUCERS] = -1;
+    for (long i = 0; i < UT_POST_WAKEUPS; ++i) {
+        ut_post(loop, post_cb, UT_POST_PRODUCERS, i);
+        ASSERT_TRUE(ut_wait_posts(total + i + 1)) << "lost wakeup " << i;
+    }
+    total += UT_POST_WAKEUPS;
+
+    // NOTE: producers racing with the loop going to sleep and waking up.
+    for (long p = 0; p < UT_POST_PRODUCERS; ++p) {
+        post_last[p] = -1;
+        producers.emplace_back([loop, p] {
+            unsigned seed = p + 1;
+            for (long i = 0; i < UT_POST_WAKEUPS; ++i) {
+                ut_post(loop, post_cb, p, i);
+                usleep(rand_r(&seed) % 200);
+            }
+        });
+    }
+    for (auto& producer : producers) {
+        producer.join();
+    }
+    total += (long)UT_POST_PRODUCERS * UT_POST_WAKEUPS;
+    EXPECT_TRUE(ut_wait_posts(total)) << post_got << "/" << total;
+    EXPECT_EQ(post_disorder, 0);
+
+    loop_post_stat_t stat;
+    loop_post_stat(loop, &stat);
+    EXPECT_EQ(stat.posts, (uint64_t)total + 1);
+    EXPECT_GT(stat.wakeups, 0u);
+
+    loop_stop(loop);
+    runner.join();
+    loop_free(&loop);
+}
+
+#define UT_MMSG_PORT 23515
+#define UT_MMSG_SINK_PORT 23516
+#define UT_MMSG_NMSGS 4
+#define UT_MMSG_DGRAMS 8
+
+static struct sockaddr_in mmsg_sink;
+
+// NOTE: the echo to the sender (sockaddr_in6) and a copy to the ipv4 sink (sockaddr_in) fill
+// the sendq every 2 datagrams, so sendmmsg headers of both lengths are written in the middle
+// of the received batch.
+static void mmsg_echo_read_cb(io_t* io, void* buf, int readbytes) {
+    io_sendto(io, buf, readbytes, io_peeraddr(io));
+    io_sendto(io, buf, readbytes, (struct sockaddr*)&mmsg_sink);
+}
+
+static int ut_udp_socket(int family, int port) {
+    int fd = socket(family, SOCK_DGRAM, 0);
+    struct timeval tv = {2, 0};
+    setsockopt(fd, SOL_SOCKET, SO_RCVTIMEO, &tv, sizeof(tv));
+    if (port) {
+        struct sockaddr_in addr;
+        memset(&addr, 0, sizeof(addr));
+        addr.sin_family = AF_INET;
+        addr.sin_port = htons(port);
+        addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+        bind(fd, (struct sockaddr*)&addr, sizeof(addr));
+    }
+    return fd;
+}
+
+// NOTE: an ipv6 and an ipv4 (v4-mapped) client of a dual-stack server,
+// each must get its own echoes back.
+TEST(Event, MmsgEchoFlushInReadCb) {
+    loop_t* loop = loop_new(0);
+    io_t* io = loop_create_udp_server(loop, "::", UT_MMSG_PORT);
+    ASSERT_TRUE(io != NULL);
+    ASSERT_EQ(io_set_mmsg(io, UT_MMSG_NMSGS), 0);
+    io_setcb_read(io, mmsg_echo_read_cb);
+    int sink = ut_udp_socket(AF_INET, UT_MMSG_SINK_PORT);
+    memset(&mmsg_sink, 0, sizeof(mmsg_sink));
+    mmsg_sink.sin_family = AF_INET;
+    mmsg_sink.sin_port = htons(UT_MMSG_SINK_PORT);
+    mmsg_sink.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+
+    struct sockaddr_in6 addr6;
+    memset(&addr6, 0, sizeof(addr6));
+    addr6.sin6_family = AF_INET6;
+    addr6.sin6_port = htons(UT_MMSG_PORT);
+    addr6.sin6_addr = in6addr_loopback;
+    struct sockaddr_in addr4;
+    memset(&addr4, 0, sizeof(addr4));
+    addr4.sin_family = AF_INET;
+    addr4.sin_port = htons(UT_MMSG_PORT);
+    addr4.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    int fds[2] = {ut_udp_socket(AF_INET6, 0), ut_udp_socket(AF_INET, 0)};
+    // NOTE: queued before the loop runs, so one recvmmsg takes a full batch from both clients.
+    for (int i = 0; i < UT_MMSG_DGRAMS; ++i) {
+        for (int c = 0; c < 2; ++c) {
+            char msg[16];
+            int len = snprintf(msg, sizeof(msg), "%d-%d", c, i);
+            struct sockaddr* to = c ? (struct sockaddr*)&addr4 : (struct sockaddr*)&addr6;
+            ASSERT_EQ(sendto(fds[c], msg, len, 0, to, c ? sizeof(addr4) : sizeof(addr6)), len);
+        }
+    }
+    io_read(io);
+    std::thread runner([loop] { loop_run(loop); });
+
+    for (int c = 0; c < 2; ++c) {
+        for (int i = 0; i < UT_MMSG_DGRAMS; ++i) {
+            char got[16] = {0};
+            char want[16];
+            snprintf(want, sizeof(want), "%d-%d", c, i);
+            ASSERT_GT(recv(fds[c], got, sizeof(got) - 1, 0), 0) << "client " << c << " dgram " << i;
+            EXPECT_STREQ(got, want);
+        }
+        close(fds[c]);
+    }
+    char got[16];
+    for (int i = 0; i < 2 * UT_MMSG_DGRAMS; ++i) {
+        EXPECT_GT(recv(sink, got, sizeof(got), 0), 0);
+    }
+    close(sink);
+
+    loop_stop(loop);
+    runner.join();
+    loop_free(&loop);
+}
+
+#define UT_REGION_ROUNDS 64
+
+// NOTE: retained readbufs unref'd on another thread must give their slices back to the region,
+// otherwise the region drains and every read falls back to the heap.
+TEST(Event, RetainedReadbufsReturnToRegion) {
+    loop_t* loop = loop_new(0);
+    ASSERT_NE(loop, nullptr);
+    for (int cls = 0; cls < ARS_READBUF_CLASSES; ++cls) {
+        for (int round = 0; round < UT_REGION_ROUNDS; ++round) {
+            std::vector<iobuf_t*> bufs;
+            for (int i = 0; i < ARS_READBUF_POOL_SIZE; ++i) {
+                iobuf_t* buf = loop_readbuf_get(loop, cls);
+                ASSERT_NE(buf, nullptr);
+                ASSERT_NE(buf->free_fn, nullptr) << "class " << cls << " round " << round;
+                ASSERT_EQ(buf->len, (size_t)ARS_LOOP_READ_BUFSIZE << cls);
+                memset(buf->base, round, buf->len);
+                bufs.push_back(buf);
+            }
+            std::thread([&bufs] {
+                for (iobuf_t* buf : bufs) {
+                    iobuf_unref(buf);
+                }
+            }).join();
+        }
+    }
+
+    // a buf outliving the loop keeps the region mapped until its last unref
+    iobuf_t* kept = loop_readbuf_get(loop, ARS_READBUF_CLASSES - 1);
+    ASSERT_NE(kept, nullptr);
+    loop_readbuf_put(loop, loop_readbuf_get(loop, 0));
+    loop_free(&loop);
+    std::thread([kept] {
+        memset(kept->base, 0, kept->len);
+        iobuf_unref(kept);
+    }).join();
+}
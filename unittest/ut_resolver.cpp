@@ -0,0 +1,224 @@
+/**
+ * Copyright © 2021 <wotsen>.
+ * 
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of this software
+ * and associated documentation files (the “Software”), to deal in the Software without
+ * restriction, including without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sublicense, and/or sell copies of the Software, and to permit persons to whom the
+ * 
+ * The above copyright notice and this permission notice shall be included in all copies or
+ * substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED “AS IS”, WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING
+ * BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM,
+ * DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ * 
+ * @file ut_resolver.cpp
+ * @brief 
+ * @author wotsen (astralrovers@outlook.com)
+ * @version 1.0.0
+ * @date 2021-06-27
+ * 
+ * @copyright MIT
+ * 
+ */
+#include <gtest/gtest.h>
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <poll.h>
+#include <sys/socket.h>
+#include <unistd.h>
+#include <atomic>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "ars/sdk/event/loop.hpp"
+#include "ars/sdk/event/resolver.hpp"
+#include "ars/sdk/protocol/dns.hpp"
+
+using namespace ars::sdk;
+using namespace ars::sdk::event;
+
+#define UT_DNS_PORT 23530
+#define UT_DNS_TCP_PORT 23531
+
+// NOTE: local udp nameserver, names ending with ".found" answer 127.0.0.1, others NXDOMAIN.
+class StubDns {
+public:
+    StubDns() : fd_(-1), quit_(false) {}
+    ~StubDns() { stop(); }
+
+    bool start(int port) {
+        fd_ = socket(AF_INET, SOCK_DGRAM, 0);
+        struct sockaddr_in addr;
+        memset(&addr, 0, sizeof(addr));
+        addr.sin_family = AF_INET;
+        addr.sin_port = htons(port);
+        addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+        if (bind(fd_, (struct sockaddr*)&addr, sizeof(addr)) != 0) return false;
+        thread_ = std::thread([this] { serve(); });
+        return true;
+    }
+
+    void stop() {
+        quit_ = true;
+        if (thread_.joinable()) thread_.join();
+        if (fd_ >= 0) close(fd_);
+        fd_ = -1;
+    }
+
+    std::vector<std::string> names() {
+        std::lock_guard<std::mutex> lock(mutex_);
+        return names_;
+    }
+
+private:
+    void serve() {
+        char buf[512];
+        while (!quit_) {
+            struct pollfd pfd = {fd_, POLLIN, 0};
+            if (poll(&pfd, 1, 10) <= 0) continue;
+            struct sockaddr_in peer;
+            socklen_t peerlen = sizeof(peer);
+            int n = recvfrom(fd_, buf, sizeof(buf), 0, (struct sockaddr*)&peer, &peerlen);
+            dns_t query;
+            if (n <= 0 || dns_unpack(buf, n, &query) < 0) continue;
+            std::string name = query.questions[0].name;
+            {
+                std::lock_guard<std::mutex> lock(mutex_);
+                names_.push_back(name);
+            }
+            dns_t resp;
+            memset(&resp, 0, sizeof(resp));
+            resp.hdr = query.hdr;
+            resp.hdr.qr = ARS_DNS_RESPONSE;
+            resp.hdr.ra = 1;
+            resp.hdr.nquestion = 1;
+            resp.questions = query.questions;
+            dns_rr_t answer;
+            uint32_t ip = htonl(INADDR_LOOPBACK);
+            const char* suffix = ".found";
+            if (name.size() > strlen(suffix) &&
+                name.compare(name.size() - strlen(suffix), std::string::npos, suffix) == 0) {
+                memset(&answer, 0, sizeof(answer));
+                strcpy(answer.name, name.c_str());
+                answer.rtype = ARS_DNS_TYPE_A;
+                answer.rclass = ARS_DNS_CLASS_IN;
+                answer.ttl = 60;
+                answer.datalen = 4;
+                answer.data = (char*)&ip;
+                resp.hdr.nanswer = 1;
+                resp.answers = &answer;
+            } else {
+                resp.hdr.rcode = 3;
+            }
+            char out[512];
+            int len = dns_pack(&resp, out, sizeof(out));
+            resp.questions = NULL;
+            if (len > 0) sendto(fd_, out, len, 0, (struct sockaddr*)&peer, peerlen);
+            dns_free(&query);
+        }
+    }
+
+    int fd_;
+    std::atomic<bool> quit_;
+    std::thread thread_;
+    std::mutex mutex_;
+    std::vector<std::string> names_;
+};
+
+static void ut_set_resolver(loop_t* loop, const char* search) {
+    resolver_setting_t setting;
+    memset(&setting, 0, sizeof(setting));
+    setting.nameservers = "127.0.0.1:23530";
+    setting.hosts = "";
+    setting.search = search;
+    setting.timeout_ms = 500;
+    setting.attempts = 1;
+    ASSERT_EQ(loop_set_resolver(loop, &setting), 0);
+}
+
+static int resolved_error = -1;
+static std::string resolved_host;
+
+static void resolved_cb(loop_t* loop, const char* host, const sock_addr_t* addrs, int naddrs,
+                        int error, void* userdata) {
+    resolved_error = error;
+    resolved_host = host;
+    loop_stop(loop);
+}
+
+// NOTE: fewer dots than ndots 1, the search domains go first, then the name as is.
+TEST(Resolver, SearchDomains) {
+    StubDns dns;
+    ASSERT_TRUE(dns.start(UT_DNS_PORT));
+    loop_t* loop = loop_new(0);
+    ut_set_resolver(loop, "corp.test, found");
+    ASSERT_GT(loop_resolve(loop, "db", resolved_cb), 0);
+    loop_run(loop);
+    EXPECT_EQ(resolved_error, 0);
+    EXPECT_EQ(resolved_host, "db");
+    std::vector<std::string> names = dns.names();
+    ASSERT_EQ(names.size(), 2u);
+    EXPECT_EQ(names[0], "db.corp.test");
+    EXPECT_EQ(names[1], "db.found");
+
+    // NOTE: enough dots, as is first, and not expanded with a trailing dot.
+    ASSERT_GT(loop_resolve(loop, "x.found", resolved_cb), 0);
+    loop_run(loop);
+    EXPECT_EQ(resolved_error, 0);
+    ASSERT_GT(loop_resolve(loop, "nx.", resolved_cb), 0);
+    loop_run(loop);
+    EXPECT_EQ(resolved_error, ENOENT);
+    names = dns.names();
+    ASSERT_EQ(names.size(), 4u);
+    EXPECT_EQ(names[2], "x.found");
+    EXPECT_EQ(names[3], "nx");
+    loop_free(&loop);
+}
+
+static int connected = 0;
+
+static void connect_timeout_cb(event::timer_t* timer) {
+    loop_stop(ars_event_loop(timer));
+}
+
+// NOTE: no connect_cb, still connects once the name is resolved.
+TEST(Resolver, ConnectWithoutCallback) {
+    StubDns dns;
+    ASSERT_TRUE(dns.start(UT_DNS_PORT));
+    int listenfd = socket(AF_INET, SOCK_STREAM, 0);
+    int on = 1;
+    setsockopt(listenfd, SOL_SOCKET, SO_REUSEADDR, &on, sizeof(on));
+    struct sockaddr_in addr;
+    memset(&addr, 0, sizeof(addr));
+    addr.sin_family = AF_INET;
+    addr.sin_port = htons(UT_DNS_TCP_PORT);
+    addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    ASSERT_EQ(bind(listenfd, (struct sockaddr*)&addr, sizeof(addr)), 0);
+    ASSERT_EQ(listen(listenfd, 8), 0);
+    std::thread acceptor([listenfd] {
+        struct pollfd pfd = {listenfd, POLLIN, 0};
+        if (poll(&pfd, 1, 2000) == 1) {
+            int fd = accept(listenfd, NULL, NULL);
+            if (fd >= 0) {
+                ++connected;
+                close(fd);
+            }
+        }
+    });
+
+    loop_t* loop = loop_new(0);
+    ut_set_resolver(loop, "");
+    ASSERT_TRUE(loop_create_tcp_client(loop, "server.found", UT_DNS_TCP_PORT, NULL) != NULL);
+    timer_add(loop, connect_timeout_cb, 500, 1);
+    loop_run(loop);
+    acceptor.join();
+    EXPECT_EQ(connected, 1);
+    close(listenfd);
+    loop_free(&loop);
+}
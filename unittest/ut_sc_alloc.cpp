@@ -0,0 +1,234 @@
+/**
+ * Copyright © 2021 <wotsen>.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of this software
+ * and associated documentation files (the “Software”), to deal in the Software without
+ * restriction, including without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sublicense, and/or sell copies of the Software, and to permit persons to whom the
+ *
+ * The above copyright notice and this permission notice shall be included in all copies or
+ * substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED “AS IS”, WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING
+ * BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM,
+ * DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ *
+ * @file ut_sc_alloc.cpp
+ * @brief
+ * @author wotsen (astralrovers@outlook.com)
+ * @version 1.0.0
+ * @date 2021-06-27
+ *
+ * @copyright MIT
+ *
+ */
+#include <gtest/gtest.h>
+#include <errno.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <atomic>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include "ars/sdk/memory/mem.hpp"
+#include "ars/sdk/memory/sc_alloc.hpp"
+
+using namespace ars::sdk;
+
+#define UT_SC_SEGMENT_MASK (~(uintptr_t)((4 << 20) - 1))
+#define UT_SC_THREADS 4
+#define UT_SC_BLOCKS 20000
+
+// 块内写满与地址相关的值，释放前校验
+static void ut_sc_fill(void* p, size_t size) {
+    memset(p, (int)((uintptr_t)p >> 4), size);
+}
+
+static bool ut_sc_check(void* p, size_t size) {
+    unsigned char c = (unsigned char)((uintptr_t)p >> 4);
+    for (size_t i = 0; i < size; ++i) {
+        if (((unsigned char*)p)[i] != c) {
+            return false;
+        }
+    }
+    return true;
+}
+
+TEST(ScAlloc, SizeClassesAndUsableSize) {
+    // NOTE: classes step by 16 up to 128, then four per power of two, so waste stays under a quarter.
+    for (size_t size = 1; size <= SC_MAX_SMALL_SIZE; size += size < 256 ? 1 : 61) {
+        void* p = sc_malloc(size);
+        ASSERT_NE(p, nullptr) << size;
+        size_t usable = sc_usable_size(p);
+        EXPECT_GE(usable, size);
+        EXPECT_LE(usable, size < 128 ? size + 15 : size + size / 4) << size;
+        EXPECT_EQ((uintptr_t)p % 16, 0u) << size;
+        ut_sc_fill(p, usable);
+        ASSERT_TRUE(ut_sc_check(p, usable));
+        sc_free(p);
+    }
+    EXPECT_EQ(sc_usable_size(NULL), 0u);
+
+    for (size_t align = 8; align <= 64 * 1024; align <<= 1) {
+        for (size_t size : {(size_t)1, (size_t)100, (size_t)5000, (size_t)SC_MAX_SMALL_SIZE + 1}) {
+            void* p = NULL;
+            ASSERT_EQ(sc_memalign(&p, align, size), 0) << align << " " << size;
+            EXPECT_EQ((uintptr_t)p % align, 0u);
+            EXPECT_GE(sc_usable_size(p), size);
+            ut_sc_fill(p, size);
+            sc_free(p);
+        }
+    }
+    void* p = NULL;
+    EXPECT_EQ(sc_memalign(&p, 24, 10), EINVAL);
+    EXPECT_EQ(sc_memalign(&p, 128 * 1024, 10), EINVAL);
+
+    // realloc keeps the data and stays in place while it fits
+    char* r = (char*)sc_malloc(100);
+    memset(r, 7, 100);
+    EXPECT_EQ(sc_realloc(r, 110), r);
+    r = (char*)sc_realloc(r, 100000);
+    ASSERT_NE(r, nullptr);
+    for (int i = 0; i < 100; ++i) {
+        ASSERT_EQ(r[i], 7);
+    }
+    sc_free(r);
+}
+
+TEST(ScAlloc, LargeMappingsAreReused) {
+    for (size_t size : {(size_t)SC_MAX_SMALL_SIZE + 1, (size_t)100 * 1024, (size_t)1000 * 1024,
+                        (size_t)3 << 20, (size_t)8 << 20}) {
+        void* p = sc_malloc(size);
+        ASSERT_NE(p, nullptr);
+        EXPECT_GE(sc_usable_size(p), size);
+        ut_sc_fill(p, size);
+        ASSERT_TRUE(ut_sc_check(p, size));
+        sc_free(p);
+        // NOTE: mappings up to a segment are cached by class, a same-class request gets it back
+        // even when a request of another class comes in between.
+        void* other = sc_malloc(50 * 1024);
+        void* q = sc_malloc(size);
+        if (size < (4 << 20)) {
+            EXPECT_EQ(q, p) << size;
+        }
+        EXPECT_NE(other, p);
+        EXPECT_GE(sc_usable_size(q), size);
+        sc_free(q);
+        sc_free(other);
+    }
+
+    // an aligned request may reuse a mapping cached by a plain one
+    void* p = sc_malloc(200 * 1024);
+    sc_free(p);
+    void* q = NULL;
+    ASSERT_EQ(sc_memalign(&q, 4096, 200 * 1024 - 8192), 0);
+    EXPECT_EQ((uintptr_t)q % 4096, 0u);
+    EXPECT_GE(sc_usable_size(q), 200u * 1024 - 8192);
+    ut_sc_fill(q, 200 * 1024 - 8192);
+    sc_free(q);
+}
+
+TEST(ScAlloc, RemoteFree) {
+    // producers allocate, consumers on other threads free, so every block goes back remotely
+    std::mutex mtx;
+    std::vector<std::pair<void*, size_t>> queue;
+    std::atomic<int> producing(UT_SC_THREADS);
+    std::atomic<int> corrupt(0);
+    std::vector<std::thread> threads;
+    for (int t = 0; t < UT_SC_THREADS; ++t) {
+        threads.emplace_back([&, t] {
+            unsigned seed = t + 1;
+            for (int i = 0; i < UT_SC_BLOCKS; ++i) {
+                size_t size = 1 + rand_r(&seed) % (i % 64 ? 512 : SC_MAX_SMALL_SIZE * 2);
+                void* p = sc_malloc(size);
+                if (!p) {
+                    corrupt++;
+                    continue;
+                }
+                ut_sc_fill(p, size);
+                std::lock_guard<std::mutex> lck(mtx);
+                queue.emplace_back(p, size);
+            }
+            producing--;
+        });
+        threads.emplace_back([&] {
+            for (;;) {
+                std::vector<std::pair<void*, size_t>> batch;
+                bool done = producing == 0;
+                {
+                    std::lock_guard<std::mutex> lck(mtx);
+                    batch.swap(queue);
+                }
+                for (auto& b : batch) {
+                    corrupt += !ut_sc_check(b.first, b.second);
+                    sc_free(b.first);
+                }
+                if (done && batch.empty()) {
+                    break;
+                }
+                std::this_thread::yield();
+            }
+        });
+    }
+    for (auto& t : threads) {
+        t.join();
+    }
+    EXPECT_EQ(corrupt, 0);
+    EXPECT_TRUE(queue.empty());
+}
+
+TEST(ScAlloc, HeapAdoptedAfterThreadExit) {
+    void* leftover = NULL;
+    std::thread([&] {
+        leftover = sc_malloc(48);
+        ut_sc_fill(leftover, 48);
+    }).join();
+    ASSERT_NE(leftover, nullptr);
+
+    // NOTE: the next thread takes over the abandoned heap, the leftover's span is its current one.
+    std::thread([&] {
+        void* p = sc_malloc(48);
+        EXPECT_EQ((uintptr_t)p & UT_SC_SEGMENT_MASK, (uintptr_t)leftover & UT_SC_SEGMENT_MASK);
+        EXPECT_TRUE(ut_sc_check(leftover, 48));
+        // freed locally now, so it is handed out again first
+        sc_free(leftover);
+        EXPECT_EQ(sc_malloc(48), leftover);
+        sc_free(leftover);
+        sc_free(p);
+    }).join();
+}
+
+TEST(ScAlloc, CountersSumAcrossThreads) {
+    long allocs = alloc_cnt();
+    long frees = free_cnt();
+    std::vector<std::thread> threads;
+    for (int t = 0; t < UT_SC_THREADS; ++t) {
+        threads.emplace_back([] {
+            std::vector<void*> ps;
+            for (int i = 0; i < 1000; ++i) {
+                ps.push_back(ars_malloc(32));
+            }
+            // half of them are freed here, the rest by another thread
+            for (int i = 0; i < 500; ++i) {
+                ars_free(ps[i]);
+            }
+            std::vector<void*>* rest = new std::vector<void*>(ps.begin() + 500, ps.end());
+            std::thread([rest] {
+                for (void* p : *rest) {
+                    ars_free(p);
+                }
+                delete rest;
+            }).join();
+        });
+    }
+    for (auto& t : threads) {
+        t.join();
+    }
+    // NOTE: counters of exited threads are kept and reused, nothing is lost.
+    EXPECT_EQ(alloc_cnt() - allocs, UT_SC_THREADS * 1000L);
+    EXPECT_EQ(free_cnt() - frees, UT_SC_THREADS * 1000L);
+}
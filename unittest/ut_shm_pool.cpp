@@ -0,0 +1,284 @@
+/**
+ * Copyright © 2021 <wotsen>.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of this software
+ * and associated documentation files (the “Software”), to deal in the Software without
+ * restriction, including without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sublicense, and/or sell copies of the Software, and to permit persons to whom the
+ *
+ * The above copyright notice and this permission notice shall be included in all copies or
+ * substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED “AS IS”, WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING
+ * BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM,
+ * DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ *
+ * @file ut_shm_pool.cpp
+ * @brief
+ * @author wotsen (astralrovers@outlook.com)
+ * @version 1.0.0
+ * @date 2021-06-27
+ *
+ * @copyright MIT
+ *
+ */
+#include <gtest/gtest.h>
+#include <signal.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/wait.h>
+#include <unistd.h>
+#include <atomic>
+#include <set>
+#include <vector>
+
+#include "ars/sdk/ipc/shm.hpp"
+#include "ars/sdk/memory/shm_pool.hpp"
+
+using namespace ars::sdk;
+
+#define UT_SHM_POOL_NAME "/ars_ut_shm_pool"
+#define UT_SHM_POOL_SIZE (64 << 20)
+#define UT_SHM_POOL_SLOTS 1024
+#define UT_SHM_POOL_MAX_ALLOC 3000
+
+// NOTE: the shared table is the pool root, slots hold offsets of detached blocks.
+struct ut_shm_table {
+    std::atomic<uint64_t> slots[UT_SHM_POOL_SLOTS];
+};
+
+// every block starts with its size and the tag of the process that filled it
+struct ut_shm_block {
+    uint64_t size;
+    uint64_t tag;
+};
+
+class ShmPoolTest : public ::testing::Test {
+protected:
+    void SetUp() override {
+        ipc::shm_unlink(UT_SHM_POOL_NAME);
+        fd_ = ipc::shm_open(UT_SHM_POOL_NAME, O_CREAT | O_RDWR, 0600);
+        ASSERT_GE(fd_, 0);
+        ASSERT_EQ(ftruncate(fd_, UT_SHM_POOL_SIZE), 0);
+        addr_ = map();
+        ASSERT_NE(addr_, nullptr);
+    }
+
+    void TearDown() override {
+        if (addr_) {
+            munmap(addr_, UT_SHM_POOL_SIZE);
+        }
+        if (fd_ >= 0) {
+            close(fd_);
+        }
+        ipc::shm_unlink(UT_SHM_POOL_NAME);
+    }
+
+    void* map(void) {
+        void* p = ipc::shm_map(NULL, UT_SHM_POOL_SIZE, PROT_READ | PROT_WRITE, MAP_SHARED, fd_, 0);
+        return p == MAP_FAILED ? nullptr : p;
+    }
+
+    // NOTE: runs in a child, maps the pool at its own address and swaps random blocks into the table.
+    void churn(uint32_t seed, int iters) {
+        void* m = map();
+        if (!m) {
+            _exit(1);
+        }
+        MemoryShmPool pool(m, UT_SHM_POOL_SIZE, false);
+        ut_shm_table* table = (ut_shm_table*)pool.root();
+        if (!pool.valid() || !table) {
+            _exit(1);
+        }
+        for (int i = 0; i < iters; ++i) {
+            seed = seed * 1103515245 + 12345;
+            size_t size = sizeof(ut_shm_block) + (seed >> 8) % UT_SHM_POOL_MAX_ALLOC;
+            ut_shm_block* b = (ut_shm_block*)pool.alloc(size);
+            if (!b) {
+                _exit(2);
+            }
+            b->size = size;
+            b->tag = ((uint64_t)getpid() << 32) | (uint32_t)i;
+            pool.detach(b);
+            uint64_t old = table->slots[(seed >> 4) % UT_SHM_POOL_SLOTS].exchange(pool.offset(b));
+            if (old) {
+                ut_shm_block* o = (ut_shm_block*)pool.ptr(old);
+                if (o->size < sizeof(ut_shm_block) || o->size >= sizeof(ut_shm_block) + UT_SHM_POOL_MAX_ALLOC) {
+                    _exit(3);
+                }
+                pool.free(o);
+            }
+        }
+        _exit(0);
+    }
+
+    pid_t spawn(uint32_t seed, int iters) {
+        pid_t pid = fork();
+        if (pid == 0) {
+            churn(seed, iters);
+        }
+        return pid;
+    }
+
+    // 表中的块互不相同且内容完整，返回其偏移
+    std::set<uint64_t> check_table(MemoryShmPool& pool, ut_shm_table* table) {
+        std::set<uint64_t> live;
+        for (auto& slot : table->slots) {
+            uint64_t off = slot.load();
+            if (!off) {
+                continue;
+            }
+            EXPECT_TRUE(live.insert(off).second) << "block in two slots";
+            ut_shm_block* b = (ut_shm_block*)pool.ptr(off);
+            EXPECT_GE(b->size, sizeof(ut_shm_block));
+            EXPECT_LT(b->size, sizeof(ut_shm_block) + UT_SHM_POOL_MAX_ALLOC);
+        }
+        return live;
+    }
+
+    int fd_ = -1;
+    void* addr_ = nullptr;
+};
+
+TEST_F(ShmPoolTest, MultiProcessAllocFreeRecover) {
+    MemoryShmPool pool(addr_, UT_SHM_POOL_SIZE, true);
+    ASSERT_TRUE(pool.valid());
+    ut_shm_table* table = (ut_shm_table*)pool.alloc(sizeof(ut_shm_table));
+    ASSERT_NE(table, nullptr);
+    memset((void*)table, 0, sizeof(ut_shm_table));
+    pool.detach(table);
+    pool.set_root(table);
+
+    // a second mapping at another address sees the same root
+    void* other = map();
+    ASSERT_NE(other, nullptr);
+    {
+        MemoryShmPool pool2(other, UT_SHM_POOL_SIZE, false);
+        ASSERT_TRUE(pool2.valid());
+        EXPECT_EQ(pool2.root(), (char*)other + ((char*)table - (char*)addr_));
+    }
+    munmap(other, UT_SHM_POOL_SIZE);
+
+    // steady workers run to the end, victims are killed at random points while the
+    // parent recovers concurrently, so recover races live alloc/free in the others
+    const int kWorkers = 3;
+    std::vector<pid_t> workers;
+    for (int k = 0; k < kWorkers; ++k) {
+        pid_t pid = spawn(k * 7919 + 1, 100000);
+        ASSERT_GT(pid, 0);
+        workers.push_back(pid);
+    }
+    srand(1);
+    for (int round = 0; round < 20; ++round) {
+        pid_t victim = spawn(round * 104729 + 3, 1 << 30);
+        ASSERT_GT(victim, 0);
+        usleep(5000 + rand() % 20000);
+        kill(victim, SIGKILL);
+        int status = 0;
+        ASSERT_EQ(waitpid(victim, &status, 0), victim);
+        EXPECT_TRUE(WIFSIGNALED(status)) << "victim exited with " << WEXITSTATUS(status);
+        pool.recover();
+    }
+    for (pid_t pid : workers) {
+        int status = 0;
+        ASSERT_EQ(waitpid(pid, &status, 0), pid);
+        EXPECT_TRUE(WIFEXITED(status) && WEXITSTATUS(status) == 0) << "worker failed " << status;
+    }
+
+    pool.recover();
+    EXPECT_EQ(pool.recover(), 0u);
+    std::set<uint64_t> live = check_table(pool, table);
+
+    // NOTE: victims killed between detach and the table swap leave detached blocks behind.
+    shm_pool_stat_t st;
+    pool.stat(st);
+    EXPECT_EQ(st.used_blocks, st.detached_blocks);
+    EXPECT_GE(st.detached_blocks, live.size() + 1);
+
+    // 回收后分配出的块不会与表中仍在用的块重复
+    std::set<uint64_t> fresh;
+    for (size_t size = sizeof(ut_shm_block); size < sizeof(ut_shm_block) + UT_SHM_POOL_MAX_ALLOC; size += 7) {
+        for (int i = 0; i < 8; ++i) {
+            void* p = pool.alloc(size);
+            ASSERT_NE(p, nullptr);
+            uint64_t off = pool.offset(p);
+            EXPECT_EQ(live.count(off), 0u);
+            EXPECT_TRUE(fresh.insert(off).second) << "block allocated twice";
+        }
+    }
+    pool.stat(st);
+    EXPECT_EQ(st.used_blocks, st.detached_blocks + fresh.size());
+}
+
+TEST_F(ShmPoolTest, RecoverDeadOwners) {
+    MemoryShmPool pool(addr_, UT_SHM_POOL_SIZE, true);
+    ASSERT_TRUE(pool.valid());
+
+    // blocks of a killed process come back, detached ones stay
+    pid_t pid = fork();
+    ASSERT_GE(pid, 0);
+    if (pid == 0) {
+        void* m = map();
+        MemoryShmPool p(m, UT_SHM_POOL_SIZE, false);
+        void* kept = p.alloc(64);
+        p.detach(kept);
+        p.set_root(kept);
+        for (int i = 0; i < 10; ++i) {
+            p.alloc(100);
+        }
+        pause();
+        _exit(0);
+    }
+    shm_pool_stat_t st;
+    do {
+        usleep(1000);
+        pool.stat(st);
+    } while (st.used_blocks < 11);
+    EXPECT_EQ(pool.recover(), 0u);  // owner still alive
+    kill(pid, SIGKILL);
+    waitpid(pid, NULL, 0);
+    EXPECT_EQ(pool.recover(), 10u);
+    EXPECT_EQ(pool.recover(), 0u);
+    pool.stat(st);
+    EXPECT_EQ(st.used_blocks, 1u);
+    EXPECT_EQ(st.detached_blocks, 1u);
+    EXPECT_EQ(st.free_blocks, 10u);
+    ASSERT_NE(pool.root(), nullptr);
+
+    // double free and foreign pointers are refused
+    void* x = pool.alloc(100);
+    pool.free(x);
+    pool.free(x);
+    int y = 0;
+    pool.free(&y);
+    pool.stat(st);
+    EXPECT_EQ(st.free_blocks, 10u);
+}
+
+TEST_F(ShmPoolTest, RecoverFreeingOwnerDied) {
+    MemoryShmPool pool(addr_, UT_SHM_POOL_SIZE, true);
+    ASSERT_TRUE(pool.valid());
+    // NOTE: the owner word leads the 16-byte block header; a pid above pid_max reads as dead.
+    uint32_t dead = 0x80000000u | 4000000u;
+    auto owner = [](void* p) { return (std::atomic<uint32_t>*)((char*)p - 16); };
+
+    // died after pushing: recover finishes the free, the block is reused once
+    void* x = pool.alloc(100);
+    pool.free(x);
+    owner(x)->store(dead);
+    EXPECT_EQ(pool.recover(), 0u);
+    shm_pool_stat_t st;
+    pool.stat(st);
+    EXPECT_EQ(st.free_blocks, 1u);
+    EXPECT_EQ(st.used_blocks, 0u);
+    EXPECT_EQ(pool.alloc(100), x);
+    EXPECT_NE(pool.alloc(100), x);
+
+    // died before pushing looks like a block popped by a live alloc, it must not be pushed again
+    void* z = pool.alloc(200);
+    owner(z)->store(dead);
+    EXPECT_EQ(pool.recover(), 0u);
+    EXPECT_NE(pool.alloc(200), z);
+}
@@ -0,0 +1,290 @@
+/**
+ * Copyright © 2021 <wotsen>.
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of this software
+ * and associated documentation files (the “Software”), to deal in the Software without
+ * restriction, including without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sublicense, and/or sell copies of the Software, and to permit persons to whom the
+ *
+ * The above copyright notice and this permission notice shall be included in all copies or
+ * substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED “AS IS”, WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING
+ * BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM,
+ * DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ *
+ * @file ut_slab.cpp
+ * @brief
+ * @author wotsen (astralrovers@outlook.com)
+ * @version 1.0.0
+ * @date 2021-06-27
+ *
+ * @copyright MIT
+ *
+ */
+#include <gtest/gtest.h>
+#include <pthread.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/wait.h>
+#include <unistd.h>
+#include <atomic>
+#include <thread>
+#include <utility>
+#include <vector>
+
+#include "ars/sdk/memory/slab.hpp"
+
+using namespace ars::sdk;
+
+#define UT_SLAB_SIZE (16 << 20)
+#define UT_SLAB_THREADS 8
+#define UT_SLAB_ITERS 20000
+#define UT_SLAB_MAX_ALLOC 1500
+
+// NOTE: process-shared so the pool stays usable across fork.
+class ut_slab_lock : public ILock {
+public:
+    explicit ut_slab_lock(pthread_mutex_t* m) : m_(m) {
+        pthread_mutexattr_t attr;
+        pthread_mutexattr_init(&attr);
+        pthread_mutexattr_setpshared(&attr, PTHREAD_PROCESS_SHARED);
+        pthread_mutex_init(m_, &attr);
+        pthread_mutexattr_destroy(&attr);
+    }
+
+    bool lock(void) override { return pthread_mutex_lock(m_) == 0; }
+    bool unlock(void) override { return pthread_mutex_unlock(m_) == 0; }
+    bool try_lock(time_t w = -1) override { return pthread_mutex_trylock(m_) == 0; }
+
+private:
+    pthread_mutex_t* m_;
+};
+
+class SlabTest : public ::testing::Test {
+protected:
+    void SetUp() override {
+        // the lock sits in the first page, the pool after it, both shared with forked children
+        mem_ = (char*)mmap(NULL, UT_SLAB_SIZE + 4096, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_ANONYMOUS, -1, 0);
+        ASSERT_NE(mem_, MAP_FAILED);
+        lock_ = new ut_slab_lock((pthread_mutex_t*)mem_);
+    }
+
+    void TearDown() override {
+        delete lock_;
+        if (mem_ != MAP_FAILED) {
+            munmap(mem_, UT_SLAB_SIZE + 4096);
+        }
+    }
+
+    char* pool(void) { return mem_ + 4096; }
+
+    char* mem_ = (char*)MAP_FAILED;
+    ut_slab_lock* lock_ = nullptr;
+};
+
+// 随机分配释放，块首尾写入标记，释放前校验
+static int ut_slab_churn(MemorySlab& slab, unsigned seed, int iters) {
+    std::vector<std::pair<unsigned char*, size_t>> live;
+    int corrupt = 0;
+    for (int i = 0; i < iters; ++i) {
+        if (live.size() < 64 && (live.empty() || rand_r(&seed) % 3)) {
+            size_t size = 1 + rand_r(&seed) % UT_SLAB_MAX_ALLOC;
+            unsigned char* p = (unsigned char*)slab.alloc(size);
+            if (p) {
+                p[0] = p[size - 1] = (unsigned char)(seed + size);
+                live.emplace_back(p, size);
+            }
+        } else {
+            size_t k = rand_r(&seed) % live.size();
+            auto b = live[k];
+            live[k] = live.back();
+            live.pop_back();
+            unsigned char mark = b.first[0];
+            corrupt += b.first[b.second - 1] != mark;
+            slab.free(b.first);
+        }
+    }
+    for (auto& b : live) {
+        slab.free(b.first);
+    }
+    return corrupt;
+}
+
+TEST_F(SlabTest, CachedBytesAccounting) {
+    MemorySlab slab(pool(), UT_SLAB_SIZE, lock_);
+    slab_stat_t base, st;
+    slab.stat(base);
+    EXPECT_EQ(base.b_cached, 0u);
+
+    slab.enable_thread_cache();
+    // NOTE: 100 bytes fall in the 128 byte class, the rest of each refill stays cached.
+    std::vector<void*> ps;
+    for (int i = 0; i < 100; ++i) {
+        ps.push_back(slab.alloc(100));
+        ASSERT_NE(ps.back(), nullptr);
+    }
+    slab.stat(st);
+    EXPECT_EQ(st.used_size - base.used_size, 100u * 128);
+    EXPECT_GT(st.b_cached, 0u);
+    EXPECT_EQ(st.b_cached % 128, 0u);
+
+    for (void* p : ps) {
+        slab.free(p);
+    }
+    slab.stat(st);
+    EXPECT_EQ(st.used_size, base.used_size);
+    EXPECT_GT(st.b_cached, 0u);
+
+    slab.flush_thread_cache();
+    slab.stat(st);
+    EXPECT_EQ(st.b_cached, 0u);
+    EXPECT_EQ(st.used_size, base.used_size);
+    EXPECT_EQ(st.free_page, base.free_page);
+
+    // half a page and up bypasses the cache
+    void* big = slab.alloc(8192);
+    ASSERT_NE(big, nullptr);
+    slab.free(big);
+    slab.stat(st);
+    EXPECT_EQ(st.b_cached, 0u);
+}
+
+TEST_F(SlabTest, FlushAtThreadExit) {
+    MemorySlab slab(pool(), UT_SLAB_SIZE, lock_);
+    slab_stat_t base, st;
+    slab.stat(base);
+    slab.enable_thread_cache();
+
+    std::atomic<int> ready(0);
+    std::atomic<bool> go(false);
+    std::atomic<int> corrupt(0);
+    std::vector<std::thread> threads;
+    for (int t = 0; t < UT_SLAB_THREADS; ++t) {
+        threads.emplace_back([&, t] {
+            corrupt += ut_slab_churn(slab, t * 7919 + 1, UT_SLAB_ITERS);
+            ready++;
+            while (!go) {
+                std::this_thread::yield();
+            }
+        });
+    }
+    while (ready < UT_SLAB_THREADS) {
+        std::this_thread::yield();
+    }
+    // NOTE: every block is back, the parked threads still hold their caches. Only the
+    // in-page bitmaps of the tiny classes count as used, no whole page is held.
+    slab.stat(st);
+    EXPECT_GT(st.b_cached, 0u);
+    EXPECT_EQ(st.b_page, 0u);
+    EXPECT_EQ(st.used_size - base.used_size, st.b_small + st.b_exact + st.b_big - st.b_cached);
+    EXPECT_LT(st.used_size - base.used_size, st.b_cached);
+
+    go = true;
+    for (auto& t : threads) {
+        t.join();
+    }
+    EXPECT_EQ(corrupt, 0);
+    slab.stat(st);
+    EXPECT_EQ(st.b_cached, 0u);
+    EXPECT_EQ(st.used_size, base.used_size);
+    EXPECT_EQ(st.free_page, base.free_page);
+}
+
+TEST_F(SlabTest, PoolDestroyedWhileThreadsHoldCaches) {
+    std::atomic<int> ready(0);
+    std::atomic<bool> go(false);
+    std::vector<std::thread> threads;
+    MemorySlab* slab = new MemorySlab(pool(), UT_SLAB_SIZE, lock_);
+    slab->enable_thread_cache();
+    for (int t = 0; t < UT_SLAB_THREADS; ++t) {
+        threads.emplace_back([&, t] {
+            void* p = slab->alloc(64 + t * 16);
+            slab->free(p);
+            ready++;
+            while (!go) {
+                std::this_thread::yield();
+            }
+            // NOTE: a new pool drops the caches of the destroyed one, exit flushes the rest.
+            size_t len = 1 << 20;
+            void* mem = mmap(NULL, len, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+            pthread_mutex_t m;
+            ut_slab_lock lock(&m);
+            {
+                MemorySlab other(mem, len, &lock);
+                other.enable_thread_cache();
+                p = other.alloc(64);
+                other.free(p);
+            }
+            munmap(mem, len);
+        });
+    }
+    while (ready < UT_SLAB_THREADS) {
+        std::this_thread::yield();
+    }
+    delete slab;
+    // NOTE: poison the pool, a flush into the destroyed pool would corrupt the next one.
+    memset(pool(), 0xa5, UT_SLAB_SIZE);
+
+    go = true;
+    for (auto& t : threads) {
+        t.join();
+    }
+
+    MemorySlab fresh(pool(), UT_SLAB_SIZE, lock_);
+    slab_stat_t base, st;
+    fresh.stat(base);
+    fresh.enable_thread_cache();
+    EXPECT_EQ(ut_slab_churn(fresh, 1, UT_SLAB_ITERS), 0);
+    fresh.flush_thread_cache();
+    fresh.stat(st);
+    EXPECT_EQ(st.b_cached, 0u);
+    EXPECT_EQ(st.used_size, base.used_size);
+}
+
+TEST_F(SlabTest, ForkDropsInheritedCache) {
+    MemorySlab slab(pool(), UT_SLAB_SIZE, lock_);
+    slab_stat_t base, st;
+    slab.stat(base);
+    slab.enable_thread_cache();
+    void* ps[10];
+    for (auto& p : ps) {
+        p = slab.alloc(64);
+    }
+    for (auto p : ps) {
+        slab.free(p);
+    }
+    slab.stat(st);
+    ASSERT_GT(st.b_cached, 0u);
+
+    // NOTE: the child counts the parent's cached blocks as used and never hands them out.
+    pid_t pid = fork();
+    ASSERT_GE(pid, 0);
+    if (pid == 0) {
+        slab_stat_t cst;
+        slab.stat(cst);
+        if (cst.b_cached != 0) {
+            _exit(2);
+        }
+        if (ut_slab_churn(slab, 12345, UT_SLAB_ITERS) != 0) {
+            _exit(3);
+        }
+        slab.flush_thread_cache();
+        slab.stat(cst);
+        _exit(cst.b_cached == 0 ? 0 : 4);
+    }
+    int corrupt = ut_slab_churn(slab, 54321, UT_SLAB_ITERS);
+    int status = 0;
+    ASSERT_EQ(waitpid(pid, &status, 0), pid);
+    EXPECT_TRUE(WIFEXITED(status)) << status;
+    EXPECT_EQ(WEXITSTATUS(status), 0);
+    EXPECT_EQ(corrupt, 0);
+
+    slab.flush_thread_cache();
+    slab.stat(st);
+    EXPECT_EQ(st.b_cached, 0u);
+    EXPECT_EQ(st.used_size, base.used_size);
+}
@@ -0,0 +1,133 @@
+/**
+ * Copyright © 2021 <wotsen>.
+ * 
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of this software
+ * and associated documentation files (the “Software”), to deal in the Software without
+ * restriction, including without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sublicense, and/or sell copies of the Software, and to permit persons to whom the
+ * 
+ * The above copyright notice and this permission notice shall be included in all copies or
+ * substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED “AS IS”, WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING
+ * BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM,
+ * DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ * 
+ * @file ut_ssl.cpp
+ * @brief 
+ * @author wotsen (astralrovers@outlook.com)
+ * @version 1.0.0
+ * @date 2021-06-27
+ * 
+ * @copyright MIT
+ * 
+ */
+#include <gtest/gtest.h>
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <sys/socket.h>
+#include <unistd.h>
+#include <atomic>
+#include <thread>
+
+#include "ars/sdk/event/loop.hpp"
+#include "ars/sdk/net/ssl.hpp"
+#include "ut_ssl.hpp"
+
+using namespace ars::sdk;
+using namespace ars::sdk::event;
+
+#define UT_SESSION_PORT_A 23520
+#define UT_SESSION_PORT_B 23521
+// NOTE: one session a shard, new sessions keep evicting the others.
+#define UT_SESSION_CACHE 16
+#define UT_SESSION_ROUNDS 100
+
+// NOTE: read till the client leaves, then the server side closes.
+static void session_accept_cb(io_t* io) {
+    io_read(io);
+}
+
+static void session_close(SSL* ssl) {
+    SSL_shutdown(ssl);
+    close(SSL_get_fd(ssl));
+    SSL_free(ssl);
+}
+
+// NOTE: sessions are made on loop a and resumed on loop b,
+// while full handshakes on loop a evict them from the shared cache.
+TEST(Ssl, SessionCacheResumeOnOtherLoop) {
+    std::string crt, key;
+    ASSERT_TRUE(ut_make_cert(crt, key));
+    ssl_ctx_init_param_t param;
+    memset(&param, 0, sizeof(param));
+    param.crt_file = crt.c_str();
+    param.key_file = key.c_str();
+    param.endpoint = 0;
+    param.session_cache = UT_SESSION_CACHE;
+    param.no_session_ticket = 1;
+    ssl_ctx_t ctx = ssl_ctx_init(&param);
+    ASSERT_TRUE(ctx != NULL);
+
+    loop_t* loop_a = loop_new(0);
+    loop_t* loop_b = loop_new(0);
+    io_t* listenio = loop_create_tcp_server(loop_a, "127.0.0.1", UT_SESSION_PORT_A, session_accept_cb);
+    ASSERT_TRUE(listenio != NULL);
+    io_enable_ssl(listenio);
+    listenio = loop_create_tcp_server(loop_b, "127.0.0.1", UT_SESSION_PORT_B, session_accept_cb);
+    ASSERT_TRUE(listenio != NULL);
+    io_enable_ssl(listenio);
+    std::thread runner_a([loop_a] { loop_run(loop_a); });
+    std::thread runner_b([loop_b] { loop_run(loop_b); });
+
+    // NOTE: tls 1.2 resumes by session id, that is by the server cache.
+    SSL_CTX* client_ctx = SSL_CTX_new(TLS_client_method());
+    SSL_CTX_set_max_proto_version(client_ctx, TLS1_2_VERSION);
+    SSL_CTX_set_options(client_ctx, SSL_OP_NO_TICKET);
+
+    SSL* ssl = ut_ssl_connect(client_ctx, UT_SESSION_PORT_A);
+    ASSERT_TRUE(ssl != NULL);
+    SSL_SESSION* session = SSL_get1_session(ssl);
+    session_close(ssl);
+    ssl = ut_ssl_connect(client_ctx, UT_SESSION_PORT_B, session);
+    ASSERT_TRUE(ssl != NULL);
+    EXPECT_EQ(SSL_session_reused(ssl), 1);
+    session_close(ssl);
+    SSL_SESSION_free(session);
+
+    std::atomic<bool> stop(false);
+    std::thread evictor([client_ctx, &stop] {
+        while (!stop.load()) {
+            SSL* ssl = ut_ssl_connect(client_ctx, UT_SESSION_PORT_A);
+            if (ssl) session_close(ssl);
+        }
+    });
+    int connected = 0, reused = 0;
+    for (int i = 0; i < UT_SESSION_ROUNDS; ++i) {
+        ssl = ut_ssl_connect(client_ctx, UT_SESSION_PORT_A);
+        if (ssl == NULL) continue;
+        session = SSL_get1_session(ssl);
+        session_close(ssl);
+        ssl = ut_ssl_connect(client_ctx, UT_SESSION_PORT_B, session);
+        SSL_SESSION_free(session);
+        if (ssl == NULL) continue;
+        ++connected;
+        reused += SSL_session_reused(ssl);
+        session_close(ssl);
+    }
+    stop.store(true);
+    evictor.join();
+    EXPECT_EQ(connected, UT_SESSION_ROUNDS);
+    EXPECT_GT(reused, 0);
+
+    SSL_CTX_free(client_ctx);
+    loop_stop(loop_a);
+    loop_stop(loop_b);
+    runner_a.join();
+    runner_b.join();
+    loop_free(&loop_a);
+    loop_free(&loop_b);
+    ssl_ctx_cleanup(ctx);
+}
@@ -0,0 +1,234 @@
+/**
+ * Copyright © 2021 <wotsen>.
+ * 
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of this software
+ * and associated documentation files (the “Software”), to deal in the Software without
+ * restriction, including without limitation the rights to use, copy, modify, merge, publish,
+ * distribute, sublicense, and/or sell copies of the Software, and to permit persons to whom the
+ * 
+ * The above copyright notice and this permission notice shall be included in all copies or
+ * substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED “AS IS”, WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING
+ * BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND
+ * NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM,
+ * DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ * 
+ * @file ut_timewheel.cpp
+ * @brief 
+ * @author wotsen (astralrovers@outlook.com)
+ * @version 1.0.0
+ * @date 2021-06-27
+ * 
+ * @copyright MIT
+ * 
+ */
+#include <gtest/gtest.h>
+#include <stdlib.h>
+#include <string.h>
+#include <algorithm>
+#include <set>
+#include <vector>
+
+#include "ars/sdk/ds/heap.hpp"
+#include "ars/sdk/ds/timewheel.hpp"
+#include "ars/sdk/event/loop.hpp"
+
+using namespace ars::sdk;
+
+// NOTE: every node is in the wheel and in a reference min-heap by expires.
+struct ut_tw_node {
+    struct timewheel_node wheel;
+    struct heap_node heap;
+    uint64_t expires;
+    int id;
+};
+
+static int ut_tw_compare(const struct heap_node* lhs, const struct heap_node* rhs) {
+    return container_of(lhs, ut_tw_node, heap)->expires < container_of(rhs, ut_tw_node, heap)->expires;
+}
+
+static std::vector<int> ut_tw_expire(struct timewheel* tw, uint64_t now) {
+    std::vector<int> ids;
+    struct list_head expired;
+    list_init(&expired);
+    timewheel_expire(tw, now, &expired);
+    while (!list_empty(&expired)) {
+        ut_tw_node* node = container_of(expired.next, ut_tw_node, wheel.link);
+        list_del(expired.next);
+        EXPECT_EQ(node->wheel.slot, TIMEWHEEL_NOSLOT);
+        ids.push_back(node->id);
+    }
+    return ids;
+}
+
+static std::vector<int> ut_heap_expire(struct heap* heap, uint64_t now) {
+    std::vector<int> ids;
+    while (heap->root && container_of(heap->root, ut_tw_node, heap)->expires <= now) {
+        ids.push_back(container_of(heap->root, ut_tw_node, heap)->id);
+        heap_dequeue(heap);
+    }
+    return ids;
+}
+
+static std::set<int> ut_set(const std::vector<int>& ids) { return std::set<int>(ids.begin(), ids.end()); }
+
+// NOTE: spans of every level, nodes must come out in the same expire call as from the heap.
+TEST(Timewheel, CascadeMatchesHeap) {
+    static struct timewheel tw;
+    struct heap heap;
+    timewheel_init(&tw, 1000);
+    heap_init(&heap, ut_tw_compare);
+    const uint64_t spans[] = {1, 255, 256, 300, 1 << 14, (1 << 14) + 7, 1 << 20, 5000000, 1ull << 26, (1ull << 31) + 3};
+    const int nspans = sizeof(spans) / sizeof(spans[0]);
+    std::vector<ut_tw_node> nodes(2000);
+    srand(7);
+    uint64_t now = 1000;
+    size_t next = 0;
+    size_t expired = 0;
+    while (expired < nodes.size()) {
+        // add a few at the current time, then step time forward by a random amount
+        for (int i = 0; i < 4 && next < nodes.size(); ++i, ++next) {
+            ut_tw_node* node = &nodes[next];
+            memset(node, 0, sizeof(*node));
+            node->id = (int)next;
+            node->expires = now + spans[rand() % nspans] + rand() % 64;
+            timewheel_add(&tw, &node->wheel, node->expires);
+            heap_insert(&heap, &node->heap);
+        }
+        uint64_t step = heap.root ? container_of(heap.root, ut_tw_node, heap)->expires - now : 1;
+        now += rand() % 2 ? step : 1 + rand() % (step + 1);
+        std::vector<int> got = ut_tw_expire(&tw, now);
+        std::vector<int> want = ut_heap_expire(&heap, now);
+        ASSERT_EQ(ut_set(got), ut_set(want)) << "now " << now;
+        expired += got.size();
+        ASSERT_EQ(tw.nelts, heap.nelts);
+    }
+    EXPECT_EQ(tw.nelts, 0);
+}
+
+TEST(Timewheel, NextExpiresAndSkipAhead) {
+    static struct timewheel tw;
+    timewheel_init(&tw, 0);
+    EXPECT_EQ(timewheel_next_expires(&tw), UINT64_MAX);
+
+    // NOTE: idle wheel jumps straight to now.
+    struct list_head expired;
+    list_init(&expired);
+    EXPECT_EQ(timewheel_expire(&tw, 123456, &expired), 0);
+    EXPECT_EQ(tw.base, 123457u);
+
+    ut_tw_node root, upper;
+    timewheel_add(&tw, &root.wheel, tw.base + 100);
+    EXPECT_EQ(timewheel_next_expires(&tw), tw.base + 100);
+    timewheel_remove(&tw, &root.wheel);
+
+    // NOTE: upper level node, next_expires is its cascade tick, never later than expires.
+    uint64_t expires = tw.base + 100000;
+    timewheel_add(&tw, &upper.wheel, expires);
+    uint64_t next = timewheel_next_expires(&tw);
+    EXPECT_GT(next, tw.base);
+    EXPECT_LE(next, expires);
+
+    // NOTE: one call skips all the empty ticks up to now, nothing expires early.
+    EXPECT_EQ(timewheel_expire(&tw, expires - 1, &expired), 0);
+    EXPECT_EQ(tw.base, expires);
+    EXPECT_EQ(timewheel_next_expires(&tw), expires);
+    EXPECT_EQ(timewheel_expire(&tw, expires, &expired), 1);
+    EXPECT_EQ(expired.next, &upper.wheel.link);
+    EXPECT_EQ(timewheel_next_expires(&tw), UINT64_MAX);
+
+    // NOTE: beyond the max span, clamped into the last level and linked again by its
+    // real expires on each cascade, never expired early.
+    ut_tw_node far;
+    uint64_t far_expires = tw.base + TIMEWHEEL_MAX_SPAN * 2 + 12345;
+    timewheel_add(&tw, &far.wheel, far_expires);
+    list_init(&expired);
+    EXPECT_EQ(timewheel_expire(&tw, tw.base + TIMEWHEEL_MAX_SPAN, &expired), 0);
+    EXPECT_EQ(timewheel_expire(&tw, far_expires - 1, &expired), 0);
+    EXPECT_EQ(timewheel_expire(&tw, far_expires, &expired), 1);
+    EXPECT_EQ(far.wheel.expires, far_expires);
+}
+
+// NOTE: all nodes sit in the same level 1 slot, which cascades into the root at tick 1 << 14.
+TEST(Timewheel, ResetAndDeleteInCascadingSlot) {
+    static struct timewheel tw;
+    timewheel_init(&tw, 0);
+    const uint64_t cascade = 1 << TIMEWHEEL_SHIFT(1);
+    ut_tw_node nodes[4];
+    for (int i = 0; i < 4; ++i) {
+        memset(&nodes[i], 0, sizeof(nodes[i]));
+        nodes[i].id = i;
+        timewheel_add(&tw, &nodes[i].wheel, cascade + 10 * i);
+    }
+    EXPECT_EQ(nodes[0].wheel.slot, nodes[3].wheel.slot);
+
+    // before the cascade: delete 1, reset 2 to later
+    timewheel_remove(&tw, &nodes[1].wheel);
+    timewheel_remove(&tw, &nodes[1].wheel);
+    timewheel_remove(&tw, &nodes[2].wheel);
+    timewheel_add(&tw, &nodes[2].wheel, cascade + 500);
+    EXPECT_EQ(tw.nelts, 3);
+
+    // cascade: 0 expires on the cascade tick and is reset, 3 moves to a root slot and is deleted
+    EXPECT_TRUE(ut_tw_expire(&tw, cascade - 1).empty());
+    EXPECT_EQ(ut_tw_expire(&tw, cascade), std::vector<int>{0});
+    timewheel_add(&tw, &nodes[0].wheel, cascade + 200);
+    EXPECT_LT(nodes[3].wheel.slot, TIMEWHEEL_ROOT_SIZE);
+    timewheel_remove(&tw, &nodes[3].wheel);
+    EXPECT_EQ(tw.nelts, 2);
+
+    EXPECT_EQ(ut_tw_expire(&tw, cascade + 199), std::vector<int>());
+    EXPECT_EQ(ut_tw_expire(&tw, cascade + 200), std::vector<int>{0});
+    EXPECT_EQ(ut_tw_expire(&tw, cascade + 499), std::vector<int>());
+    EXPECT_EQ(ut_tw_expire(&tw, cascade + 500), std::vector<int>{2});
+    EXPECT_EQ(tw.nelts, 0);
+}
+
+// NOTE: same deadline, one added early into an upper level, one late into the root.
+// Both expire on the same tick, as they would from the heap.
+TEST(Timewheel, EqualDeadlinesAcrossLevels) {
+    static struct timewheel tw;
+    timewheel_init(&tw, 0);
+    ut_tw_node early, late;
+    early.id = 0;
+    late.id = 1;
+    timewheel_add(&tw, &early.wheel, 300);
+    EXPECT_GE(early.wheel.slot, TIMEWHEEL_ROOT_SIZE);
+    EXPECT_TRUE(ut_tw_expire(&tw, 99).empty());
+    timewheel_add(&tw, &late.wheel, 300);
+    EXPECT_LT(late.wheel.slot, TIMEWHEEL_ROOT_SIZE);
+    EXPECT_TRUE(ut_tw_expire(&tw, 299).empty());
+    EXPECT_EQ(ut_set(ut_tw_expire(&tw, 300)), (std::set<int>{0, 1}));
+}
+
+static std::vector<uint32_t> ut_fired;
+
+static void ut_timer_cb(event::timer_t* timer) {
+    ut_fired.push_back((uint32_t)(uintptr_t)ars_event_userdata(timer));
+    if (ut_fired.size() == 9) {
+        event::loop_stop(ars_event_loop(timer));
+    }
+}
+
+// NOTE: the wheel fires loop timers in the deadline order of the heap, equal ones together.
+TEST(Timewheel, LoopEqualDeadlinesMatchHeap) {
+    const uint32_t timeouts[] = {30, 10, 20, 10, 30, 20, 10, 20, 30};
+    std::vector<uint32_t> orders[2];
+    for (int mode = 0; mode < 2; ++mode) {
+        event::loop_t* loop = event::loop_new(mode ? ARS_LOOP_FLAG_TIMER_HEAP : 0);
+        ut_fired.clear();
+        for (uint32_t timeout : timeouts) {
+            event::timer_t* timer = event::timer_add(loop, ut_timer_cb, timeout, 1);
+            ars_event_set_userdata(timer, (uintptr_t)timeout);
+        }
+        event::loop_run(loop);
+        event::loop_free(&loop);
+        orders[mode] = ut_fired;
+    }
+    std::vector<uint32_t> want(timeouts, timeouts + 9);
+    std::sort(want.begin(), want.end());
+    EXPECT_EQ(orders[0], want);
+    EXPECT_EQ(orders[1], want);
+}